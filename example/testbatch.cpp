@@ -0,0 +1,238 @@
+/**********************************************************
+ * This is a test program for BatchReader, BatchWriter and
+ * batchImage()
+ *
+ *   - the images handed out by BatchReader, in the order of
+ *     the list, against readImage() of each file: P5, P6,
+ *     P2, 16-bit and PFM files of different sizes, read up
+ *     to 1, 2 and 5 files ahead
+ *   - the images kept or modified by the caller are not
+ *     touched when their buffers are recycled
+ *   - a reader destroyed before the end of its list, and an
+ *     empty list
+ *   - the files written by BatchWriter, with and without
+ *     rescaling, the image modified right after write(),
+ *     against writeImage(), byte for byte
+ *   - batchImage() against the function applied to each
+ *     image
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include "BatchIO.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+#define Usage "./testbatch\n"
+
+#define NFILE 11
+
+static char refName[] = "testbatch_ref.pnm";
+
+
+/**
+ * The contents of a file.
+ */
+string fileBytes(const char *name)
+{
+  ifstream ifp(name, ios::in | ios::binary);
+  ostringstream s;
+
+  s << ifp.rdbuf();
+  return s.str();
+}
+
+
+/**
+ * 1 if a and b have the same size, maxval and pixels.
+ */
+int same(const Image &a, const Image &b)
+{
+  int i, j, k;
+
+  if (a.getRow() != b.getRow() || a.getCol() != b.getCol() ||
+      a.getChannel() != b.getChannel() || a.getMaxval() != b.getMaxval())
+    return 0;
+  for (k=0; k<a.getChannel(); k++)
+    for (i=0; i<a.getRow(); i++)
+      for (j=0; j<a.getCol(); j++)
+        if (a(i,j,k) != b(i,j,k))
+          return 0;
+  return 1;
+}
+
+
+/**
+ * An image of nr x nc pixels of the type t, the maxval maxval, random
+ * pixels in [0, maxval] and, when frac is set, out of it and fractional.
+ */
+Image testImage(int nr, int nc, int t, int maxval, int frac)
+{
+  Image img(nr, nc, t);
+  int i, j, k;
+
+  img.setMaxval(maxval);
+  for (k=0; k<img.getChannel(); k++)
+    for (i=0; i<nr; i++)
+      for (j=0; j<nc; j++)
+        img(i,j,k) = rand() % (maxval + 1) +
+                     (frac ? (rand() % 81 - 40) + 0.25 : 0);
+  return img;
+}
+
+
+/**
+ * Read the files of names with a BatchReader, ahead files ahead, and
+ * check the images against refs; every other image is kept, and the
+ * others are modified, before the next one is asked for.
+ */
+int readAll(const vector<string> &names, const vector<Image> &refs,
+            int ahead)
+{
+  BatchReader in(names, ahead);
+  vector<Image> kept;
+  Image img;
+  int n, ok = 1;
+
+  for (n=0; in.next(img); n++) {
+    if (n >= (int)refs.size() || in.getIndex() != n ||
+        in.getName() != names[n] || !same(img, refs[n])) {
+      cout << "ahead " << ahead << ": image " << n << " differs\n";
+      return 0;
+    }
+    if (n % 2)
+      kept.push_back(img);
+    else
+      img(0,0) = -1;
+  }
+  if (n != (int)refs.size() || img.getRow() != 0) {
+    cout << "ahead " << ahead << ": " << n << " images of "
+         << refs.size() << endl;
+    ok = 0;
+  }
+  for (n=0; n<(int)kept.size(); n++)
+    if (!same(kept[n], refs[2*n+1])) {
+      cout << "ahead " << ahead << ": image " << 2*n+1
+           << " kept is changed\n";
+      ok = 0;
+    }
+  return ok;
+}
+
+
+int main()
+{
+  int types[NFILE] = {PGMRAW, PPMRAW, PGMASCII, PGMRAW, PPMRAW, PGMRAW,
+                      PGMRAW, PPMASCII, PGMRAW, PPMRAW, PGMRAW};
+  int maxvals[NFILE] = {255, 255, 255, 1000, 65535, 255, 255, 255, 4095,
+                        255, 255};
+  int aheads[3] = {1, 2, 5};
+  vector<string> names, outs, none;
+  vector<Image> imgs, refs;
+  Image img, mask(3, 3);
+  int n, a, i, j, ok = 1;
+
+  srand(17);
+  for (n=0; n<NFILE; n++) {
+    names.push_back("testbatch_in" + to_string(n) + ".pnm");
+    outs.push_back("testbatch_out" + to_string(n) + ".pnm");
+    imgs.push_back(testImage(20 + 7 * n, 45 - 3 * n, types[n], maxvals[n],
+                             n % 3 == 1));
+    if (n == 6)                        // floats as they are
+      writePFM(imgs[n], (char *) names[n].c_str());
+    else
+      writeImage(imgs[n], (char *) names[n].c_str());
+    refs.push_back(readImage((char *) names[n].c_str()));
+  }
+
+  // the images read ahead
+  for (a=0; a<3; a++)
+    ok &= readAll(names, refs, aheads[a]);
+
+  // a reader destroyed with files left, and an empty list
+  {
+    BatchReader in(names, 3);
+    if (!in.next(img) || !same(img, refs[0])) {
+      cout << "the first image differs\n";
+      ok = 0;
+    }
+  }
+  {
+    BatchReader in(none);
+    if (in.next(img) || in.getIndex() != -1) {
+      cout << "an empty list gives an image\n";
+      ok = 0;
+    }
+  }
+
+  // the images written, the rescale flag on the odd ones; each image is
+  // modified right after it is queued
+  {
+    BatchWriter out(2);
+    for (n=0; n<NFILE; n++) {
+      img = imgs[n];
+      out.write(img, outs[n], n % 2);
+      img(0,0) = img(0,0) + 1000;
+    }
+    out.flush();
+    for (n=0; n<NFILE; n++) {
+      writeImage(imgs[n], refName, n % 2);
+      if (fileBytes(outs[n].c_str()) != fileBytes(refName)) {
+        cout << "file " << n << " written differs\n";
+        ok = 0;
+      }
+    }
+  }
+
+  // the images queued are written by the destructor
+  for (n=0; n<NFILE; n++)
+    remove(outs[n].c_str());
+  {
+    BatchWriter out(3);
+    for (n=0; n<NFILE; n++)
+      out.write(imgs[n], outs[n]);
+  }
+  for (n=0; n<NFILE; n++) {
+    writeImage(imgs[n], refName);
+    if (fileBytes(outs[n].c_str()) != fileBytes(refName)) {
+      cout << "file " << n << " written at the end differs\n";
+      ok = 0;
+    }
+  }
+
+  // a 3x3 mean of each file
+  for (i=0; i<3; i++)
+    for (j=0; j<3; j++)
+      mask(i,j) = 1;
+  batchImage(names, outs, 2, [&](const Image &f) -> Image {
+               return conv(f, mask) / 9;
+             });
+  for (n=0; n<NFILE; n++) {
+    writeImage(Image(conv(refs[n], mask) / 9), refName);
+    if (fileBytes(outs[n].c_str()) != fileBytes(refName)) {
+      cout << "batchImage() of file " << n << " differs\n";
+      ok = 0;
+    }
+  }
+
+  for (n=0; n<NFILE; n++) {
+    remove(names[n].c_str());
+    remove(outs[n].c_str());
+  }
+  remove(refName);
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,286 @@
+/**********************************************************
+ * This is a test program for the paths of conv(): each one
+ * is checked against the direct convolution computed here
+ *
+ *   - separable masks (row and column passes)
+ *   - the FFT, forced, disabled and at the default crossover
+ *   - the four border modes
+ *   - 1 thread and several threads (same result)
+ *   - convMulti() and convGradient()
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include "Parallel.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+#define Usage "./testconvpaths\n"
+
+#define TOL 1e-5        // error allowed, over the largest output of a mask
+                        // (about the rounding of its FFT in float)
+#define NMASK 7
+#define NIMG 3
+
+static const char *borderName[] = {"zero", "replicate", "reflect", "wrap"};
+
+
+/**
+ * The pixel read for index i of a row or column of n pixels, -1 when it
+ * is 0 (BORDERZERO).
+ */
+int borderIndex(int i, int n, int border)
+{
+  if (i >= 0 && i < n)
+    return i;
+  switch (border) {
+  case BORDERREPLICATE:
+    return (i < 0) ? 0 : n-1;
+  case BORDERREFLECT:
+    while (i < 0 || i >= n)
+      i = (i < 0) ? -1-i : 2*n-1-i;
+    return i;
+  case BORDERWRAP:
+    return (i % n + n) % n;
+  }
+  return -1;
+}
+
+
+/**
+ * The direct convolution: output pixel (i,j) is the sum of the taps
+ * times the pixels around (i,j), in double.
+ */
+Image direct(const Image &img, const Image &mask, int border)
+{
+  int i, j, k, a, c, y, x, nr, nc, rr, rc;
+  double s;
+  Image out;
+
+  nr = img.getRow();
+  nc = img.getCol();
+  rr = mask.getRow() / 2;
+  rc = mask.getCol() / 2;
+  out.createImage(nr, nc, img.getType());
+  for (k=0; k<img.getChannel(); k++)
+    for (i=0; i<nr; i++)
+      for (j=0; j<nc; j++) {
+        s = 0;
+        for (a=0; a<mask.getRow(); a++)
+          for (c=0; c<mask.getCol(); c++) {
+            y = borderIndex(i+a-rr, nr, border);
+            x = borderIndex(j+c-rc, nc, border);
+            if (y >= 0 && x >= 0)
+              s += mask(a,c) * img(y,x,k);
+          }
+        out(i,j,k) = s;
+      }
+  return out;
+}
+
+
+/**
+ * The largest difference between a and b, over the largest output of
+ * the mask, 255 times the sum of its absolute taps: rounding is relative
+ * to the terms of the sums, not to their result, which is near 0 for
+ * masks summing to 0.
+ */
+double relError(const Image &a, const Image &b, const Image &mask)
+{
+  int i, j, k;
+  double d, e = 0, s = 0;
+
+  if (a.getRow() != b.getRow() || a.getCol() != b.getCol() ||
+      a.getChannel() != b.getChannel())
+    return 1;
+  for (i=0; i<mask.getRow(); i++)
+    for (j=0; j<mask.getCol(); j++)
+      s += 255 * fabs(mask(i,j));
+  for (k=0; k<a.getChannel(); k++)
+    for (i=0; i<a.getRow(); i++)
+      for (j=0; j<a.getCol(); j++) {
+        d = fabs(a(i,j,k) - b(i,j,k));
+        if (d > e)
+          e = d;
+      }
+  return e / (s > 0 ? s : 1);
+}
+
+
+/**
+ * 1 if a and b hold the same pixels, bit for bit.
+ */
+int same(const Image &a, const Image &b)
+{
+  int i, j, k;
+
+  for (k=0; k<a.getChannel(); k++)
+    for (i=0; i<a.getRow(); i++)
+      for (j=0; j<a.getCol(); j++)
+        if (a(i,j,k) != b(i,j,k))
+          return 0;
+  return 1;
+}
+
+
+/**
+ * A mask of nr x nc taps, random integers in [-4, 4] when sep is 0, the
+ * product of a random column and a random row otherwise.
+ */
+Image randomMask(int nr, int nc, int sep)
+{
+  int i, j;
+  vector<float> u(nr), v(nc);
+  Image mask(nr, nc);
+
+  for (i=0; i<nr; i++)
+    u[i] = rand() % 9 - 4 + 0.5;
+  for (j=0; j<nc; j++)
+    v[j] = rand() % 9 - 4 + 0.5;
+  for (i=0; i<nr; i++)
+    for (j=0; j<nc; j++)
+      mask(i,j) = sep ? u[i] * v[j] : rand() % 9 - 4;
+  return mask;
+}
+
+
+/**
+ * Print a failed case.
+ */
+int fail(const char *what, const Image &img, const Image &mask, int border,
+         double err)
+{
+  cout << what << ": " << mask.getRow() << "x" << mask.getCol()
+       << " mask, " << img.getRow() << "x" << img.getCol() << "x"
+       << img.getChannel() << " image, " << borderName[border]
+       << " border, error " << err << endl;
+  return 0;
+}
+
+
+int main()
+{
+  Image imgs[NIMG], masks[NMASK], ref, out, out1, mag, dir, sx, sy;
+  vector<Image> multi, outs;
+  float cross[3] = {-1, 0, 10};  // spatial, FFT, default
+  double err, d;
+  int i, j, k, b, m, n, c, ok = 1;
+
+  srand(7);
+
+  // an odd-sized gray image, a color image and one smaller than the masks
+  imgs[0].createImage(97, 83);
+  imgs[1].createImage(60, 50, PPMRAW);
+  imgs[2].createImage(3, 2);
+  for (n=0; n<NIMG; n++)
+    for (k=0; k<imgs[n].getChannel(); k++)
+      for (i=0; i<imgs[n].getRow(); i++)
+        for (j=0; j<imgs[n].getCol(); j++)
+          imgs[n](i,j,k) = rand() % 256;
+
+  // separable masks, small masks of odd and even sizes below the
+  // crossover, and large ones above it
+  masks[0] = gaussianKernel(2);
+  masks[1] = randomMask(5, 9, 1);
+  masks[2] = randomMask(3, 3, 0);
+  masks[3] = randomMask(4, 7, 0);
+  masks[4] = randomMask(15, 15, 0);
+  masks[5] = randomMask(31, 31, 0);
+  masks[6] = LoG(2.0);
+
+  // conv() on each path against the direct convolution
+  for (b=0; b<4; b++)
+    for (m=0; m<NMASK; m++)
+      for (n=0; n<NIMG; n++) {
+        ref = direct(imgs[n], masks[m], b);
+        for (c=0; c<3; c++) {
+          setConvCrossover(cross[c]);
+          out = conv(imgs[n], masks[m], b);
+          err = relError(out, ref, masks[m]);
+          if (err > TOL)
+            ok = fail(c == 0 ? "conv spatial" : c == 1 ? "conv FFT" :
+                      "conv default", imgs[n], masks[m], b, err);
+        }
+      }
+  setConvCrossover(10);
+
+  // the same result on 1 thread and on several, on each path
+  for (c=0; c<3; c++) {
+    setConvCrossover(cross[c]);
+    for (m=0; m<NMASK; m++) {
+      setThreads(1);
+      conv(imgs[0], masks[m], out1, BORDERREFLECT);
+      setThreads(4);
+      conv(imgs[0], masks[m], out, BORDERREFLECT);
+      if (!same(out, out1))
+        ok = fail("conv threads", imgs[0], masks[m], BORDERREFLECT,
+                  relError(out, out1, masks[m]));
+    }
+  }
+  setThreads(0);
+  setConvCrossover(10);
+
+  // convMulti(), more masks than are applied together, of mixed sizes
+  multi.push_back(masks[2]);
+  multi.push_back(randomMask(1, 5, 0));
+  multi.push_back(randomMask(5, 1, 0));
+  multi.push_back(masks[3]);
+  multi.push_back(masks[0]);
+  multi.push_back(randomMask(7, 7, 0));
+  for (b=0; b<4; b++)
+    for (n=0; n<NIMG; n++) {
+      convMulti(imgs[n], multi, outs, b);
+      for (m=0; m<(int)multi.size(); m++) {
+        err = relError(outs[m], direct(imgs[n], multi[m], b), multi[m]);
+        if (err > TOL)
+          ok = fail("convMulti", imgs[n], multi[m], b, err);
+      }
+    }
+
+  // convGradient() with the masks of sobel()
+  sx.createImage(3, 3);
+  sy.createImage(3, 3);
+  for (i=0; i<3; i++) {
+    sx(i,0) = sy(0,i) = (i == 1) ? -2 : -1;
+    sx(i,1) = sy(1,i) = 0;
+    sx(i,2) = sy(2,i) = (i == 1) ? 2 : 1;
+  }
+  for (b=0; b<4; b++)
+    for (n=0; n<NIMG; n++) {
+      Image gx = direct(imgs[n], sx, b);
+      Image gy = direct(imgs[n], sy, b);
+
+      convGradient(imgs[n], sx, sy, mag, dir, b);
+      ref = gx;
+      for (k=0; k<ref.getChannel(); k++)
+        for (i=0; i<ref.getRow(); i++)
+          for (j=0; j<ref.getCol(); j++)
+            ref(i,j,k) = sqrt(gx(i,j,k) * gx(i,j,k) + gy(i,j,k) * gy(i,j,k));
+      err = relError(mag, ref, sx);
+      if (err > TOL)
+        ok = fail("convGradient magnitude", imgs[n], sx, b, err);
+      // the directions, in radians, PI and -PI being the same
+      err = 0;
+      for (k=0; k<ref.getChannel(); k++)
+        for (i=0; i<ref.getRow(); i++)
+          for (j=0; j<ref.getCol(); j++) {
+            d = fabs(dir(i,j,k) - atan2(gy(i,j,k), gx(i,j,k)));
+            err = max(err, min(d, fabs(d - 2*M_PI)));
+          }
+      if (err > TOL)
+        ok = fail("convGradient direction", imgs[n], sx, b, err);
+    }
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
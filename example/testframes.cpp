@@ -0,0 +1,396 @@
+/**********************************************************
+ * This is a test program for FrameReader and FrameWriter
+ *
+ *   - a stream of frames whose header changes from frame to
+ *     frame (size, gray and color, maxval, a comment) or
+ *     stays the same, 8 and 16-bit P5/P6 frames, PFM and PAM
+ *     frames, frames larger than the block read at once,
+ *     read from the file, from a pipe and from stdin into
+ *     Image, Image16 and Image8, against readImage() of each
+ *     frame as a file of its own
+ *   - the frames written by FrameWriter, to a named file and
+ *     to a file descriptor, against writeImage() of each
+ *     frame, byte for byte
+ *   - a stream cut in a header or in a frame, and a stream
+ *     with an ASCII frame, are reported (exit status 1),
+ *     from the file and from a pipe; a stream cut between
+ *     two frames ends there
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include "FrameIO.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+#define Usage "./testframes\n"
+
+#define NFRAME 13
+
+static char fileName[] = "testframes.pnm";
+static char oneName[] = "testframes_one.pnm";
+
+
+/**
+ * The contents of a file.
+ */
+string fileBytes(const char *name)
+{
+  ifstream ifp(name, ios::in | ios::binary);
+  ostringstream s;
+
+  s << ifp.rdbuf();
+  return s.str();
+}
+
+
+/**
+ * Write bytes to a file.
+ */
+void putBytes(const char *name, const string &bytes)
+{
+  ofstream ofp(name, ios::out | ios::binary | ios::trunc);
+
+  ofp.write(bytes.data(), bytes.size());
+}
+
+
+/**
+ * 1 if a and b have the same size, maxval and pixels.
+ */
+template <class T>
+int same(const BasicImage<T> &a, const BasicImage<T> &b)
+{
+  int i, j, k;
+
+  if (a.getRow() != b.getRow() || a.getCol() != b.getCol() ||
+      a.getChannel() != b.getChannel() || a.getMaxval() != b.getMaxval())
+    return 0;
+  for (k=0; k<a.getChannel(); k++)
+    for (i=0; i<a.getRow(); i++)
+      for (j=0; j<a.getCol(); j++)
+        if (a(i,j,k) != b(i,j,k))
+          return 0;
+  return 1;
+}
+
+
+/**
+ * Fork a child that writes bytes into a pipe; returns the read end.
+ */
+int pipeFrom(const string &bytes, pid_t &pid)
+{
+  int p[2];
+
+  if (pipe(p) != 0) {
+    cout << "Can't create a pipe\n";
+    exit(1);
+  }
+  fflush(stdout);                      // not written again by the child
+  pid = fork();
+  if (pid == 0) {
+    close(p[0]);
+    if (write(p[1], bytes.data(), bytes.size()) != (ssize_t)bytes.size())
+      _exit(1);
+    _exit(0);
+  }
+  close(p[1]);
+  return p[0];
+}
+
+
+/**
+ * Read all the frames of in and check them against refs.
+ */
+template <class T>
+int readFrames(FrameReader &in, const vector<BasicImage<T> > &refs,
+               const char *what)
+{
+  BasicImage<T> img;
+  int n;
+
+  for (n=0; in.next(img); n++)
+    if (n >= (int)refs.size() || !same(img, refs[n]) ||
+        in.getCount() != n + 1) {
+      cout << what << ": frame " << n << " differs\n";
+      return 0;
+    }
+  if (n != (int)refs.size()) {
+    cout << what << ": " << n << " frames of " << refs.size() << endl;
+    return 0;
+  }
+  return 1;
+}
+
+
+/**
+ * Read the frames of bytes from a pipe, given as a file descriptor or,
+ * when stdin is set, as the standard input of a child process.
+ */
+template <class T>
+int readPipe(const string &bytes, const vector<BasicImage<T> > &refs,
+             int stdin, const char *what)
+{
+  char dash[] = "-";
+  pid_t pid, child;
+  int fd, status, ok = 1;
+
+  fd = pipeFrom(bytes, pid);
+  if (!stdin) {
+    FrameReader in(fd);
+    ok = readFrames(in, refs, what);
+  }
+  else {
+    child = fork();
+    if (child == 0) {
+      dup2(fd, 0);
+      close(fd);
+      FrameReader in(dash);
+      _exit(readFrames(in, refs, what) ? 0 : 2);
+    }
+    waitpid(child, &status, 0);
+    ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  close(fd);
+  waitpid(pid, 0, 0);
+  return ok;
+}
+
+
+/**
+ * 1 if reading all the frames of bytes, from a file or, when pipe is set,
+ * from a pipe, exits with status 1; with count >= 0, 1 if instead the
+ * stream ends after count frames.
+ */
+int cut(const string &bytes, int pipe, int count)
+{
+  Image img;
+  pid_t pid, child;
+  int fd = -1, status, n;
+
+  putBytes(fileName, bytes);
+  if (pipe)
+    fd = pipeFrom(bytes, pid);
+  fflush(stdout);
+  child = fork();
+  if (child == 0) {
+    freopen("/dev/null", "w", stdout);
+    if (pipe) {
+      FrameReader in(fd);
+      for (n=0; in.next(img); n++)
+        ;
+      _exit(n == count ? 0 : 2);
+    }
+    FrameReader in(fileName);
+    for (n=0; in.next(img); n++)
+      ;
+    _exit(n == count ? 0 : 2);
+  }
+  waitpid(child, &status, 0);
+  if (pipe) {
+    close(fd);
+    waitpid(pid, 0, 0);
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == ((count < 0) ? 1 : 0);
+}
+
+
+/**
+ * Write the frames imgs, rescaling the odd ones, then img8 and img16.
+ */
+void writeFrames(FrameWriter &out, const vector<Image> &imgs,
+                 const Image8 &img8, const Image16 &img16)
+{
+  int n;
+
+  for (n=0; n<(int)imgs.size(); n++)
+    out.write(imgs[n], n % 2);
+  out.write(img8);
+  out.write(img16);
+  if (out.getCount() != (int)imgs.size() + 2)
+    cout << "FrameWriter: " << out.getCount() << " frames written of "
+         << imgs.size() + 2 << endl;
+}
+
+
+/**
+ * An image of nr x nc pixels of the type t, the maxval maxval, random
+ * pixels in [0, maxval] and, when frac is set, out of it and fractional.
+ */
+Image testImage(int nr, int nc, int t, int maxval, int frac)
+{
+  Image img(nr, nc, t);
+  int i, j, k;
+
+  img.setMaxval(maxval);
+  for (k=0; k<img.getChannel(); k++)
+    for (i=0; i<nr; i++)
+      for (j=0; j<nc; j++)
+        img(i,j,k) = rand() % (maxval + 1) +
+                     (frac ? (rand() % 81 - 40) + 0.25 : 0);
+  return img;
+}
+
+
+int main()
+{
+  // rows, columns, color, maxval, kind: 0 writeImage(), 1 with a comment
+  // in the header, 2 writePFM(), 3 writePAM(); the header changes, or
+  // stays the same, from one frame to the next
+  int frames[NFRAME][5] = {{48, 64, 0, 255, 0}, {48, 64, 0, 255, 0},
+                           {48, 64, 0, 255, 1}, {49, 64, 0, 255, 0},
+                           {49, 64, 1, 255, 0}, {49, 64, 0, 1000, 0},
+                           {20, 30, 1, 65535, 0}, {20, 30, 0, 255, 2},
+                           {20, 30, 1, 255, 2}, {20, 30, 0, 255, 3},
+                           {600, 700, 1, 255, 0}, {600, 700, 1, 255, 0},
+                           {3, 5, 0, 255, 0}};
+  vector<Image> refs, imgs;
+  vector<Image16> refs16;
+  vector<Image8> refs8;
+  vector<size_t> ends;
+  string stream, stream8, bytes, expect;
+  Image img;
+  Image8 img8;
+  Image16 img16;
+  char name[64];
+  int n, p, fd, ok = 1;
+
+  // each frame in a file of its own, kept until the end: readImage8()
+  // uses the pixels of a P5 file in place
+  srand(19);
+  for (n=0; n<NFRAME; n++) {
+    sprintf(name, "testframes%d.pnm", n);
+    img = testImage(frames[n][0], frames[n][1],
+                    frames[n][2] ? PPMRAW : PGMRAW, frames[n][3],
+                    frames[n][4] == 2);
+    if (frames[n][4] == 2)
+      writePFM(img, name);
+    else if (frames[n][4] == 3)
+      writePAM(img, name);
+    else
+      writeImage(img, name);
+    bytes = fileBytes(name);
+    if (frames[n][4] == 1) {
+      bytes.insert(3, "# frame " + to_string(n) + "\n");
+      putBytes(name, bytes);
+    }
+    stream += bytes;
+    ends.push_back(stream.size());
+    refs.push_back(readImage(name));
+    refs16.push_back(readImage16(name));
+    if (frames[n][3] <= 255 && frames[n][4] != 2) {
+      stream8 += bytes;
+      refs8.push_back(readImage8(name));
+    }
+  }
+
+  // from the file, a pipe and stdin
+  putBytes(fileName, stream);
+  {
+    FrameReader in(fileName);
+    ok &= readFrames(in, refs, "Image");
+  }
+  {
+    FrameReader in(fileName);
+    ok &= readFrames(in, refs16, "Image16");
+  }
+  ok &= readPipe(stream, refs, 0, "Image, pipe");
+  ok &= readPipe(stream, refs16, 0, "Image16, pipe");
+  ok &= readPipe(stream, refs, 1, "Image, stdin");
+  putBytes(fileName, stream8);
+  {
+    FrameReader in(fileName);
+    ok &= readFrames(in, refs8, "Image8");
+  }
+  ok &= readPipe(stream8, refs8, 0, "Image8, pipe");
+
+  // cut in the header of frame 3, in the first large frame, by the last
+  // byte, and between the frames 11 and 12
+  for (p=0; p<2; p++) {
+    if (!cut(stream.substr(0, ends[2] + 4), p, -1) ||
+        !cut(stream.substr(0, (ends[9] + ends[10]) / 2), p, -1) ||
+        !cut(stream.substr(0, stream.size() - 1), p, -1)) {
+      cout << "a cut stream is not reported" << (p ? " from a pipe\n" : "\n");
+      ok = 0;
+    }
+    if (!cut(stream.substr(0, ends[11]), p, 12)) {
+      cout << "a stream cut between frames does not end there"
+           << (p ? " from a pipe\n" : "\n");
+      ok = 0;
+    }
+  }
+
+  // an ASCII frame after two raw ones
+  img = testImage(4, 6, PGMASCII, 255, 0);
+  writeImage(img, oneName);
+  for (p=0; p<2; p++)
+    if (!cut(stream.substr(0, ends[1]) + fileBytes(oneName), p, -1)) {
+      cout << "an ASCII frame is not reported"
+           << (p ? " from a pipe\n" : "\n");
+      ok = 0;
+    }
+
+  // the frames written: clamped, rescaled (the odd ones), Image8 and
+  // Image16 frames, to a named file and to a file descriptor
+  for (n=0; n<NFRAME; n++)
+    imgs.push_back(testImage(frames[n][0], frames[n][1],
+                             frames[n][2] ? PPMRAW : PGMRAW, frames[n][3], 1));
+  expect.clear();
+  for (n=0; n<NFRAME; n++) {
+    writeImage(imgs[n], oneName, n % 2);
+    expect += fileBytes(oneName);
+  }
+  img8 = refs8[4];
+  writeImage(img8, oneName);
+  expect += fileBytes(oneName);
+  img16 = refs16[6];
+  img16.setMaxval(4000);
+  writeImage(img16, oneName);
+  expect += fileBytes(oneName);
+  {
+    FrameWriter out(fileName);
+    writeFrames(out, imgs, img8, img16);
+  }
+  if (fileBytes(fileName) != expect) {
+    cout << "the frames written differ from writeImage()\n";
+    ok = 0;
+  }
+  fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  {
+    FrameWriter out(fd);
+    writeFrames(out, imgs, img8, img16);
+  }
+  close(fd);
+  if (fileBytes(fileName) != expect) {
+    cout << "the frames written to a file descriptor differ from "
+         << "writeImage()\n";
+    ok = 0;
+  }
+
+  refs8.clear();
+  img8 = Image8();
+  for (n=0; n<NFRAME; n++) {
+    sprintf(name, "testframes%d.pnm", n);
+    remove(name);
+  }
+  remove(fileName);
+  remove(oneName);
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
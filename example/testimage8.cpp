@@ -0,0 +1,177 @@
+/**********************************************************
+ * This is a test program for the 8-bit paths of median(),
+ * bdilate(), berode() and threshold(): each one is checked
+ * against the float version on the same pixels, pixel for
+ * pixel
+ *
+ *   - median() with odd and even masks, of 1 to 8 pixels,
+ *     and with masks larger than the image; pixels of few
+ *     values (ties) and of all values
+ *   - bdilate() and berode() with odd, even and one-row or
+ *     one-column structuring elements, their origin at each
+ *     corner, on an edge and at the center, with a zero
+ *     origin and with elements larger than the image
+ *   - threshold() with one threshold and with a range,
+ *     integer, fractional and out of [0, 255] thresholds,
+ *     empty ranges, GRAY, BINARY and an unknown type, gray
+ *     and color images
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+#define Usage "./testimage8\n"
+
+#define NTHRESH 14
+
+
+/**
+ * 1 if the 8-bit image a holds the pixels of the float image b, and has
+ * its size and maxval.
+ */
+int same(const Image8 &a, const Image &b)
+{
+  int i, j, k;
+
+  if (a.getRow() != b.getRow() || a.getCol() != b.getCol() ||
+      a.getChannel() != b.getChannel() || a.getMaxval() != b.getMaxval())
+    return 0;
+  for (k=0; k<a.getChannel(); k++)
+    for (i=0; i<a.getRow(); i++)
+      for (j=0; j<a.getCol(); j++)
+        if (a(i,j,k) != b(i,j,k))
+          return 0;
+  return 1;
+}
+
+
+/**
+ * An 8-bit image of nr x nc pixels of the type t: each pixel is 0 with
+ * the probability zero, else a random value of 1 to levels-1 times
+ * 255/(levels-1).
+ */
+Image8 testImage(int nr, int nc, int t, int zero, int levels)
+{
+  Image8 img(nr, nc, t);
+  int i, j, k;
+
+  for (k=0; k<img.getChannel(); k++)
+    for (i=0; i<nr; i++)
+      for (j=0; j<nc; j++)
+        img(i,j,k) = (rand() % 100 < zero) ? 0 :
+                     (1 + rand() % (levels - 1)) * (255 / (levels - 1));
+  return img;
+}
+
+
+/**
+ * Print a failed case.
+ */
+int fail(const char *what, const Image8 &img, const char *how)
+{
+  cout << what << ", " << img.getRow() << "x" << img.getCol() << "x"
+       << img.getChannel() << " image, " << how
+       << ": the 8-bit result differs\n";
+  return 0;
+}
+
+
+int main()
+{
+  // sizes of structuring elements: odd, even, a row, a column, larger
+  // than the small image
+  int ses[6][2] = {{3, 3}, {2, 4}, {1, 5}, {5, 1}, {4, 3}, {6, 7}};
+  float thresh[NTHRESH] = {-1e9, -10, -0.5, 0, 0.25, 1, 99.5, 100, 254.5,
+                           255, 255.5, 256, 300, 1e9};
+  int types[3] = {GRAY, BINARY, 5};
+  Image8 imgs[4], se8;
+  Image se;
+  char how[64];
+  int n, m, s, o, r, c, a, b, t, i, ok = 1;
+
+  srand(29);
+
+  // gray images of all values and of few values, a small one, and a
+  // color one (threshold() only)
+  imgs[0] = testImage(37, 41, PGMRAW, 10, 256);
+  imgs[1] = testImage(30, 23, PGMRAW, 40, 3);
+  imgs[2] = testImage(3, 4, PGMRAW, 30, 256);
+  imgs[3] = testImage(17, 19, PPMRAW, 10, 256);
+
+  // median, masks of 1 to 8 pixels across
+  for (n=0; n<3; n++)
+    for (m=1; m<=8; m++) {
+      sprintf(how, "%dx%d mask", m, m);
+      if (!same(median(imgs[n], m), median(Image(imgs[n]), m)))
+        ok = fail("median", imgs[n], how);
+    }
+
+  // dilation and erosion, the origin at each corner, on the top edge and
+  // at the center, the element's pixels random, 0 or not
+  for (n=0; n<3; n++)
+    for (s=0; s<6; s++)
+      for (o=0; o<6; o++) {
+        r = ses[s][0];
+        c = ses[s][1];
+        se8 = testImage(r, c, PGMRAW, 25, 256);
+        switch (o) {
+        case 0: a = 0; b = 0; break;
+        case 1: a = 0; b = c-1; break;
+        case 2: a = r-1; b = 0; break;
+        case 3: a = r-1; b = c-1; break;
+        case 4: a = 0; b = c/2; break;
+        default: a = r/2; b = c/2;
+        }
+        if (o == 5)
+          se8(a,b) = 0;                // a zero origin counts as set
+        se = Image(se8);
+        sprintf(how, "%dx%d element, origin (%d, %d)", r, c, a, b);
+        if (!same(bdilate(imgs[n], se8, a, b),
+                  bdilate(Image(imgs[n]), se, a, b)))
+          ok = fail("bdilate", imgs[n], how);
+        if (!same(berode(imgs[n], se8, a, b),
+                  berode(Image(imgs[n]), se, a, b)))
+          ok = fail("berode", imgs[n], how);
+      }
+
+  // thresholds, one and a range of two, on each image
+  for (n=0; n<4; n++)
+    for (t=0; t<3; t++)
+      for (a=0; a<NTHRESH; a++) {
+        sprintf(how, "threshold %g, type %d", thresh[a], types[t]);
+        if (!same(threshold(imgs[n], thresh[a], types[t]),
+                  threshold(Image(imgs[n]), thresh[a], types[t])))
+          ok = fail("threshold", imgs[n], how);
+        if (imgs[n].getChannel() > 1)
+          continue;
+        for (b=0; b<NTHRESH; b++) {
+          sprintf(how, "range [%g, %g], type %d", thresh[a], thresh[b],
+                  types[t]);
+          if (!same(threshold(imgs[n], thresh[a], thresh[b], types[t]),
+                    threshold(Image(imgs[n]), thresh[a], thresh[b],
+                              types[t])))
+            ok = fail("threshold", imgs[n], how);
+        }
+      }
+
+  // a range of one value, on each value
+  for (i=0; i<256; i++) {
+    sprintf(how, "range [%d, %d]", i, i);
+    if (!same(threshold(imgs[0], i, i, GRAY),
+              threshold(Image(imgs[0]), i, i, GRAY)))
+      ok = fail("threshold", imgs[0], how);
+  }
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/**********************************************************
+ * This is a test program for the maxval of 16-bit images:
+ * a 12-bit PGM file (maxval 4095) is read, filtered and
+ * written back, and the file written is read again
+ *
+ *   - the results of the filters, of the expressions and of
+ *     the filters writing into a given image keep 4095
+ *   - the file written has maxval 4095 and the pixels of the
+ *     result, truncated, not clamped to 255
+ *   - readImage16() and writeImage() of an Image16 as well
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+
+#define Usage "./testmaxval\n"
+
+#define MAXVAL 4095
+#define NR 37
+#define NC 53
+
+static char inName[] = "testmaxval_in.pgm";
+static char outName[] = "testmaxval_out.pgm";
+
+
+/**
+ * Write an NR x NC 12-bit P5 file of known pixels, 16-bit samples with
+ * the most significant byte first.
+ */
+void writeInput()
+{
+  FILE *fp;
+  int i, j, v;
+
+  fp = fopen(inName, "wb");
+  if (!fp) {
+    cout << "Can't write " << inName << endl;
+    exit(1);
+  }
+  fprintf(fp, "P5\n%d %d\n%d\n", NC, NR, MAXVAL);
+  for (i=0; i<NR; i++)
+    for (j=0; j<NC; j++) {
+      v = (i * 97 + j * 61 + (i * j) % 13) % (MAXVAL + 1);
+      fputc(v >> 8, fp);
+      fputc(v & 255, fp);
+    }
+  fclose(fp);
+}
+
+
+/**
+ * Check that img has maxval MAXVAL, then write it, read the file back
+ * and check that it holds the pixels of img, clamped to [0, MAXVAL] and
+ * truncated as writeImage() does.
+ */
+int check(const char *what, const Image &img)
+{
+  Image back;
+  float v;
+  int i, j, k, ok = 1;
+
+  if (img.getMaxval() != MAXVAL) {
+    cout << what << ": maxval " << img.getMaxval() << endl;
+    return 0;
+  }
+  writeImage(img, outName);
+  back = readImage(outName);
+  if (back.getMaxval() != MAXVAL) {
+    cout << what << ": the file has maxval " << back.getMaxval() << endl;
+    return 0;
+  }
+  for (k=0; k<img.getChannel(); k++)
+    for (i=0; i<img.getRow(); i++)
+      for (j=0; j<img.getCol(); j++) {
+        v = img(i,j,k);
+        v = (v > 0) ? floor(v < MAXVAL ? v : MAXVAL) : 0;
+        if (back(i,j,k) != v)
+          ok = 0;
+      }
+  if (!ok)
+    cout << what << ": the pixels read back differ\n";
+  return ok;
+}
+
+
+int main()
+{
+  Image a, out, neg, mask;
+  Image16 a16, b16;
+  int i, j, ok = 1;
+
+  writeInput();
+  a = readImage(inName);
+  ok &= check("readImage", a);
+  if (a.getMaximum() <= 255) {
+    cout << "the test image has no pixel above 255\n";
+    ok = 0;
+  }
+
+  // the filters returning a new image
+  ok &= check("gaussianSmooth", gaussianSmooth(a));
+  ok &= check("median", median(a, 3));
+  ok &= check("average", average(a, 5));
+  ok &= check("contrah", contrah(a, 1.5, 3));
+  ok &= check("gdilate", gdilate(a, Image(3, 3), 1, 1));
+  ok &= check("rotate", rotate(a, 0.1));
+  ok &= check("sobel", sobel(a));
+
+  // the negative is taken from the maxval, not from 255
+  neg = negative(a);
+  ok &= check("negative", neg);
+  for (i=0; i<NR; i++)
+    for (j=0; j<NC; j++)
+      if (neg(i,j) != MAXVAL - a(i,j)) {
+        cout << "negative: " << neg(i,j) << " for " << a(i,j) << endl;
+        ok = 0;
+        i = NR;
+        break;
+      }
+
+  // the expressions, evaluated into a new image and in place
+  ok &= check("a*0.5", Image(a * 0.5));
+  ok &= check("(a+a)/2", Image((a + a) / 2));
+  out = a;
+  out *= 0.75;
+  ok &= check("*=", out);
+
+  // the filters writing into an image of another maxval, then reused
+  out = Image(NR, NC);
+  mask = gaussianKernel(1);
+  conv(a, mask, out);
+  ok &= check("conv into", out);
+  out.setMaxval(255);
+  conv(a, mask, out, BORDERREFLECT);
+  ok &= check("conv into reused", out);
+  out.setMaxval(255);
+  median(a, 5, out);
+  ok &= check("median into", out);
+  out.setMaxval(255);
+  negative(a, out);
+  ok &= check("negative into", out);
+  out.setMaxval(255);
+  threshold(a, 1000, GRAY, out);
+  ok &= check("threshold into", out);
+
+  // 16-bit pixels
+  a16 = readImage16(inName);
+  b16 = a16 + a16 / 3;
+  if (a16.getMaxval() != MAXVAL || b16.getMaxval() != MAXVAL) {
+    cout << "Image16: maxval " << a16.getMaxval() << " and "
+         << b16.getMaxval() << endl;
+    ok = 0;
+  }
+  else {
+    writeImage(b16, outName);
+    ok &= check("Image16", Image(b16));
+    a16 = readImage16(outName);
+    for (i=0; i<NR; i++)
+      for (j=0; j<NC; j++)
+        if (a16(i,j) != (b16(i,j) < MAXVAL ? b16(i,j) : MAXVAL)) {
+          cout << "Image16: the pixels read back differ\n";
+          ok = 0;
+          i = NR;
+          break;
+        }
+  }
+
+  remove(inName);
+  remove(outName);
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
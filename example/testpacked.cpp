@@ -0,0 +1,275 @@
+/**********************************************************
+ * This is a test program for the packed files (PGMPACK and
+ * PPMPACK), written by writeImage() and read by readImage()
+ *
+ *   - bit-exact round trips of Image, Image8 and Image16,
+ *     gray and color, 8, 12 and 16-bit samples, from the
+ *     file and from a pipe
+ *   - sizes of 1 row or column, odd sizes, rows at the band
+ *     boundaries (64 rows) and rows at the block boundaries
+ *     (32 samples), pixels of every width, from runs of one
+ *     value (0 bits) to jumps between 0 and maxval
+ *   - files cut in the header, in the sizes of the bands and
+ *     in the bands, from the file and from a pipe, are
+ *     reported (exit status 1)
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+#define Usage "./testpacked\n"
+
+#define NSIZE 8
+#define NMAXVAL 3
+
+static char fileName[] = "testpacked.pnm";
+static char cutName[] = "testpacked_cut.pnm";
+
+
+/**
+ * The contents of a file.
+ */
+string fileBytes(const char *name)
+{
+  ifstream ifp(name, ios::in | ios::binary);
+  ostringstream s;
+
+  s << ifp.rdbuf();
+  return s.str();
+}
+
+
+/**
+ * Fill img with samples in [0, maxval]: runs of one value, smooth
+ * ramps, random samples and jumps between 0 and maxval, a kind per band
+ * of 16 rows and of 40 columns.
+ */
+template <class T>
+void fill(BasicImage<T> &img, int maxval)
+{
+  int i, j, k, v;
+
+  for (k=0; k<img.getChannel(); k++)
+    for (i=0; i<img.getRow(); i++)
+      for (j=0; j<img.getCol(); j++) {
+        switch ((i / 16 + j / 40 + k) % 4) {
+        case 0:
+          v = maxval / 3;
+          break;
+        case 1:
+          v = (i + 2 * j + k) % (maxval + 1);
+          break;
+        case 2:
+          v = rand() % (maxval + 1);
+          break;
+        default:
+          v = ((i + j) & 1) ? maxval : 0;
+        }
+        img(i,j,k) = v;
+      }
+}
+
+
+/**
+ * 1 if a and b have the same size, maxval and pixels.
+ */
+template <class T>
+int same(const BasicImage<T> &a, const BasicImage<T> &b)
+{
+  int i, j, k;
+
+  if (a.getRow() != b.getRow() || a.getCol() != b.getCol() ||
+      a.getChannel() != b.getChannel() || a.getMaxval() != b.getMaxval())
+    return 0;
+  for (k=0; k<a.getChannel(); k++)
+    for (i=0; i<a.getRow(); i++)
+      for (j=0; j<a.getCol(); j++)
+        if (a(i,j,k) != b(i,j,k))
+          return 0;
+  return 1;
+}
+
+
+/**
+ * Read the file name through a pipe, written by a child process, with
+ * read("/proc/self/fd/<the read end>"); each open of that name is a new
+ * descriptor of the same pipe.
+ */
+template <class R>
+R readPipe(R (*read)(char *), const char *name)
+{
+  FILE *in, *out;
+  R img;
+  char path[64];
+  pid_t pid;
+  int fd[2], c;
+
+  if (pipe(fd) != 0) {
+    cout << "Can't create a pipe\n";
+    exit(1);
+  }
+  fflush(stdout);                      // not written again by the child
+  pid = fork();
+  if (pid == 0) {
+    close(fd[0]);
+    in = fopen(name, "rb");
+    out = fdopen(fd[1], "wb");
+    if (!in || !out)
+      _exit(1);
+    while ((c = fgetc(in)) != EOF)
+      fputc(c, out);
+    fclose(out);
+    _exit(0);
+  }
+  close(fd[1]);
+  sprintf(path, "/proc/self/fd/%d", fd[0]);
+  img = read(path);
+  close(fd[0]);
+  waitpid(pid, 0, 0);
+  return img;
+}
+
+
+/**
+ * 1 if readImage() of the file name exits with status 1, from the file
+ * or, when pipe is set, from a pipe.
+ */
+int rejected(char *name, int pipe)
+{
+  pid_t pid;
+  int status;
+
+  fflush(stdout);
+  pid = fork();
+  if (pid == 0) {
+    freopen("/dev/null", "w", stdout);
+    if (pipe)
+      readPipe(readImage, name);
+    else
+      readImage(name);
+    _exit(0);
+  }
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 1;
+}
+
+
+/**
+ * Write img to a packed file, read it back from the file and from a
+ * pipe with read(), and check the pixels; returns 1 if they are the same.
+ */
+template <class T>
+int roundTrip(const BasicImage<T> &img, BasicImage<T> (*read)(char *))
+{
+  writeImage(img, fileName);
+  return same(img, read(fileName)) && same(img, readPipe(read, fileName));
+}
+
+
+/**
+ * Cut the file in the header, in the sizes of the bands, in the first
+ * band and by one byte, and check that each cut is reported.
+ */
+int truncations(int nb)
+{
+  string bytes, head;
+  size_t cuts[4], n;
+  int c, p, ok = 1, line = 0;
+
+  bytes = fileBytes(fileName);
+  for (n=0; n<bytes.size() && line<4; n++)  // the header, 4 lines
+    if (bytes[n] == '\n')
+      line++;
+  cuts[0] = n / 2;
+  cuts[1] = n + 4 * nb;
+  cuts[2] = n + 8 * nb + (bytes.size() - n - 8 * nb) / 3;
+  cuts[3] = bytes.size() - 1;
+  for (c=0; c<4; c++) {
+    {
+      ofstream ofp(cutName, ios::out | ios::binary | ios::trunc);
+      ofp.write(bytes.data(), cuts[c]);
+    }
+    for (p=0; p<2; p++)
+      if (!rejected(cutName, p)) {
+        cout << "a file cut at " << cuts[c] << " of " << bytes.size()
+             << " bytes is not reported" << (p ? " from a pipe\n" : "\n");
+        ok = 0;
+      }
+  }
+  return ok;
+}
+
+
+int main()
+{
+  // rows and columns: 1 row or column, odd sizes, the band and block
+  // boundaries
+  int sizes[NSIZE][2] = {{1, 1}, {1, 97}, {77, 1}, {63, 31}, {64, 32},
+                         {65, 33}, {129, 47}, {128, 64}};
+  int maxvals[NMAXVAL] = {255, 4095, 65535};
+  Image img;
+  Image8 img8;
+  Image16 img16;
+  int s, m, c, nr, nc, ok = 1;
+
+  srand(11);
+  for (s=0; s<NSIZE; s++)
+    for (m=0; m<NMAXVAL; m++)
+      for (c=0; c<2; c++) {
+        nr = sizes[s][0];
+        nc = sizes[s][1];
+
+        img.createImage(nr, nc, c ? PPMPACK : PGMPACK);
+        img.setMaxval(maxvals[m]);
+        fill(img, maxvals[m]);
+        if (!roundTrip(img, readImage)) {
+          cout << nr << "x" << nc << (c ? " color" : " gray")
+               << ", maxval " << maxvals[m] << ": Image differs\n";
+          ok = 0;
+        }
+
+        img16.createImage(nr, nc, c ? PPMPACK : PGMPACK);
+        img16.setMaxval(maxvals[m]);
+        fill(img16, maxvals[m]);
+        if (!roundTrip(img16, readImage16)) {
+          cout << nr << "x" << nc << (c ? " color" : " gray")
+               << ", maxval " << maxvals[m] << ": Image16 differs\n";
+          ok = 0;
+        }
+
+        if (maxvals[m] == 255) {
+          img8.createImage(nr, nc, c ? PPMPACK : PGMPACK);
+          fill(img8, 255);
+          if (!roundTrip(img8, readImage8)) {
+            cout << nr << "x" << nc << (c ? " color" : " gray")
+                 << ": Image8 differs\n";
+            ok = 0;
+          }
+        }
+
+        // the file of the last image written, cut
+        if (s == NSIZE - 1 || (s == 3 && m == 0))
+          ok &= truncations((nr + 63) / 64);
+      }
+
+  remove(fileName);
+  remove(cutName);
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
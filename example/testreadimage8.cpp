@@ -0,0 +1,323 @@
+/**********************************************************
+ * This is a test program for the reading of the raw and
+ * ASCII files
+ *
+ *   - readImage8() uses the pixels of a raw 8-bit PGM file
+ *     in place, whatever the width and the alignment of the
+ *     pixels in the file: the first row lies in the mapping
+ *     of the file listed in /proc/self/maps, the row pitch is
+ *     the width
+ *   - a modified image never changes the file, a copy of it
+ *     gets its own aligned rows
+ *   - PPM and 16-bit files are copied
+ *   - the same files read from a pipe by readImage(),
+ *     readImage8() and readImage16() (the stream path) give
+ *     the same pixels as from the file
+ *   - ASCII files, with comments and lines of any length,
+ *     from the file and from a pipe; a truncated one is
+ *     reported (exit status 1)
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+#define Usage "./testreadimage8\n"
+
+#define NFILE 5
+
+static char fileName[] = "testreadimage8.pnm";
+
+
+/**
+ * The value of sample k of pixel (i,j) in the test files.
+ */
+int sample(int i, int j, int k, int maxval)
+{
+  return (i * 31 + j * 7 + k * 101 + (i * j) % 11) % (maxval + 1);
+}
+
+
+/**
+ * Write an nr x nc file of nchan channels, 16-bit samples when maxval is
+ * above 255, with a comment making the header of odd length. An ASCII
+ * file has lines of 7 values, some ending with a comment holding
+ * numbers, and comment lines.
+ */
+void writeFile(const char *name, int nr, int nc, int nchan, int maxval,
+               int ascii)
+{
+  FILE *fp;
+  int i, j, k, v, n = 0;
+
+  fp = fopen(name, "wb");
+  if (!fp) {
+    cout << "Can't write " << name << endl;
+    exit(1);
+  }
+  fprintf(fp, "P%d\n# test\n%d %d\n%d\n",
+          (nchan == 1 ? 2 : 3) + (ascii ? 0 : 3), nc, nr, maxval);
+  for (i=0; i<nr; i++)
+    for (j=0; j<nc; j++)
+      for (k=0; k<nchan; k++) {
+        v = sample(i, j, k, maxval);
+        if (ascii) {
+          n++;
+          fprintf(fp, "%d%s", v, n % 13 == 0 ? " # 9 9\n" :
+                  n % 29 == 0 ? "\n# 1 2 3\n" : n % 7 == 0 ? "\n" : "  ");
+        }
+        else {
+          if (maxval > 255)
+            fputc(v >> 8, fp);
+          fputc(v & 255, fp);
+        }
+      }
+  fclose(fp);
+}
+
+
+/**
+ * 1 if p lies in a mapping of the file name, as listed in /proc/self/maps.
+ */
+int inMapping(const void *p, const char *name)
+{
+  FILE *fp;
+  char line[4096];
+  unsigned long lo, hi;
+  int in = 0;
+
+  fp = fopen("/proc/self/maps", "r");
+  if (!fp)
+    return 0;
+  while (fgets(line, sizeof(line), fp))
+    if (strstr(line, name) && sscanf(line, "%lx-%lx", &lo, &hi) == 2 &&
+        (uintptr_t)p >= lo && (uintptr_t)p < hi)
+      in = 1;
+  fclose(fp);
+  return in;
+}
+
+
+/**
+ * 1 if img holds the pixels of the test file, samples above 255 narrowed
+ * as readImage8() does (clamped) when clamp is set.
+ */
+template <class T>
+int samePixels(const BasicImage<T> &img, int nr, int nc, int nchan,
+               int maxval, int clamp)
+{
+  int i, j, k, v;
+
+  if (img.getRow() != nr || img.getCol() != nc || img.getChannel() != nchan)
+    return 0;
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++)
+      for (j=0; j<nc; j++) {
+        v = sample(i, j, k, maxval);
+        if (clamp && v > 255)
+          v = 255;
+        if (img(i,j,k) != (T)v)
+          return 0;
+      }
+  return 1;
+}
+
+
+/**
+ * Read the file through a pipe, written by a child process, with
+ * read("/proc/self/fd/<the read end>"): each open of that name is a new
+ * descriptor of the same pipe, so the open of mapPNM() loses no data.
+ */
+template <class R>
+R readPipe(R (*read)(char *))
+{
+  FILE *in, *out;
+  R img;
+  char name[64];
+  pid_t pid;
+  int fd[2], c;
+
+  if (pipe(fd) != 0) {
+    cout << "Can't create a pipe\n";
+    exit(1);
+  }
+  fflush(stdout);                      // not written again by the child
+  pid = fork();
+  if (pid == 0) {
+    close(fd[0]);
+    in = fopen(fileName, "rb");
+    out = fdopen(fd[1], "wb");
+    if (!in || !out)
+      _exit(1);
+    while ((c = fgetc(in)) != EOF)
+      fputc(c, out);
+    fclose(out);
+    _exit(0);
+  }
+  close(fd[1]);
+  sprintf(name, "/proc/self/fd/%d", fd[0]);
+  img = read(name);
+  close(fd[0]);
+  waitpid(pid, 0, 0);
+  return img;
+}
+
+
+/**
+ * 1 if readImage() of the file from a pipe exits with status 1, as it
+ * does for a truncated file.
+ */
+int rejectedPipe()
+{
+  pid_t pid;
+  int status;
+
+  fflush(stdout);                      // not written again by the child
+  pid = fork();
+  if (pid == 0) {
+    freopen("/dev/null", "w", stdout);
+    readPipe(readImage);
+    _exit(0);
+  }
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 1;
+}
+
+
+int main()
+{
+  // rows and columns, channels and maxval of the files: widths that are
+  // and are not multiples of ALIGNMENT, and one of 1024 pixels
+  int sizes[NFILE][4] = {{37, 640, 1, 255}, {5, 1024, 1, 255},
+                         {23, 61, 1, 200}, {19, 45, 3, 255},
+                         {13, 29, 1, 4095}};
+  Image8 a, b;
+  const Image8 &ca = a, &cb = b;
+  Image16 w;
+  Image f;
+  int n, nr, nc, nchan, maxval, mapped, ascii, ok = 1;
+
+  for (n=0; n<NFILE; n++) {
+    nr = sizes[n][0];
+    nc = sizes[n][1];
+    nchan = sizes[n][2];
+    maxval = sizes[n][3];
+    mapped = (nchan == 1 && maxval <= 255);
+    writeFile(fileName, nr, nc, nchan, maxval, 0);
+
+    a = readImage8(fileName);
+    if (!samePixels(a, nr, nc, nchan, maxval, 1)) {
+      cout << nc << " wide: readImage8() pixels differ\n";
+      ok = 0;
+    }
+    if (mapped && (a.getStride() != nc ||
+                   !inMapping(ca.rowPtr(0), fileName) ||
+                   !inMapping(ca.rowPtr(nr-1) + nc-1, fileName))) {
+      cout << nc << " wide: the pixels of the PGM file are not mapped\n";
+      ok = 0;
+    }
+    if (!mapped && inMapping(ca.rowPtr(0), fileName)) {
+      cout << nc << " wide: the pixels are used in place, not copied\n";
+      ok = 0;
+    }
+
+    if (mapped) {
+      // a copy gets its own aligned rows, then the image itself is
+      // modified in its private pages; the file does not change
+      // (the read-only accessors, the others would unshare a)
+      b = a;
+      b(0,0) = 1 - ca(0,0);
+      if (!inMapping(ca.rowPtr(0), fileName) ||
+          inMapping(cb.rowPtr(0), fileName) ||
+          (uintptr_t)cb.rowPtr(0) % ALIGNMENT != 0 ||
+          b.getStride() * sizeof(unsigned char) % ALIGNMENT != 0 ||
+          ca(0,0) == cb(0,0)) {
+        cout << nc << " wide: the modified copy still shares the pixels\n";
+        ok = 0;
+      }
+      a(nr-1,nc-1) = 1 - sample(nr-1, nc-1, 0, maxval);
+      b = readImage8(fileName);
+      if (!samePixels(b, nr, nc, nchan, maxval, 1)) {
+        cout << nc << " wide: modifying the image changed the file\n";
+        ok = 0;
+      }
+      a = Image8();
+      b = Image8();
+    }
+
+    // the same pixels read from a pipe
+    if (!samePixels(readPipe(readImage8), nr, nc, nchan, maxval, 1)) {
+      cout << nc << " wide: readImage8() of a pipe differs\n";
+      ok = 0;
+    }
+    f = readPipe(readImage);
+    if (!samePixels(f, nr, nc, nchan, maxval, 0) || f.getMaxval() != maxval) {
+      cout << nc << " wide: readImage() of a pipe differs\n";
+      ok = 0;
+    }
+    w = readPipe(readImage16);
+    if (!samePixels(w, nr, nc, nchan, maxval, 0)) {
+      cout << nc << " wide: readImage16() of a pipe differs\n";
+      ok = 0;
+    }
+  }
+
+  // a PFM file from a pipe, stored from the bottom row up
+  f = readPipe(readImage);
+  writePFM(f, fileName);
+  if (!samePixels(readPipe(readImage), 13, 29, 1, 4095, 0)) {
+    cout << "readImage() of a PFM pipe differs\n";
+    ok = 0;
+  }
+
+  // ASCII files, gray and color, 8 and 16-bit, from the file and from a
+  // pipe, then the same files cut in the middle of the last row
+  for (n=2; n<NFILE; n++) {
+    nr = sizes[n][0];
+    nc = sizes[n][1];
+    nchan = sizes[n][2];
+    maxval = sizes[n][3];
+    writeFile(fileName, nr, nc, nchan, maxval, 1);
+    f = readImage(fileName);
+    if (!samePixels(f, nr, nc, nchan, maxval, 0)) {
+      cout << nc << " wide: readImage() of an ASCII file differs\n";
+      ok = 0;
+    }
+    f = readPipe(readImage);
+    if (!samePixels(f, nr, nc, nchan, maxval, 0)) {
+      cout << nc << " wide: readImage() of an ASCII pipe differs\n";
+      ok = 0;
+    }
+    if (!samePixels(readPipe(readImage8), nr, nc, nchan, maxval, 1)) {
+      cout << nc << " wide: readImage8() of an ASCII pipe differs\n";
+      ok = 0;
+    }
+    for (ascii=0; ascii<2; ascii++) {
+      writeFile(fileName, nr, nc, nchan, maxval, ascii);
+      if (truncate(fileName, ascii ? 40 + nr * nc * nchan * 2 :
+                   50 + (nr - 1) * nc * nchan) != 0 || !rejectedPipe()) {
+        cout << nc << " wide: a truncated " << (ascii ? "ASCII" : "raw")
+             << " pipe is not reported\n";
+        ok = 0;
+      }
+    }
+  }
+
+  remove(fileName);
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
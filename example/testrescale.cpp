@@ -0,0 +1,141 @@
+/**********************************************************
+ * This is a test program for rescale() and the writers that
+ * rescale (writeImage(), FrameWriter and writeTiled() with
+ * the rescale flag): every channel of a color image is
+ * mapped by the minimum and maximum over the whole image,
+ * so the colors keep their hue
+ *
+ *   - gray and color images, 8 and 16-bit, whose channels
+ *     have different ranges
+ *   - an image of one value (every pixel to a or to b)
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include "FrameIO.h"
+#include "TileIO.h"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+
+#define Usage "./testrescale\n"
+
+#define NR 19
+#define NC 27
+#define BOTTOM 10      // the smallest pixel, the largest is BOTTOM + maxval
+
+static char fileName[] = "testrescale.pnm";
+
+
+/**
+ * An image of the type t whose channel k is in [BOTTOM + k*maxval/4,
+ * BOTTOM + (k+2)*maxval/4], except for the pixel (0,0) of the first
+ * channel, BOTTOM, and the pixel (0,1) of the last one, BOTTOM + maxval.
+ */
+Image testImage(int t, int maxval)
+{
+  Image img(NR, NC, t);
+  int i, j, k;
+
+  img.setMaxval(maxval);
+  for (k=0; k<img.getChannel(); k++)
+    for (i=0; i<NR; i++)
+      for (j=0; j<NC; j++)
+        img(i,j,k) = BOTTOM + k * maxval / 4 + (i * NC + j) % (maxval / 2 + 1);
+  img(0,0,0) = BOTTOM;
+  img(0,1,img.getChannel()-1) = BOTTOM + maxval;
+  return img;
+}
+
+
+/**
+ * 1 if each pixel of out is (pixel of in - BOTTOM) * s + a, within tol.
+ */
+int mapped(const Image &in, const Image &out, float s, float a, float tol)
+{
+  int i, j, k;
+
+  if (out.getRow() != NR || out.getCol() != NC ||
+      out.getChannel() != in.getChannel())
+    return 0;
+  for (k=0; k<in.getChannel(); k++)
+    for (i=0; i<NR; i++)
+      for (j=0; j<NC; j++)
+        if (fabs(out(i,j,k) - ((in(i,j,k) - BOTTOM) * s + a)) > tol)
+          return 0;
+  return 1;
+}
+
+
+int main()
+{
+  int types[2] = {PGMRAW, PPMRAW}, maxvals[2] = {255, 1000};
+  Image img, out;
+  int t, m, ok = 1;
+
+  for (t=0; t<2; t++)
+    for (m=0; m<2; m++) {
+      img = testImage(types[t], maxvals[m]);
+
+      // to [a, b] and to [0, maxval]
+      if (!mapped(img, rescale(img, 20, 70), 50.0 / maxvals[m], 20, 1e-3)) {
+        cout << "rescale to [20, 70], type " << types[t] << ", maxval "
+             << maxvals[m] << ": not one map for all the channels\n";
+        ok = 0;
+      }
+      out = rescale(img);
+      if (!mapped(img, out, 1, 0, 1e-3) || out.getMaxval() != maxvals[m]) {
+        cout << "rescale, type " << types[t] << ", maxval " << maxvals[m]
+             << ": not one map for all the channels\n";
+        ok = 0;
+      }
+
+      // the writers, to [0, maxval]: the pixels minus BOTTOM, exactly
+      writeImage(img, fileName, 1);
+      if (!mapped(img, readImage(fileName), 1, 0, 0)) {
+        cout << "writeImage, type " << types[t] << ", maxval "
+             << maxvals[m] << ": not one map for all the channels\n";
+        ok = 0;
+      }
+      {
+        FrameWriter frames(fileName);
+        frames.write(img, 1);
+      }
+      if (!mapped(img, readImage(fileName), 1, 0, 0)) {
+        cout << "FrameWriter, type " << types[t] << ", maxval "
+             << maxvals[m] << ": not one map for all the channels\n";
+        ok = 0;
+      }
+      writeTiled(img, fileName, 16, 1);
+      if (!mapped(img, readImage(fileName), 1, 0, 0)) {
+        cout << "writeTiled, type " << types[t] << ", maxval "
+             << maxvals[m] << ": not one map for all the channels\n";
+        ok = 0;
+      }
+
+      // an image of one value, above 0 and at 0
+      img = Image(NR, NC, types[t]) + 7;
+      if (!mapped(img, rescale(img, 20, 70), 0, 70, 0)) {
+        cout << "rescale of 7s, type " << types[t] << ": not all 70\n";
+        ok = 0;
+      }
+      img = Image(NR, NC, types[t]);
+      if (!mapped(img, rescale(img, 20, 70), 0, 20, 0)) {
+        cout << "rescale of 0s, type " << types[t] << ": not all 20\n";
+        ok = 0;
+      }
+    }
+
+  remove(fileName);
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
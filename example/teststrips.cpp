@@ -0,0 +1,258 @@
+/**********************************************************
+ * This is a test program for StripReader and StripWriter
+ *
+ *   - the strips of P5/P6/P2/P3 files, 8 and 16-bit, read
+ *     from the file and from a pipe, with and without halo
+ *     rows, against readImage()
+ *   - streamImage() with a 5x5 mean (conv()) against the mean
+ *     of the whole image, written by writeImage(), byte for
+ *     byte
+ *   - the rows written are clamped to [0, maxval] and
+ *     truncated, whatever the maxval of the strip
+ *   - a truncated file read from a pipe is reported (exit
+ *     status 1)
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include "StripIO.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+#define Usage "./teststrips\n"
+
+#define NR 41
+#define NC 23
+#define NTYPE 4
+
+static char inName[] = "teststrips_in.pnm";
+static char outName[] = "teststrips_out.pnm";
+static char refName[] = "teststrips_ref.pnm";
+
+
+/**
+ * The contents of a file.
+ */
+string fileBytes(const char *name)
+{
+  ifstream ifp(name, ios::in | ios::binary);
+  ostringstream s;
+
+  s << ifp.rdbuf();
+  return s.str();
+}
+
+
+/**
+ * 1 if a and b hold the same pixels.
+ */
+int same(const Image &a, const Image &b)
+{
+  int i, j, k;
+
+  if (a.getRow() != b.getRow() || a.getCol() != b.getCol() ||
+      a.getChannel() != b.getChannel())
+    return 0;
+  for (k=0; k<a.getChannel(); k++)
+    for (i=0; i<a.getRow(); i++)
+      for (j=0; j<a.getCol(); j++)
+        if (a(i,j,k) != b(i,j,k))
+          return 0;
+  return 1;
+}
+
+
+/**
+ * Fork a child that writes the file in into a pipe; returns the name
+ * of the read end, "/proc/self/fd/<fd>", which each open reads from the
+ * same pipe.
+ */
+string pipeFrom(const char *in, int &fd, pid_t &pid)
+{
+  FILE *fp, *out;
+  int p[2], c;
+
+  if (pipe(p) != 0) {
+    cout << "Can't create a pipe\n";
+    exit(1);
+  }
+  fflush(stdout);                      // not written again by the child
+  pid = fork();
+  if (pid == 0) {
+    close(p[0]);
+    fp = fopen(in, "rb");
+    out = fdopen(p[1], "wb");
+    if (!fp || !out)
+      _exit(1);
+    while ((c = fgetc(fp)) != EOF)
+      fputc(c, out);
+    fclose(out);
+    _exit(0);
+  }
+  close(p[1]);
+  fd = p[0];
+  return "/proc/self/fd/" + to_string(fd);
+}
+
+
+/**
+ * Read the file name strip by strip, n own rows and halo rows at a time,
+ * checking each strip against the rows of ref; returns 1 if they match.
+ */
+int readStrips(const char *name, const Image &ref, int n, int halo)
+{
+  StripReader in((char *) name, n, halo);
+  Image strip;
+  int own, i, j, k, top, ok = 1, rows = 0;
+
+  if (in.getRow() != ref.getRow() || in.getCol() != ref.getCol() ||
+      in.getChannel() != ref.getChannel() ||
+      in.getMaxval() != ref.getMaxval())
+    return 0;
+  while ((own = in.next(strip)) > 0) {
+    top = in.getTop();
+    if (in.getFirst() != rows || top != min(halo, rows) ||
+        strip.getRow() != top + own + min(halo, ref.getRow() - rows - own))
+      ok = 0;
+    for (k=0; k<strip.getChannel(); k++)
+      for (i=0; i<strip.getRow(); i++)
+        for (j=0; j<strip.getCol(); j++)
+          if (strip(i,j,k) != ref(rows - top + i, j, k))
+            ok = 0;
+    rows += own;
+  }
+  return ok && rows == ref.getRow();
+}
+
+
+/**
+ * 1 if reading the file name strip by strip exits with status 1.
+ */
+int rejected(const char *name)
+{
+  Image strip;
+  pid_t pid;
+  int status;
+
+  fflush(stdout);
+  pid = fork();
+  if (pid == 0) {
+    freopen("/dev/null", "w", stdout);
+    StripReader in((char *) name, 7, 1);
+    while (in.next(strip) > 0)
+      ;
+    _exit(0);
+  }
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 1;
+}
+
+
+int main()
+{
+  int types[NTYPE] = {PGMRAW, PPMRAW, PGMASCII, PPMASCII};
+  int maxvals[2] = {255, 1000};
+  Image img, ref, big, mask(5, 5);
+  string name, bytes;
+  pid_t pid;
+  int t, m, h, i, j, k, fd, ok = 1;
+
+  srand(3);
+  for (i=0; i<5; i++)
+    for (j=0; j<5; j++)
+      mask(i,j) = 1;
+  for (t=0; t<NTYPE; t++)
+    for (m=0; m<2; m++) {
+      img.createImage(NR, NC, types[t]);
+      img.setMaxval(maxvals[m]);
+      for (k=0; k<img.getChannel(); k++)
+        for (i=0; i<NR; i++)
+          for (j=0; j<NC; j++)
+            img(i,j,k) = rand() % (maxvals[m] + 1);
+      writeImage(img, inName);
+      ref = readImage(inName);
+
+      // the strips, from the file and from a pipe
+      for (h=0; h<3; h++) {
+        if (!readStrips(inName, ref, 5 + h, 2 * h)) {
+          cout << "type " << types[t] << ", maxval " << maxvals[m]
+               << ", halo " << 2 * h << ": the strips differ\n";
+          ok = 0;
+        }
+        name = pipeFrom(inName, fd, pid);
+        if (!readStrips(name.c_str(), ref, 5 + h, 2 * h)) {
+          cout << "type " << types[t] << ", maxval " << maxvals[m]
+               << ", halo " << 2 * h << ": the strips of a pipe differ\n";
+          ok = 0;
+        }
+        close(fd);
+        waitpid(pid, 0, 0);
+      }
+
+      // a 5x5 mean strip by strip, as of the whole image (the sums of
+      // integers are exact on every path of conv())
+      streamImage(inName, outName, 6, 2, [&](const Image &s) -> Image {
+                    return conv(s, mask) / 25;
+                  });
+      writeImage(Image(conv(ref, mask) / 25), refName);
+      if (fileBytes(outName) != fileBytes(refName)) {
+        cout << "type " << types[t] << ", maxval " << maxvals[m]
+             << ": streamImage() differs from conv()\n";
+        ok = 0;
+      }
+
+      // the pixels out of [0, maxval], of a strip of another maxval,
+      // written as by writeImage() without rescaling
+      big = ref * 1.7 - 40.5;
+      big.setMaxval(maxvals[1 - m]);
+      {
+        StripWriter out(outName, NR, NC, types[t], maxvals[m]);
+        out.write(big, 0, 20);
+        out.write(big, 20);
+      }
+      big.setMaxval(maxvals[m]);
+      writeImage(big, refName);
+      if (fileBytes(outName) != fileBytes(refName)) {
+        cout << "type " << types[t] << ", maxval " << maxvals[m]
+             << ": the rows written are not clamped as by writeImage()\n";
+        ok = 0;
+      }
+      if (!same(readImage(outName), readImage(refName)))
+        ok = 0;
+
+      // the file cut in its last rows, read from a pipe
+      bytes = fileBytes(inName);
+      {
+        ofstream ofp(inName, ios::out | ios::binary | ios::trunc);
+        ofp.write(bytes.data(), bytes.size() * 9 / 10);
+      }
+      name = pipeFrom(inName, fd, pid);
+      if (!rejected(name.c_str())) {
+        cout << "type " << types[t] << ", maxval " << maxvals[m]
+             << ": a truncated pipe is not reported\n";
+        ok = 0;
+      }
+      close(fd);
+      waitpid(pid, 0, 0);
+    }
+
+  remove(inName);
+  remove(outName);
+  remove(refName);
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+/**********************************************************
+ * This is a test program for the operators that run their
+ * rows on the threads of parallelRows(): the result on 3
+ * and on 4 threads is checked against the result on 1
+ * thread, bit for bit
+ *
+ *   - median() of Image and Image8, contrah(), gdilate(),
+ *     gerode(), nonmax(), zeroCrossing(), convMulti() and
+ *     convGradient() (conv() is checked by testconvpaths)
+ *   - the ->* operator (gemm())
+ *   - the packed files (PGMPACK, PPMPACK) and the tiled
+ *     files, written (the bytes of the file) and read
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include "Parallel.h"
+#include "TileIO.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+#define Usage "./testthreads\n"
+
+#define NR 301
+#define NC 517
+
+static char fileName[] = "testthreads.pnm";
+
+
+/**
+ * The contents of a file.
+ */
+string fileBytes(const char *name)
+{
+  ifstream ifp(name, ios::in | ios::binary);
+  ostringstream s;
+
+  s << ifp.rdbuf();
+  return s.str();
+}
+
+
+/**
+ * 1 if a and b have the same size and pixels, bit for bit.
+ */
+template <class T>
+int same(const BasicImage<T> &a, const BasicImage<T> &b)
+{
+  int i, j, k;
+
+  if (a.getRow() != b.getRow() || a.getCol() != b.getCol() ||
+      a.getChannel() != b.getChannel() || a.getMaxval() != b.getMaxval())
+    return 0;
+  for (k=0; k<a.getChannel(); k++)
+    for (i=0; i<a.getRow(); i++)
+      for (j=0; j<a.getCol(); j++)
+        if (memcmp(&a(i,j,k), &b(i,j,k), sizeof(T)))
+          return 0;
+  return 1;
+}
+
+int same(const string &a, const string &b)
+{
+  return a == b;
+}
+
+int same(const vector<Image> &a, const vector<Image> &b)
+{
+  size_t n;
+
+  if (a.size() != b.size())
+    return 0;
+  for (n=0; n<a.size(); n++)
+    if (!same(a[n], b[n]))
+      return 0;
+  return 1;
+}
+
+
+/**
+ * Run f on 1 thread, then on 3 and on 4 threads, and compare the results;
+ * returns 1 if they are the same.
+ */
+template <class F>
+int threads(const char *what, F f)
+{
+  int t, n[2] = {3, 4}, ok = 1;
+
+  setThreads(1);
+  auto ref = f();
+  for (t=0; t<2; t++) {
+    setThreads(n[t]);
+    if (!same(f(), ref)) {
+      cout << what << ": " << n[t] << " threads differ from 1\n";
+      ok = 0;
+    }
+  }
+  setThreads(0);
+  return ok;
+}
+
+
+/**
+ * An image of nr x nc pixels of the type t, random pixels in [lo, lo +
+ * 255] with a fraction.
+ */
+Image testImage(int nr, int nc, int t, float lo)
+{
+  Image img(nr, nc, t);
+  int i, j, k;
+
+  for (k=0; k<img.getChannel(); k++)
+    for (i=0; i<nr; i++)
+      for (j=0; j<nc; j++)
+        img(i,j,k) = lo + rand() % 256 + (rand() % 1000) / 1000.0;
+  return img;
+}
+
+
+int main()
+{
+  Image img, color, se, a, b, gx, gy, kx, ky;
+  Image8 img8;
+  vector<Image> masks;
+  int i, j, ok = 1;
+
+  srand(23);
+  img = testImage(NR, NC, PGMRAW, 0);
+  color = testImage(NR, NC, PPMRAW, 0);
+  img8.createImage(NR, NC);
+  for (i=0; i<NR; i++)
+    for (j=0; j<NC; j++)
+      img8(i,j) = rand() % 256;
+
+  // the neighborhood operators
+  ok &= threads("median 3", [&] { return median(img, 3); });
+  ok &= threads("median 5", [&] { return median(img, 5); });
+  ok &= threads("median of Image8, 3", [&] { return median(img8, 3); });
+  ok &= threads("median of Image8, 7", [&] { return median(img8, 7); });
+  a = img + 1;
+  ok &= threads("contrah 1.5", [&] { return contrah(a, 1.5, 3); });
+  ok &= threads("contrah -1.5", [&] { return contrah(a, -1.5, 2); });
+  se = testImage(4, 5, PGMRAW, -128);
+  ok &= threads("gdilate", [&] { return gdilate(img, se, 1, 3); });
+  ok &= threads("gerode", [&] { return gerode(img, se, 3, 0); });
+
+  kx.createImage(3, 3);
+  ky.createImage(3, 3);
+  for (i=0; i<3; i++) {
+    kx(i,0) = ky(0,i) = -1 - (i == 1);
+    kx(i,2) = ky(2,i) = 1 + (i == 1);
+  }
+  gx = conv(img, kx);
+  gy = conv(img, ky);
+  ok &= threads("nonmax", [&] { return nonmax(gx, gy); });
+  b = conv(img, LoG(2.0));
+  ok &= threads("zeroCrossing", [&] { return zeroCrossing(b); });
+  masks.push_back(kx);
+  masks.push_back(ky);
+  masks.push_back(LoG(1.5));
+  ok &= threads("convMulti", [&] {
+                  vector<Image> outs;
+                  convMulti(color, masks, outs, BORDERREFLECT);
+                  return outs;
+                });
+  ok &= threads("convGradient", [&] {
+                  vector<Image> outs(2);
+                  convGradient(img, kx, ky, outs[0], outs[1]);
+                  return outs;
+                });
+
+  // products of matrices of fractions, summed in blocks
+  a = testImage(300, 257, PGMRAW, -128) / 64;
+  b = testImage(257, 311, PGMRAW, -128) / 64;
+  ok &= threads("->*", [&] { return Image(a->*b); });
+  ok &= threads("->* of a row", [&] {
+                  return Image(a.getSubImage(0, 0, 0, 256)->*b);
+                });
+
+  // the packed and the tiled files, written and read
+  a = color;
+  a.setType(PPMPACK);
+  b = img;
+  b.setType(PGMPACK);
+  b.setMaxval(4095);
+  b = b * 16;
+  ok &= threads("write PPMPACK", [&] {
+                  writeImage(a, fileName);
+                  return fileBytes(fileName);
+                });
+  ok &= threads("read PPMPACK", [&] { return readImage(fileName); });
+  ok &= threads("write PGMPACK, 12-bit", [&] {
+                  writeImage(b, fileName);
+                  return fileBytes(fileName);
+                });
+  ok &= threads("read PGMPACK, 12-bit", [&] { return readImage(fileName); });
+  ok &= threads("write tiled", [&] {
+                  writeTiled(color, fileName, 32);
+                  return fileBytes(fileName);
+                });
+  ok &= threads("read tiled", [&] {
+                  TiledReader in(fileName);
+                  vector<Image> levels(2);
+                  in.read(levels[0], 0, 0, in.getRow(), in.getCol());
+                  in.read(levels[1], 17, 9, in.getRow(1) - 17,
+                          in.getCol(1) - 9, 1);
+                  return levels;
+                });
+
+  remove(fileName);
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+/**********************************************************
+ * This is a test program for the tiled files, written by
+ * writeTiled() and read by TiledReader
+ *
+ *   - level 0: the regions read against getSubImage() of
+ *     readImage() of the file, and readImage() against the
+ *     image clamped and truncated as writeImage() does (or
+ *     rescaled, with the rescale flag)
+ *   - the other levels: the regions read against a reference
+ *     halved here from the level above, each pixel the mean
+ *     of a 2x2 block, the last row or column repeated when
+ *     the size is odd
+ *   - regions across the tile edges, of one pixel and whole
+ *     levels; odd level sizes, a tile larger than the image,
+ *     levels of 1 row or 1 column
+ *   - Image, Image8 and Image16 regions, gray and color,
+ *     8 and 16-bit samples
+ *   - a failed write (to /dev/full) is reported (exit
+ *     status 1)
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include "TileIO.h"
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+#define Usage "./testtiled\n"
+
+#define NCASE 6
+#define NREGION 40
+
+static char fileName[] = "testtiled.pt";
+static char refName[] = "testtiled.pgm";
+
+
+/**
+ * Halve a level: each pixel the mean of a 2x2 block of samples, its
+ * fraction dropped, the last row or column repeated when the size is
+ * odd.
+ */
+Image halveRef(const Image &img)
+{
+  Image out;
+  int i, j, k, nr, nc, i1, j1;
+
+  nr = img.getRow();
+  nc = img.getCol();
+  out.createImage((nr + 1) / 2, (nc + 1) / 2, img.getType());
+  out.setMaxval(img.getMaxval());
+  for (k=0; k<img.getChannel(); k++)
+    for (i=0; i<out.getRow(); i++)
+      for (j=0; j<out.getCol(); j++) {
+        i1 = min(2*i+1, nr-1);
+        j1 = min(2*j+1, nc-1);
+        out(i,j,k) = ((int)img(2*i,2*j,k) + (int)img(2*i,j1,k) +
+                      (int)img(i1,2*j,k) + (int)img(i1,j1,k)) >> 2;
+      }
+  return out;
+}
+
+
+/**
+ * 1 if roi holds the pixels of ref from (top, left), and has its maxval.
+ */
+template <class T>
+int sameRegion(const BasicImage<T> &roi, const Image &ref, int top, int left)
+{
+  Image sub;
+  int i, j, k;
+
+  sub = ref.getSubImage(top, left, top + roi.getRow() - 1,
+                        left + roi.getCol() - 1);
+  if (roi.getChannel() != ref.getChannel() ||
+      roi.getMaxval() != ref.getMaxval())
+    return 0;
+  for (k=0; k<roi.getChannel(); k++)
+    for (i=0; i<roi.getRow(); i++)
+      for (j=0; j<roi.getCol(); j++)
+        if (roi(i,j,k) != sub(i,j,k))
+          return 0;
+  return 1;
+}
+
+
+/**
+ * Check the regions of every level of the file against the levels of
+ * ref, level 0: regions across the tile edges, random regions, single
+ * pixels and the whole level, read into each pixel type.
+ */
+int checkLevels(const Image &level0, int tile, int levels, const char *what)
+{
+  TiledReader in(fileName);
+  Image ref, roi;
+  Image8 roi8;
+  Image16 roi16;
+  vector<int> box;
+  int l, n, r, top, left, nr, nc, ok = 1;
+
+  if (in.getLevels() != levels || in.getTile() != tile ||
+      in.getMaxval() != level0.getMaxval() ||
+      in.getChannel() != level0.getChannel()) {
+    cout << what << ": the header differs\n";
+    return 0;
+  }
+  ref = level0;
+  for (l=0; l<levels; l++) {
+    if (l > 0)
+      ref = halveRef(ref);
+    nr = ref.getRow();
+    nc = ref.getCol();
+    if (in.getRow(l) != nr || in.getCol(l) != nc) {
+      cout << what << ": level " << l << " is " << in.getRow(l) << "x"
+           << in.getCol(l) << ", not " << nr << "x" << nc << endl;
+      ok = 0;
+      continue;
+    }
+
+    // the whole level, the corners, a region around the first tile
+    // corner, then random ones
+    box.clear();
+    box.insert(box.end(), {0, 0, nr, nc});
+    box.insert(box.end(), {0, 0, 1, 1});
+    box.insert(box.end(), {nr-1, nc-1, 1, 1});
+    if (nr > tile && nc > tile)
+      box.insert(box.end(), {tile-1, tile-1, 2, 2});
+    for (r=0; r<NREGION; r++) {
+      top = rand() % nr;
+      left = rand() % nc;
+      box.insert(box.end(), {top, left, 1 + rand() % (nr - top),
+                             1 + rand() % (nc - left)});
+    }
+    for (n=0; n<(int)box.size(); n+=4) {
+      in.read(roi, box[n], box[n+1], box[n+2], box[n+3], l);
+      if (!sameRegion(roi, ref, box[n], box[n+1]))
+        ok = 0;
+      in.read(roi16, box[n], box[n+1], box[n+2], box[n+3], l);
+      if (!sameRegion(roi16, ref, box[n], box[n+1]))
+        ok = 0;
+      if (ref.getMaxval() <= 255) {
+        in.read(roi8, box[n], box[n+1], box[n+2], box[n+3], l);
+        if (!sameRegion(roi8, ref, box[n], box[n+1]))
+          ok = 0;
+      }
+      if (!ok) {
+        cout << what << ": level " << l << ", region " << box[n+2] << "x"
+             << box[n+3] << " at (" << box[n] << ", " << box[n+1]
+             << ") differs\n";
+        break;
+      }
+    }
+  }
+  return ok;
+}
+
+
+/**
+ * 1 if writeTiled() of img to /dev/full exits with status 1.
+ */
+int failedWrite(const Image &img)
+{
+  char full[] = "/dev/full";
+  pid_t pid;
+  int status;
+
+  fflush(stdout);                      // not written again by the child
+  pid = fork();
+  if (pid == 0) {
+    freopen("/dev/null", "w", stdout);
+    writeTiled(img, full, 8);
+    _exit(0);
+  }
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 1;
+}
+
+
+int main()
+{
+  // rows, columns, color, maxval, tile, levels: odd level sizes, a tile
+  // larger than the image, levels of 1 row and of 1 column
+  int cases[NCASE][6] = {{37, 53, 0, 255, 8, 4}, {64, 48, 1, 4095, 16, 3},
+                         {29, 31, 0, 255, 64, 1}, {1, 50, 0, 255, 4, 5},
+                         {50, 1, 1, 65535, 4, 5}, {100, 70, 1, 255, 32, 3}};
+  Image img, level0;
+  char what[64];
+  int c, i, j, k, f, nr, nc, maxval, ok = 1;
+
+  srand(5);
+  for (c=0; c<NCASE; c++) {
+    nr = cases[c][0];
+    nc = cases[c][1];
+    maxval = cases[c][3];
+
+    // smooth pixels and noise, out of [0, maxval] and fractional in
+    // places, clamped and truncated when written
+    img.createImage(nr, nc, cases[c][2] ? PPMRAW : PGMRAW);
+    img.setMaxval(maxval);
+    for (k=0; k<img.getChannel(); k++)
+      for (i=0; i<nr; i++)
+        for (j=0; j<nc; j++)
+          img(i,j,k) = (i * 7 + j * 3 + k * 50) % (maxval + 1) +
+                       (rand() % 41 - 20) * (maxval / 255) + 0.75;
+
+    for (f=0; f<2; f++) {
+      sprintf(what, "%dx%dx%d, maxval %d, tile %d%s", nr, nc,
+              img.getChannel(), maxval, cases[c][4], f ? ", rescaled" : "");
+      writeTiled(img, fileName, cases[c][4], f);
+      writeImage(img, refName, f);
+      level0 = readImage(refName);
+      if (!sameRegion(readImage(fileName), level0, 0, 0)) {
+        cout << what << ": readImage() differs from writeImage()\n";
+        ok = 0;
+      }
+      ok &= checkLevels(level0, cases[c][4], cases[c][5], what);
+    }
+  }
+
+  if (!failedWrite(img)) {
+    cout << "a failed write is not reported\n";
+    ok = 0;
+  }
+
+  remove(fileName);
+  remove(refName);
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
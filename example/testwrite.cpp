@@ -0,0 +1,176 @@
+/**********************************************************
+ * This is a test program for writeImage(): the bytes of the
+ * files written are compared with the bytes expected, built
+ * here from the header and the samples
+ *
+ *   - P5, P6, P2 and P3 files, 8 and 16-bit samples (most
+ *     significant byte first), the channels interleaved
+ *   - float pixels clamped to [0, maxval] and truncated, or
+ *     rescaled to [0, maxval] with the rescale flag
+ *   - Image8 and Image16 pixels
+ *   - images larger than the blocks written at once
+ *
+ * Prints PASS, or the cases that fail and FAIL.
+ *
+ * Date: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include "Dip.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+
+#define Usage "./testwrite\n"
+
+#define NSIZE 3
+#define NTYPE 4
+#define NMAXVAL 3
+
+static char fileName[] = "testwrite.pnm";
+
+
+/**
+ * The contents of a file.
+ */
+string fileBytes(const char *name)
+{
+  ifstream ifp(name, ios::in | ios::binary);
+  ostringstream s;
+
+  s << ifp.rdbuf();
+  return s.str();
+}
+
+
+/**
+ * The bytes of a file of type t holding the samples s, interleaved: the
+ * header, then the raw samples or one value per line.
+ */
+string expected(int t, int nr, int nc, int maxval,
+                const vector<int> &s)
+{
+  string out;
+  size_t n;
+
+  out = string(t == PGMRAW ? "P5" : t == PPMRAW ? "P6" :
+               t == PGMASCII ? "P2" : "P3") + "\n" + to_string(nc) + " " +
+        to_string(nr) + "\n" + to_string(maxval) + "\n";
+  for (n=0; n<s.size(); n++)
+    if (t == PGMRAW || t == PPMRAW) {
+      if (maxval > 255)
+        out += (char)(s[n] >> 8);
+      out += (char)(s[n] & 255);
+    }
+    else
+      out += to_string(s[n]) + "\n";
+  return out;
+}
+
+
+/**
+ * Compare the file written with the bytes expected.
+ */
+int check(const string &want, const char *what, int t, int nr, int nc,
+          int maxval)
+{
+  if (fileBytes(fileName) == want)
+    return 1;
+  cout << what << ": type " << t << ", " << nr << "x" << nc << ", maxval "
+       << maxval << ": the file differs\n";
+  return 0;
+}
+
+
+int main()
+{
+  int sizes[NSIZE][2] = {{1, 1}, {13, 7}, {700, 600}};
+  int types[NTYPE] = {PGMRAW, PPMRAW, PGMASCII, PPMASCII};
+  int maxvals[NMAXVAL] = {255, 1000, 65535};
+  Image img;
+  Image8 img8;
+  Image16 img16;
+  vector<int> clamped, rescaled, ints;
+  float v, lo;
+  int s, t, m, i, j, k, nr, nc, maxval, ok = 1;
+
+  srand(13);
+  for (s=0; s<NSIZE; s++)
+    for (t=0; t<NTYPE; t++)
+      for (m=0; m<NMAXVAL; m++) {
+        nr = sizes[s][0];
+        nc = sizes[s][1];
+        maxval = maxvals[m];
+        // the large image only as raw 16-bit and as ASCII 8-bit files
+        if (s == NSIZE-1 && (t < 2) != (m > 0))
+          continue;
+
+        // pixels below 0, above maxval and fractional, clamped and
+        // truncated; rescaled, their range [lo, lo + maxval] maps to
+        // [0, maxval] by the float map (x - lo) * maxval / maxval of
+        // rescale(), truncated
+        img.createImage(nr, nc, types[t]);
+        img.setMaxval(maxval);
+        img16.createImage(nr, nc, types[t]);
+        img16.setMaxval(maxval);
+        img8.createImage(nr, nc, types[t]);
+        lo = -20.5;
+        clamped.clear();
+        rescaled.clear();
+        ints.clear();
+        for (i=0; i<nr; i++)
+          for (j=0; j<nc; j++)
+            for (k=0; k<img.getChannel(); k++) {
+              v = lo + rand() % (maxval + 1);
+              if (i == 0 && j == 0 && k == 0)
+                v = lo;
+              if (i == nr - 1 && j == nc - 1 && k == img.getChannel() - 1)
+                v = lo + maxval;
+              img(i,j,k) = v;
+              clamped.push_back((v > 0) ? (int)floor(min(v, (float)maxval))
+                                        : 0);
+              rescaled.push_back((int)((v - lo) * (float)maxval /
+                                       (float)maxval));
+              img16(i,j,k) = rand() % 65536;
+              ints.push_back(min((int)img16(i,j,k), maxval));
+            }
+
+        writeImage(img, fileName);
+        ok &= check(expected(types[t], nr, nc, maxval, clamped),
+                    "Image", types[t], nr, nc, maxval);
+        if (nr * nc > 1) {
+          writeImage(img, fileName, 1);
+          ok &= check(expected(types[t], nr, nc, maxval, rescaled),
+                      "Image rescaled", types[t], nr, nc, maxval);
+        }
+        writeImage(img16, fileName);
+        ok &= check(expected(types[t], nr, nc, maxval, ints),
+                    "Image16", types[t], nr, nc, maxval);
+
+        if (maxval == 255) {
+          ints.clear();
+          for (i=0; i<nr; i++)
+            for (j=0; j<nc; j++)
+              for (k=0; k<img8.getChannel(); k++) {
+                img8(i,j,k) = rand() % 256;
+                ints.push_back(img8(i,j,k));
+              }
+          writeImage(img8, fileName);
+          ok &= check(expected(types[t], nr, nc, 255, ints),
+                      "Image8", types[t], nr, nc, 255);
+        }
+      }
+
+  remove(fileName);
+
+  cout << (ok ? "PASS" : "FAIL") << endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+/********************************************************************
+ * BatchIO.h - read and write many image files in background threads
+ *
+ * A job that reads, processes and writes a long list of frames leaves
+ * the CPU idle while a file is read or written. A BatchReader reads the
+ * next few files of the list in a thread of its own while the current
+ * image is processed, and a BatchWriter writes the results in another
+ * thread, so that the I/O overlaps with the computation:
+ *
+ *     BatchReader in(names, 2);          // read up to 2 files ahead
+ *     BatchWriter out(2);                // queue up to 2 files
+ *     Image frame;
+ *     while (in.next(frame))
+ *       out.write(canny(frame, 1.0), edgeName(in.getName()));
+ *
+ * or, the same,
+ *
+ *     batchImage(names, edgeNames, 2,
+ *                [](const Image &f) { return canny(f, 1.0); });
+ *
+ * The files are read with readImage() and written with writeImage(), in
+ * any format they support. The buffers of the images are recycled (see
+ * ImagePool.h): the image given back to next() returns to the reader
+ * thread, which reads the next file into its buffer, and the images
+ * written are released by the thread that created them, at its next
+ * call to write().
+ *
+ * Created: 10/17/26
+ ********************************************************************/
+
+#ifndef BATCHIO_H
+#define BATCHIO_H
+
+#include "Image.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class BatchReader {
+ public:
+  BatchReader(const std::vector<std::string> &names, // read these files,
+              int ahead=2);            // up to ahead of them in advance
+  ~BatchReader();                      // stop reading
+
+  int next(Image &img);                // the next image (img's previous
+                                       // pixels are recycled), 0 at the end
+  int getIndex() const;                // index in names of the last image
+  const std::string &getName() const;  // its file name
+
+ private:
+  BatchReader(const BatchReader &);    // a reader cannot be copied
+  BatchReader & operator=(const BatchReader &);
+  void run();                          // the reader thread
+
+  std::vector<std::string> names;
+  int ahead;
+  int index;                           // of the last image handed out
+  std::deque<Image> ready;             // images read, not handed out
+  std::vector<Image> spent;            // images given back to next()
+  int stop;                            // the reader thread has to stop
+  std::mutex lock;
+  std::condition_variable changed;     // ready, spent or stop changed
+  std::thread reader;
+};
+
+class BatchWriter {
+ public:
+  BatchWriter(int depth=2);            // queue up to depth images
+  ~BatchWriter();                      // write the queued images
+
+  void write(const Image &img,         // queue img to be written to a
+             const std::string &name,  // file (flag: rescale, see
+             int flag=0);              // writeImage())
+  void flush();                        // wait until all are written
+
+ private:
+  BatchWriter(const BatchWriter &);    // a writer cannot be copied
+  BatchWriter & operator=(const BatchWriter &);
+  void run();                          // the writer thread
+
+  struct Job {
+    Image img;
+    std::string name;
+    int flag;
+  };
+
+  int depth;
+  std::deque<Job> queue;               // being written, then waiting
+  std::vector<Image> done;             // written, to be released
+  int stop;                            // no more images will be queued
+  std::mutex lock;
+  std::condition_variable changed;     // queue or stop changed
+  std::thread writer;
+};
+
+// apply op, a function or a lambda taking an image (const Image &) and
+// returning an image, to the images in the files in, writing the results
+// to the files out, reading and writing up to ahead files in advance;
+// the images op creates for one file are recycled for the next
+template <class F>
+void batchImage(const std::vector<std::string> &in,
+                const std::vector<std::string> &out, int ahead, F op) {
+  ImagePool pool;                      // op's images are recycled
+  BatchReader reader(in, ahead);
+  BatchWriter writer(ahead);
+  Image img;
+
+  while (reader.next(img))
+    writer.write(op(img), out[reader.getIndex()]);
+}
+
+#endif
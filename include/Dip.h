@@ -6,6 +6,15 @@
  * Created: 01/22/06
  *
  * Modification:
+ *   10/17/26 - add overloads of the point, lowpass and edge functions and
+ *              conv() that write into a given output image (the last 
+ *              argument), reusing its buffer when possible
+ *   10/17/26 - pass the images that are only read as const references
+ *   10/17/26 - add setConvCrossover(), the switch of conv() to the FFT
+ *   10/17/26 - add the border modes of conv()
+ *   10/17/26 - add convMulti() and convGradient(), several masks in one pass
+ *   10/17/26 - add FFTPlan, fftRows() and fftCols(), the radix-2 FFT shared
+ *              by fftifft() and conv()
  ********************************************************************/
 
 #ifndef DIP_H
@@ -13,6 +22,7 @@
 
 #include "Image.h"
 #include "Map.h"
+#include <vector>
 
 #define PI 3.1415926
 
@@ -20,107 +30,172 @@
 #define HIGH 1
 #define LOW 0
 
+// border modes of conv(), the pixels outside the image are
+#define BORDERZERO      0            // 0
+#define BORDERREPLICATE 1            // the nearest pixel of the image
+#define BORDERREFLECT   2            // mirrored about the edge (cba|abc)
+#define BORDERWRAP      3            // the pixels of the opposite side
+
 //////////////////////////////////////////////
 // point-based image enhancement processing
 
-Image negative(Image &);             // image negative
-Image cs(Image &,                    // contrast stretching 
+Image negative(const Image &);       // image negative
+Image cs(const Image &,              // contrast stretching 
          float,                      // slope
          float);                     // intercept
-Image logtran(Image &);              // dynamic range compression
-Image powerlaw(Image &,              // power-law transformation
+Image logtran(const Image &);        // dynamic range compression
+Image powerlaw(const Image &,        // power-law transformation
                float);               // the gamma value
-Image threshold(Image &,             // thresholding an image
+Image threshold(const Image &,       // thresholding an image
                 float,               // the threshold
                 int nt=BINARY);      // binary or grey-level thresholding
                                      // use "BINARY" or "GRAY"
-Image threshold(Image &,             // thresholding an image
+Image threshold(const Image &,       // thresholding an image
                 float,               // the lower threshold
 		float,               // the upper threshold
                 int nt=BINARY);      // binary or grey-level thresholding
                                      // use "BINARY" or "GRAY"
-Image autoThreshold(Image &);        // use Otsu's automatic thresholding
-void bitplane(Image &, Image []);    // bitplane slicing
-Image sampling(Image &,              // downsample the image
+Image autoThreshold(const Image &);  // use Otsu's automatic thresholding
+void bitplane(const Image &, Image []); // bitplane slicing
+Image sampling(const Image &,        // downsample the image
                int);                 // the sampling ratio, should be > 1
-Image quantization(Image &,          // quantize the image 
+Image quantization(const Image &,    // quantize the image 
                    int);             // number of quantization levels
-Image histeq(Image &);               // histogram equalization
+Image histeq(const Image &);         // histogram equalization
+
+// the same, but the result goes to the last argument, whose buffer is 
+// reused when it has the right size and is not shared with other images
+void negative(const Image &, Image &);
+void cs(const Image &, float, float, Image &);
+void logtran(const Image &, Image &);
+void powerlaw(const Image &, float, Image &);
+void threshold(const Image &, float, int, Image &);
+void threshold(const Image &, float, float, int, Image &);
+
+// 8-bit versions, the pixels are never widened to float
+Image8 negative(const Image8 &);     // image negative
+Image8 threshold(const Image8 &,     // thresholding an image
+                 float,              // the threshold
+                 int nt=BINARY);     // binary or grey-level thresholding
+Image8 threshold(const Image8 &,     // thresholding an image
+                 float,              // the lower threshold
+		 float,              // the upper threshold
+                 int nt=BINARY);     // binary or grey-level thresholding
+void negative(const Image8 &, Image8 &);
+void threshold(const Image8 &, float, int, Image8 &);
+void threshold(const Image8 &, float, float, int, Image8 &);
 
 // add various types of noise to the image
-Image gaussianNoise(Image &inimg,    // add Gaussian noise
+Image gaussianNoise(const Image &inimg, // add Gaussian noise
                     float std,       // standard deviation of Gaussian
                     float mean=0.0); // mean of Gaussian, default is zero
-Image sapNoise(Image &,              // add salt and pepper noise
+Image sapNoise(const Image &,        // add salt and pepper noise
                float);               // probability
 
 
 /////////////////////////////////////
 // neighbor-based processing
 
-Image conv(Image &,                  // convolution between an image
-           Image &);                 // and a mask image (kernel operation)
+Image conv(const Image &,            // convolution between an image
+           const Image &,            // and a mask image (kernel operation)
+           int border=BORDERZERO);   // the pixels outside the image
+void conv(const Image &,             // convolution into the output image
+          const Image &,             // the mask image
+          Image &,                   // the output image (reused)
+          int border=BORDERZERO);
+void convMulti(const Image &,        // convolution with several masks in
+               const std::vector<Image> &, // one pass, one output per
+               std::vector<Image> &, // mask (reused)
+               int border=BORDERZERO);
+void convGradient(const Image &,     // magnitude of the gradient from a
+                  const Image &,     // pair of masks, kx and ky, in one
+                  const Image &,     // pass
+                  Image &,           // magnitude (reused)
+                  int border=BORDERZERO);
+void convGradient(const Image &,     // the same, with the direction
+                  const Image &,     // atan2(gy, gx)
+                  const Image &,
+                  Image &,           // magnitude
+                  Image &,           // direction
+                  int border=BORDERZERO);
+void setConvCrossover(float);        // conv() uses the FFT when a mask takes
+                                     // more than this times the FFT work
+                                     // per pixel (0: always, <0: never)
 
 // low-pass filters
-Image average(Image &,               // average lowpass filter
+Image average(const Image &,         // average lowpass filter
               int size=3);           // masksize (assume square mask)
-Image gmean(Image &,                 // geometric mean
+Image gmean(const Image &,           // geometric mean
 	    int size=3);             // masksize (assume square mask)
-Image gaussianSmooth(Image &);       // Gaussian lowpass filter
-Image median(Image &,                // median filter
+Image gaussianSmooth(const Image &); // Gaussian lowpass filter
+Image median(const Image &,          // median filter
              int size=3);            // masksize (assume square mask)
-Image amedian(Image &,               // adaptive median filter
+Image8 median(const Image8 &,        // median filter of an 8-bit image
+              int size=3);           // masksize (assume square mask)
+Image amedian(const Image &,         // adaptive median filter
 	      int size=7);           // maximum mask size
-Image contrah(Image &,               // contraharmonic filter
+Image contrah(const Image &,         // contraharmonic filter
               float,                 // the order of the filter
               int size=3);           // the size (radius) of neighborhood
+void average(const Image &, int, Image &);  // the same, into the output
+void gmean(const Image &, int, Image &);    // image given as the last
+void gaussianSmooth(const Image &, Image &); // argument (buffer reused)
+void median(const Image &, int, Image &);
+void median(const Image8 &, int, Image8 &);
+void amedian(const Image &, int, Image &);
+void contrah(const Image &, float, int, Image &);
 
 // edge detectors
-Image roberts(Image &);              // Roberts edge detector
-Image sobel(Image &);                // Sobel edge detector
-void sobel(Image &img,               // Sobel edge detector
+Image roberts(const Image &);        // Roberts edge detector
+Image sobel(const Image &);          // Sobel edge detector
+void sobel(const Image &img,         // Sobel edge detector
            Image &mag,               // edge magnitude
            Image &gradient);         // edge direction
-Image prewitt(Image &);              // Prewitt edge detector
-Image laplacian(Image &,             // Laplacian edge detector
+Image prewitt(const Image &);        // Prewitt edge detector
+Image laplacian(const Image &,       // Laplacian edge detector
                 int nt = 1);         // use different types of kernel
                                      // 1 - [0 1 0; 1 -4 1; 0 1 0]
                                      // 2 - [1 1 1; 1 -8 1; 1 1 1]
                                      // 3 - [-1 2 -1; 2 -4 2; -1 2 -1]
-Image quadratic(Image &);            // quadratic variation
+Image quadratic(const Image &);      // quadratic variation
+void roberts(const Image &, Image &); // the same, into the output image
+void sobel(const Image &, Image &);   // given as the last argument 
+void prewitt(const Image &, Image &); // (buffer reused)
+void laplacian(const Image &, int, Image &);
+void quadratic(const Image &, Image &);
 
 // frequency-domain filters
-Image ideal(Image &inimg,            // the ideal filter
+Image ideal(const Image &inimg,      // the ideal filter
 	    int flag,                // HIGH for highpass, LOW for lowpass
 	    float radius);
-Image butterworth(Image &inimg,      // the butterworth filter
+Image butterworth(const Image &inimg, // the butterworth filter
 		  int flag,          // HIGH for highpass, LOW for lowpass
 		  float radius,
 		  int n);            // controls the sharpness of the curve
-Image gaussianFreq(Image &inimg,     // the Gaussian filter
+Image gaussianFreq(const Image &inimg, // the Gaussian filter
 		   int flag,         // HIGH for highpass, LOW for lowpass
 		   float std);       // standard deviation
-Image inverseFilter(Image &inimg,    // the inverse filter
+Image inverseFilter(const Image &inimg, // the inverse filter
 		    float std);      // standard deviation of the blur kernel
-Image wiener(Image &inimg,           // the input image
+Image wiener(const Image &inimg,     // the input image
 	     float K,                // power of noise / power of signal
 	     float std);             // standard deviation of the blur kernel
                                      // assuming it's Gaussian
 
 // The Marr-Hildreth edge detector
-Image marr(Image &,                 
+Image marr(const Image &,                 
            float);                   // std of Gaussian
 Image LoG(float);                    // generate the Laplacian of Gaussian
                                      // kernel with certain standard deviation
-Image zeroCrossing(Image &);         // find zero crossings in the image
+Image zeroCrossing(const Image &);   // find zero crossings in the image
 
 // Canny edge detector
-Image canny(Image &,                 // Canny edge detector
+Image canny(const Image &,           // Canny edge detector
             float);                  // std of Gaussian
-Image nonmax(Image &,                // nonmax suppression, the edge in x dire
-             Image &);               // the edge image in the y direction
-Image hThreshold(Image &);           // double thresholding
-void estThreshold(Image &,           // estimate the thresholds used above 
+Image nonmax(const Image &,          // nonmax suppression, the edge in x dire
+             const Image &);         // the edge image in the y direction
+Image hThreshold(const Image &);     // double thresholding
+void estThreshold(const Image &,     // estimate the thresholds used above 
                   int *,             // higher threshold
                   int *);            // lower threshold
 Image DoGX(float);                   // difference of Gaussian kernel
@@ -131,41 +206,41 @@ Image gaussianKernel(float);         // generate a Gaussian smooth kernel
 
 ////////////////////////////////////////////
 // image restoration and feature extraction
-Image mapmfa(Image &gimg,            // use mean field annealing to solve MAP
+Image mapmfa(const Image &gimg,      // use mean field annealing to solve MAP
              Map &par);              // parameter object
 int linear(Image &fimg,              // piece-wise linear surface model
-           Image &gimg,              // the measured image
+           const Image &gimg,        // the measured image
            Map &par);                // parameter
                  
 
 ///////////////////////////////////////////
 // Hough transform
 Image houghLine(Image &img);         // locate a line segment
-void houghPara(Image &img);          // locate parabolic curves
+void houghPara(const Image &img);    // locate parabolic curves
 
                             
 ////////////////////////////////////
 // geometric transformations
-Image translate(Image &,             // translation
+Image translate(const Image &,       // translation
                 float, float);       // tx and ty
-Image shear(Image &,                 // shear
+Image shear(const Image &,           // shear
             float, float);           // hx and hy
-Image scale(Image &,                 // scale
+Image scale(const Image &,           // scale
             float, float);           // sx and sy
-Image rotate(Image &,                // rotation
+Image rotate(const Image &,          // rotation
              float);                 // angle in degree (counterclock is +)
-Image perspective(Image &,           // perspective transform
-                  Image &);          // coordinates of n tiepoints
+Image perspective(const Image &,     // perspective transform
+                  const Image &);    // coordinates of n tiepoints
                                      // an nx4 matrix with the first two cols
                                      // coordinates from the original image
                                      // and the last two cols those of the 
                                      // transformed image
-Image geocorr(Image &);              // geometric correction
+Image geocorr(const Image &);        // geometric correction
 
 
 ////////////////////////////////////
 // Fourier transform
-void fft(Image &inimg,               // forward transform 
+void fft(const Image &inimg,         // forward transform 
 	 Image &mag, 
 	 Image &phase);
 void ifft(Image &outimg,             // inverse transform
@@ -176,13 +251,29 @@ void fftifft(Image &inimg,           // FFT
 	     Image &phase,
 	     int scale);             // 1: forward trans; -1: inverse trans
 
+struct FFTPlan {                     // radix-2 FFT of size n (a power of 2):
+  int n;                             // the bit-reversed order and the
+  std::vector<int> rev;              // twiddle factors exp(-2 pi i k/n),
+  std::vector<float> wr, wi;         // k < n/2
+
+  FFTPlan(int n);
+};
+void fftRows(float *re, float *im,   // in-place FFT of each row of an nr x nc
+             int nr, int nc,         // complex array (parts apart), with a
+             const FFTPlan &f,       // plan of size nc
+             int inv);               // 1: inverse (unscaled); 0: forward
+void fftCols(float *re, float *im,   // in-place FFT of each column, with a
+             int nr, int nc,         // plan of size nr
+             const FFTPlan &f,
+             int inv);
+
 
 ////////////////////////////////////
 // wavelet transform
-Image wt2d(Image &,                  // the 2-D image
+Image wt2d(const Image &,            // the 2-D image
 	   int,                      // level of wt decomposition/coefficients
 	   int);                     // forward transform (>=0) or inverse (-1)
-Image wt1d(Image &,                  // the 1-D row vector
+Image wt1d(const Image &,            // the 1-D row vector
 	   int);                     // forward transform (>=0) or inverse (-1)
 void daub4(Image &,                  // the 1-D row vector 
 	   int,                      // level of transform
@@ -191,60 +282,70 @@ void daub4(Image &,                  // the 1-D row vector
 
 ////////////////////////////////////
 // morphological operators
-Image dilate(Image &,                // the original image
-             Image &,                // the structuring element
+Image dilate(const Image &,          // the original image
+             const Image &,          // the structuring element
              int origRow=0,          // row coordinate of the origin of s.e.
              int origCol=0,          // col coordinate of the origin of s.e.
              int nt=BINARY);         // type of image, BINARY or GRAY
-Image erode(Image &,                 // the original image
-            Image &,                 // the structuring element
+Image erode(const Image &,           // the original image
+            const Image &,           // the structuring element
             int origRow=0,           // row coordinate of the origin of s.e.
             int origCol=0,           // col coordinate of the origin of s.e.
             int nt=BINARY);          // type of image, BINARY or GRAY
-Image open(Image &,                  // the original image
-           Image &,                  // the structuring element
+Image open(const Image &,            // the original image
+           const Image &,            // the structuring element
            int origRow=0,            // row coordinate of the origin of s.e.
            int origCol=0,            // col coordinate of the origin of s.e.
            int nt=BINARY);           // type of image, BINARY or GRAY
-Image close(Image &,                 // the original image
-            Image &,                 // the structuring element
+Image close(const Image &,           // the original image
+            const Image &,           // the structuring element
             int origRow=0,           // row coordinate of the origin of s.e.
             int origCol=0,           // col coordinate of the origin of s.e.
             int nt=BINARY);          // type of image, BINARY or GRAY
-Image bdilate(Image &img, Image &se, // binary dilation
+Image bdilate(const Image &img,      // binary dilation
+              const Image &se,
               int origRow, int origCol);
-Image berode(Image &img, Image &se,  // binary erosion
+Image berode(const Image &img,       // binary erosion
+             const Image &se,
              int origRow, int origCol);
-Image gdilate(Image &img, Image &se, // gray-scale dilation
+Image8 bdilate(const Image8 &img,    // binary dilation of an 8-bit image
+               const Image8 &se,
+               int origRow, int origCol);
+Image8 berode(const Image8 &img,     // binary erosion of an 8-bit image
+              const Image8 &se,
+              int origRow, int origCol);
+Image gdilate(const Image &img,      // gray-scale dilation
+              const Image &se,
               int origRow, int origCol);
-Image gerode(Image &img, Image &se,  // gray-scale erosion
+Image gerode(const Image &img,       // gray-scale erosion
+             const Image &se,
              int origRow, int origCol);
              
 
 ////////////////////////////////////
 // color processing routines
-Image RGB2HSI(Image &);              // convert from RGB to HSI model
-Image HSI2RGB(Image &);              // convert from HSI to RGB model
+Image RGB2HSI(const Image &);        // convert from RGB to HSI model
+Image HSI2RGB(const Image &);        // convert from HSI to RGB model
  
 
 ////////////////////////////////////
 // other utility functions
-float psnr(Image &,                  // peak SNR, original image
-           Image &);                 // degraded image
-float rmse(Image &,                  // root mean square error, original image
-	   Image &);                 // degraded image
+float psnr(const Image &,            // peak SNR, original image
+           const Image &);           // degraded image
+float rmse(const Image &,            // root mean square error, original image
+	   const Image &);           // degraded image
 double gaussrand();                  // generate a Gaussian random # (-3,3)
 void bubblesort(float *,             // bubblesort, pointer to the array
                 int);                // size of the array
 void bubblesort(float *,             // bubblesort, pointer to the array
                 int,                 // size of the array
                 int *p);             // pointer to the index
-float power(Image &);                // return the power of an image
-Image sqrt(Image &);                 // function overloading of sqrt()
-                                     // pixel-wise processing
-Image abs(Image &);                  // overloading function abs(), pixel-wise
+float power(const Image &);          // return the power of an image
+                                     // sqrt() and abs() of an image are
+                                     // pixel-wise expressions, see 
+                                     // ImageExpr.h
 float norm(float, float);            // calculate magnitude
-float sum(Image &img);               // summation of all pixel intensities
+float sum(const Image &img);         // summation of all pixel intensities
 void outofMemory();                  // print error message
 int floorPower2(int);                // the largested power of 2 <= the given
 
@@ -0,0 +1,98 @@
+/********************************************************************
+ * FrameIO.h - read and write streams of PGM/PPM frames
+ *
+ * A video stream piped from another program (e.g., ffmpeg -f image2pipe
+ * -vcodec pgm) is a sequence of raw PGM/PPM (or PAM, PFM) images, one
+ * after the other, on a pipe or in one file. A FrameReader reads the
+ * frames one at a time into an image whose buffer is reused from frame
+ * to frame, and a FrameWriter appends frames to such a stream:
+ *
+ *     FrameReader in("-");               // from stdin
+ *     FrameWriter out("-");              // to stdout
+ *     Image frame;
+ *     while (in.next(frame))
+ *       out.write(sobel(frame));
+ *
+ * The input is read in large blocks, and the header of a frame that is
+ * the same as the one of the previous frame is skipped without being
+ * parsed, so that a stream of frames of the same size costs little more
+ * than copying its bytes. The 8-bit frames of a PGM stream are read
+ * straight into the rows of an Image8. The frames written are raw PGM
+ * (gray-scale) or PPM (color) images, clamped to [0, maxval] as
+ * writeImage() does without rescaling.
+ *
+ * Created: 10/17/26
+ ********************************************************************/
+
+#ifndef FRAMEIO_H
+#define FRAMEIO_H
+
+#include "Image.h"
+#include <string>
+#include <vector>
+
+struct RescaleMap;
+
+class FrameReader {
+ public:
+  FrameReader(char *fname);            // read the frames of a file, or of
+                                       // stdin when fname is "-"
+  FrameReader(int fd);                 // or of an open file (e.g., a pipe)
+  ~FrameReader();                      // close the file if opened here
+
+  int next(Image &img);                // read the next frame into img,
+  int next(Image8 &img);               // reusing its buffer when the size
+  int next(Image16 &img);              // is the same; 0 at the end
+  int getCount() const;                // # of frames read so far
+
+ private:
+  FrameReader(const FrameReader &);    // a reader cannot be copied
+  FrameReader & operator=(const FrameReader &);
+  int fill(size_t n);                  // have n unread bytes in buf
+  void take(void *p, size_t n);        // the next n bytes of the stream
+  int header();                        // read the header of a frame
+  template <class T>
+  int frame(BasicImage<T> &img);       // read a frame
+
+  std::string name;
+  int fd, own;                         // the file, closed if own
+  std::vector<unsigned char> buf;      // the bytes read ahead,
+  size_t pos, len;                     // unread from pos to len
+  std::string head;                    // the header of the last frame
+  int nr, nc, nt, nchan, maxval;
+  float scale;                         // PFM (see readImage())
+  std::vector<unsigned char> raw;      // a row of the frame
+  std::vector<unsigned short> wide;    // a row of 16-bit samples
+  int count;
+};
+
+class FrameWriter {
+ public:
+  FrameWriter(char *fname);            // create a file of frames, or
+                                       // write to stdout when fname is "-"
+  FrameWriter(int fd);                 // or write to an open file
+  ~FrameWriter();                      // close the file if opened here
+
+  void write(const Image &img,         // append a frame (flag: rescale,
+             int flag=0);              // see writeImage())
+  void write(const Image8 &img);
+  void write(const Image16 &img);
+  int getCount() const;                // # of frames written so far
+
+ private:
+  FrameWriter(const FrameWriter &);    // a writer cannot be copied
+  FrameWriter & operator=(const FrameWriter &);
+  template <class T>
+  void frame(const BasicImage<T> &img, const RescaleMap *r);
+
+  std::string name;
+  int fd, own;                         // the file, closed if own
+  std::string head;                    // the header of the last frame
+  int nr, nc, nchan, maxval;           // and its size
+  std::vector<unsigned char> out;      // rows of samples, to be written
+  std::vector<unsigned char> plane8;   // the channels of a row
+  std::vector<unsigned short> row, plane16;
+  int count;
+};
+
+#endif
@@ -0,0 +1,26 @@
+/********************************************************************
+ * Gemm.h - cache-blocked matrix multiplication of float matrices,
+ *          used by the ->* operator of the image
+ *
+ * The product is computed by blocks that fit in the caches: a block of
+ * rows of b and a block of columns of a are copied (packed) into small
+ * contiguous panels, and a register-tiled kernel multiplies the panels.
+ * The kernel uses AVX (and FMA) when the library is compiled for it,
+ * e.g., with -mavx2 -mfma, SSE2 on other x86-64 builds, and plain loops
+ * elsewhere. Large products are split over the threads of parallelRows()
+ * (see Parallel.h), each computing a band of the result.
+ *
+ * Created: 10/17/26
+ ********************************************************************/
+
+#ifndef GEMM_H
+#define GEMM_H
+
+// c += a * b, where a is m x k, b is k x n and c is m x n; lda, ldb and
+// ldc are the row pitches (in floats) of the three matrices
+void gemm(int m, int n, int k,
+          const float *a, int lda,
+          const float *b, int ldb,
+          float *c, int ldc);
+
+#endif
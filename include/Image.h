@@ -10,9 +10,47 @@
  *   This is a simple C++ library for image processing. 
  *   The purpose is not high performance, but to show how 
  *   the algorithm works through programming.
- *   This library can only read in PGM/PPM format images. 
+ *   This library can only read in PGM/PPM (and PAM/PFM) format images. 
  *
  * Modification:
+ *   10/17/26 - createImage() keeps the maxval of the image; the filters
+ *              and the expressions give their result the maxval of the
+ *              input, so 12-bit data is written back as 12-bit data
+ *   10/17/26 - compute the pixel offsets in ptrdiff_t, so that a channel
+ *              can hold more than 2^31 pixels
+ *   10/17/26 - readImage8() uses the mapped pixels of any raw 8-bit PGM
+ *              file in place, with the row pitch of the file (the width)
+ *   10/17/26 - add the tiled types PGMTILE and PPMTILE, a file of tiles
+ *              with reduced-resolution levels (see TileIO.h)
+ *   10/17/26 - add the packed types PGMPACK and PPMPACK, a lossless
+ *              compressed raster written and read by writeImage() and
+ *              readImage()
+ *   10/17/26 - add writePAM() and writePFM(); readImage() reads PAM and
+ *              PFM files
+ *   10/17/26 - add getMaxval()/setMaxval(), the maximum value of the file
+ *              the image is read from or written to (e.g., 4095 for
+ *              12-bit data); add readImage16() and writeImage() of 16-bit
+ *              images, 16-bit PGM/PPM files are supported
+ *   10/17/26 - a PGM file read by readImage8() is mapped in memory and its
+ *              pixels used in place; add useBuffer()
+ *   10/17/26 - the ->* operator multiplies float images with the cache-
+ *              blocked, multithreaded gemm() (see Gemm.h)
+ *   10/17/26 - add getMinMax(); the min/max functions use vectorized row
+ *              kernels (see Reduce.h) and handle multi-channel images
+ *   10/17/26 - the pixel-wise operators return lazy expressions that are
+ *              evaluated in one pass on assignment (see ImageExpr.h)
+ *   10/17/26 - subImage(), getImage() and getRed/Green/Blue() return views
+ *              sharing the pixels of the image instead of copies; read-only
+ *              image parameters are passed as const references
+ *   10/17/26 - the pixel buffers can be recycled by a scoped ImagePool
+ *   10/17/26 - add createImageUninit() for results whose every pixel is
+ *              written
+ *   10/17/26 - make the image a template over the pixel type (BasicImage);
+ *              Image (float), Image8 and Image16 are its instances
+ *   10/17/26 - store each channel as a separate plane of 64-byte aligned,
+ *              padded rows; add getStride() and rowPtr()
+ *   10/17/26 - share the pixel buffer between copies (copy-on-write) and
+ *              add move constructor/assignment
  *   07/31/09 - moving header files for colorProcessing, imageIO, and
  *               matrixProcessing to this file
  *   01/22/06 - reorganize the Image library such that the Image class
@@ -31,6 +69,10 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstddef>
+#include <atomic>
+#include <limits>
+#include <type_traits>
 
 using namespace std;
 
@@ -38,111 +80,230 @@ using namespace std;
 #define PPMRAW   2                     // magic number is 'P6'
 #define PGMASCII 3                     // magic number is 'P2'
 #define PPMASCII 4                     // magic number is 'P3'
+#define PGMPACK  5                     // lossless packed, magic is 'Pz'
+#define PPMPACK  6                     // lossless packed, magic is 'PZ'
+#define PGMTILE  7                     // tiled, packed tiles, magic is 'Pt'
+#define PPMTILE  8                     // tiled, magic number is 'PT'
 #define GRAY     10                    // gray-level image
 #define BINARY   11                    // binary image
 
 #define NBIT 8         
 #define L ( pow(2.0,NBIT)-1 )    // the largest intensity represented by NBIT
 
-class Image {
-  friend ostream & operator<<(ostream &, Image &);
-  friend Image operator/(Image &, double);    // image divided by a scalar
-  friend Image operator*(Image &, double);    // image multiplied by a scalar
-  friend Image operator+(Image &, double);    // image add a scalar
-  friend Image operator-(Image &, double);    // image subtract a scalar
-    
+#define ALIGNMENT 64   // alignment (in bytes) of the rows of the pixel buffer
+
+// pixel buffer shared by all the copies of an image. The buffer is only 
+// duplicated when one of the sharing images is about to be modified 
+// (copy-on-write), so passing and returning images by value is cheap.
+// An image can also be a view of a region or a channel of another image's
+// buffer (see getSubImage()), with the row pitch and channel pitch of 
+// that image; modifying the view gives it its own compact copy.
+// The buffers are obtained through ImagePool, which recycles them while
+// a pool is in scope. The pixels can also lie in a private (copy-on-write)
+// memory mapping of an image file, which is unmapped with the buffer.
+struct ImageBuffer {
+  atomic<int> refs;                    // number of images using the buffer
+  void *data;                          // the pixels
+  size_t bytes;                        // the size of data
+  unsigned pool;                       // the pool that handed it out
+  void *map;                           // the file mapping holding data,
+  size_t mapBytes;                     // if any, and its size
+};
+
+#include "ImagePool.h"
+
+// convert a value to the pixel type T. Integer pixels are clamped to 
+// the range of T and the fraction is dropped, as done by writeImage()
+template <class T, class V> 
+inline T pixelCast(V v) {
+  if (!numeric_limits<T>::is_integer)
+    return (T) v;
+  if (!(v > 0))                        // also catches NaN
+    return 0;
+  if (v >= (V) numeric_limits<T>::max())
+    return numeric_limits<T>::max();
+  return (T) v;
+}
+
+// base of the lazy image expressions built by the pixel-wise operators
+// (see ImageExpr.h), E is the type of the expression
+template <class E>
+struct ImageExpr {
+  const E & self() const { return static_cast<const E &>(*this); }
+};
+
+template <class T>                     // T is the pixel type
+class BasicImage {
  public:
   // constructors and destructor
-  Image();                             // default constructor 
-  Image(int,                           // constructor with row
-    	int,                           // column
-    	int t=PGMRAW);                 // type (use PGMRAW, PPMRAW, 
-                                       // PGMASCII, PPMASCII)
-  Image(const Image &);                // copy constructor 
-  ~Image();                            // destructor 
+  BasicImage();                        // default constructor 
+  BasicImage(int,                      // constructor with row
+	     int,                      // column
+	     int t=PGMRAW);            // type (use PGMRAW, PPMRAW, 
+                                       // PGMASCII, PPMASCII, PGMPACK,
+                                       // PPMPACK, PGMTILE, PPMTILE)
+  BasicImage(const BasicImage &);      // copy constructor (shares pixels)
+  BasicImage(BasicImage &&);           // move constructor
+  template <class U>                   // convert from another pixel type
+  explicit BasicImage(const BasicImage<U> &);
+  template <class E, class =           // evaluate an image expression
+            typename enable_if<is_same<typename E::value_type, T>::value>::type>
+  BasicImage(const ImageExpr<E> &);
+  ~BasicImage();                       // destructor 
 
   // create an image
   void createImage();                  // create an image, parameters all set
   void createImage(int,                // create an image with row
 		   int c=1,            // column (default 1, a column vector)
 		   int t=PGMRAW);      // and type, default is PGMRAW
-  void initImage(float init=0.0);      // initiate the pixel value of an img
-                                       // the default is 0.0
+  void createImageUninit(int,          // the same, but the pixels are
+                         int c=1,      // not initialized, for callers that
+                         int t=PGMRAW);// write every pixel
+  void useBuffer(ImageBuffer *,        // use pixels that are already in a 
+                 T *, int, int,        // buffer (e.g., a mapped file):
+                 int, int);            // pixels, row, col, type, row pitch
+  void initImage(T init=0);            // initiate the pixel value of an img
+                                       // the default is 0
 
   // get and set functions
   int getRow() const;                  // get row # / the height of the img 
   int getCol() const;                  // get col # / the width of the image 
   int getChannel() const;              // get channel number of the image
   int getType() const;                 // get the image type 
+  int getStride() const;               // get the row pitch (# of pixels 
+                                       // from one row to the next)
+  int getMaxval() const;               // get the maximum value of the file
   float getMaximum() const;            // get the maximum pixel value
   void getMaximum(float &,             // return the maximum pixel value
-		  int &, int &);       // and its indices
+		  int &, int &) const; // and its indices
   float getMinimum() const;            // get the mininum pixel value
   void getMinimum(float &,             // return the minimum pixel value
-		  int &, int &);       // and its indices
-  Image getRed() const;                // get the red channel
-  Image getGreen() const;              // get the green channel
-  Image getBlue() const;               // get the blue channel
-  Image getImage(int) const;           // get the kth channel image, 
+		  int &, int &) const; // and its indices
+  void getMinMax(float &,              // get both in one pass: the minimum
+		 float &) const;       // and the maximum pixel value
+  void getMinMax(float &, int &, int &,// and with their row and column
+		 float &, int &, int &) const; // indices
+  BasicImage getRed() const;           // get the red channel
+  BasicImage getGreen() const;         // get the green channel
+  BasicImage getBlue() const;          // get the blue channel
+  BasicImage getImage(int) const;      // get the kth channel image, 
                                        // k starts at 0
+  BasicImage getSubImage(int,          // get a region, starting row index
+                         int,          // starting column index
+                         int,          // ending row index
+                         int) const;   // ending column index
 
   void setRow(int);                    // set row number 
   void setCol(int);                    // set column number 
   void setChannel(int);                // set the number of channel
   void setType(int t=PGMRAW);          // set the image type
-  void setRed(Image &);                // set the red channel
-  void setGreen(Image &);              // set the green channel
-  void setBlue(Image &);               // set the blue channel
-  void setImage(Image &, int);         // set the kth channel image,
+  void setMaxval(int);                 // set the maximum value of the file
+  void setRed(BasicImage &);           // set the red channel
+  void setGreen(BasicImage &);         // set the green channel
+  void setBlue(BasicImage &);          // set the blue channel
+  void setImage(BasicImage &, int);    // set the kth channel image,
                                        // k starts at 0
                                        
   // operator overloading functions
-  float & operator()(int,                  // operator overloading (i,j,k)
-		     int c = 0,            // when c=k=0, a column vector 
-		     int k = 0) const;     
-  const Image operator=(const Image &);    // = operator overloading
-  Image operator+(const Image &) const;    // overloading + operator
-  Image operator-(const Image &) const;    // overloading - operator
-  Image operator*(const Image &) const;    // overloading pixelwise *
-  Image operator/(const Image &) const;    // overloading pixelwise division
-  Image operator->*(const Image &) const;  // overloading ->* operator 
-                                           // (matrix multiplication) 
+  T & operator()(int i,                    // operator overloading (i,j,k)
+		 int j = 0,                // when j=k=0, a column vector 
+		 int k = 0) {              // (write access, unshares pixels)
+    if (buf && buf->refs.load(memory_order_relaxed) > 1)
+      detach();
+    return image[k*cstride+(ptrdiff_t)i*stride+j];
+  }
+  const T & operator()(int i,              // read-only access (i,j,k)
+		       int j = 0,
+		       int k = 0) const {
+    return image[k*cstride+(ptrdiff_t)i*stride+j];
+  }
+  T * rowPtr(int i,                        // pointer to the ith row of the
+	     int k = 0) {                  // kth channel, the col pixels of 
+    if (buf && buf->refs.load(memory_order_relaxed) > 1)
+      detach();                            // the row are contiguous
+    return image + k*cstride + (ptrdiff_t)i*stride;
+  }
+  const T * rowPtr(int i,                  // read-only row pointer
+		   int k = 0) const {
+    return image + k*cstride + (ptrdiff_t)i*stride;
+  }
+  BasicImage & operator=(const BasicImage &);       // = operator overloading
+  BasicImage & operator=(BasicImage &&);            // move assignment
+  template <class E>                                // evaluate an expression
+  BasicImage & operator=(const ImageExpr<E> &);     // (+, -, *, /, sqrt, abs)
+  BasicImage operator->*(const BasicImage &) const; // overloading ->* operator
+                                                    // (matrix multiplication)
 
   bool IsEmpty() const { return (image==NULL); }
 
  private:
+  void allocate();          // allocate a new (unshared) pixel buffer
+  void release();           // drop this image's reference to its buffer
+  void detach();            // get a private copy of a shared buffer
+  bool isView() const;      // true if not using the whole buffer
+  template <class E>
+  void assign(const E &);   // evaluate an expression into the image
+
   int row;                  // number of rows / height 
   int col;                  // number of columns / width 
   int channel;              // nr of channels (1 for gray, 3 for color)
   int type;                 // image type (PGM, PPM, etc.)
-  int maximum;              // the maximum pixel value
-  float *image;             // image buffer
+  int maximum;              // the maximum value of the file (maxval)
+  int stride;               // nr of pixels between two rows (row pitch)
+  ptrdiff_t cstride;        // nr of pixels between two channel planes
+  ImageBuffer *buf;         // the (possibly shared) pixel buffer
+  T *image;                 // image buffer, same as buf->data
 };
 
+typedef BasicImage<float> Image;            // the default, float pixels
+typedef BasicImage<unsigned char> Image8;   // 8-bit pixels
+typedef BasicImage<unsigned short> Image16; // 16-bit pixels
+
+template <class T>                          // output the pixel values
+ostream & operator<<(ostream &, const BasicImage<T> &);
+
+// the pixel-wise operators +, -, *, / (between images, or an image and a
+// scalar), sqrt() and abs()
+#include "ImageExpr.h"
+
 
 ////////////////////////////////////
 // image I/O
 Image readImage(char *);             // read image
-void writeImage(Image &,             // write an image
+void writeImage(const Image &,       // write an image
                 char *,
                 int flag=0);         // flag for rescale, rescale when == 1
-Image rescale(Image &,               // rescale an image
+Image8 readImage8(char *);           // read image into 8-bit pixels
+                                     // (a PGM file is used in place)
+void writeImage(const Image8 &,      // write an 8-bit image
+                char *);
+Image16 readImage16(char *);         // read image into 16-bit pixels
+void writeImage(const Image16 &,     // write a 16-bit image
+                char *);
+void writePAM(const Image &, char *); // write a PAM file (P7), with the
+void writePAM(const Image8 &,        // maxval of the image
+              char *);
+void writePAM(const Image16 &, char *);
+void writePFM(const Image &, char *); // write the floats as they are to a
+                                     // PFM file (read by readImage())
+Image rescale(const Image &,         // rescale an image
               float a=0.0,           // lower bound
-              float b=L);            // upper bound
+              float b=-1);           // upper bound, the default (-1) is
+                                     // the maxval of the image
 
 
 ////////////////////////////////////
 // color processing routines
-Image RGB2HSI(Image &);              // convert from RGB to HSI model
-Image HSI2RGB(Image &);              // convert from HSI to RGB model
+Image RGB2HSI(const Image &);        // convert from RGB to HSI model
+Image HSI2RGB(const Image &);        // convert from HSI to RGB model
 
 
 ////////////////////////////////////
 // matrix manipulation
-Image transpose(Image &);            // image transpose
-Image inverse(Image &);              // image inverse
-Image pinv(Image &);                 // image pseudo-inverse
-Image subImage(Image &,              // crop an image
+Image transpose(const Image &);      // image transpose
+Image inverse(const Image &);        // image inverse
+Image pinv(const Image &);           // image pseudo-inverse
+Image subImage(const Image &,        // crop an image (a view, no copy)
                int,                  // starting row index
                int,                  // starting column index
                int,                  // ending row index
@@ -0,0 +1,342 @@
+/********************************************************************
+ * ImageExpr.h - lazy evaluation of the pixel-wise image arithmetic
+ *
+ * The operators +, -, *, / between images, between an image and a
+ * scalar, and sqrt(), abs() of an image do not compute anything. They
+ * return small expression objects that remember the operands, so that
+ *
+ *     mag = sqrt(gx * gx + gy * gy);
+ *
+ * is evaluated in a single loop when it is assigned to an image (or used
+ * to construct one), without any temporary image. Each operation rounds
+ * its result to the pixel type, so the pixels are exactly the same as
+ * those computed one operation at a time.
+ *
+ * An expression refers to the images it was built from and should be
+ * assigned before the end of the statement.
+ *
+ * The compound operators +=, -=, *=, /= work in place: they reuse the
+ * buffer of the image unless it is shared with another image.
+ *
+ * The result has the maxval of the image operands (the largest one,
+ * when they differ), so that 12-bit data stays 12-bit when written.
+ *
+ * This file is included by Image.h.
+ *
+ * Created: 10/17/26
+ ********************************************************************/
+
+#ifndef IMAGEEXPR_H
+#define IMAGEEXPR_H
+
+#include <type_traits>
+
+// an image operand of an expression, reads the pixels one row at a time
+template <class T>
+class ImageTerm : public ImageExpr<ImageTerm<T> > {
+ public:
+  typedef T value_type;
+
+  ImageTerm(const BasicImage<T> &img) : img(&img), p(0) {}
+
+  int getRow() const { return img->getRow(); }
+  int getCol() const { return img->getCol(); }
+  int getChannel() const { return img->getChannel(); }
+  int getType() const { return img->getType(); }
+  int getMaxval() const { return img->getMaxval(); }
+  void seekRow(int i, int k) { p = img->rowPtr(i,k); } // move to row i
+  T at(int j) const { return p[j]; }                   // jth pixel of row
+
+ private:
+  const BasicImage<T> *img;
+  const T *p;
+};
+
+// turns an operand (image or expression) into an expression; only
+// defined for those, so the operators below ignore all the other types
+template <class A, class Enable = void>
+struct ExprOf {};
+
+template <class T>
+struct ExprOf<BasicImage<T> > {
+  typedef ImageTerm<T> type;
+  static type make(const BasicImage<T> &a) { return type(a); }
+};
+
+template <class A>
+struct ExprOf<A, typename enable_if<is_base_of<ImageExpr<A>, A>::value>::type> {
+  typedef A type;
+  static const A & make(const A &a) { return a; }
+};
+
+
+// the pixel-wise operations, with the messages used when the operands
+// do not match
+struct ExprAdd {
+  template <class V> static V apply(V a, V b) { return pixelCast<V>(a + b); }
+  static const char *name() { return "operator+: "; }
+  static const char *what() { return "can't do addition"; }
+};
+
+struct ExprSub {
+  template <class V> static V apply(V a, V b) { return pixelCast<V>(a - b); }
+  static const char *name() { return "operator-: "; }
+  static const char *what() { return "can't do subtraction"; }
+};
+
+struct ExprMul {
+  template <class V> static V apply(V a, V b) { return pixelCast<V>(a * b); }
+  static const char *name() { return "operator*: "; }
+  static const char *what() { return "can't do multiplication"; }
+};
+
+struct ExprDiv {
+  template <class V> static V apply(V a, V b) {
+    return pixelCast<V>(a / (b+0.000001));
+  }
+  static const char *name() { return "operator/: "; }
+  static const char *what() { return "can't do division"; }
+};
+
+struct ExprScalarAdd {
+  template <class V> static V apply(V a, double s) {
+    return pixelCast<V>(a + s);
+  }
+};
+
+struct ExprScalarSub {
+  template <class V> static V apply(V a, double s) {
+    return pixelCast<V>(a - s);
+  }
+};
+
+struct ExprScalarMul {
+  template <class V> static V apply(V a, double s) {
+    return pixelCast<V>(a * s);
+  }
+};
+
+struct ExprScalarDiv {
+  template <class V> static V apply(V a, double s) {
+    return pixelCast<V>(a / s);
+  }
+};
+
+struct ExprSqrt {
+  template <class V> static V apply(V a) { return pixelCast<V>(sqrt(a)); }
+};
+
+struct ExprAbs {
+  template <class V> static V apply(V a) { return pixelCast<V>(fabs(a)); }
+};
+
+
+// pixel-wise operation between two images of the same size and type
+template <class A, class B, class Op>
+class ImageBinaryExpr : public ImageExpr<ImageBinaryExpr<A,B,Op> > {
+ public:
+  typedef typename A::value_type value_type;
+
+  ImageBinaryExpr(const A &a, const B &b) : a(a), b(b) {
+    static_assert(is_same<value_type, typename B::value_type>::value,
+                  "the images must have the same pixel type");
+    if (a.getRow() != b.getRow() || a.getCol() != b.getCol() ||
+        a.getChannel() != b.getChannel() || a.getType() != b.getType()) {
+      cout << Op::name()
+           << "Images are not of the same size or type, "
+           << Op::what() << "\n";
+      exit(3);
+    }
+  }
+
+  int getRow() const { return a.getRow(); }
+  int getCol() const { return a.getCol(); }
+  int getChannel() const { return a.getChannel(); }
+  int getType() const { return a.getType(); }
+  int getMaxval() const {
+    return (a.getMaxval() > b.getMaxval()) ? a.getMaxval() : b.getMaxval();
+  }
+  void seekRow(int i, int k) { a.seekRow(i,k); b.seekRow(i,k); }
+  value_type at(int j) const { return Op::apply(a.at(j), b.at(j)); }
+
+ private:
+  A a;
+  B b;
+};
+
+// pixel-wise operation between an image and a scalar
+template <class A, class Op>
+class ImageScalarExpr : public ImageExpr<ImageScalarExpr<A,Op> > {
+ public:
+  typedef typename A::value_type value_type;
+
+  ImageScalarExpr(const A &a, double s) : a(a), s(s) {}
+
+  int getRow() const { return a.getRow(); }
+  int getCol() const { return a.getCol(); }
+  int getChannel() const { return a.getChannel(); }
+  int getType() const { return a.getType(); }
+  int getMaxval() const { return a.getMaxval(); }
+  void seekRow(int i, int k) { a.seekRow(i,k); }
+  value_type at(int j) const { return Op::apply(a.at(j), s); }
+
+ private:
+  A a;
+  double s;
+};
+
+// pixel-wise function of an image
+template <class A, class Op>
+class ImageUnaryExpr : public ImageExpr<ImageUnaryExpr<A,Op> > {
+ public:
+  typedef typename A::value_type value_type;
+
+  ImageUnaryExpr(const A &a) : a(a) {}
+
+  int getRow() const { return a.getRow(); }
+  int getCol() const { return a.getCol(); }
+  int getChannel() const { return a.getChannel(); }
+  int getType() const { return a.getType(); }
+  int getMaxval() const { return a.getMaxval(); }
+  void seekRow(int i, int k) { a.seekRow(i,k); }
+  value_type at(int j) const { return Op::apply(a.at(j)); }
+
+ private:
+  A a;
+};
+
+
+////////////////////////////////////
+// the operators, taking images or expressions as operands
+
+#define IMAGE_BINARY_OPERATOR(op, Op)                                   \
+template <class A, class B>                                             \
+inline ImageBinaryExpr<typename ExprOf<A>::type,                        \
+                       typename ExprOf<B>::type, Op>                    \
+operator op(const A &a, const B &b) {                                   \
+  return ImageBinaryExpr<typename ExprOf<A>::type,                      \
+                         typename ExprOf<B>::type, Op>                  \
+    (ExprOf<A>::make(a), ExprOf<B>::make(b));                           \
+}
+
+#define IMAGE_SCALAR_OPERATOR(op, Op)                                   \
+template <class A>                                                      \
+inline ImageScalarExpr<typename ExprOf<A>::type, Op>                    \
+operator op(const A &a, double s) {                                     \
+  return ImageScalarExpr<typename ExprOf<A>::type, Op>                  \
+    (ExprOf<A>::make(a), s);                                            \
+}
+
+#define IMAGE_FUNCTION(f, Op)                                           \
+template <class A>                                                      \
+inline ImageUnaryExpr<typename ExprOf<A>::type, Op>                     \
+f(const A &a) {                                                         \
+  return ImageUnaryExpr<typename ExprOf<A>::type, Op>                   \
+    (ExprOf<A>::make(a));                                               \
+}
+
+IMAGE_BINARY_OPERATOR(+, ExprAdd)        // overloading + operator
+IMAGE_BINARY_OPERATOR(-, ExprSub)        // overloading - operator
+IMAGE_BINARY_OPERATOR(*, ExprMul)        // overloading pixelwise *
+IMAGE_BINARY_OPERATOR(/, ExprDiv)        // overloading pixelwise division
+IMAGE_SCALAR_OPERATOR(+, ExprScalarAdd)  // image add a scalar
+IMAGE_SCALAR_OPERATOR(-, ExprScalarSub)  // image subtract a scalar
+IMAGE_SCALAR_OPERATOR(*, ExprScalarMul)  // image times a scalar
+IMAGE_SCALAR_OPERATOR(/, ExprScalarDiv)  // image divided by scalar
+IMAGE_FUNCTION(sqrt, ExprSqrt)           // pixel-wise square root
+IMAGE_FUNCTION(abs, ExprAbs)             // pixel-wise absolute value
+
+#define IMAGE_COMPOUND_OPERATOR(op, binop)                              \
+template <class T, class B>                                             \
+inline typename enable_if<is_same<T, typename                           \
+  ExprOf<B>::type::value_type>::value, BasicImage<T> &>::type           \
+operator op(BasicImage<T> &a, const B &b) {                             \
+  return a = a binop b;                                                 \
+}                                                                       \
+template <class T>                                                      \
+inline BasicImage<T> & operator op(BasicImage<T> &a, double s) {        \
+  return a = a binop s;                                                 \
+}
+
+IMAGE_COMPOUND_OPERATOR(+=, +)           // add in place
+IMAGE_COMPOUND_OPERATOR(-=, -)           // subtract in place
+IMAGE_COMPOUND_OPERATOR(*=, *)           // pixelwise * in place
+IMAGE_COMPOUND_OPERATOR(/=, /)           // pixelwise division in place
+
+#undef IMAGE_BINARY_OPERATOR
+#undef IMAGE_SCALAR_OPERATOR
+#undef IMAGE_FUNCTION
+#undef IMAGE_COMPOUND_OPERATOR
+
+
+////////////////////////////////////
+// evaluation of an expression into an image
+
+/**
+ * Create an image from an expression.
+ * @param e The expression.
+ */
+template <class T> template <class E, class>
+BasicImage<T>::BasicImage(const ImageExpr<E> &e) {
+  stride = cstride = 0;
+  buf = 0;
+  image = 0;
+  assign(e.self());
+}
+
+/**
+ * Assign an expression to the image.
+ * @param e The expression.
+ * @return Reference to this image.
+ */
+template <class T> template <class E>
+BasicImage<T> & BasicImage<T>::operator=(const ImageExpr<E> &e) {
+  assign(e.self());
+  return *this;
+}
+
+/**
+ * Evaluate an expression into the image in one pass over the pixels.
+ * When this image has the size and type of the result and does not share
+ * its buffer, the pixels are written in place: the expression can only
+ * refer to this buffer through this very image, and every pixel is read
+ * before it is written. Otherwise the result goes to a new buffer. The
+ * image takes the maxval of the expression.
+ * @param expr The expression.
+ */
+template <class T> template <class E>
+void BasicImage<T>::assign(const E &expr) {
+  static_assert(is_same<T, typename E::value_type>::value,
+                "the expression must have the pixel type of the image");
+  E e = expr;                   // the copy keeps the current row pointers
+  BasicImage<T> temp, *out;
+  T *q;
+  int i, j, k, nr, nc, nchan, nt;
+
+  nr = e.getRow();
+  nc = e.getCol();
+  nchan = e.getChannel();
+  nt = e.getType();
+
+  if (buf && buf->refs == 1 && !isView() &&
+      nr == row && nc == col && nchan == channel && nt == type)
+    out = this;
+  else {
+    temp.createImageUninit(nr, nc, nt);
+    out = &temp;
+  }
+
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++) {
+      q = out->rowPtr(i,k);
+      e.seekRow(i,k);
+      for (j=0; j<nc; j++)
+        q[j] = e.at(j);
+    }
+
+  out->maximum = e.getMaxval();
+  if (out != this)
+    *this = std::move(temp);
+}
+
+#endif
@@ -0,0 +1,66 @@
+/********************************************************************
+ * ImagePool.h - a scoped pool of image buffers
+ *
+ * While an ImagePool object exists, the pixel buffers released by the
+ * images of the same thread are kept in the pool instead of being freed,
+ * and new images take their buffers from the pool. A loop that creates
+ * and destroys images of the same sizes, e.g., the temporaries of an
+ * edge detector applied to every frame of a video, then stops allocating
+ * (and page faulting) after the first frame:
+ *
+ *     ImagePool pool;                  // recycle buffers in this scope
+ *     for (i=0; i<nframes; i++) {
+ *       frame = readImage(fname[i]);
+ *       edge = canny(frame, 1.0);
+ *       ...
+ *     }
+ *     cout << pool.getHits() << " buffers reused\n";
+ *
+ * The buffers are grouped in size classes which are at most 1/4 larger
+ * than the requested size. The cached buffers are freed when the pool
+ * goes out of scope; images that still use buffers of the pool free them
+ * as usual later. Pools can be nested, the innermost one is used.
+ *
+ * This file is included by Image.h.
+ *
+ * Created: 10/17/26
+ ********************************************************************/
+
+#ifndef IMAGEPOOL_H
+#define IMAGEPOOL_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+struct ImageBuffer;
+
+class ImagePool {
+ public:
+  ImagePool();                         // start recycling in this thread
+  ~ImagePool();                        // free the cached buffers
+
+  long getHits() const;                // # of buffers taken from the pool
+  long getMisses() const;              // # of buffers newly allocated
+  size_t getPeakBytes() const;         // most bytes in use and cached
+  size_t getCachedBytes() const;       // bytes kept for reuse right now
+  void clear();                        // free the cached buffers
+
+  // used by the images to get and give back their pixel buffers
+  static ImageBuffer *acquire(size_t bytes);
+  static void recycle(ImageBuffer *b);
+
+ private:
+  ImagePool(const ImagePool &);        // a pool cannot be copied
+  ImagePool & operator=(const ImagePool &);
+
+  ImagePool *prev;                     // the enclosing pool
+  unsigned id;                         // marks the buffers handed out
+  std::map<size_t, std::vector<ImageBuffer *> > cache; // by size class
+  long hits, misses;
+  size_t held;                         // bytes handed out or cached
+  size_t cached;                       // bytes cached
+  size_t peak;                         // the maximum of held
+};
+
+#endif
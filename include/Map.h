@@ -6,6 +6,7 @@
  * Created: 02/12/06
  *
  * Modification:
+ *   10/17/26 - incrNann() and incrNiter() return the new count
  ********************************************************************/
 #ifndef _MAP_H_
 #define _MAP_H_
@@ -45,8 +46,8 @@ class Map {
   void setDiv(int div=25) { this->div = div; }
       
   // increment functions
-  int incrNann() { nann++; }
-  int incrNiter() { niter++; }
+  int incrNann() { return ++nann; }
+  int incrNiter() { return ++niter; }
   
  private:
   float t;                    // the current temperature 
@@ -0,0 +1,144 @@
+/********************************************************************
+ * PNMCodec.h - the parts of the PGM/PPM codec shared by the readers
+ *              and writers of imageIO.cpp, frameIO.cpp, tileIO.cpp and
+ *              stripIO.cpp
+ *
+ * Not part of the library interface: the header of a file, the
+ * conversions between the rows of a file and the rows of an image, and
+ * the coding of the bands of packed and tiled files, defined in
+ * imageIO.cpp (writeTiles() in tileIO.cpp) for the pixel types of Image,
+ * Image8 and Image16.
+ *
+ * Created: 10/17/26
+ ********************************************************************/
+
+#ifndef PNMCODEC_H
+#define PNMCODEC_H
+
+#include "Image.h"
+#include <vector>
+#include <string>
+#include <iosfwd>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+
+#define RAWBLOCK (1 << 20)     // bytes of raw samples before each write
+
+// the header of a PGM/PPM/PAM/PFM, packed or tiled file; PAM files are
+// read as PGMRAW or PPMRAW files, which have the same raster
+struct PNMHeader {
+  int nr, nc, nt, nchan;
+  int maxval;                  // > 255: 16-bit samples, MSB first
+  float scale;                 // PFM: float samples, little-endian when
+                               // < 0, big-endian when > 0; 0 otherwise
+  int band;                    // packed: the rows of a band, coded on
+                               // their own; 0 otherwise
+  int tile, levels;            // tiled: the size of the tiles and the
+                               // number of levels; 0 otherwise
+};
+
+// the map of the pixels of a channel done by rescale(): (x-m)*c/d + a,
+// or a for every pixel when d == 0
+struct RescaleMap {
+  float m, c, d, a;
+};
+
+// a PGM/PPM/PAM/PFM file mapped in memory
+struct PNMMap : PNMHeader {
+  void *map;                   // the mapping of the whole file
+  size_t bytes;                // its size
+  unsigned char *pixels;       // the raster (interleaved for PPM), or
+                               // the text of the pixels (ASCII formats)
+};
+
+// the text of an ASCII file read as a stream: whole lines, parsed up to
+// pos, the text from pos holding avail pixel values
+struct PNMText {
+  std::string text;
+  size_t pos, avail;
+  PNMText() : pos(0), avail(0) {}
+};
+
+struct iovec;
+
+// parse a header, line(buf) reading its next line into buf, 0 at the end
+int parseHeader(const std::function<int(char *)> &line, PNMHeader &h);
+int sampleBytes(const PNMHeader &h);   // bytes of a sample of a raw file
+
+// row i of img from a row of a raw file (wide: room for a row of 16-bit
+// samples)
+template <class T>
+void rawRow(const unsigned char *s, const PNMHeader &h, BasicImage<T> &img,
+            int i, unsigned short *wide);
+
+// row i of img from the text p of an ASCII file in memory, up to end;
+// returns the text after the row
+template <class T>
+const char *textRow(const char *p, const char *end, BasicImage<T> &img,
+                    int i, const char *fname);
+
+// row i of img from an ASCII file read as a stream, its text kept in t
+template <class T>
+void textRow(std::istream &ifp, PNMText &t, BasicImage<T> &img, int i,
+             const char *fname);
+
+// the map of every channel done by rescale(inimg, a, b)
+RescaleMap rescaleMap(const Image &inimg, float a, float b);
+
+// row i of img as samples of type S (plane: room for the channels of a
+// row; r: the maps of rescale(), or 0)
+template <class T, class S>
+void packSamples(const BasicImage<T> &img, int i, S *q,
+                 std::vector<S> &plane, const RescaleMap *r);
+
+// write all the buffers of iov to a file
+void writeAll(int fd, struct iovec *iov, int n, const char *fname);
+
+// map a file in memory, 0 if it cannot be (it is then read as a stream)
+int mapPNM(char *fname, PNMMap &m);
+
+// code rows i0 to i1-1 of img as a band of a packed file, of samples of
+// type S, followed by 8 zero bytes
+template <class S, class T>
+void packBand(const BasicImage<T> &img, int i0, int i1, const RescaleMap *r,
+              std::vector<unsigned char> &out);
+
+// decode a band of len bytes, followed by 8 zero bytes, into rows i0 to
+// i1-1 of img
+template <class S, class T>
+void unpackBand(const unsigned char *s, size_t len, BasicImage<T> &img,
+                int i0, int i1, const char *fname);
+
+// run f(b) for b = 0 to n-1 on the threads of parallelRows()
+void eachBand(int n, const std::function<void(int)> &f);
+
+// write img to a tiled file, with tile x tile tiles
+template <class T>
+void writeTiles(const BasicImage<T> &img, char *fname, int tile,
+                const RescaleMap *r);
+
+/**
+ * Load the 8 bytes at p, least significant first.
+ */
+static inline uint64_t loadLE64(const unsigned char *p) {
+  uint64_t v;
+
+  memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+/**
+ * Store v at p, least significant byte first.
+ */
+static inline void storeLE64(unsigned char *p, uint64_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64(v);
+#endif
+  memcpy(p, &v, 8);
+}
+
+#endif
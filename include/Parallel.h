@@ -0,0 +1,51 @@
+/********************************************************************
+ * Parallel.h - run the rows of a neighborhood operator on all the
+ *              cores
+ *
+ * An operator whose output rows do not depend on each other (conv(),
+ * median(), contrah(), gdilate(), gerode(), nonmax(), zeroCrossing())
+ * splits its rows into tiles, bands of full rows that fit in the L2
+ * cache together with the input rows they read, and hands them to
+ * parallelRows():
+ *
+ *     parallelRows(nr, rowBand(2 * nc * sizeof(float)), [&](int i0, int i1) {
+ *       for (int i=i0; i<i1; i++)
+ *         ...                            // output row i
+ *     });
+ *
+ * gemm() and the codecs of the packed and tiled files run their bands
+ * through parallelRows() as well, so that setThreads() sets the threads
+ * of the whole library.
+ *
+ * The tiles run on a pool of threads started once. Each thread is given
+ * a range of consecutive tiles, taken from its front, and a thread that
+ * has run out steals the back half of the largest range left, so that
+ * the work stays balanced while each thread mostly reads rows next to
+ * the ones it has just read. A pixel is computed by the same code
+ * whichever thread runs its tile, so the result is bit-identical to the
+ * one of a single thread.
+ *
+ * A parallelRows() called from within a tile, or while another thread
+ * runs one, runs its tiles in the calling thread.
+ *
+ * Created: 10/17/26
+ ********************************************************************/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+void setThreads(int n);              // the threads of parallelRows(),
+                                     // 0 (default) for one per core
+int getThreads();                    // the threads that will be used
+
+int rowBand(size_t rowBytes);        // rows of a tile, when a row reads
+                                     // and writes rowBytes bytes
+
+// run f(i0, i1) for the bands [i0, i1) of band rows that cover [0, n)
+void parallelRows(int n, int band,
+                  const std::function<void(int, int)> &f);
+
+#endif
@@ -0,0 +1,69 @@
+/********************************************************************
+ * Reduce.h - reductions over one row of pixels, used by the min/max
+ *            functions of the image and by sum(), power(), rmse(),
+ *            and the conversions of a row of pixels done by the image
+ *            I/O (8/16-bit to float and back, 16-bit big-endian
+ *            samples)
+ *
+ * The float and 8-bit kernels use AVX2 when the library is compiled
+ * for it (e.g., with -mavx2), SSE2 on other x86-64 builds, and plain
+ * loops elsewhere. The sums are accumulated in double; the row sums of
+ * an image are added with Kahan compensation (see KahanSum).
+ *
+ * Created: 10/17/26
+ ********************************************************************/
+
+#ifndef REDUCE_H
+#define REDUCE_H
+
+// the smallest and largest of the n pixels p[0..n-1] are merged into
+// mini and maxi; NaN pixels are ignored
+void rowMinMax(const float *p, int n, float &mini, float &maxi);
+void rowMinMax(const unsigned char *p, int n,
+               unsigned char &mini, unsigned char &maxi);
+void rowMinMax(const unsigned short *p, int n,
+               unsigned short &mini, unsigned short &maxi);
+
+double rowSumAbs(const float *p, int n);     // sum of |p[j]|
+double rowSumSq(const float *p, int n);      // sum of p[j]^2
+double rowSumSqDiff(const float *p,          // sum of (p[j]-q[j])^2
+                    const float *q, int n);
+
+void rowWiden(const unsigned char *p,        // q[j] = p[j], 8-bit to float
+              float *q, int n);
+void rowWiden(const unsigned short *p,       // q[j] = p[j], 16-bit to float
+              float *q, int n);
+
+// q[j] = p[j] clamped to [0, maxv] and truncated (NaN to 0), the samples
+// written for float pixels; when d != 0, (p[j]-m)*c/d + a is clamped
+// instead (the pixels rescaled by rescale()), and when d == 0 every
+// sample is a, clamped
+void rowPack(const float *p, unsigned char *q, int n, int maxv,
+             float m=0, float c=1, float d=1, float a=0);
+void rowPack(const float *p, unsigned short *q, int n, int maxv,
+             float m=0, float c=1, float d=1, float a=0);
+
+// the n 16-bit samples of a PGM/PPM file, stored most significant byte
+// first, to native 16-bit pixels and back
+void rowLoadBE16(const unsigned char *p, unsigned short *q, int n);
+void rowStoreBE16(const unsigned short *p, unsigned char *q, int n);
+
+// adds up many values (e.g., the sums of the rows) with Kahan
+// compensation, so the rounding error does not grow with the count
+class KahanSum {
+ public:
+  KahanSum() : s(0), c(0) {}
+  void add(double x) {
+    double y = x - c;
+    double t = s + y;
+    c = (t - s) - y;
+    s = t;
+  }
+  double get() const { return s; }
+
+ private:
+  double s;                            // the sum
+  double c;                            // the lost low-order part
+};
+
+#endif
@@ -0,0 +1,132 @@
+/********************************************************************
+ * StripIO.h - read and write PGM/PPM images a strip of rows at a time
+ *
+ * An image too large to be held in memory as an Image is processed
+ * strip by strip: a StripReader hands out strips of at most n rows,
+ * each with up to halo rows of its neighbors above and below, and a
+ * StripWriter appends the rows of the results to the output file. A
+ * neighborhood operator gives the same result as on the whole image when
+ * halo is at least the radius of its neighborhood (e.g., 2 for a 5x5
+ * median, 1 for sobel(), the kernel rows/2 for conv() and gdilate()):
+ *
+ *     StripReader in("mosaic.pgm", 256, 2);
+ *     StripWriter out("smooth.pgm", in.getRow(), in.getCol(),
+ *                     in.getType());
+ *     Image strip;
+ *     while ((n = in.next(strip)) > 0)
+ *       out.write(median(strip, 5), in.getTop(), n);
+ *
+ * or, the same,
+ *
+ *     streamImage("mosaic.pgm", "smooth.pgm", 256, 2,
+ *                 [](const Image &s) { return median(s, 5); });
+ *
+ * Only n+2*halo rows of the image are in memory at a time; the pages of
+ * a mapped input file are dropped once read. The rows written are
+ * clamped to [0, maxval], as writeImage() does without rescaling; files
+ * with a maxval above 255 have 16-bit samples.
+ *
+ * Created: 10/17/26
+ * Modified:
+ *   10/17/26 - move the readers and writers to stripIO.cpp; a truncated
+ *              ASCII stream is reported
+ *   10/17/26 - 16-bit samples (maxval > 255)
+ ********************************************************************/
+
+#ifndef STRIPIO_H
+#define STRIPIO_H
+
+#include "Image.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct PNMText;
+
+class StripReader {
+ public:
+  StripReader(char *fname,             // open an image file, to be read
+              int n,                   // n rows at a time with halo rows
+              int halo=0);             // of context above and below
+  ~StripReader();
+
+  int getRow() const;                  // the size and type of the image
+  int getCol() const;
+  int getChannel() const;
+  int getType() const;
+  int getMaxval() const;
+
+  int next(Image &strip);              // read the next strip, returns its
+                                       // # of own rows (0 at the end)
+  int getFirst() const;                // image row of its first own row
+  int getTop() const;                  // # of halo rows above that row
+
+ private:
+  StripReader(const StripReader &);    // a reader cannot be copied
+  StripReader & operator=(const StripReader &);
+  void readRows(int i0, int n);        // next n rows of the file into buf
+
+  std::string name;                    // the file
+  void *map;                           // its mapping, if it can be mapped
+  size_t bytes;
+  const char *cur;                     // the next row in the mapping
+  size_t released;                     // bytes of the mapping dropped
+  std::ifstream ifp;                   // the file, if it cannot
+  PNMText *text;                       // the text read from ifp (ASCII)
+  std::vector<unsigned char> raw;      // a row read from ifp
+  std::vector<unsigned short> wide;    // a row of 16-bit samples
+  int nr, nc, nt, nchan;
+  int maxval, bps;                     // bytes per sample
+  int rows, halo;
+  int nextRow;                         // first own row of the next strip
+  int first;                           // first own row of the strip
+  int start;                           // image row of the first row of buf
+  int nread;                           // # of rows read from the file
+  Image buf;                           // the rows of the strip
+};
+
+class StripWriter {
+ public:
+  StripWriter(char *fname,             // create an image file of the
+              int r, int c,            // given size and type, written
+              int t=PGMRAW,            // a few rows at a time
+              int maxval=255);
+  ~StripWriter();                      // close the file
+
+  void write(const Image &strip,       // append n rows of the strip
+             int first=0,              // starting at row first (n=-1:
+             int n=-1);                // to the end of the strip)
+  int getWritten() const;              // # of rows written so far
+
+ private:
+  StripWriter(const StripWriter &);    // a writer cannot be copied
+  StripWriter & operator=(const StripWriter &);
+
+  std::string name;
+  std::ofstream ofp;
+  std::vector<char> text;              // a row, formatted
+  std::vector<unsigned short> row;     // a row, clamped to [0, maxval]
+  std::vector<unsigned char> plane8;   // the channels of a color row
+  std::vector<unsigned short> plane16;
+  int nr, nc, nt, nchan, maxval;
+  int nwritten;
+};
+
+// apply op, a function or a lambda taking a strip (const Image &) and
+// returning a strip of the same size, to the image in file in strip by
+// strip, writing the result to file out; the images op creates for one
+// strip are recycled for the next (see ImagePool.h)
+template <class F>
+void streamImage(char *in, char *out, int n, int halo, F op) {
+  ImagePool pool;                      // op's images are recycled
+  StripReader reader(in, n, halo);
+  StripWriter writer(out, reader.getRow(), reader.getCol(),
+                     reader.getType(), reader.getMaxval());
+  Image strip;
+  int own;
+
+  while ((own = reader.next(strip)) > 0)
+    writer.write(op(strip), reader.getTop(), own);
+}
+
+#endif
@@ -0,0 +1,85 @@
+/********************************************************************
+ * TileIO.h - write and read tiled image files, with reduced-resolution
+ *            levels, a region at a time
+ *
+ * Cropping a small region out of a huge image with readImage() and
+ * subImage() reads the whole file. A tiled file holds the image in
+ * tiles (e.g., 256x256) coded as packed files are (see writeImage()),
+ * then, level after level, the image reduced 2, 4, 8, ... times until
+ * it fits in one tile, after an index of the tiles. A TiledReader
+ * maps the file and decodes only the tiles under the region asked for,
+ * at the level asked for, so that the cost of a read follows the size
+ * of the region and not of the image:
+ *
+ *     writeTiled(mosaic, "mosaic.pt");   // once
+ *
+ *     TiledReader in("mosaic.pt");
+ *     Image roi, thumb;
+ *     in.read(roi, 5000, 7000, 512, 512);             // full resolution
+ *     in.read(thumb, 0, 0, in.getRow(in.getLevels()-1),
+ *             in.getCol(in.getLevels()-1), in.getLevels()-1);
+ *
+ * Level l is ceil(rows/2^l) by ceil(cols/2^l), each pixel the mean of a
+ * 2x2 block of the samples of level l-1. The samples are clamped to
+ * [0, maxval] as writeImage() does (rescaled when asked to), at every
+ * level, and are lossless at level 0. The tiles are written as they are
+ * coded, level after level, so that only the level being written and
+ * the next one are held in memory besides the image. readImage() reads level 0 of a tiled file whole, and an image of
+ * type PGMTILE or PPMTILE is written by writeImage() to a tiled file
+ * with TILESIZE tiles.
+ *
+ * Created: 10/17/26
+ ********************************************************************/
+
+#ifndef TILEIO_H
+#define TILEIO_H
+
+#include "Image.h"
+#include <string>
+#include <vector>
+
+#define TILESIZE 256                   // the tiles written by writeImage()
+
+void writeTiled(const Image &img,      // write img to a tiled file, with
+                char *fname,           // tile x tile tiles (flag:
+                int tile=TILESIZE,     // rescale, see writeImage())
+                int flag=0);
+void writeTiled(const Image8 &img, char *fname, int tile=TILESIZE);
+void writeTiled(const Image16 &img, char *fname, int tile=TILESIZE);
+
+class TiledReader {
+ public:
+  TiledReader(char *fname);            // open a tiled file
+  ~TiledReader();
+
+  int getRow(int level=0) const;       // the size of a level
+  int getCol(int level=0) const;
+  int getChannel() const;
+  int getMaxval() const;
+  int getLevels() const;               // # of levels, 0 is full size
+  int getTile() const;                 // the size of the tiles
+
+  void read(Image &roi,                // read the region of nr x nc
+            int top, int left,         // pixels from (top, left) of a
+            int nr, int nc,            // level into roi, reusing its
+            int level=0);              // buffer when of that size
+  void read(Image8 &roi, int top, int left, int nr, int nc, int level=0);
+  void read(Image16 &roi, int top, int left, int nr, int nc, int level=0);
+
+ private:
+  TiledReader(const TiledReader &);    // a reader cannot be copied
+  TiledReader & operator=(const TiledReader &);
+  template <class T>
+  void region(BasicImage<T> &roi, int top, int left, int nr, int nc,
+              int level);
+
+  std::string name;
+  void *map;                           // the mapping of the file
+  size_t bytes;
+  const unsigned char *index;          // the offsets in the file of the
+                                       // tiles, and of the end of the last
+  std::vector<int> first;              // # of the first tile of a level
+  int nr, nc, nchan, maxval, tile, levels;
+};
+
+#endif
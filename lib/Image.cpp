@@ -11,20 +11,36 @@
 
 #include "Image.h"
 #include "Dip.h"
+#include "Reduce.h"
+#include "Gemm.h"
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
 #include <iomanip>
 #include <cstdio>
 #include <cmath>
+#include <vector>
+#include <algorithm>
 using namespace std;
 
 
+/**
+ * The maxval of a new image: 65535 for 16-bit pixels, 255 otherwise.
+ */
+template <class T>
+static int defaultMaxval() {
+  return (numeric_limits<T>::is_integer && sizeof(T) > 1) ? 65535 : 255;
+}
+
 /**
  * Default constructor.
  */ 
-Image::Image() {
+template <class T>
+BasicImage<T>::BasicImage() {
+  stride = cstride = 0;
+  buf = 0;
   image = 0;
+  maximum = defaultMaxval<T>();
   createImage(0, 0);
 }
 
@@ -37,79 +53,148 @@ Image::Image() {
  * @see PGMASCII.
  * @see PPMRAW.
  * @see PPMASCII.
+ * @see PGMPACK.
+ * @see PPMPACK.
+ * @see PGMTILE.
+ * @see PPMTILE.
  * @return The created image.
  */
-Image::Image(int r, int c, int t) {
+template <class T>
+BasicImage<T>::BasicImage(int r, int c, int t) {
   if (r<=0 || c<=0) {
     cout << "Image: Index out of range.\n";
     exit(3);
   }
+  stride = cstride = 0;
+  buf = 0;
   image = 0;
+  maximum = defaultMaxval<T>();
   createImage(r, c, t);
 }
 
 /**
- * Copy constructor. 
+ * Copy constructor. The pixel buffer is shared with img and only 
+ * duplicated when either image is modified (copy-on-write).
  * @param img Copy image.
  * @return The created image.
  */
-Image::Image(const Image &img) {
-  int i, j, k;
+template <class T>
+BasicImage<T>::BasicImage(const BasicImage<T> &img) {
+  row = img.row;
+  col = img.col;
+  channel = img.channel;
+  type = img.type;
+  maximum = img.maximum;
+  stride = img.stride;
+  cstride = img.cstride;
+  buf = img.buf;
+  image = img.image;
+  if (buf)
+    buf->refs++;
+}
+
+/**
+ * Move constructor. Takes over the pixel buffer of img, which is left
+ * as an empty image.
+ * @param img The image to move from.
+ * @return The created image.
+ */
+template <class T>
+BasicImage<T>::BasicImage(BasicImage<T> &&img) {
+  row = img.row;
+  col = img.col;
+  channel = img.channel;
+  type = img.type;
+  maximum = img.maximum;
+  stride = img.stride;
+  cstride = img.cstride;
+  buf = img.buf;
+  image = img.image;
+
+  img.row = img.col = 0;
+  img.buf = 0;
+  img.image = 0;
+}
 
+/**
+ * Convert a row of n pixels to the pixel type T.
+ */
+template <class T, class U>
+static void convertRow(const U *p, T *q, int n) {
+  int j;
+
+  for (j=0; j<n; j++)
+    q[j] = pixelCast<T>(p[j]);
+}
+
+/**
+ * 8-bit pixels are widened to float with the vectorized rowWiden(), so
+ * an 8-bit image (e.g., a mapped PGM file) is cheap to convert.
+ */
+static void convertRow(const unsigned char *p, float *q, int n) {
+  rowWiden(p, q, n);
+}
+
+/**
+ * Converting constructor. Creates an image of pixel type T holding the 
+ * pixels of img. Values that do not fit an integer pixel type are clamped
+ * to its range and the fraction is dropped, the same as writeImage() does.
+ * @param img The image to convert.
+ * @return The created image.
+ */
+template <class T> template <class U>
+BasicImage<T>::BasicImage(const BasicImage<U> &img) {
+  int i, k;
+
+  stride = cstride = 0;
+  buf = 0;
   image = 0;
-  row = img.getRow();
-  col = img.getCol();
-  type = img.getType();
-  if (type == PGMRAW || type == PGMASCII)
-    channel = 1;
-  else if (type == PPMRAW || type == PPMASCII)
-    channel = 3;
-  else
-    cout << "Copy constructor: Undefined image type!\n";
+  createImageUninit(img.getRow(), img.getCol(), img.getType());
 
-  createImage(row, col, type);             // allocate memory
-  
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      for (k=0; k<channel; k++)
-	image[(i*col+j)*channel+k] = img(i,j,k);
+  maximum = img.getMaxval();
+
+  for (k=0; k<channel; k++)
+    for (i=0; i<row; i++)
+      convertRow(img.rowPtr(i,k), rowPtr(i,k), col);
 }
 
 /**
- * Destructor.  Frees memory.
+ * Destructor.  Frees memory when this is the last image using the buffer.
  */
-Image::~Image() {
-  if (image)
-    delete [] image;       // free the image buffer
+template <class T>
+BasicImage<T>::~BasicImage() {
+  release();
 }
 
 /**
  * Allocate memory for the image and initialize the content to be 0.
+ * The maxval of the image is kept.
  */
-void Image::createImage() {
+template <class T>
+void BasicImage<T>::createImage() {
 
-  if (image)
-    delete [] image;
+  release();
 
-  if (type == PGMRAW || type == PGMASCII)
+  if (type == PGMRAW || type == PGMASCII || type == PGMPACK ||
+      type == PGMTILE)
     channel = 1;
-  else if (type == PPMRAW || type == PPMASCII)
+  else if (type == PPMRAW || type == PPMASCII || type == PPMPACK ||
+           type == PPMTILE)
     channel = 3;
   else
     cout << "createImage: Undefined image type!\n";
-  maximum = 255;
-
-  image = (float *) new float [row * col * channel];
-  if (!image) {
-    cout << "CREATEIMAGE: Out of memory.\n";
-    exit(1);
-  }
 
+  allocate();
   initImage();
 }
 
 /**
  * Allocate memory for the image and initialize the content to be zero.
+ * When the image already owns an unshared buffer of the same size, the
+ * buffer is reused, so an image created over and over again (e.g., the
+ * output of a filter in a loop) is allocated only once. The maxval of
+ * the image is kept, whether it is reused or resized; the filters set
+ * the one of their input (see setMaxval()).
  * @param r Numbers of rows (height).
  * @param c Number of columns (width).
  * @param t Type of image to be created (see below for types). Default is
@@ -118,49 +203,189 @@ void Image::createImage() {
  * @see PGMASCII.
  * @see PPMRAW.
  * @see PPMASCII.
- */
-void Image::createImage(int r, int c, int t) {
-  
-  if (image)
-    delete [] image;
+ * @see PGMPACK.
+ * @see PPMPACK.
+ * @see PGMTILE.
+ * @see PPMTILE.
+ */
+template <class T>
+void BasicImage<T>::createImage(int r, int c, int t) {
+  createImageUninit(r, c, t);
+  initImage();
+}
+
+/**
+ * Allocate memory for the image like createImage() but leave the content
+ * (including the row padding) undefined. Used when every pixel is written
+ * right after, which saves a pass over the image; the pages of a new 
+ * buffer are then first touched by the computation itself.
+ * @param r Numbers of rows (height).
+ * @param c Number of columns (width).
+ * @param t Type of image to be created. Default is PGMRAW.
+ */
+template <class T>
+void BasicImage<T>::createImageUninit(int r, int c, int t) {
+  int nchan;
+  bool reuse;
+
+  if (t == PGMRAW || t == PGMASCII || t == PGMPACK || t == PGMTILE)
+    nchan = 1;
+  else if (t == PPMRAW || t == PPMASCII || t == PPMPACK ||
+           t == PPMTILE)
+    nchan = 3;
+  else {
+    cout << "createImage: Undefined image type!\n";
+    nchan = buf ? channel : 0;
+  }
+  reuse = buf && buf->refs == 1 && !isView() &&
+          r == row && c == col && nchan == channel;
 
   row = r;
   col = c;
   type = t;
-  if (type == PGMRAW || type == PGMASCII)
-    channel = 1;
-  else if (type == PPMRAW || type == PPMASCII)
-    channel = 3;
-  else
-    cout << "createImage: Undefined image type!\n";
-  maximum = 255;
+  channel = nchan;
 
-  image = (float *) new float [row * col * channel];
-  if (!image) {
-    cout << "CREATEIMAGE: Out of memory.\n";
-    exit(1);
-  }
+  if (!reuse)
+    allocate();
+}
 
-  initImage();
+/**
+ * Make the image use pixels that were not allocated by the image library,
+ * e.g., those of an image file mapped in memory (see readImage8()),
+ * without copying them. The image takes over the reference held on the
+ * buffer, which goes to ImagePool::recycle() once no image uses it. The
+ * channel planes follow each other.
+ * @param b The buffer, with one reference for this image.
+ * @param p The first pixel, which becomes b->data.
+ * @param r Numbers of rows (height).
+ * @param c Number of columns (width).
+ * @param t Type of the image.
+ * @param s The row pitch, in pixels.
+ */
+template <class T>
+void BasicImage<T>::useBuffer(ImageBuffer *b, T *p, int r, int c, int t,
+                              int s) {
+  release();
+
+  row = r;
+  col = c;
+  type = t;
+  channel = (t == PPMRAW || t == PPMASCII || t == PPMPACK ||
+             t == PPMTILE) ? 3 : 1;
+  stride = s;
+  cstride = (ptrdiff_t)s * r;
+  buf = b;
+  buf->data = p;
+  image = p;
 }
 
 /**
  * Initialize the image.
- * @para init The value the image is initialized to. Default is 0.0.
+ * @para init The value the image is initialized to. Default is 0.
  */
-void Image::initImage(float init) {
-  int i;
+template <class T>
+void BasicImage<T>::initImage(T init) {
+  ptrdiff_t i, n;
 
-  for (i=0; i<row*col*channel; i++)
+  if (buf && (buf->refs > 1 || isView()))  // old content is not needed
+    allocate();
+
+  n = cstride * channel;         // the padding is initialized as well
+  for (i=0; i<n; i++)
     image[i] = init;
 }
 
+/**
+ * Allocate a new pixel buffer that is used by this image only. Each 
+ * channel is stored as a separate plane of row rows. Every row starts 
+ * on an ALIGNMENT-byte boundary and the row pitch is padded so that
+ * vertically adjacent pixels never sit a multiple of 1KB apart, which
+ * would make them compete for the same cache sets (e.g., 512x512 images).
+ * The reference to the previous buffer is dropped.
+ */
+template <class T>
+void BasicImage<T>::allocate() {
+  const int apix = ALIGNMENT / sizeof(T);    // pixels per aligned unit
+
+  release();
+
+  stride = (col + apix - 1) / apix * apix;
+  if (stride > 0 && (stride * sizeof(T)) % 1024 == 0)
+    stride += apix;
+  cstride = (ptrdiff_t)stride * row;
+  if (cstride * channel <= 0) {  // an empty image has no buffer
+    stride = cstride = 0;
+    return;
+  }
+
+  buf = ImagePool::acquire((size_t)cstride * channel * sizeof(T));
+  image = (T *) buf->data;
+}
+
+/**
+ * Drop the reference to the pixel buffer. The buffer is freed (or kept 
+ * by the current ImagePool) when no other image is using it.
+ */
+template <class T>
+void BasicImage<T>::release() {
+  if (buf && --buf->refs == 0)
+    ImagePool::recycle(buf);     // free the image buffer
+  buf = 0;
+  image = 0;
+}
+
+/**
+ * Give this image its own copy of a buffer shared with other images,
+ * called before the pixels are modified. Only the pixels of the image
+ * are copied, so a view of a region or a channel gets a compact buffer.
+ */
+template <class T>
+void BasicImage<T>::detach() {
+  ImageBuffer *shared;
+  const T *p;
+  T *q;
+  int i, j, k, ostride;
+  ptrdiff_t ocstride;
+
+  if (!buf || buf->refs == 1)
+    return;
+
+  shared = buf;
+  p = image;
+  ostride = stride;
+  ocstride = cstride;
+  buf = 0;                       // keep allocate() from releasing shared
+  allocate();
+
+  for (k=0; k<channel; k++)
+    for (i=0; i<row; i++) {
+      q = image + k*cstride + (ptrdiff_t)i*stride;
+      for (j=0; j<col; j++)
+        q[j] = p[k*ocstride+(ptrdiff_t)i*ostride+j];
+      for (; j<stride; j++)      // the padding
+        q[j] = 0;
+    }
+
+  if (--shared->refs == 0)       // the other owner may have gone meanwhile
+    ImagePool::recycle(shared);
+}
+
+/**
+ * Tells if the image is a view that does not start at the beginning of
+ * its buffer or does not cover all of it.
+ */
+template <class T>
+bool BasicImage<T>::isView() const {
+  return buf && (image != buf->data || cstride != (ptrdiff_t)stride*row);
+}
+
 /**
  * Returns the total number of rows in the image.
  * @return Total number of rows.
  * \ingroup getset
  */
-int Image::getRow() const {
+template <class T>
+int BasicImage<T>::getRow() const {
   return row;
 }
 
@@ -169,7 +394,8 @@ int Image::getRow() const {
  * @return Total number of columns.
  * \ingroup getset
  */
-int Image::getCol() const {
+template <class T>
+int BasicImage<T>::getCol() const {
   return col;
 }
 
@@ -178,7 +404,8 @@ int Image::getCol() const {
  * @return Total number of channels.
  * \ingroup getset
  */
-int Image::getChannel() const {
+template <class T>
+int BasicImage<T>::getChannel() const {
   return channel;
 }
 
@@ -188,107 +415,194 @@ int Image::getChannel() const {
  * @return The type of the image.
  * \ingroup getset
  */
-int Image::getType() const {
+template <class T>
+int BasicImage<T>::getType() const {
   return type;
 }
 
 /**
- * Returns the maximum pixel value of a gray-level image. 
+ * Returns the row pitch of the pixel buffer, i.e., the number of pixels
+ * from the start of one row to the start of the next. The pitch is
+ * at least the number of columns; use it with rowPtr() to walk the image.
+ * @return The row pitch.
+ * \ingroup getset
+ */
+template <class T>
+int BasicImage<T>::getStride() const {
+  return stride;
+}
+
+/**
+ * Returns the smallest and the largest pixel value over all the channels
+ * of the image, found in one pass. NaN pixels are ignored. Both are 0
+ * for an empty image.
+ * @param mini The minimum pixel value.
+ * @param maxi The maximum pixel value.
+ * \ingroup getset
+ */
+template <class T>
+void BasicImage<T>::getMinMax(float &mini, float &maxi) const {
+  int minRow, minCol, maxRow, maxCol;
+
+  getMinMax(mini, minRow, minCol, maxi, maxRow, maxCol);
+}
+
+
+/**
+ * Returns the smallest and the largest pixel value over all the channels
+ * of the image, found in one pass, as well as where they are first found
+ * (the first channel, then the first row and column in that channel).
+ * NaN pixels are ignored.
+ * @param mini The minimum pixel value.
+ * @param minRow The row index of the minimum.
+ * @param minCol The column index of the minimum.
+ * @param maxi The maximum pixel value.
+ * @param maxRow The row index of the maximum.
+ * @param maxCol The column index of the maximum.
+ * \ingroup getset
+ */
+template <class T>
+void BasicImage<T>::getMinMax(float &mini, int &minRow, int &minCol,
+                              float &maxi, int &maxRow, int &maxCol) const {
+  T lo, hi, rlo, rhi;
+  int i, j, k, loRow, loChan, hiRow, hiChan;
+  const T *p;
+
+  lo = numeric_limits<T>::has_infinity ? numeric_limits<T>::infinity()
+                                       : numeric_limits<T>::max();
+  hi = numeric_limits<T>::has_infinity ? -numeric_limits<T>::infinity()
+                                       : numeric_limits<T>::lowest();
+  loRow = hiRow = -1;
+  loChan = hiChan = 0;
+
+  // find the smallest and largest pixel of each row with the vectorized
+  // kernel, and remember the first row holding them
+  for (k=0; k<channel; k++)
+    for (i=0; i<row; i++) {
+      rlo = lo;
+      rhi = hi;
+      rowMinMax(rowPtr(i, k), col, rlo, rhi);
+      if (rlo < lo || (loRow < 0 && rlo <= lo)) {
+        lo = rlo;
+        loRow = i;
+        loChan = k;
+      }
+      if (rhi > hi || (hiRow < 0 && rhi >= hi)) {
+        hi = rhi;
+        hiRow = i;
+        hiChan = k;
+      }
+    }
+
+  mini = maxi = 0;
+  minRow = minCol = maxRow = maxCol = 0;
+  if (loRow < 0)                       // empty image
+    return;
+
+  // then the column, in that row only
+  mini = lo;
+  minRow = loRow;
+  p = rowPtr(loRow, loChan);
+  for (j=0; j<col; j++)
+    if (p[j] == lo) {
+      minCol = j;
+      break;
+    }
+
+  maxi = hi;
+  maxRow = hiRow;
+  p = rowPtr(hiRow, hiChan);
+  for (j=0; j<col; j++)
+    if (p[j] == hi) {
+      maxCol = j;
+      break;
+    }
+}
+
+
+/**
+ * Returns the maximum value of the PGM/PPM file the image was read from,
+ * which is also written to the file by writeImage(): 255 for 8-bit data,
+ * e.g., 4095 for 12-bit data in 16-bit samples. A new image has 255
+ * (65535 for 16-bit pixels); the result of a filter or of an expression
+ * has the maxval of its input.
+ * @return The maxval.
+ * \ingroup getset
+ */
+template <class T>
+int BasicImage<T>::getMaxval() const {
+  return maximum;
+}
+
+/**
+ * Returns the maximum pixel value of the image (over all the channels).
+ * As it always has, the value is never below 0.
  * @return The intensity of that pixel.
  * \ingroup getset
  */
-float Image::getMaximum() const {
-  int i, j;
-  float maxi=0.0;
+template <class T>
+float BasicImage<T>::getMaximum() const {
+  float mini, maxi;
 
-  if (channel > 1) {
-    cout << "GETMAXIMUM: Can only handle single-channel image\n";
-    exit(3);
-  }
-  
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      if (maxi < image[i*col+j])
-	maxi = image[i*col+j];
+  getMinMax(mini, maxi);
   
-  return maxi;
+  return (maxi > 0) ? maxi : 0;
 }
 
 
 /**
- * Returns the maximum pixel value of a gray-scale image,
- * as well as its indices 
- * @return the maximum intensity, its row and column indices
+ * Returns the maximum pixel value of the image (over all the channels),
+ * as well as its indices. The value is never below 0; when all the pixels
+ * are, 0 is returned at (0,0).
+ * @return the maximum intensity, its column (ix) and row (iy) indices
  * \ingroup getset
  */
-void Image::getMaximum(float &intensity, int &ix, int &iy) {
-  int i, j;
-
-  intensity = 0;
-  ix = iy = 0;
+template <class T>
+void BasicImage<T>::getMaximum(float &intensity, int &ix, int &iy) const {
+  float mini;
+  int minRow, minCol;
 
-  if (channel > 1) {
-    cout << "GETMAXIMUM: Can only handle single-channel image\n";
-    exit(3);
+  getMinMax(mini, minRow, minCol, intensity, iy, ix);
+  if (!(intensity > 0)) {
+    intensity = 0;
+    ix = iy = 0;
   }
-    
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      if (intensity < image[i*col+j]) {
-        intensity = image[i*col+j];
-        ix = j;
-        iy = i;
-      }
 }
 
 
 /**
- * Returns the minimum pixel value of the image.
+ * Returns the minimum pixel value of the image (over all the channels).
+ * As it always has, the value is never above 256.
  * @return The minimum pixel value.
  * \ingroup getset
  */
-float Image::getMinimum() const {
-  int i, j;
-  float mini=256; 
-
-  if (channel > 1) {
-    cout << "GETMINIMUM: Can only handle single-channel image\n";
-    exit(3);
-  }
+template <class T>
+float BasicImage<T>::getMinimum() const {
+  float mini, maxi;
 
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      if (mini > image[i*col+j])
-	mini = image[i*col+j];
+  getMinMax(mini, maxi);
 
-  return mini;
+  return (mini < 256) ? mini : 256;
 }
 
 
 /**
- * Returns the minimum pixel value of a gray-scale image,
- * as well as its indices 
- * @return the miniimum intensity, its row and column indices
+ * Returns the minimum pixel value of the image (over all the channels),
+ * as well as its indices. The value is never above 256; when all the
+ * pixels are, 256 is returned at (0,0).
+ * @return the miniimum intensity, its column (ix) and row (iy) indices
  * \ingroup getset
  */
-void Image::getMinimum(float &intensity, int &ix, int &iy) {
-  int i, j;
+template <class T>
+void BasicImage<T>::getMinimum(float &intensity, int &ix, int &iy) const {
+  float maxi;
+  int maxRow, maxCol;
 
-  intensity = 256.0;
-  ix = iy = 0;
-
-  if (channel > 1) {
-    cout << "GETMINIMUM: Can only handle single-channel image\n";
-    exit(3);
+  getMinMax(intensity, iy, ix, maxi, maxRow, maxCol);
+  if (!(intensity < 256)) {
+    intensity = 256;
+    ix = iy = 0;
   }
-    
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      if (intensity > image[i*col+j]) {
-        intensity = image[i*col+j];
-        ix = j;
-        iy = i;
-      }
 }
 
 /**
@@ -297,8 +611,9 @@ void Image::getMinimum(float &intensity, int &ix, int &iy) {
  * @return Grayscale image representing the red channel of a RGB image.
  * \ingroup getset
  */
-Image Image::getRed() const  {
-  Image temp;
+template <class T>
+BasicImage<T> BasicImage<T>::getRed() const  {
+  BasicImage<T> temp;
 
   temp = getImage(0);
   
@@ -311,8 +626,9 @@ Image Image::getRed() const  {
  * @return Grayscale image representing the green channel of a RGB image.
  * \ingroup getset
  */
-Image Image::getGreen() const {
-  Image temp;
+template <class T>
+BasicImage<T> BasicImage<T>::getGreen() const {
+  BasicImage<T> temp;
 
   temp = getImage(1);
   
@@ -325,8 +641,9 @@ Image Image::getGreen() const {
  * @return Grayscale image representing the blue channel of a RGB image.
  * \ingroup getset
  */
-Image Image::getBlue() const {
-  Image temp;
+template <class T>
+BasicImage<T> BasicImage<T>::getBlue() const {
+  BasicImage<T> temp;
   
   temp = getImage(2);
 
@@ -335,14 +652,15 @@ Image Image::getBlue() const {
 
 /**
  * Returns the kth channel of the image. If k is outside [0, channel-1], 
- * then the function will error.
+ * then the function will error. The channel is a view sharing the pixels
+ * of this image, no pixel is copied until one of them is modified.
  * @param k The channel number. Starts at 0.
  * @return The kth channel as a gray-scale image
  * \ingroup getset
  */
-Image Image::getImage(int k) const {
-  Image temp;
-  int i, j;
+template <class T>
+BasicImage<T> BasicImage<T>::getImage(int k) const {
+  BasicImage<T> temp;
   
   if (k>=channel || k<0) {
     cout << "getImage: Check the value of the input channel. \n"
@@ -350,20 +668,50 @@ Image Image::getImage(int k) const {
     exit(3);
   }
   
-  temp.createImage(row, col);   // temp is a gray-scale image
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      temp(i,j) = image[(i*col+j)*channel+k];
+  temp = *this;
+  temp.image = image + k*cstride;
+  temp.channel = 1;             // temp is a gray-scale image
+  temp.type = PGMRAW;
       
   return temp;
 }
 
+/**
+ * Returns a region of the image. The region is a view sharing the pixels
+ * of this image, no pixel is copied until one of them is modified.
+ * @param srow The row index of the top-left corner, starts from 0.
+ * @param scol The column index of the top-left corner.
+ * @param erow The row index of the lower-right corner.
+ * @param ecol The column index of the lower-right corner.
+ * @return The region, with the same number of channels and type.
+ * \ingroup getset
+ */
+template <class T>
+BasicImage<T> BasicImage<T>::getSubImage(int srow, int scol, 
+                                         int erow, int ecol) const {
+  BasicImage<T> temp;
+
+  if (srow < 0 || scol < 0 || srow > erow || scol > ecol || 
+      erow > row-1 || ecol > col-1) {
+    cout << "subImage: Check the cropping index.\n";
+    exit(3);
+  }
+
+  temp = *this;
+  temp.row = erow-srow+1;
+  temp.col = ecol-scol+1;
+  temp.image = image + (ptrdiff_t)srow*stride + scol;
+
+  return temp;
+}
+
 /**
  * Sets the total number of rows in an image.
  * @param r Total number of rows.
  * \ingroup getset
  */
-void Image::setRow(int r) {
+template <class T>
+void BasicImage<T>::setRow(int r) {
   row = r;
 }
 
@@ -372,7 +720,8 @@ void Image::setRow(int r) {
  * @param c Total number of columns.
  * \ingroup getset
  */
-void Image::setCol(int c) {
+template <class T>
+void BasicImage<T>::setCol(int c) {
   col = c;
 }
 
@@ -381,7 +730,8 @@ void Image::setCol(int c) {
  * @param c Total number of channels.
  * \ingroup getset
  */
-void Image::setChannel(int c)
+template <class T>
+void BasicImage<T>::setChannel(int c)
 {
   channel = c;
 }
@@ -392,26 +742,48 @@ void Image::setChannel(int c)
  * @see PGMASCII.
  * @see PPMRAW.
  * @see PPMASCII.
+ * @see PGMPACK.
+ * @see PPMPACK.
+ * @see PGMTILE.
+ * @see PPMTILE.
  * @param t The type of image desired.
  * \ingroup getset
  */
-void Image::setType(int t) {
+template <class T>
+void BasicImage<T>::setType(int t) {
   type = t;
-  if (t == PGMRAW || t == PGMASCII)
+  if (t == PGMRAW || t == PGMASCII || t == PGMPACK || t == PGMTILE)
     channel = 1;
-  else if (t == PPMRAW || t == PPMASCII)
+  else if (t == PPMRAW || t == PPMASCII || t == PPMPACK ||
+           t == PPMTILE)
     channel = 3;
   else
     cout << "setType: Undefined image type!\n";
 }
 
+/**
+ * Sets the maximum value of the file the image is written to. The pixels
+ * are clamped to it by writeImage(); more than 255 gives 16-bit samples.
+ * @param m The maxval, between 1 and 65535.
+ * \ingroup getset
+ */
+template <class T>
+void BasicImage<T>::setMaxval(int m) {
+  if (m < 1 || m > 65535) {
+    cout << "setMaxval: The maxval needs to be between 1 and 65535\n";
+    exit(3);
+  }
+  maximum = m;
+}
+
 /**
  * Sets the red channel of a color image given a grayscale image
  * that represents the red channel.
  * @param red Grayscale image to replace the current red channel.
  * \ingroup getset
  */
-void Image::setRed(Image &red) {
+template <class T>
+void BasicImage<T>::setRed(BasicImage<T> &red) {
   setImage(red, 0);
 }
 
@@ -421,7 +793,8 @@ void Image::setRed(Image &red) {
  * @param green Grayscale image to replace the current green channel.
  * \ingroup getset
  */
-void Image::setGreen(Image &green) {
+template <class T>
+void BasicImage<T>::setGreen(BasicImage<T> &green) {
   setImage(green, 1);
 }
 
@@ -431,7 +804,8 @@ void Image::setGreen(Image &green) {
  * @param blue Grayscale image to replace the current blue channel.
  * \ingroup getset
  */
-void Image::setBlue(Image &blue) {
+template <class T>
+void BasicImage<T>::setBlue(BasicImage<T> &blue) {
   setImage(blue, 2);
 }
 
@@ -442,7 +816,11 @@ void Image::setBlue(Image &blue) {
  * @param k The channel number. Starts at 0.
  * \ingroup getset
  */
-void Image::setImage(Image &img, int k) {
+template <class T>
+void BasicImage<T>::setImage(BasicImage<T> &img, int k) {
+  const BasicImage<T> &src = img;
+  const T *p;
+  T *q;
   int i, j;
 
   if (channel < k+1) {
@@ -455,187 +833,126 @@ void Image::setImage(Image &img, int k) {
   	exit(3);
   }
 
-  for (i=0; i<row; i++)
+  for (i=0; i<row; i++) {
+    p = src.rowPtr(i);
+    q = rowPtr(i,k);
     for (j=0; j<col; j++)
-      image[(i*col+j)*channel+k] = img(i,j);
-}
-
-/**
- * Overloading () operator
- * \ingroup overload
- * @param i Row
- * @param j Column
- * @param k Channel
- */
-float & Image::operator()(int i, int j, int k) const {
-  return image[(i*col+j)*channel+k];
+      q[j] = p[j];
+  }
 }
 
 /**
- * Overloading = operator.
+ * Overloading = operator. The pixel buffer is shared with img and only
+ * duplicated when either image is modified (copy-on-write).
  * \ingroup overload
  * @param img Image to copy.
- * @return Newly copied image.
+ * @return Reference to this image.
  */
-const Image Image::operator=(const Image& img) {
-  int i, j, k;
+template <class T>
+BasicImage<T> & BasicImage<T>::operator=(const BasicImage<T> &img) {
 
   if (this == &img)
     return *this;
 
-  // double delete, bug found by Brian Bodkin of class Fall 2009
-  if (image) {
-    delete [] image;
-    image = 0;
+  if (buf != img.buf) {
+    // double delete, bug found by Brian Bodkin of class Fall 2009
+    release();
+    buf = img.buf;
+    if (buf)
+      buf->refs++;
   }
 
-  row = img.getRow();
-  col = img.getCol();
-  channel = img.getChannel();
-  type = img.getType();
-  createImage(row, col, type);             
-
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      for (k=0; k<channel; k++)
-	(*this)(i,j,k) = img(i,j,k);
-  //        image[(i*col+j)*channel+k] = img(i,j,k);
+  row = img.row;
+  col = img.col;
+  channel = img.channel;
+  type = img.type;
+  maximum = img.maximum;
+  stride = img.stride;
+  cstride = img.cstride;
+  image = img.image;
 
   return *this;
 }
 
 /**
- * Overloading + operator.
+ * Move assignment. Takes over the pixel buffer of img, which is left as
+ * an empty image.
  * \ingroup overload
- * @param img Image to add to specified image.
- * @return Addition of the two images.
+ * @param img Image to move from.
+ * @return Reference to this image.
  */
-Image Image::operator+(const Image& img) const {
-  int i, j, k, nr, nc, nchan, nt;
-  Image temp;
+template <class T>
+BasicImage<T> & BasicImage<T>::operator=(BasicImage<T> &&img) {
 
-  nr = img.getRow();
-  nc = img.getCol();
-  nchan = img.getChannel();
-  nt = img.getType();
-  if (nr != row || nc != col || nchan != channel || nt != type) {
-    cout << "operator+: "
-         << "Images are not of the same size or type, can't do addition\n";
-    exit(3);
-  }
-  temp.createImage(row, col, type);             
-  
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      for (k=0; k<channel; k++)
-        temp(i,j,k) = image[(i*col+j)*channel+k] + img(i,j,k);
+  if (this == &img)
+    return *this;
 
-  return temp;
-}
+  release();
 
-/**
- * Overloading - operator.
- * \ingroup overload
- * @param img Image to subtract from specified image.
- * @return Subtraction of the two images.
- */
-Image Image::operator-(const Image &img) const {
-  int i, j, k, nr, nc, nchan, nt;
-  Image temp;
+  row = img.row;
+  col = img.col;
+  channel = img.channel;
+  type = img.type;
+  maximum = img.maximum;
+  stride = img.stride;
+  cstride = img.cstride;
+  buf = img.buf;
+  image = img.image;
 
-  nr = img.getRow();
-  nc = img.getCol();
-  nchan = img.getChannel();
-  nt = img.getType();
-  if (nr != row || nc != col || nchan != channel || nt != type) {
-    cout << "operator-: "
-         << "Images are not of the same size or type, can't do subtraction\n";
-    exit(3);
-  }
-  temp.createImage(row, col, type);             
-  
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      for (k=0; k<channel; k++)
-        temp(i,j,k) = image[(i*col+j)*channel+k] - img(i,j,k);
+  img.row = img.col = 0;
+  img.buf = 0;
+  img.image = 0;
 
-  return temp;
+  return *this;
 }
 
 /**
- * Overloading * operator.  This function does pixel by pixel multiplication.
- * \ingroup overload
- * @param img Image to multiply with specified image.
- * @return Multiplication of the two images.
+ * Multiply one channel of two matrices, c = a * b, accumulating each
+ * element in float in the order of the original triple loop.
+ * @param m The number of rows of a and c.
+ * @param n The number of columns of b and c.
+ * @param k The number of columns of a and rows of b.
+ * @param a, b, c The matrices and their row pitches lda, ldb, ldc.
  */
-Image Image::operator*(const Image &img) const {
-  int i, j, k, nr, nc, nchan, nt;
-  Image temp;
+template <class T>
+static void matmul(int m, int n, int k,
+                   const T *a, int lda, const T *b, int ldb, T *c, int ldc) {
+  vector<float> acc(n);
+  int i, j, p;
 
-  nr = img.getRow();
-  nc = img.getCol();
-  nchan = img.getChannel();
-  nt = img.getType();
-  if (nr != row || nc != col || nchan != channel || nt != type) {
-    cout << "operator*: Images are not of the same size or type, "
-         << "can't do multiplication\n";
-    exit(3);
+  for (i=0; i<m; i++) {
+    fill(acc.begin(), acc.end(), 0.0f);
+    for (p=0; p<k; p++)               // walk b one row at a time
+      for (j=0; j<n; j++)
+        acc[j] += a[i*lda+p] * b[p*ldb+j];
+    for (j=0; j<n; j++)
+      c[i*ldc+j] = pixelCast<T>(acc[j]);
   }
-  temp.createImage(row, col, type);
-  
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      for (k=0; k<channel; k++)
-        temp(i,j,k) = image[(i*col+j)*channel+k] * img(i,j,k);
-
-  return temp;
 }
 
 /**
- * Overloading / operator.  This function does pixel by pixel division.
- * Specified image is the dividend.
- * \ingroup overload
- * @param img Image to be divided (divisor).
- * @return Quotient of the two images.
+ * Float matrices use the blocked, multithreaded gemm(); c is zero.
  */
-Image Image::operator/(const Image &img) const {
-  int i, j, k, nr, nc, nchan, nt;
-  Image temp;
-
-  nr = img.getRow();
-  nc = img.getCol();
-  nchan = img.getChannel();
-  nt = img.getType();
-  if (nr != row || nc != col || nchan != channel || nt != type) {
-    cout << "operator/: "
-         << "Images are not of the same size or type, can't do division\n";
-    exit(3);
-  }
-  temp.createImage(row, col, type);
-  
-  for (i=0; i<row; i++)
-    for (j=0; j<col; j++)
-      for (k=0; k<channel; k++)
-        temp(i,j,k) = image[(i*col+j)*channel+k] / (img(i,j,k)+0.000001);
-
-  return temp;
+static void matmul(int m, int n, int k, const float *a, int lda,
+                   const float *b, int ldb, float *c, int ldc) {
+  gemm(m, n, k, a, lda, b, ldb, c, ldc);
 }
 
 /**
  * Overloading ->* operator.  This function does matrix
- * multiplication of Image files.
+ * multiplication of Image files, channel by channel. Float images
+ * are multiplied by the cache-blocked gemm() (see Gemm.h).
  * \ingroup overload
  * @param img Image (matrix) to multiply specified image with.
  * @result Result from doing matrix multiplication.
  */
-Image Image::operator->*(const Image &img) const {
-  int i, j, k, m, nr, nc, nchan, nt;
-  Image temp;
-  float tmp;
+template <class T>
+BasicImage<T> BasicImage<T>::operator->*(const BasicImage<T> &img) const {
+  int k, nr, nc, nt;
+  BasicImage<T> temp;
 
   nr = img.getRow();
   nc = img.getCol();
-  nchan = img.getChannel();
   nt = img.getType();
   if (col != nr || nt != type) {
     cout << "operaotr->*: "
@@ -645,14 +962,8 @@ Image Image::operator->*(const Image &img) const {
   temp.createImage(row, nc, type);
   
   for (k=0; k<channel; k++)
-    for (i=0; i<row; i++)
-      for (j=0; j<nc; j++) {
-        tmp = 0.0;
-        for (m=0; m<col; m++) {
-          tmp += image[(i*col+m)*channel+k] * img(m,j,k);
-          temp(i,j,k) = tmp;
-        }
-      }
+    matmul(row, nc, col, rowPtr(0,k), stride, img.rowPtr(0,k), img.stride,
+           temp.rowPtr(0,k), temp.stride);
 
   return temp;
 }
@@ -664,14 +975,15 @@ Image Image::operator->*(const Image &img) const {
  * @param img Image to be output.
  * @result Output image to the specified file destination.
  */
-ostream & operator<<(ostream &out, Image &img) {
+template <class T>
+ostream & operator<<(ostream &out, const BasicImage<T> &img) {
   int i, j, k;
   
   for (k=0; k<img.getChannel(); k++) {
     out << endl;
     for (i=0; i<img.getRow(); i++) {
       for (j=0; j<img.getCol(); j++)
-        out << setw(4) << img(i,j,k) << ' ';
+        out << setw(4) << +img(i,j,k) << ' ';
       out << endl;
     }
   }
@@ -679,113 +991,19 @@ ostream & operator<<(ostream &out, Image &img) {
   return out; 
 }
 
-/**
- * Overloading / operator.  The left operand is the image and the right
- * is the dividend (a double point number). Each pixel in the image is 
- * divided by the double point number.
- * \ingroup overload
- * @param img Image as the left operand.
- * @param dev A double point number as the right operand.
- * @result Image divided by a double point number.
- */
-Image operator/(Image &img, double dev) {
-  int i, j, k, nr, nc, nt, nchan;
-  Image temp;
-  
-  nr = img.getRow();
-  nc = img.getCol();
-  nchan = img.getChannel();
-  nt = img.getType();
-  temp.createImage(nr, nc, nt);
-  
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        temp(i,j,k) = img(i,j,k) / dev;
-  
-  return temp;
-}
-
-/**
- * Overloading * operator.  The left operand is the image and the right
- * is a double point number. Each pixel in the image is multiplied by the
- * double point number.
- * \ingroup overload
- * @param img Image as the left operand.
- * @param s A double point number as the right operand.
- * @result Image multiplied by a double point scalar.
- */
-Image operator*(Image &img, double s) {
-  int i, j, k, nr, nc, nt, nchan;
-  Image temp;
-  
-  nr = img.getRow();
-  nc = img.getCol();
-  nchan = img.getChannel();
-  nt = img.getType();
-  temp.createImage(nr, nc, nt);
-  
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        temp(i,j,k) = img(i,j,k) * s;
-  
-  return temp;
-}
-
-
-/**
- * Overloading + operator.  The left operand is the image and the right
- * is a double point number. Each pixel in the image is added by the
- * double point number.
- * \ingroup overload
- * @param img Image as the left operand.
- * @param s A double point number as the right operand.
- * @result Image add a double point scalar.
- */
-Image operator+(Image &img, double s) {
-  int i, j, k, nr, nc, nt, nchan;
-  Image temp;
-  
-  nr = img.getRow();
-  nc = img.getCol();
-  nchan = img.getChannel();
-  nt = img.getType();
-  temp.createImage(nr, nc, nt);
-  
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        temp(i,j,k) = img(i,j,k) + s;
-  
-  return temp;
-}
-
+// the pixel types supported by the library
+template class BasicImage<float>;
+template class BasicImage<unsigned char>;
+template class BasicImage<unsigned short>;
 
-/**
- * Overloading - operator.  The left operand is the image and the right
- * is a double point number. Each pixel in the image is subtracted by the
- * double point number.
- * \ingroup overload
- * @param img Image as the left operand.
- * @param s A double point number as the right operand.
- * @result Image subtract a double point scalar.
- */
-Image operator-(Image &img, double s) {
-  int i, j, k, nr, nc, nt, nchan;
-  Image temp;
-  
-  nr = img.getRow();
-  nc = img.getCol();
-  nchan = img.getChannel();
-  nt = img.getType();
-  temp.createImage(nr, nc, nt);
-  
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        temp(i,j,k) = img(i,j,k) - s;
-  
-  return temp;
-}
+template ostream & operator<<(ostream &, const BasicImage<float> &);
+template ostream & operator<<(ostream &, const BasicImage<unsigned char> &);
+template ostream & operator<<(ostream &, const BasicImage<unsigned short> &);
 
+// conversions between the pixel types
+template BasicImage<float>::BasicImage(const BasicImage<unsigned char> &);
+template BasicImage<float>::BasicImage(const BasicImage<unsigned short> &);
+template BasicImage<unsigned char>::BasicImage(const BasicImage<float> &);
+template BasicImage<unsigned char>::BasicImage(const BasicImage<unsigned short> &);
+template BasicImage<unsigned short>::BasicImage(const BasicImage<float> &);
+template BasicImage<unsigned short>::BasicImage(const BasicImage<unsigned char> &);
@@ -0,0 +1,191 @@
+/**********************************************************
+ * ImagePool.cpp - a scoped pool that recycles the pixel
+ *                 buffers of the images (see ImagePool.h)
+ *
+ * Created: 10/17/26
+ **********************************************************/
+
+#include "Image.h"
+#include <iostream>
+#include <cstdlib>
+#include <sys/mman.h>
+
+using namespace std;
+
+static thread_local ImagePool *current = 0;   // the innermost pool
+static atomic<unsigned> npools(0);            // to give each pool an id
+
+
+/**
+ * The size class of a request: the size rounded up to a multiple of a
+ * quarter of its largest power of 2 (and of ALIGNMENT).
+ * @param n The requested size in bytes.
+ * @return The size of the buffer to allocate.
+ */
+static size_t sizeClass(size_t n) {
+  size_t step = ALIGNMENT;
+
+  while (step*8 <= n)
+    step <<= 1;
+  return (n + step - 1) / step * step;
+}
+
+/**
+ * The largest size class a buffer can serve.
+ * @param n The size of the buffer in bytes.
+ * @return The size class.
+ */
+static size_t classBelow(size_t n) {
+  size_t step = ALIGNMENT;
+
+  while (step*8 <= n)
+    step <<= 1;
+  return n / step * step;
+}
+
+
+/**
+ * Start a pool. Until it is destroyed, the buffers released in this
+ * thread are kept in the pool and reused by new images.
+ */
+ImagePool::ImagePool() {
+  prev = current;
+  id = ++npools;
+  hits = misses = 0;
+  held = cached = peak = 0;
+  current = this;
+}
+
+/**
+ * Free the cached buffers and go back to the enclosing pool, if any.
+ */
+ImagePool::~ImagePool() {
+  clear();
+  current = prev;
+}
+
+/**
+ * Returns the number of buffers taken from the pool.
+ * @return Number of hits.
+ */
+long ImagePool::getHits() const {
+  return hits;
+}
+
+/**
+ * Returns the number of buffers that had to be allocated.
+ * @return Number of misses.
+ */
+long ImagePool::getMisses() const {
+  return misses;
+}
+
+/**
+ * Returns the largest number of bytes held at a time by the buffers
+ * handed out by the pool and the cached ones.
+ * @return Peak bytes.
+ */
+size_t ImagePool::getPeakBytes() const {
+  return peak;
+}
+
+/**
+ * Returns the number of bytes of the cached buffers.
+ * @return Cached bytes.
+ */
+size_t ImagePool::getCachedBytes() const {
+  return cached;
+}
+
+/**
+ * Free the cached buffers.
+ */
+void ImagePool::clear() {
+  map<size_t, vector<ImageBuffer *> >::iterator it;
+  size_t i;
+
+  for (it=cache.begin(); it!=cache.end(); it++)
+    for (i=0; i<it->second.size(); i++) {
+      free(it->second[i]->data);
+      delete it->second[i];
+    }
+  cache.clear();
+  held -= cached;
+  cached = 0;
+}
+
+/**
+ * Get a pixel buffer of at least the given size, used by one image. It
+ * comes from the innermost pool of the thread when there is one.
+ * @param bytes The size in bytes, a multiple of ALIGNMENT.
+ * @return The buffer.
+ */
+ImageBuffer *ImagePool::acquire(size_t bytes) {
+  ImagePool *pool = current;
+  map<size_t, vector<ImageBuffer *> >::iterator it;
+  ImageBuffer *b;
+
+  if (pool) {
+    bytes = sizeClass(bytes);
+    it = pool->cache.find(bytes);
+    if (it != pool->cache.end() && !it->second.empty()) {
+      b = it->second.back();
+      it->second.pop_back();
+      pool->cached -= b->bytes;
+      pool->hits++;
+      b->pool = pool->id;
+      b->refs = 1;
+      return b;
+    }
+    pool->misses++;
+  }
+
+  b = new ImageBuffer;
+  b->data = aligned_alloc(ALIGNMENT, bytes);
+  if (!b->data) {
+    cout << "CREATEIMAGE: Out of memory.\n";
+    exit(1);
+  }
+  b->bytes = bytes;
+  b->refs = 1;
+  b->pool = 0;
+  b->map = 0;
+  b->mapBytes = 0;
+  if (pool) {
+    b->pool = pool->id;
+    pool->held += bytes;
+    if (pool->held > pool->peak)
+      pool->peak = pool->held;
+  }
+  return b;
+}
+
+/**
+ * Give back a buffer no image is using. It is kept by the innermost pool
+ * of the thread, or freed when there is none. A buffer in a mapped file
+ * is unmapped.
+ * @param b The buffer.
+ */
+void ImagePool::recycle(ImageBuffer *b) {
+  ImagePool *pool = current;
+
+  if (b->map) {
+    munmap(b->map, b->mapBytes);
+    delete b;
+    return;
+  }
+
+  if (!pool) {
+    free(b->data);
+    delete b;
+    return;
+  }
+
+  if (b->pool != pool->id) {     // not from this pool, adopt it
+    pool->held += b->bytes;
+    if (pool->held > pool->peak)
+      pool->peak = pool->held;
+  }
+  pool->cache[classBelow(b->bytes)].push_back(b);
+  pool->cached += b->bytes;
+}
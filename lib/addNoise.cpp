@@ -15,6 +15,8 @@
  *   - 02/12/06: each pixel is added with a random number
  *               instead of a fixed number all across the
  *               image plane (bug found by Tom Karnowski)            
+ *   - 10/17/26: the noisy image is not zeroed before it is written
+ *   - 10/17/26: the noisy image keeps the maxval of the input image
  **********************************************************/
 #include "Image.h"
 #include "Dip.h"
@@ -31,7 +33,7 @@
  * @param std The standard deviation of the noise
  * @return Image corrupted by Gaussian noise
  */
-Image gaussianNoise(Image &inimg, float std, float mean) {
+Image gaussianNoise(const Image &inimg, float std, float mean) {
   Image outimg;
   int nr, nc, nt, nchan;
   int i, j, k;
@@ -41,7 +43,8 @@ Image gaussianNoise(Image &inimg, float std, float mean) {
   nr = inimg.getRow();
   nt = inimg.getType();
   nchan = inimg.getChannel();
-  outimg.createImage(nr, nc, nt);
+  outimg.createImageUninit(nr, nc, nt);
+  outimg.setMaxval(inimg.getMaxval());
   
   srand(time(NULL));         // randomize the seed
 
@@ -67,7 +70,7 @@ Image gaussianNoise(Image &inimg, float std, float mean) {
  * The higher the q, the worse the noise
  * @return Image corrupted by salt and pepper noise.
  */
-Image sapNoise(Image &inimg, float q) {
+Image sapNoise(const Image &inimg, float q) {
   Image outimg;
   int i, j, k;
   int nc, nr, ntype, nchan;
@@ -80,7 +83,8 @@ Image sapNoise(Image &inimg, float q) {
   nchan = inimg.getChannel();
     
   // allocate memory for the negative image
-  outimg.createImage(nr, nc, ntype);
+  outimg.createImageUninit(nr, nc, ntype);
+  outimg.setMaxval(inimg.getMaxval());
 
   // add SAP noise
   srand(time(0));         // so that a different seed nr is generated
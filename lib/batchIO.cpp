@@ -0,0 +1,200 @@
+/**********************************************************
+ * batchIO.cpp - read and write many image files in
+ *               background threads (see BatchIO.h)
+ *
+ *   - BatchReader: read the files of a list ahead of use
+ *   - BatchWriter: write images in the background
+ *
+ * Created: 10/17/26
+ **********************************************************/
+
+#include "BatchIO.h"
+
+using namespace std;
+
+
+/**
+ * Start reading the files of a list in a thread of its own.
+ * @param list The names of the files.
+ * @param n The number of images read in advance, at least 1.
+ */
+BatchReader::BatchReader(const vector<string> &list, int n) {
+  names = list;
+  ahead = (n > 0) ? n : 1;
+  index = -1;
+  stop = 0;
+  reader = thread(&BatchReader::run, this);
+}
+
+/**
+ * Stop the reader thread; the images it has read and not handed out are
+ * dropped.
+ */
+BatchReader::~BatchReader() {
+  {
+    lock_guard<mutex> g(lock);
+    stop = 1;
+  }
+  changed.notify_all();
+  reader.join();
+}
+
+/**
+ * Read the files, up to ahead of them before they are handed out. The
+ * images given back to next() are released here, so their buffers are
+ * reused by the pool of this thread for the next files.
+ */
+void BatchReader::run() {
+  ImagePool pool;                      // the buffers of the images read
+  vector<Image> old;
+  Image img;
+  size_t i;
+
+  for (i=0; i<names.size(); i++) {
+    {
+      unique_lock<mutex> g(lock);
+      changed.wait(g, [this] { return stop || (int)ready.size() < ahead; });
+      if (stop)
+        return;
+      old.swap(spent);
+    }
+    old.clear();                       // their buffers back to the pool
+    img = readImage((char *) names[i].c_str());
+    {
+      lock_guard<mutex> g(lock);
+      ready.push_back(img);
+    }
+    img = Image();
+    changed.notify_all();
+  }
+}
+
+/**
+ * Get the next image of the list, waiting for it to be read if needed.
+ * The image img held before is given back to the reader thread, which
+ * reuses its buffer unless another image still shares it.
+ * @param img The image.
+ * @return 1, or 0 once all the images have been handed out (img is then
+ *         empty).
+ */
+int BatchReader::next(Image &img) {
+  unique_lock<mutex> g(lock);
+
+  if (img.getRow() > 0)
+    spent.push_back(img);
+  img = Image();
+  if (index + 1 >= (int)names.size())
+    return 0;
+
+  changed.wait(g, [this] { return !ready.empty(); });
+  img = ready.front();
+  ready.pop_front();
+  index++;
+  g.unlock();
+  changed.notify_all();
+
+  return 1;
+}
+
+/**
+ * Returns the index in the list of the last image handed out.
+ * @return The index, -1 before the first image.
+ */
+int BatchReader::getIndex() const {
+  return index;
+}
+
+/**
+ * Returns the file name of the last image handed out.
+ * @return The name.
+ */
+const string &BatchReader::getName() const {
+  return names[index];
+}
+
+
+/**
+ * Start the writer thread.
+ * @param n The number of images queued before write() waits, at least 1.
+ */
+BatchWriter::BatchWriter(int n) {
+  depth = (n > 0) ? n : 1;
+  stop = 0;
+  writer = thread(&BatchWriter::run, this);
+}
+
+/**
+ * Write the images still queued, then stop the writer thread.
+ */
+BatchWriter::~BatchWriter() {
+  {
+    lock_guard<mutex> g(lock);
+    stop = 1;
+  }
+  changed.notify_all();
+  writer.join();
+}
+
+/**
+ * Write the queued images one after the other. An image stays at the
+ * front of the queue while it is written.
+ */
+void BatchWriter::run() {
+  Job job;
+
+  for (;;) {
+    {
+      unique_lock<mutex> g(lock);
+      changed.wait(g, [this] { return stop || !queue.empty(); });
+      if (queue.empty())
+        return;
+      job = queue.front();
+    }
+    writeImage(job.img, (char *) job.name.c_str(), job.flag);
+    {
+      lock_guard<mutex> g(lock);
+      done.push_back(job.img);
+      queue.pop_front();
+    }
+    job.img = Image();
+    changed.notify_all();
+  }
+}
+
+/**
+ * Queue an image to be written, waiting while depth images are queued.
+ * The image is not copied: it shares its pixels with img, which can be
+ * modified right away (copy-on-write). The images written since the last
+ * call are released here, in the thread that created them, so their
+ * buffers go back to its pool.
+ * @param img The image.
+ * @param name The name of the file.
+ * @param flag The rescale flag of writeImage().
+ */
+void BatchWriter::write(const Image &img, const string &name, int flag) {
+  vector<Image> old;
+  Job job;
+
+  job.img = img;
+  job.name = name;
+  job.flag = flag;
+  {
+    unique_lock<mutex> g(lock);
+    old.swap(done);
+    changed.wait(g, [this] { return (int)queue.size() < depth; });
+    queue.push_back(job);
+  }
+  changed.notify_all();
+}
+
+/**
+ * Wait until the queued images are written, e.g., before the files are
+ * used.
+ */
+void BatchWriter::flush() {
+  vector<Image> old;
+  unique_lock<mutex> g(lock);
+
+  changed.wait(g, [this] { return queue.empty(); });
+  old.swap(done);
+}
@@ -22,9 +22,12 @@
  *              pixel is set to edge pixel only if its 
  *              intensity is higher than the low threshold 
  *              and it's adjacent to a connected edge.
+ *   10/17/26 - free the histogram in estThreshold()
+ *   10/17/26 - run the rows of nonmax() on all the cores
  **********************************************************/
 #include "Image.h"
 #include "Dip.h"
+#include "Parallel.h"
 #include <iostream>
 #include <cstdlib>
 
@@ -37,7 +40,7 @@ using namespace std;
  * @param sigma The standard deviation
  * @return The edge image by Canny filter
  */
-Image canny(Image &inimg, float sigma) {
+Image canny(const Image &inimg, float sigma) {
   Image G, DoGx, DoGy, I, Ix, Iy, thinEdge;
 
   // Create Gaussian kernel G, and seperate DoG 
@@ -71,61 +74,66 @@ Image canny(Image &inimg, float sigma) {
  * @param imgy Edge image in the vertical direction
  * @return Edge suppressed image.
  */
-Image nonmax(Image &imgx, Image &imgy) {
-  float ratio, x, y, g, o1, o2, a1, a2;
-  int nr, nc, i, j;
+Image nonmax(const Image &imgx, const Image &imgy) {
+  int nr, nc;
   Image edge;
 
   nr = imgx.getRow();
   nc = imgx.getCol();
   edge.createImage(nr, nc);
 
-  for (i=1; i<nr-1; i++)
-    for (j=1; j<nc-1; j++) {
-      x = imgx(i,j);
-      y = imgy(i,j);
-      g = norm(x, y);        
-
-      // gradient direction is roughly vertical or edge direction is horizontal 
-      if (fabs(y) > fabs(x)) {
-        ratio = fabs(x) / fabs(y);
-        // the two pixels "across" edge direction
-        o1 = norm(imgx(i-1,j), imgy(i-1,j));
-        o2 = norm(imgx(i+1,j), imgy(i+1,j));
-        // when the edge is not strictly horizontal, but tilted with an angle
-        // we also find those neighbors along the crossing direction
-        if (x*y > 0.0) {   // edge with a positive slope
-          a1 = norm(imgx(i-1,j-1), imgy(i-1,j-1));
-          a2 = norm(imgx(i+1,j+1), imgy(i+1,j+1));
-        } else {           // edge with a negative slope
-          a1 = norm(imgx(i-1,j+1), imgy(i-1,j+1));
-          a2 = norm(imgx(i+1,j-1), imgy(i+1,j-1));
-        }
-      } else {        // edge direction is basically vertical
-        ratio = fabs(y) / fabs(x);
-        o1 = norm(imgx(i,j-1), imgy(i,j-1));
-        o2 = norm(imgx(i,j+1), imgy(i,j+1));
-        if (x*y > 0.0) {
-          a1 = norm(imgx(i-1,j-1), imgy(i-1,j-1));
-          a2 = norm(imgx(i+1,j+1), imgy(i+1,j+1));
-        } else {
-          a1 = norm(imgx(i+1,j-1), imgy(i+1,j-1));   // modified on 02/02/06
-          a2 = norm(imgx(i-1,j+1), imgy(i-1,j+1));   // modified on 02/02/06
+  // the bands of rows run on separate threads
+  parallelRows(nr-2, rowBand(3 * nc * sizeof(float)), [&](int i0, int i1) {
+      float ratio, x, y, g, o1, o2, a1, a2;
+      int i, j;
+
+      for (i=1+i0; i<1+i1; i++)
+        for (j=1; j<nc-1; j++) {
+          x = imgx(i,j);
+          y = imgy(i,j);
+          g = norm(x, y);        
+
+          // gradient direction is roughly vertical or edge direction is horizontal 
+          if (fabs(y) > fabs(x)) {
+            ratio = fabs(x) / fabs(y);
+            // the two pixels "across" edge direction
+            o1 = norm(imgx(i-1,j), imgy(i-1,j));
+            o2 = norm(imgx(i+1,j), imgy(i+1,j));
+            // when the edge is not strictly horizontal, but tilted with an angle
+            // we also find those neighbors along the crossing direction
+            if (x*y > 0.0) {   // edge with a positive slope
+              a1 = norm(imgx(i-1,j-1), imgy(i-1,j-1));
+              a2 = norm(imgx(i+1,j+1), imgy(i+1,j+1));
+            } else {           // edge with a negative slope
+              a1 = norm(imgx(i-1,j+1), imgy(i-1,j+1));
+              a2 = norm(imgx(i+1,j-1), imgy(i+1,j-1));
+            }
+          } else {        // edge direction is basically vertical
+            ratio = fabs(y) / fabs(x);
+            o1 = norm(imgx(i,j-1), imgy(i,j-1));
+            o2 = norm(imgx(i,j+1), imgy(i,j+1));
+            if (x*y > 0.0) {
+              a1 = norm(imgx(i-1,j-1), imgy(i-1,j-1));
+              a2 = norm(imgx(i+1,j+1), imgy(i+1,j+1));
+            } else {
+              a1 = norm(imgx(i+1,j-1), imgy(i+1,j-1));   // modified on 02/02/06
+              a2 = norm(imgx(i-1,j+1), imgy(i-1,j+1));   // modified on 02/02/06
+            }
+          }
+
+          // compare the current pixel mag with interpolated two neighbor mag
+          // use interpolation to more accurately estimate the edge direction
+          if ((g > (ratio*o1+(1-ratio)*a1)) && (g > (ratio*o2+(1-ratio)*a2))) {
+            if (g > L)
+              edge(i,j) = L;
+            else       
+              edge(i,j) = g; 
+          }
+          else {
+            edge(i,j) = 0.0;
+          }
         }
-      }
-
-      // compare the current pixel mag with interpolated two neighbor mag
-      // use interpolation to more accurately estimate the edge direction
-      if ((g > (ratio*o1+(1-ratio)*a1)) && (g > (ratio*o2+(1-ratio)*a2))) {
-        if (g > L)
-          edge(i,j) = L;
-        else       
-          edge(i,j) = g; 
-      }
-      else {
-        edge(i,j) = 0.0;
-      }
-    }
+    });
 
   return(edge);
 }
@@ -138,7 +146,7 @@ Image nonmax(Image &imgx, Image &imgy) {
  * @param inimg The input image.
  * @return Fined tuned edge image.
  */
-Image hThreshold(Image &inimg) {
+Image hThreshold(const Image &inimg) {
   int high, low, i, j, m, n;
   int nr, nc;
   Image edge;
@@ -183,7 +191,7 @@ Image hThreshold(Image &inimg) {
  * @param high The pointer to the high threshold
  * @param low The pointer to the low threshold
  */
-void estThreshold(Image &inimg, int *high, int *low) {
+void estThreshold(const Image &inimg, int *high, int *low) {
   int i, j, *hist, count, pixels;
   int nr, nc;
 
@@ -210,6 +218,8 @@ void estThreshold(Image &inimg, int *high, int *low) {
   }
   *high = i;
   *low = (int)(*high / 2.0);
+
+  delete [] hist;
 }
 
 
@@ -11,6 +11,7 @@
  * Modified:
  *   - Mitch Horton (Class 2008) fixed two bugs in 
  *     RGB2HSI and HSI2RGB
+ *   - 10/17/26: the converted image is not zeroed before it is written
  **********************************************************/
 
 #include "Image.h"
@@ -27,7 +28,7 @@ using namespace std;
  * @param inimg The input image in RGB model
  * @return The color image represented using hte HSI model
  */
-Image RGB2HSI(Image &inimg) {
+Image RGB2HSI(const Image &inimg) {
   Image temp;        // a 3-channel image holds H, S, and I components
   float r, g, b, theta, mini;
   int i, j;
@@ -41,7 +42,7 @@ Image RGB2HSI(Image &inimg) {
     cout << "RGB2HSI: This is not a color image\n";
     exit(3);
   }
-  temp.createImage(nr, nc, nt);
+  temp.createImageUninit(nr, nc, nt);
 
   // model conversion
   for (i=0; i<nr; i++)
@@ -76,7 +77,7 @@ Image RGB2HSI(Image &inimg) {
  * @param inimg The input color image in HSI model.
  * @return The color image in RGB model.
  */
-Image HSI2RGB(Image &inimg) {
+Image HSI2RGB(const Image &inimg) {
   Image temp;        // a 3-channel image holds R, G, B components
   float hue, saturation, intensity, theta;
   int i, j;
@@ -90,7 +91,7 @@ Image HSI2RGB(Image &inimg) {
     cout << "HSI2RGB: This is not a color image\n";
     exit(3);
   }
-  temp.createImage(nr, nc, nt);
+  temp.createImageUninit(nr, nc, nt);
 
   // color model conversion
   for (i=0; i<nr; i++)
@@ -1,22 +1,446 @@
+#include "Image.h"
+#include "Dip.h"
+#include "Parallel.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+#define SEPTOL 1e-6     // relative (Frobenius) error allowed when a mask is
+                        // split into separable terms, about the rounding
+                        // error of its float taps
+#define SVDSWEEP 30     // most sweeps of the Jacobi SVD
+#define FFTMAX 1024     // largest side of an FFT tile
+#define MULTI 4         // masks applied together by convMulti()
+
+// conv() goes through the FFT when the multiplications per pixel of the
+// mask (or of its separable terms) exceed crossover times the FFT work per
+// pixel, N log2 N for a tile of N pixels over the pixels it yields (10,
+// measured on x86-64, see setConvCrossover())
+static float crossover = 10;
+
+/**
+ * Singular value decomposition of an nr x nc matrix a (row by row, in
+ * double) by one-sided Jacobi rotations: the columns of a are rotated
+ * until they are orthogonal, so that a = (a v) v^T with the columns of
+ * a v being the singular vectors scaled by the singular values.
+ * @param a The matrix, replaced by a v.
+ * @param v The nc x nc rotation (row by row).
+ */
+static void jacobiSVD(vector<double> &a, int nr, int nc, vector<double> &v)
+{
+  int i, p, q, sweep, rotated;
+  double alpha, beta, gamma, zeta, t, c, s, x, y;
+
+  v.assign((size_t)nc*nc, 0);
+  for (i=0; i<nc; i++)
+    v[(size_t)i*nc+i] = 1;
+
+  for (sweep=0; sweep<SVDSWEEP; sweep++) {
+    rotated = 0;
+    for (p=0; p<nc-1; p++) {
+      for (q=p+1; q<nc; q++) {
+        alpha = beta = gamma = 0;
+        for (i=0; i<nr; i++) {
+          x = a[(size_t)i*nc+p];
+          y = a[(size_t)i*nc+q];
+          alpha += x * x;
+          beta += y * y;
+          gamma += x * y;
+        }
+        if (fabs(gamma) <= 1e-15 * sqrt(alpha * beta))
+          continue;
+        rotated = 1;
+        zeta = (beta - alpha) / (2 * gamma);
+        t = ((zeta >= 0) ? 1 : -1) / (fabs(zeta) + sqrt(1 + zeta * zeta));
+        c = 1 / sqrt(1 + t * t);
+        s = c * t;
+        for (i=0; i<nr; i++) {
+          x = a[(size_t)i*nc+p];
+          y = a[(size_t)i*nc+q];
+          a[(size_t)i*nc+p] = c * x - s * y;
+          a[(size_t)i*nc+q] = s * x + c * y;
+        }
+        for (i=0; i<nc; i++) {
+          x = v[(size_t)i*nc+p];
+          y = v[(size_t)i*nc+q];
+          v[(size_t)i*nc+p] = c * x - s * y;
+          v[(size_t)i*nc+q] = s * x + c * y;
+        }
+      }
+    }
+    if (!rotated)
+      break;
+  }
+}
+
+
+/**
+ * Split a mask into a short sum of separable terms, mask(m,n) = sum over
+ * t of col[t][m] * row[t][n], up to a relative error of SEPTOL. A rank-1
+ * mask (e.g., gaussianKernel(), DoGX(), DoGY() or the box of average())
+ * is found directly from its largest tap; otherwise the terms are the
+ * largest singular values and vectors of the mask.
+ * @param mask The mask, 1 channel.
+ * @param col The columns of the terms, nr2 taps each.
+ * @param row The rows of the terms, nc2 taps each.
+ * @return The number of terms, or 0 when they would take as many
+ *         multiplications per pixel as the mask itself.
+ */
+static int separate(const Image &mask, vector<float> &col,
+                    vector<float> &row)
+{
+  int m, n, t, r, rmax, nr2, nc2, pm, pn;
+  double big, x, energy, err;
+  vector<double> a, v, sv;
+  vector<int> order;
+
+  nr2 = mask.getRow();
+  nc2 = mask.getCol();
+  rmax = (nr2 * nc2 - 1) / (nr2 + nc2);     // terms cheaper than the mask
+  if (rmax < 1)
+    return 0;
+
+  // the mask in double, and its largest tap
+  a.resize((size_t)nr2*nc2);
+  big = energy = 0;
+  pm = pn = 0;
+  for (m=0; m<nr2; m++)
+    for (n=0; n<nc2; n++) {
+      x = a[(size_t)m*nc2+n] = mask(m,n);
+      energy += x * x;
+      if (fabs(x) > big) {
+        big = fabs(x);
+        pm = m;
+        pn = n;
+      }
+    }
+  if (big == 0)
+    return 0;
+
+  // rank 1: every row is the row of the largest tap, scaled
+  err = 0;
+  for (m=0; m<nr2; m++)
+    for (n=0; n<nc2; n++) {
+      x = a[(size_t)m*nc2+n] - a[(size_t)m*nc2+pn] * a[(size_t)pm*nc2+n] /
+        a[(size_t)pm*nc2+pn];
+      err += x * x;
+    }
+  if (err <= SEPTOL * SEPTOL * energy) {
+    col.resize(nr2);
+    row.resize(nc2);
+    for (m=0; m<nr2; m++)
+      col[m] = a[(size_t)m*nc2+pn];
+    for (n=0; n<nc2; n++)
+      row[n] = a[(size_t)pm*nc2+n] / a[(size_t)pm*nc2+pn];
+    return 1;
+  }
+  if (rmax < 2)
+    return 0;
+
+  // otherwise keep the largest singular values until the rest is small
+  jacobiSVD(a, nr2, nc2, v);
+  sv.assign(nc2, 0);
+  order.resize(nc2);
+  for (n=0; n<nc2; n++) {
+    for (m=0; m<nr2; m++)
+      sv[n] += a[(size_t)m*nc2+n] * a[(size_t)m*nc2+n];
+    order[n] = n;
+  }
+  for (n=1; n<nc2; n++)                     // by decreasing singular value
+    for (t=n; t>0 && sv[order[t]] > sv[order[t-1]]; t--)
+      swap(order[t], order[t-1]);
+  err = energy;
+  for (r=0; r<nc2 && err > SEPTOL * SEPTOL * energy; r++)
+    err -= sv[order[r]];
+  if (r > rmax)
+    return 0;
+
+  // col = (a v)[:,t], the singular vector scaled by its value; row = v[:,t]
+  col.resize((size_t)r*nr2);
+  row.resize((size_t)r*nc2);
+  for (t=0; t<r; t++) {
+    for (m=0; m<nr2; m++)
+      col[(size_t)t*nr2+m] = a[(size_t)m*nc2+order[t]];
+    for (n=0; n<nc2; n++)
+      row[(size_t)t*nc2+n] = v[(size_t)n*nc2+order[t]];
+  }
+  return r;
+}
+
+
+/**
+ * Set the crossover between the spatial and the frequency-domain paths of
+ * conv(): a mask goes through the FFT when the multiplications it takes
+ * per pixel exceed c times the FFT work per pixel. The default, 10, was
+ * measured on x86-64; a larger c favors the spatial path.
+ * @param c The crossover, 0 to always use the FFT, negative to never.
+ */
+void setConvCrossover(float c)
+{
+  crossover = c;
+}
+
+
+/**
+ * The FFT tile for a mask of nr2 x nc2 taps over an nr1 x nc1 image: the
+ * power-of-2 size that yields the output for the least work, each tile
+ * giving (br-nr2+1) x (bc-nc2+1) pixels (overlap-save).
+ * @param br The rows of the tile.
+ * @param bc The columns of the tile.
+ * @return The FFT work per output pixel, N log2 N for a tile of N pixels
+ *         over the pixels it yields (two tiles share a transform).
+ */
+static double fftTile(int nr1, int nc1, int nr2, int nc2, int &br, int &bc)
+{
+  int r, c, nt;
+  double work, best = -1;
+
+  br = bc = 0;
+  for (r=1; r<=FFTMAX; r<<=1) {
+    if (r < nr2 || (r > 1 && r/2 >= nr1 + nr2 - 1))
+      continue;
+    for (c=1; c<=FFTMAX; c<<=1) {
+      if (c < nc2 || (c > 1 && c/2 >= nc1 + nc2 - 1))
+        continue;
+      nt = ((nr1 + r-nr2) / (r-nr2+1)) * ((nc1 + c-nc2) / (c-nc2+1));
+      work = (double) nt * r * c * log2((double) r * c + 1) /
+        (2.0 * nr1 * nc1);
+      if (best < 0 || work < best) {
+        best = work;
+        br = r;
+        bc = c;
+      }
+    }
+  }
+  return best;
+}
+
+
+/**
+ * Convolution through the FFT, with the same result as the spatial path
+ * up to rounding: output pixel (i,j) is the sum of the taps times the
+ * pixels of src around (i+oi,j+oj), zero outside src. The output is made of
+ * tiles of (br-nr2+1) x (bc-nc2+1) pixels: the br x bc input pixels a tile
+ * needs are transformed, multiplied by the conjugate spectrum of the mask
+ * (a correlation, as conv() computes) and transformed back, and the
+ * pixels that did not wrap around are kept (overlap-save). Two tiles go
+ * through one complex transform, as its real and imaginary parts, since
+ * the mask is real; the pairs of tiles are spread over the threads.
+ */
+static void convFFT(const Image &src, int oi, int oj, const Image &mask,
+                    Image &outimg, int br, int bc)
+{
+  int i, j, nr1, nc1, nrs, ncs, nr2, nc2, nchan;
+  int tr, tc, ntr, ntc, ntile, radiusR, radiusC;
+  size_t b, nb;
+  vector<float> hr, hi;
+  FFTPlan fr(br), fc(bc);
+
+  nr1 = outimg.getRow();
+  nc1 = outimg.getCol();
+  nchan = outimg.getChannel();
+  nrs = src.getRow();
+  ncs = src.getCol();
+  nr2 = mask.getRow();
+  nc2 = mask.getCol();
+  radiusR = nr2/2;
+  radiusC = nc2/2;
+  tr = br - nr2 + 1;
+  tc = bc - nc2 + 1;
+  ntr = (nr1 + tr-1) / tr;
+  ntc = (nc1 + tc-1) / tc;
+  ntile = ntr * ntc * nchan;
+  nb = (size_t) br * bc;
+
+  // the spectrum of the mask, conjugated and scaled for the inverse
+  hr.assign(nb, 0);
+  hi.assign(nb, 0);
+  for (i=0; i<nr2; i++)
+    for (j=0; j<nc2; j++)
+      hr[(size_t)i*bc+j] = mask(i,j);
+  fftRows(&hr[0], &hi[0], br, bc, fc, 0);
+  fftCols(&hr[0], &hi[0], br, bc, fr, 0);
+  for (b=0; b<nb; b++) {
+    hr[b] /= nb;
+    hi[b] /= -(float)nb;
+  }
+
+  // the pairs of tiles run on separate threads, each with its own buffers
+  parallelRows((ntile + 1) / 2, 1, [&](int t0, int t1) {
+      int i, k, t, u, i0, j0, nrow, ncol;
+      size_t b;
+      float x, y, *xr;
+      const float *p;
+      float *q;
+      vector<float> re(nb), im(nb);
+
+      for (t=2*t0; t<2*t1; t+=2) {
+        // the input of tile t (and t+1) starts radius pixels above and
+        // left of its output, zero outside src
+        for (u=0; u<2; u++) {
+          xr = u ? &im[0] : &re[0];
+          fill(xr, xr + nb, 0.0f);
+          if (t+u >= ntile)
+            continue;
+          k = (t+u) / (ntr*ntc);
+          i0 = ((t+u) / ntc) % ntr * tr + oi - radiusR;
+          j0 = (t+u) % ntc * tc + oj - radiusC;
+          for (i=max(i0,0); i<min(i0+br,nrs); i++) {
+            p = src.rowPtr(i,k);
+            if (j0 < ncs && j0 + bc > 0)
+              copy(p + max(j0,0), p + min(j0+bc,ncs),
+                   xr + (size_t)(i-i0)*bc + max(-j0,0));
+          }
+        }
+
+        fftRows(&re[0], &im[0], br, bc, fc, 0);
+        fftCols(&re[0], &im[0], br, bc, fr, 0);
+        for (b=0; b<nb; b++) {
+          x = re[b] * hr[b] - im[b] * hi[b];
+          y = re[b] * hi[b] + im[b] * hr[b];
+          re[b] = x;
+          im[b] = y;
+        }
+        fftCols(&re[0], &im[0], br, bc, fr, 1);
+        fftRows(&re[0], &im[0], br, bc, fc, 1);
+
+        // keep the pixels that did not wrap around
+        for (u=0; u<2 && t+u<ntile; u++) {
+          xr = u ? &im[0] : &re[0];
+          k = (t+u) / (ntr*ntc);
+          i0 = ((t+u) / ntc) % ntr * tr;
+          j0 = (t+u) % ntc * tc;
+          nrow = min(tr, nr1-i0);
+          ncol = min(tc, nc1-j0);
+          for (i=0; i<nrow; i++) {
+            q = outimg.rowPtr(i0+i,k);
+            copy(xr + (size_t)i*bc, xr + (size_t)i*bc + ncol, q + j0);
+          }
+        }
+      }
+    });
+}
+
+
+/**
+ * The pixel of a row (or column) of n pixels that stands for pixel i,
+ * which may be outside, under a border mode.
+ * @return The index in [0, n), or -1 for a pixel taken as 0.
+ */
+static int borderIndex(int i, int n, int border)
+{
+  if (i >= 0 && i < n)
+    return i;
+  switch (border) {
+  case BORDERREPLICATE:
+    return (i < 0) ? 0 : n-1;
+  case BORDERREFLECT:                      // ... c b a | a b c ... 
+    i %= 2*n;
+    if (i < 0)
+      i += 2*n;
+    return (i < n) ? i : 2*n-1-i;
+  case BORDERWRAP:
+    i %= n;
+    return (i < 0) ? i+n : i;
+  default:
+    return -1;
+  }
+}
+
+
+/**
+ * Copy an image into ext with a border of top, bottom, left and right
+ * pixels filled under a border mode.
+ * @param inimg The image.
+ * @param border The border mode (not BORDERZERO).
+ * @param ext The image with its border.
+ */
+static void padImage(const Image &inimg, int border, int top, int bottom,
+                     int left, int right, Image &ext)
+{
+  int i, j, k, nr, nc, nrs, ncs;
+  const float *p;
+  float *q;
+  vector<int> index;
+
+  nr = inimg.getRow();
+  nc = inimg.getCol();
+  nrs = nr + top + bottom;
+  ncs = nc + left + right;
+  ext.createImageUninit(nrs, ncs, inimg.getType());
+  index.resize(ncs);
+  for (j=0; j<ncs; j++)
+    index[j] = borderIndex(j-left, nc, border);
+  for (k=0; k<inimg.getChannel(); k++)
+    for (i=0; i<nrs; i++) {
+      p = inimg.rowPtr(borderIndex(i-top, nr, border),k);
+      q = ext.rowPtr(i,k);
+      for (j=0; j<left; j++)
+        q[j] = p[index[j]];
+      copy(p, p + nc, q + left);
+      for (j=left+nc; j<ncs; j++)
+        q[j] = p[index[j]];
+    }
+}
+
+
 /**
  * Image convolution with "mask" - a linear operation.
  * @param inimg The input image.
  * @param mask The convolution kernel as an image. 
  * Cannot have more than 1 channel.
+ * @param border How the pixels outside the image are taken: BORDERZERO,
+ * BORDERREPLICATE, BORDERREFLECT or BORDERWRAP.
  * @return The image after the kernel operation
  */
-#include "Image.h"
-#include "Dip.h"
-#include <iostream>
+Image conv(const Image &inimg, const Image &mask, int border)
+{
+  Image outimg;
+
+  conv(inimg, mask, outimg, border);
+
+  return outimg;
+}
 
-using namespace std;
 
-Image conv(Image &inimg, Image &mask)
+/**
+ * Image convolution into outimg, whose buffer is reused when it has the
+ * size of the input and is not shared, so a convolution repeated in a 
+ * loop allocates nothing.
+ *
+ * A mask that is the outer product of a column and a row (e.g., the
+ * Gaussian and DoG kernels of canny(), or the box of average()) is
+ * applied as a pass of the row over the rows of the image followed by a
+ * pass of the column over the result, i.e., nr2+nc2 instead of nr2*nc2
+ * multiplications per pixel; a mask that is close to a sum of a few such
+ * terms is applied term by term while that is cheaper. The result is
+ * the same as the one of the full mask up to rounding. A large mask that
+ * is not separable goes through the FFT instead when that is cheaper
+ * (see setConvCrossover()).
+ *
+ * The pixels outside the image are 0 (BORDERZERO), or the ones of the
+ * border mode: the nearest pixel of the image (BORDERREPLICATE), its
+ * mirror image about the edge (BORDERREFLECT), or the pixel of the
+ * opposite side (BORDERWRAP). For the last three, the image is copied
+ * with a border of the size of the mask, which every path then reads
+ * the same way, so the FFT and the spatial paths agree for each mode.
+ * @param img The input image, can be outimg itself.
+ * @param kernel The convolution kernel, can be outimg itself.
+ * @param outimg The image after the kernel operation.
+ * @param border The border mode.
+ */
+void conv(const Image &img, const Image &kernel, Image &outimg, int border)
 {
-  Image outimg;
-  int i, j, k, m, n;
+  const Image inimg = img, mask = kernel;  // shared, so outimg can be either
+  int k, t, nterm, band;
   int nc1, nr1, nc2, nr2, ntype1, nchan1, nchan2;
-  float sum, radiusC, radiusR;
+  int radiusC, radiusR, br, bc, oi, oj, nrs, ncs;
+  double work;
+  vector<float> col, row;
+  Image tmp, ext;
 
   // get the dimension of the image
   nc1 = inimg.getCol();
@@ -33,26 +457,432 @@ Image conv(Image &inimg, Image &mask)
     exit(3);
   }
   
-  // handle odd and even mask size
-  radiusC = (float)nc2/2;
-  radiusR = (float)nr2/2;
+  // handle odd and even mask size, the mask covers [-radius, size-radius)
+  radiusC = nc2/2;
+  radiusR = nr2/2;
   
-  // allocate memory for the output image
-  outimg.createImage(nr1, nc1, ntype1);
+  // the pixels are read from src, output pixel (i,j) being centered on
+  // src pixel (i+oi,j+oj): the image itself padded with zeros, or the
+  // image with a border of the mask's size
+  oi = oj = 0;
+  if (border != BORDERZERO && nr1 > 0 && nc1 > 0) {
+    oi = radiusR;
+    oj = radiusC;
+    padImage(inimg, border, radiusR, nr2-1-radiusR, radiusC, nc2-1-radiusC,
+             ext);
+  }
+  const Image &src = (ext.getRow() > 0) ? ext : inimg;
+  nrs = src.getRow();
+  ncs = src.getCol();
+
+  // allocate memory for the output image, each row is cleared right
+  // before it accumulates the taps
+  outimg.createImageUninit(nr1, nc1, ntype1);
+  outimg.setMaxval(inimg.getMaxval());
+  band = rowBand(2 * (size_t)ncs * sizeof(float));
+
+  // a separable mask: for each term, the row pass goes into tmp and the
+  // column pass adds the rows of tmp to the output, in the same way as
+  // the taps of the full mask below
+  nterm = separate(mask, col, row);
+
+  // or through the FFT, when it takes less work than either
+  if (crossover >= 0 && nr1 > 0 && nc1 > 0) {
+    work = fftTile(nr1, nc1, nr2, nc2, br, bc);
+    if (work >= 0 &&
+        ((nterm > 0) ? nterm * (nr2 + nc2) : nr2 * nc2) > crossover * work) {
+      convFFT(src, oi, oj, mask, outimg, br, bc);
+      return;
+    }
+  }
+
+  if (nterm > 0) {
+    tmp.createImageUninit(nrs, nc1, ntype1);
+    for (t=0; t<nterm; t++) {
+      for (k=0; k<nchan1; k++) {
+        parallelRows(nrs, band, [&](int r0, int r1) {
+            int r, j, n, jstart, jend;
+            const float *p;
+            float *q, w;
 
-  // perform the convolution (or kernel operation)
+            for (r=r0; r<r1; r++) {
+              p = src.rowPtr(r,k) + oj;
+              q = tmp.rowPtr(r,k);
+              for (j=0; j<nc1; j++)
+                q[j] = 0;
+              for (n=-radiusC; n<nc2-radiusC; n++) {
+                w = row[(size_t)t*nc2+radiusC+n];
+                jstart = max(-(oj+n), 0);     // keep j+n inside src
+                jend = min(ncs-(oj+n), nc1);
+                for (j=jstart; j<jend; j++)
+                  q[j] += w * p[j+n];
+              }
+            }
+          });
+        parallelRows(nr1, band, [&](int i0, int i1) {
+            int i, j, m;
+            const float *p;
+            float *q, w;
+
+            for (i=i0; i<i1; i++) {
+              q = outimg.rowPtr(i,k);
+              if (t == 0)
+                for (j=0; j<nc1; j++)
+                  q[j] = 0;
+              for (m=-radiusR; m<nr2-radiusR; m++) {
+                if (i+oi+m < 0 || i+oi+m >= nrs)
+                  continue;
+                p = tmp.rowPtr(i+oi+m,k);
+                w = col[(size_t)t*nr2+radiusR+m];
+                for (j=0; j<nc1; j++)
+                  q[j] += w * p[j];
+              }
+            }
+          });
+      }
+    }
+    return;
+  }
+
+  // perform the convolution (or kernel operation) one output row at a 
+  // time: every tap of the mask scales a shifted input row and adds it to 
+  // the output row, so the inner loop runs over contiguous pixels without
+  // any bound checking. Each pixel still accumulates the taps in the
+  // same (row by row) order. The bands of rows run on separate threads.
   for (k=0; k<nchan1; k++) {
-    for (i=0; i<nr1; i++)
-      for (j=0; j<nc1; j++) {
-        sum = 0;    
-        for (m=(int)-radiusR; m<=(int)radiusR; m++)
-          for (n=(int)-radiusC; n<=(int)radiusC; n++)
-            if (i+m>=0 && i+m<nr1 && j+n>=0 && j+n<nc1 &&
-                radiusR+m>=0 && radiusR+m<nr2 && radiusC+n>=0 && radiusC+n<nc2)
-              sum += inimg(i+m,j+n,k) * mask((int)radiusR+m,(int)radiusC+n);
-        outimg(i,j,k) = sum;
+    parallelRows(nr1, band, [&](int i0, int i1) {
+        int i, j, m, n, jstart, jend;
+        const float *p;
+        float *q, w;
+
+        for (i=i0; i<i1; i++) {
+          q = outimg.rowPtr(i,k);
+          for (j=0; j<nc1; j++)
+            q[j] = 0;
+          for (m=-radiusR; m<nr2-radiusR; m++) {
+            if (i+oi+m < 0 || i+oi+m >= nrs)
+              continue;
+            p = src.rowPtr(i+oi+m,k) + oj;
+            for (n=-radiusC; n<nc2-radiusC; n++) {
+              w = mask(radiusR+m,radiusC+n);
+              jstart = max(-(oj+n), 0);       // keep j+n inside src
+              jend = min(ncs-(oj+n), nc1);
+              for (j=jstart; j<jend; j++)
+                q[j] += w * p[j+n];
+            }
+          }
+        }
+      });
+  }
+}
+
+
+/**
+ * A tap of up to MULTI masks, at offset (m,n) from the output pixel: the
+ * weights w[0] to w[nk-1] of the masks u[0] to u[nk-1] of the group, the
+ * ones that are not 0 there.
+ */
+struct MultiTap {
+  int m, n, nk;
+  int u[MULTI];
+  float w[MULTI];
+};
+
+
+/**
+ * Pad the image for a set of masks: src is the image itself (padded with
+ * zeros), or ext, the image with a border as large as the largest mask
+ * reaches on each side.
+ * @param oi The row of src under the first output row.
+ * @param oj The column of src under the first output column.
+ * @return src.
+ */
+static const Image &multiSource(const Image &inimg,
+                                const vector<Image> &masks, int border,
+                                Image &ext, int &oi, int &oj)
+{
+  int u, top, bottom, left, right, nr2, nc2;
+
+  top = bottom = left = right = 0;
+  for (u=0; u<(int)masks.size(); u++) {
+    nr2 = masks[u].getRow();
+    nc2 = masks[u].getCol();
+    top = max(top, nr2/2);
+    bottom = max(bottom, nr2-1-nr2/2);
+    left = max(left, nc2/2);
+    right = max(right, nc2-1-nc2/2);
+  }
+  oi = oj = 0;
+  if (border == BORDERZERO || inimg.getRow() == 0 || inimg.getCol() == 0)
+    return inimg;
+  oi = top;
+  oj = left;
+  padImage(inimg, border, top, bottom, left, right, ext);
+  return ext;
+}
+
+
+/**
+ * The taps of masks[u0] to masks[u0+nk-1] over the union of their
+ * footprints (each mask covering [-size/2, size-size/2) as in conv()),
+ * row by row, leaving out the offsets where all of them are 0.
+ */
+static void multiTaps(const vector<Image> &masks, int u0, int nk,
+                      vector<MultiTap> &taps)
+{
+  int u, m, n, r, c, nr2, nc2, top, bottom, left, right;
+  float w;
+  MultiTap t;
+
+  top = bottom = left = right = 0;
+  for (u=u0; u<u0+nk; u++) {
+    nr2 = masks[u].getRow();
+    nc2 = masks[u].getCol();
+    top = max(top, nr2/2);
+    bottom = max(bottom, nr2-1-nr2/2);
+    left = max(left, nc2/2);
+    right = max(right, nc2-1-nc2/2);
+  }
+
+  taps.clear();
+  for (m=-top; m<=bottom; m++)
+    for (n=-left; n<=right; n++) {
+      t = MultiTap();                   // the unused weights are 0
+      t.m = m;
+      t.n = n;
+      for (u=0; u<nk; u++) {
+        r = masks[u0+u].getRow()/2 + m;
+        c = masks[u0+u].getCol()/2 + n;
+        if (r < 0 || r >= masks[u0+u].getRow() ||
+            c < 0 || c >= masks[u0+u].getCol())
+          continue;
+        w = masks[u0+u](r,c);
+        if (w != 0) {
+          t.u[t.nk] = u;
+          t.w[t.nk++] = w;
+        }
+      }
+      if (t.nk > 0)
+        taps.push_back(t);
+    }
+}
+
+
+/**
+ * Output row i (channel k) of nk masks at once, into the rows q[0] to
+ * q[nk-1]: each shifted input row is read once and scaled by the taps
+ * of all the masks not 0 there, so the inner loop still runs over
+ * contiguous pixels.
+ */
+static void multiRow(const Image &src, int oi, int oj, int i, int k,
+                     int nc1, const vector<MultiTap> &taps, int nk,
+                     float **q)
+{
+  int j, u, r, jstart, jend, nrs, ncs;
+  size_t t;
+  float x, w0, w1, w2, w3;
+  float *__restrict q0, *__restrict q1, *__restrict q2, *__restrict q3;
+  const float *p;
+
+  nrs = src.getRow();
+  ncs = src.getCol();
+  for (u=0; u<nk; u++)
+    for (j=0; j<nc1; j++)
+      q[u][j] = 0;
+
+  for (t=0; t<taps.size(); t++) {
+    r = i + oi + taps[t].m;
+    if (r < 0 || r >= nrs)
+      continue;
+    p = src.rowPtr(r,k) + oj + taps[t].n;
+    jstart = max(-(oj+taps[t].n), 0);         // keep j+n inside src
+    jend = min(ncs-(oj+taps[t].n), nc1);
+    q0 = q[taps[t].u[0]];
+    q1 = (taps[t].nk > 1) ? q[taps[t].u[1]] : 0;
+    q2 = (taps[t].nk > 2) ? q[taps[t].u[2]] : 0;
+    q3 = (taps[t].nk > 3) ? q[taps[t].u[3]] : 0;
+    w0 = taps[t].w[0];
+    w1 = taps[t].w[1];
+    w2 = taps[t].w[2];
+    w3 = taps[t].w[3];
+    switch (taps[t].nk) {
+    case 1:
+      for (j=jstart; j<jend; j++)
+        q0[j] += w0 * p[j];
+      break;
+    case 2:
+      for (j=jstart; j<jend; j++) {
+        x = p[j];
+        q0[j] += w0 * x;
+        q1[j] += w1 * x;
       }
+      break;
+    case 3:
+      for (j=jstart; j<jend; j++) {
+        x = p[j];
+        q0[j] += w0 * x;
+        q1[j] += w1 * x;
+        q2[j] += w2 * x;
+      }
+      break;
+    default:
+      for (j=jstart; j<jend; j++) {
+        x = p[j];
+        q0[j] += w0 * x;
+        q1[j] += w1 * x;
+        q2[j] += w2 * x;
+        q3[j] += w3 * x;
+      }
+    }
   }
+}
 
-  return outimg;
+
+/**
+ * Convolve an image with several masks in one pass. The masks are taken
+ * MULTI at a time: a row of the input is read once for all of them, and
+ * a tap that is 0 in all of them is skipped, so the masks of different
+ * sizes (e.g., the 1x3, 3x1 and 3x3 masks of quadratic()) cost no more
+ * than their union. The result is the one of conv() with the full masks
+ * up to rounding.
+ * @param img The input image, can be one of outs.
+ * @param masks The masks, 1 channel each.
+ * @param outs The results, one per mask, whose buffers are reused when
+ *        possible.
+ * @param border The border mode (see conv()).
+ */
+void convMulti(const Image &img, const vector<Image> &masks,
+               vector<Image> &outs, int border)
+{
+  const Image inimg = img;                 // shared, so outs can hold it
+  int u, k, nr1, nc1, nmask, ngroup, oi, oj;
+  vector<vector<MultiTap> > taps;
+  Image ext;
+
+  nr1 = inimg.getRow();
+  nc1 = inimg.getCol();
+  nmask = (int)masks.size();
+  for (u=0; u<nmask; u++)
+    if (masks[u].getChannel() > 1) {
+      cout << "convMulti: The masks cannot have more than 1 channel.\n";
+      exit(3);
+    }
+
+  const Image &src = multiSource(inimg, masks, border, ext, oi, oj);
+  outs.resize(nmask);
+  for (u=0; u<nmask; u++) {
+    outs[u].createImageUninit(nr1, nc1, inimg.getType());
+    outs[u].setMaxval(inimg.getMaxval());
+  }
+  ngroup = (nmask + MULTI - 1) / MULTI;
+  taps.resize(ngroup);
+  for (u=0; u<ngroup; u++)
+    multiTaps(masks, u*MULTI, min(MULTI, nmask - u*MULTI), taps[u]);
+
+  // the bands of rows run on separate threads
+  for (k=0; k<inimg.getChannel(); k++)
+    parallelRows(nr1, rowBand((1 + min(MULTI, nmask)) * (size_t)nc1 *
+                              sizeof(float)), [&](int i0, int i1) {
+        int i, g, u, nk;
+        float *q[MULTI];
+
+        for (i=i0; i<i1; i++)
+          for (g=0; g<ngroup; g++) {
+            nk = min(MULTI, nmask - g*MULTI);
+            for (u=0; u<nk; u++)
+              q[u] = outs[g*MULTI+u].rowPtr(i,k);
+            multiRow(src, oi, oj, i, k, nc1, taps[g], nk, q);
+          }
+      });
+}
+
+
+/**
+ * Convolve an image with a pair of gradient masks (e.g., the two masks
+ * of sobel()) in one pass, keeping only the magnitude of the gradient,
+ * sqrt(gx^2 + gy^2), and, if dir is given, its direction atan2(gy, gx).
+ * The two responses of a row are kept in a buffer of the row only.
+ */
+static void gradient(const Image &img, const Image &kx, const Image &ky,
+                     Image &mag, Image *dir, int border)
+{
+  const Image inimg = img;                 // shared, so mag can be img
+  int k, nr1, nc1, oi, oj;
+  vector<Image> masks(2);
+  vector<MultiTap> taps;
+  Image ext;
+
+  masks[0] = kx;
+  masks[1] = ky;
+  if (kx.getChannel() > 1 || ky.getChannel() > 1) {
+    cout << "convGradient: The masks cannot have more than 1 channel.\n";
+    exit(3);
+  }
+
+  nr1 = inimg.getRow();
+  nc1 = inimg.getCol();
+  const Image &src = multiSource(inimg, masks, border, ext, oi, oj);
+  multiTaps(masks, 0, 2, taps);
+  mag.createImageUninit(nr1, nc1, inimg.getType());
+  mag.setMaxval(inimg.getMaxval());
+  if (dir)
+    dir->createImageUninit(nr1, nc1, inimg.getType());
+
+  // the bands of rows run on separate threads, each with its own buffer
+  for (k=0; k<inimg.getChannel(); k++)
+    parallelRows(nr1, rowBand(4 * (size_t)nc1 * sizeof(float)),
+                 [&](int i0, int i1) {
+        int i, j;
+        float *q[2], *m, *d;
+        vector<float> gx(nc1), gy(nc1);
+
+        q[0] = gx.data();
+        q[1] = gy.data();
+        for (i=i0; i<i1; i++) {
+          multiRow(src, oi, oj, i, k, nc1, taps, 2, q);
+          m = mag.rowPtr(i,k);
+          for (j=0; j<nc1; j++)
+            m[j] = sqrt(gx[j] * gx[j] + gy[j] * gy[j]);
+          if (dir) {
+            d = dir->rowPtr(i,k);
+            for (j=0; j<nc1; j++)
+              d[j] = atan2(gy[j], gx[j]);
+          }
+        }
+      });
+}
+
+
+/**
+ * Magnitude of the gradient of an image, from a pair of masks, in one
+ * pass (see convMulti()).
+ * @param img The input image, can be mag itself.
+ * @param kx The mask of the horizontal derivative.
+ * @param ky The mask of the vertical derivative.
+ * @param mag sqrt(gx^2 + gy^2), gx and gy being the image convolved with
+ *        kx and ky.
+ * @param border The border mode (see conv()).
+ */
+void convGradient(const Image &img, const Image &kx, const Image &ky,
+                  Image &mag, int border)
+{
+  gradient(img, kx, ky, mag, 0, border);
+}
+
+
+/**
+ * Magnitude and direction of the gradient of an image, from a pair of
+ * masks, in one pass (see convMulti()).
+ * @param img The input image, can be mag or dir itself.
+ * @param kx The mask of the horizontal derivative.
+ * @param ky The mask of the vertical derivative.
+ * @param mag sqrt(gx^2 + gy^2), gx and gy being the image convolved with
+ *        kx and ky.
+ * @param dir atan2(gy, gx), in [-PI, PI].
+ * @param border The border mode (see conv()).
+ */
+void convGradient(const Image &img, const Image &kx, const Image &ky,
+                  Image &mag, Image &dir, int border)
+{
+  gradient(img, kx, ky, mag, &dir, border);
 }
@@ -15,6 +15,10 @@
  *   - 02/12/06: added quadratic variation
  *   - 02/12/06: modified laplacian() such that abs(img) is 
  *               returned instead of img
+ *   - 10/17/26: combine the edge images in one pass (lazy expressions)
+ *   - 10/17/26: add overloads that write into a given output image
+ *   - 10/17/26: apply the masks of a detector in one pass (convMulti(),
+ *               convGradient())
  **********************************************************/
 
 #include "Image.h"
@@ -22,6 +26,7 @@
 #include <iostream>
 #include <cstdlib>
 #include <cmath>
+#include <vector>
 
 using namespace std;
 
@@ -35,8 +40,22 @@ using namespace std;
  * @param inimg The input image
  * @return The edge image using the Prewitt kernels
  */
-Image prewitt(Image &inimg) {
-  Image outimg, outimg1, outimg2, mask1, mask2;
+Image prewitt(const Image &inimg) {
+  Image outimg;
+
+  prewitt(inimg, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Prewitt edge detector into outimg, whose buffer is reused if possible.
+ * @param inimg The input image, can be outimg itself
+ * @param outimg The edge image using the Prewitt kernels
+ */
+void prewitt(const Image &inimg, Image &outimg) {
+  Image mask1, mask2;
 
   // create the two masks and initialize to zero  
   mask1.createImage(3,3);
@@ -47,15 +66,9 @@ Image prewitt(Image &inimg) {
 
   mask2 = transpose(mask1);       
 
-  // apply kernel operation
-  outimg1 = conv(inimg, mask1);  // edge in the vertical direction
-  outimg2 = conv(inimg, mask2);  // edge in the horizontal direction
-  
-  // combine edges in both directions
-  Image temp = outimg1 * outimg1 + outimg2 * outimg2;
-  outimg = sqrt(temp);
-      
-  return outimg;
+  // apply kernel operation, the edges in the vertical and horizontal
+  // directions combined in the same pass
+  convGradient(inimg, mask1, mask2, outimg);
 }
  
  
@@ -67,8 +80,22 @@ Image prewitt(Image &inimg) {
  * @param inimg The input image
  * @return The edge image using the Roberts kernels
  */
-Image roberts(Image &inimg) {
-  Image outimg, outimg1, outimg2, mask1, mask2;
+Image roberts(const Image &inimg) {
+  Image outimg;
+
+  roberts(inimg, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Roberts edge detector into outimg, whose buffer is reused if possible.
+ * @param inimg The input image, can be outimg itself
+ * @param outimg The edge image using the Roberts kernels
+ */
+void roberts(const Image &inimg, Image &outimg) {
+  Image mask1, mask2;
 
   // create the mask  
   mask1.createImage(2,2);
@@ -78,15 +105,9 @@ Image roberts(Image &inimg) {
   mask2(0,1) = 1;
   mask2(1,0) = -1;
 
-  // apply kernel operation
-  outimg1 = conv(inimg, mask1);  // edge in the 135 degree direction
-  outimg2 = conv(inimg, mask2);  // edge in the 45 degree direction
-  
-  // combine edges in both directions
-  Image temp = outimg1 * outimg1 + outimg2 * outimg2;
-  outimg = sqrt(temp);
-
-  return outimg;
+  // apply kernel operation, the edges in the 135 and 45 degree
+  // directions combined in the same pass
+  convGradient(inimg, mask1, mask2, outimg);
 }
 
 
@@ -99,8 +120,22 @@ Image roberts(Image &inimg) {
  * @param inimg The input image
  * @return The edge image using the Sobel kernels
  */
-Image sobel(Image &inimg) {
-  Image outimg, outimg1, outimg2, mask1, mask2;
+Image sobel(const Image &inimg) {
+  Image outimg;
+
+  sobel(inimg, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Sobel edge detector into outimg, whose buffer is reused if possible.
+ * @param inimg The input image, can be outimg itself
+ * @param outimg The edge image using the Sobel kernels
+ */
+void sobel(const Image &inimg, Image &outimg) {
+  Image mask1, mask2;
 
   // create the masks
   mask1.createImage(3,3);
@@ -113,15 +148,9 @@ Image sobel(Image &inimg) {
 
   mask2 = transpose(mask1);
 
-  // kernel operation
-  outimg1 = conv(inimg, mask1);  // vertical edge
-  outimg2 = conv(inimg, mask2);  // horizontal edge
-  
-  // combine edges in both directions
-  Image temp = outimg1 * outimg1 + outimg2 * outimg2;
-  outimg = sqrt(temp);
-        
-  return outimg;
+  // kernel operation, the vertical and horizontal edges combined in
+  // the same pass
+  convGradient(inimg, mask1, mask2, outimg);
 }
 
 
@@ -138,8 +167,10 @@ Image sobel(Image &inimg) {
  * @param mag The magnitude of the edge.
  * @param gradient The direction of the edge.
  */
-void sobel(Image &inimg, Image &mag, Image &gradient) {
-  Image outimg, outimg1, outimg2, mask1, mask2, edge;
+void sobel(const Image &inimg, Image &mag, Image &gradient) {
+  Image outimg1, outimg2, edge;
+  vector<Image> masks(2), outs;
+  Image &mask1 = masks[0], &mask2 = masks[1];
 
   // create the masks
   mask1.createImage(3,3);
@@ -152,13 +183,13 @@ void sobel(Image &inimg, Image &mag, Image &gradient) {
 
   mask2 = transpose(mask1);
 
-  // kernel operation
-  outimg1 = conv(inimg, mask1);  // vertical edge
-  outimg2 = conv(inimg, mask2);  // horizontal edge
+  // kernel operation, both masks in one pass
+  convMulti(inimg, masks, outs);
+  outimg1 = outs[0];             // vertical edge
+  outimg2 = outs[1];             // horizontal edge
   
   // combine edges in both directions
-  Image temp = outimg1 * outimg1 + outimg2 * outimg2;
-  edge = sqrt(temp);
+  edge = sqrt(outimg1 * outimg1 + outimg2 * outimg2);    // in one pass
   
   // calculate gradient
   gradient = outimg2 / outimg1;
@@ -177,8 +208,24 @@ void sobel(Image &inimg, Image &mag, Image &gradient) {
  * When nt = 3, [-1 2 -1; 2 -4 2; -1 2 -1].
  * @return
  **********************************************************************/
-Image laplacian(Image &inimg, int nt) {
-  Image outimg, mask;
+Image laplacian(const Image &inimg, int nt) {
+  Image outimg;
+
+  laplacian(inimg, nt, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Laplacian edge detector into outimg, whose buffer is reused if
+ * possible.
+ * @param inimg The input image, can be outimg itself
+ * @param nt The type of the Laplacian mask.
+ * @param outimg The edge image
+ */
+void laplacian(const Image &inimg, int nt, Image &outimg) {
+  Image mask;
 
   // create the mask  
   mask.createImage(3,3);
@@ -201,10 +248,9 @@ Image laplacian(Image &inimg, int nt) {
     cout << "laplacian: the mask type is wrong. Choose between 1 and 3\n";
   }
    
-  outimg = conv(inimg, mask);  
-  outimg = zeroCrossing(outimg);  
-    
-  return abs(outimg);
+  conv(inimg, mask, outimg);
+  outimg = zeroCrossing(outimg);
+  outimg = abs(outimg);
 }
 
 
@@ -217,9 +263,24 @@ Image laplacian(Image &inimg, int nt) {
  * @param inimg The input image
  * @return The quadratic variation of the image
  **********************************************************************/
-Image quadratic(Image &inimg) {
-  Image qxx, qyy, qxy;
-  Image inxx, inyy, inxy;
+Image quadratic(const Image &inimg) {
+  Image outimg;
+
+  quadratic(inimg, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Quadratic edge detector into outimg, whose buffer is reused if
+ * possible.
+ * @param inimg The input image, can be outimg itself
+ * @param outimg The quadratic variation of the image
+ */
+void quadratic(const Image &inimg, Image &outimg) {
+  vector<Image> q(3), in;
+  Image &qxx = q[0], &qyy = q[1], &qxy = q[2];
 
   // create the mask  
   qxx.createImage(1,3);        // only one row is nonzero, thus a row vector
@@ -231,25 +292,11 @@ Image quadratic(Image &inimg) {
   qxy(0,0) = qxy(2,2) = -0.25;
   qxy(0,2) = qxy(2,0) = 0.25;
   
-  // calculate the convolution   
-  inxx = conv(inimg, qxx);
-//  inxx = inxx * inxx;  
-  inxx = abs(inxx);
-  inyy = conv(inimg, qyy);
-//  inyy = inyy * inyy;
-  inyy = abs(inyy);
-  inxy = conv(inimg, qxy);
-//  inxy = inxy * inxy;
-  inxy = abs(inxy);
-  inxy = inxy * 2;
-  
-  // calculate the final quadratic variation
-  // (note that because images are passed to a function using reference 
-  // but returned from a function as Image, cascading the operators wouldn't
-  // work.)
-  inxx = inxx + inyy;
-  inxx = inxx + inxy;
+  // calculate the convolution, the three masks in one pass
+  convMulti(inimg, q, in);
   
-  return inxx;
+  // calculate the final quadratic variation in one pass
+  // (|.| is used instead of the square, e.g., inxx * inxx)
+  outimg = abs(in[0]) + abs(in[1]) + abs(in[2]) * 2;
 }
 
@@ -5,6 +5,8 @@
  *   - fft: forward FFT
  *   - ifft: inverse FFT
  *   - fftifft: fast Fourier transform
+ *   - FFTPlan, fftRows, fftCols: radix-2 FFT of the rows or columns
+ *     of a complex array, used by fftifft() and conv()
  * 
  * Author: Hairong Qi (C) hqi@utk.edu
  * 
@@ -13,12 +15,17 @@
  * Modified:
  *   - 10/04/08: fix problems when phase is outside the range
  *               of [-PI, PI], by Timothy Ragland, Fall 2008
+ *   - 10/17/26: move the radix-2 FFT of conv() here as fftRows() and
+ *               fftCols(), which fftifft() now uses too
  **********************************************************/
 #include "Image.h"
 #include "Dip.h"
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
 
 using namespace std;
 
@@ -29,9 +36,11 @@ using namespace std;
  * @mag The magnitude image from the FFT.
  * @phase The phase image from the FFT.
  */
-void fft(Image &inimg, Image &mag, Image &phase)
+void fft(const Image &inimg, Image &mag, Image &phase)
 {
-  fftifft(inimg, mag, phase, 1);
+  Image temp = inimg;            // shares the pixels, only read by fftifft()
+
+  fftifft(temp, mag, phase, 1);
 }
 
 
@@ -47,6 +56,108 @@ void ifft(Image &outimg, Image &mag, Image &phase)
 }
 
 
+/**
+ * Radix-2 FFT of size n: the bit-reversed order and the twiddle factors
+ * exp(-2 pi i k/n), k < n/2.
+ * @param size The size of the transform, a power of 2.
+ */
+FFTPlan::FFTPlan(int size) : n(size), rev(size), wr(size/2), wi(size/2)
+{
+  int i, j, bit;
+
+  for (i=1, j=0; i<n; i++) {
+    for (bit=n>>1; j & bit; bit>>=1)
+      j ^= bit;
+    j |= bit;
+    rev[i] = j;
+  }
+  for (i=0; i<n/2; i++) {
+    wr[i] = (float) cos(2 * M_PI * i / n);
+    wi[i] = (float) -sin(2 * M_PI * i / n);
+  }
+}
+
+
+/**
+ * In-place FFT of each row of an nr x nc complex array (real and
+ * imaginary parts apart), the inverse (unscaled) when inv is set.
+ * @param f The plan of size nc.
+ */
+void fftRows(float *re, float *im, int nr, int nc, const FFTPlan &f, int inv)
+{
+  int i, j, k, h, step, len;
+  float *pr, *pi, tr, ti, wr, wi;
+
+  for (i=0; i<nr; i++) {
+    pr = re + (size_t)i*nc;
+    pi = im + (size_t)i*nc;
+    for (j=0; j<nc; j++)
+      if (j < f.rev[j]) {
+        swap(pr[j], pr[f.rev[j]]);
+        swap(pi[j], pi[f.rev[j]]);
+      }
+    for (len=2; len<=nc; len<<=1) {
+      h = len >> 1;
+      step = nc / len;
+      for (k=0; k<h; k++) {
+        wr = f.wr[k*step];
+        wi = inv ? -f.wi[k*step] : f.wi[k*step];
+        for (j=k; j<nc; j+=len) {
+          tr = wr * pr[j+h] - wi * pi[j+h];
+          ti = wr * pi[j+h] + wi * pr[j+h];
+          pr[j+h] = pr[j] - tr;
+          pi[j+h] = pi[j] - ti;
+          pr[j] += tr;
+          pi[j] += ti;
+        }
+      }
+    }
+  }
+}
+
+
+/**
+ * In-place FFT of each column of an nr x nc complex array. The butterflies
+ * combine whole rows, so the inner loop runs over contiguous pixels.
+ * @param f The plan of size nr.
+ */
+void fftCols(float *re, float *im, int nr, int nc, const FFTPlan &f, int inv)
+{
+  int i, j, k, h, step, len;
+  float *ar, *ai, *br, *bi, tr, ti, wr, wi;
+
+  for (i=0; i<nr; i++)
+    if (i < f.rev[i]) {
+      swap_ranges(re + (size_t)i*nc, re + (size_t)(i+1)*nc,
+                  re + (size_t)f.rev[i]*nc);
+      swap_ranges(im + (size_t)i*nc, im + (size_t)(i+1)*nc,
+                  im + (size_t)f.rev[i]*nc);
+    }
+  for (len=2; len<=nr; len<<=1) {
+    h = len >> 1;
+    step = nr / len;
+    for (k=0; k<h; k++) {
+      wr = f.wr[k*step];
+      wi = inv ? -f.wi[k*step] : f.wi[k*step];
+      for (i=k; i<nr; i+=len) {
+        ar = re + (size_t)i*nc;
+        ai = im + (size_t)i*nc;
+        br = re + (size_t)(i+h)*nc;
+        bi = im + (size_t)(i+h)*nc;
+        for (j=0; j<nc; j++) {
+          tr = wr * br[j] - wi * bi[j];
+          ti = wr * bi[j] + wi * br[j];
+          br[j] = ar[j] - tr;
+          bi[j] = ai[j] - ti;
+          ar[j] += tr;
+          ai[j] += ti;
+        }
+      }
+    }
+  }
+}
+
+
 /**
  * Fast Fourier transform (FFT)
  * @param inimg The output image from FFT.
@@ -56,28 +167,16 @@ void ifft(Image &outimg, Image &mag, Image &phase)
  */
 void fftifft(Image &inimg, Image &mag, Image &phase, int scale)
 {
-  int N, M, N2;
+  int N;
   int nr, nc;
-  int i, j, k, m, n, p, q, sign, index;
-  float *realv, *imagv;
-  float *real, *imag;            // the real and imaginary part of the fft
-  float temp1, temp2, theta;
-  int *loc;                      // the reordered index
+  int i, j, index;
+  float temp1, temp2;
+  vector<float> real, imag;      // the real and imaginary part of the fft
+  const Image &src = inimg;      // read access does not unshare the pixels
 
   nr = inimg.getRow();
   nc = inimg.getCol();
 
-  // allocate memory for real and imag
-  real = (float *) new float [nr * nc];
-  if (!real) {
-    cout << "FFTIFFT: Out of memory.\n";
-    exit(1);
-  }
-  imag = (float *) new float [nr * nc];
-  if (!imag) { 
-    cout << "FFTIFFT: Out of memory.\n";
-    exit(1);
-  }
   if (nr != nc) {
     cout << "FFTIFFT: The image has to be square and dimension power of 2. " 
          << "The current image is not square.\n";
@@ -90,119 +189,39 @@ void fftifft(Image &inimg, Image &mag, Image &phase, int scale)
   }
 
   N = nr; 
-  M = N/2;
-  N2 = (int)ceil(log((double)N)/log(2.0));
-  realv = (float *) new float [N];
-  if (!realv) {
-    cout << "FFTIFFT: Out of memory.\n";
-    exit(1);
-  }
-  imagv = (float *) new float [N];
-  if (!imagv) {
-    cout << "FFTIFFT: Out of memory.\n";
-    exit(1);
-  }
-  loc = (int *) new int [N];
-  if (!loc) {
-    cout << "FFTIFFT: Out of memory.\n";
-    exit(1);
-  }
-
-  // ordering the 1D vector for FFT
-  loc[0] = 0;
-  k = 1;
-  m = 1;
-  n = M;
-  for (i=0; i<N2; i++) {
-    for (j=0; j<pow(2.0,(double)i); j++) {
-      loc[k] = loc[k-m]+n;
-      k++;
-    }
-    m <<= 1;
-    n >>= 1;
-  }
+  real.assign((size_t)nr * nc, 0);
+  imag.assign((size_t)nr * nc, 0);
+  FFTPlan plan(N);
 
-  // 1D FFT - 2D row transform
   for (i=0; i<nr; i++) {
     for (j=0; j<nc; j++) {
-      sign = (int)pow(-1.0, (double)loc[j]);
-      if (scale == 1) {
-        realv[j] = sign * inimg(i,loc[j]);
-        imagv[j] = sign * 0;
-      }
+      index = i*nc + j;
+      if (scale == 1)           // translate image to the center
+        real[index] = ((i + j) & 1) ? -src(i,j) : src(i,j);
       else {
-        temp1 = mag(i, loc[j]);
+        temp1 = mag(i, j);
 	// to fix problems when phase is outside the range of [-PI, PI]
 	// this would occur when phases are accumulated in certain operators
 	// like convolution
 	// the following bug is found by Timothy Ragland, class of Fall 2008
 	// start fixing ...............
-	if (phase(i, loc[j]) > PI)
-	  phase(i, loc[j]) -= 2*PI;
-	if (phase(i, loc[j]) < -PI)
-	  phase(i, loc[j]) += 2*PI;
+	if (phase(i, j) > PI)
+	  phase(i, j) -= 2*PI;
+	if (phase(i, j) < -PI)
+	  phase(i, j) += 2*PI;
 	// end fixing .................
-        temp2 = tan(phase(i, loc[j]));
-        realv[j] = sqrt(temp1 * temp1 / (1+temp2*temp2));
-        if (phase(i, loc[j]) > PI/2 || phase(i, loc[j]) < -PI/2)
-          realv[j] = -realv[j];
-        imagv[j] = realv[j] * temp2;
-      }
-    }
-    for (p=0; p<N2; p++) {      // each level
-      n = (int)pow(2.0,(double)p);
-      for (q=0; q<n; q++) {
-        theta = 2 * PI * q / (float)(2*n);
-        for (k=q; k<N; k+=2*n) {
-          temp1 = realv[k+n] * cos(theta) + imagv[k+n] * sin(theta) * scale;
-          temp2 = -realv[k+n] * sin(theta) * scale + imagv[k+n] * cos(theta);
-          realv[k+n] = realv[k] - temp1;
-          realv[k] = realv[k] + temp1;
-          imagv[k+n] = imagv[k] - temp2;
-          imagv[k] = imagv[k] + temp2;
-        }
+        temp2 = tan(phase(i, j));
+        real[index] = sqrt(temp1 * temp1 / (1+temp2*temp2));
+        if (phase(i, j) > PI/2 || phase(i, j) < -PI/2)
+          real[index] = -real[index];
+        imag[index] = real[index] * temp2;
       }
     }
-    for (j=0; j<nc; j++) {
-      index = i*nc + j;
-      real[index] = realv[j];
-      imag[index] = imagv[j];
-    }    
   }
 
-  // 1D FFT - 2D column transform
-  for (j=0; j<nc; j++) {
-    for (i=0; i<nr; i++) {
-      sign = (int)pow(-1.0, (double)loc[i]);  // translate image to the center
-      if (scale == 1) {
-        realv[i] = sign * real[loc[i]*nc+j];   // reorder
-        imagv[i] = sign * imag[loc[i]*nc+j];
-      }
-      else {
-        realv[i] = real[loc[i]*nc+j];
-        imagv[i] = imag[loc[i]*nc+j];
-      }
-    }
-    for (p=0; p<N2; p++) {    
-      n = (int)pow(2.0,(double)p);
-      for (q=0; q<n; q++) {
-        theta = 2 * PI * q / (2*n);
-        for (k=q; k<N; k+=2*n) {
-          temp1 = realv[k+n] * cos(theta) + imagv[k+n] * sin(theta) * scale;
-          temp2 = -realv[k+n] * sin(theta) * scale + imagv[k+n] * cos(theta);
-          realv[k+n] = realv[k] - temp1;        // F(u+M)
-          realv[k] = realv[k] + temp1;          // F(u)
-          imagv[k+n] = imagv[k] - temp2;
-          imagv[k] = imagv[k] + temp2;
-        }
-      }
-    }
-    for (i=0; i<nr; i++) {
-      index = i*nc + j;
-      real[index] = realv[i];
-      imag[index] = imagv[i];
-    }
-  }
+  // 1D FFT - 2D row transform, then column transform
+  fftRows(&real[0], &imag[0], nr, nc, plan, scale != 1);
+  fftCols(&real[0], &imag[0], nr, nc, plan, scale != 1);
 
   for (i=0; i<nr; i++)
     for (j=0; j<nc; j++) {
@@ -216,10 +235,4 @@ void fftifft(Image &inimg, Image &mag, Image &phase, int scale)
                 imag[index]*imag[index])/(N*N);
       }
     }
-
-  delete [] realv;
-  delete [] imagv;
-  delete [] real;
-  delete [] imag;
-  delete [] loc;
 }
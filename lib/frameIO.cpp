@@ -0,0 +1,387 @@
+/**********************************************************
+ * frameIO.cpp - read and write streams of PGM/PPM frames
+ *               (see FrameIO.h)
+ *
+ *   - FrameReader: read the frames of a file, a pipe or stdin
+ *   - FrameWriter: append frames to a file, a pipe or stdout
+ *
+ * Created: 10/17/26
+ **********************************************************/
+
+#include "FrameIO.h"
+#include "PNMCodec.h"
+#include "Reduce.h"
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+using namespace std;
+
+#define FRAMEBLOCK (1 << 20)   // bytes of a stream of frames read at once
+
+
+/**
+ * Open a file of frames to be read, or stdin.
+ * @param fname The name of the file, "-" for stdin.
+ */
+FrameReader::FrameReader(char *fname) {
+  name = fname;
+  if (name == "-") {
+    fd = 0;
+    own = 0;
+  }
+  else {
+    fd = open(fname, O_RDONLY);
+    own = 1;
+    if (fd < 0) {
+      cout << "FrameReader: Can't read frames: " << fname << endl;
+      exit(1);
+    }
+  }
+  buf.resize(FRAMEBLOCK);
+  pos = len = 0;
+  count = 0;
+}
+
+/**
+ * Read the frames of an open file, e.g., a pipe; the file is not closed
+ * by the reader.
+ * @param f The file descriptor.
+ */
+FrameReader::FrameReader(int f) {
+  name = "file descriptor " + to_string(f);
+  fd = f;
+  own = 0;
+  buf.resize(FRAMEBLOCK);
+  pos = len = 0;
+  count = 0;
+}
+
+/**
+ * Close the file if it was opened by the reader.
+ */
+FrameReader::~FrameReader() {
+  if (own)
+    close(fd);
+}
+
+/**
+ * Returns the number of frames read so far.
+ * @return Number of frames.
+ */
+int FrameReader::getCount() const {
+  return count;
+}
+
+/**
+ * Read the stream until n bytes are not read yet in buf, or the stream
+ * ends.
+ * @param n The number of bytes.
+ * @return 1 if there are n bytes, 0 at the end of the stream.
+ */
+int FrameReader::fill(size_t n) {
+  ssize_t r;
+
+  if (len - pos >= n)
+    return 1;
+  if (pos > 0) {                       // move the unread bytes to the front
+    memmove(buf.data(), buf.data() + pos, len - pos);
+    len -= pos;
+    pos = 0;
+  }
+  if (buf.size() < n)
+    buf.resize(n);
+  while (len < n) {
+    r = ::read(fd, buf.data() + len, buf.size() - len);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r < 0) {
+      cout << "FrameReader: Can't read frames: " << name << endl;
+      exit(1);
+    }
+    if (r == 0)
+      return 0;
+    len += r;
+  }
+  return 1;
+}
+
+/**
+ * Copy the next n bytes of the stream. What is left after the bytes in
+ * buf, if large, is read straight to p.
+ * @param p Where to copy the bytes.
+ * @param n The number of bytes.
+ */
+void FrameReader::take(void *p, size_t n) {
+  unsigned char *q = (unsigned char *) p;
+  size_t m;
+  ssize_t r;
+
+  m = min(n, len - pos);
+  memcpy(q, buf.data() + pos, m);
+  pos += m;
+  q += m;
+  n -= m;
+  if (n >= buf.size() / 2)             // no need to go through buf
+    while (n > 0) {
+      r = ::read(fd, q, n);
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r <= 0)
+        break;
+      q += r;
+      n -= r;
+    }
+  else if (n > 0 && fill(n)) {
+    memcpy(q, buf.data() + pos, n);
+    pos += n;
+    n = 0;
+  }
+  if (n > 0) {
+    cout << "FrameReader: " << name << " ends within frame " << count + 1
+         << endl;
+    exit(1);
+  }
+}
+
+/**
+ * Read the header of the next frame. When it has the same bytes as the
+ * header of the previous frame, it is skipped without being parsed.
+ * @return 1, or 0 at the end of the stream.
+ */
+int FrameReader::header() {
+  PNMHeader h;
+  string text;
+
+  if (!fill(1))                        // the end of the stream
+    return 0;
+  if (!head.empty() && fill(head.size()) &&
+      !memcmp(buf.data() + pos, head.data(), head.size())) {
+    pos += head.size();
+    return 1;
+  }
+
+  if (!parseHeader([&](char *line) {
+                     int n = 0;
+                     char c;
+
+                     for (;;) {
+                       if (!fill(1)) {
+                         line[n] = '\0';
+                         return n > 0 ? 1 : 0;
+                       }
+                       c = buf[pos++];
+                       text += c;
+                       if (c == '\n')
+                         break;
+                       if (n < 79)
+                         line[n++] = c;
+                     }
+                     line[n] = '\0';
+                     return 1;
+                   }, h)) {
+    cout << "FrameReader: frame " << count + 1 << " of " << name
+         << " is not a PGM/PPM/PAM/PFM image\n";
+    exit(1);
+  }
+  if (h.nt != PGMRAW && h.nt != PPMRAW) {
+    cout << "FrameReader: the frames of " << name
+         << " need to be raw (P5/P6), not ASCII or packed\n";
+    exit(1);
+  }
+
+  head = text;
+  nr = h.nr;
+  nc = h.nc;
+  nt = h.nt;
+  nchan = h.nchan;
+  maxval = h.maxval;
+  scale = h.scale;
+  raw.resize((size_t)nc * nchan * sampleBytes(h));
+  wide.resize((maxval > 255) ? (size_t)nc * nchan : 0);
+  return 1;
+}
+
+/**
+ * Read the next frame into an image of pixel type T, reusing its buffer
+ * when it has the size of the frame and no other image shares it.
+ * @param img The image.
+ * @return 1, or 0 at the end of the stream.
+ */
+template <class T>
+int FrameReader::frame(BasicImage<T> &img) {
+  PNMHeader h;
+  int i, r;
+
+  if (!header())
+    return 0;
+  img.createImageUninit(nr, nc, nt);
+  img.setMaxval(maxval);
+
+  h.nr = nr;
+  h.nc = nc;
+  h.nt = nt;
+  h.nchan = nchan;
+  h.maxval = maxval;
+  h.scale = scale;
+  for (r=0; r<nr; r++) {
+    i = (scale != 0) ? nr-1-r : r;     // PFM: from the bottom row up
+    if (sizeof(T) == 1 && nchan == 1 && maxval <= 255 && scale == 0)
+      take(img.rowPtr(i), nc);         // 8-bit samples, as they are
+    else {
+      take(raw.data(), raw.size());
+      rawRow(raw.data(), h, img, i, wide.data());
+    }
+  }
+  count++;
+  return 1;
+}
+
+/**
+ * Read the next frame.
+ * @param img The frame, its buffer is reused.
+ * @return 1, or 0 at the end of the stream.
+ */
+int FrameReader::next(Image &img) {
+  return frame(img);
+}
+
+int FrameReader::next(Image8 &img) {
+  return frame(img);
+}
+
+int FrameReader::next(Image16 &img) {
+  return frame(img);
+}
+
+
+/**
+ * Create a file of frames, or write them to stdout.
+ * @param fname The name of the file, "-" for stdout.
+ */
+FrameWriter::FrameWriter(char *fname) {
+  name = fname;
+  if (name == "-") {
+    fd = 1;
+    own = 0;
+  }
+  else {
+    fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    own = 1;
+    if (fd < 0) {
+      cout << "FrameWriter: Can't write frames: " << fname << endl;
+      exit(1);
+    }
+  }
+  nr = nc = nchan = maxval = -1;
+  count = 0;
+}
+
+/**
+ * Write the frames to an open file, e.g., a pipe; the file is not closed
+ * by the writer.
+ * @param f The file descriptor.
+ */
+FrameWriter::FrameWriter(int f) {
+  name = "file descriptor " + to_string(f);
+  fd = f;
+  own = 0;
+  nr = nc = nchan = maxval = -1;
+  count = 0;
+}
+
+/**
+ * Close the file if it was opened by the writer.
+ */
+FrameWriter::~FrameWriter() {
+  if (own)
+    close(fd);
+}
+
+/**
+ * Returns the number of frames written so far.
+ * @return Number of frames.
+ */
+int FrameWriter::getCount() const {
+  return count;
+}
+
+/**
+ * Append a frame, a raw PGM or PPM image. The header is formatted again
+ * only when the size of the frames changes; the rows are converted into
+ * a buffer written every RAWBLOCK bytes, the first time with the header.
+ * @param img The frame.
+ * @param r The map of each channel done by rescale(), or 0.
+ */
+template <class T>
+void FrameWriter::frame(const BasicImage<T> &img, const RescaleMap *r) {
+  struct iovec iov[2];
+  size_t o, len;
+  int i, n, rows, bps;
+
+  if (img.getRow() != nr || img.getCol() != nc ||
+      img.getChannel() != nchan || img.getMaxval() != maxval) {
+    nr = img.getRow();
+    nc = img.getCol();
+    nchan = img.getChannel();
+    maxval = img.getMaxval();
+    head = string((nchan == 1) ? "P5\n" : "P6\n") + to_string(nc) + " " +
+           to_string(nr) + "\n" + to_string(maxval) + "\n";
+  }
+  bps = (maxval > 255) ? 2 : 1;
+  len = (size_t)nc * nchan * bps;
+  rows = max(1, (int)(RAWBLOCK / max(len, (size_t)1)));
+  if (out.size() < (size_t)min(rows, nr) * len)
+    out.resize((size_t)min(rows, nr) * len);
+  if (bps == 2)
+    row.resize((size_t)nc * nchan);
+
+  iov[0].iov_base = (void *) head.data();
+  iov[0].iov_len = head.size();
+  i = 0;
+  do {
+    o = 0;
+    for (n=0; n<rows && i<nr; n++, i++) {
+      if (bps == 1)
+        packSamples(img, i, out.data() + o, plane8, r);
+      else {
+        packSamples(img, i, row.data(), plane16, r);
+        rowStoreBE16(row.data(), out.data() + o, nc * nchan);
+      }
+      o += len;
+    }
+    iov[1].iov_base = out.data();
+    iov[1].iov_len = o;
+    writeAll(fd, iov, 2, name.c_str());
+    iov[0].iov_len = 0;
+  } while (i < nr);
+  count++;
+}
+
+/**
+ * Append a frame.
+ * @param img The frame.
+ * @param flag The rescale flag. Rescale when true.
+ */
+void FrameWriter::write(const Image &img, int flag) {
+  RescaleMap r[3];
+
+  if (flag) {
+    r[0] = r[1] = r[2] = rescaleMap(img, 0, img.getMaxval());
+    frame(img, r);
+  }
+  else
+    frame(img, (const RescaleMap *) 0);
+}
+
+void FrameWriter::write(const Image8 &img) {
+  frame(img, 0);
+}
+
+void FrameWriter::write(const Image16 &img) {
+  frame(img, 0);
+}
@@ -28,7 +28,7 @@ using namespace std;
  * @param radius The radius of the filter. 
  * @return The filtered image.
  */
-Image ideal(Image &inimg, int flag, float radius) {
+Image ideal(const Image &inimg, int flag, float radius) {
   Image outimg, filter, mag, phase;
   int nr, nc;
   double dist;
@@ -58,6 +58,7 @@ Image ideal(Image &inimg, int flag, float radius) {
 
   // inverse FFT
   outimg.createImage(nr, nc);
+  outimg.setMaxval(inimg.getMaxval());
   ifft(outimg, mag, phase);
   
   return outimg;
@@ -74,7 +75,7 @@ Image ideal(Image &inimg, int flag, float radius) {
  * @param n The exponent that controls the sharpness of the filter.
  * @return The filtered image.
  */
-Image butterworth(Image &inimg, int flag, float radius, int n) {
+Image butterworth(const Image &inimg, int flag, float radius, int n) {
   Image outimg, filter, mag, phase;
   int nr, nc;
   double dist;
@@ -104,6 +105,7 @@ Image butterworth(Image &inimg, int flag, float radius, int n) {
 
   // inverse FFT
   outimg.createImage(nr, nc);
+  outimg.setMaxval(inimg.getMaxval());
   ifft(outimg, mag, phase);
   
   return outimg;
@@ -119,7 +121,7 @@ Image butterworth(Image &inimg, int flag, float radius, int n) {
  * @param radius The radius of the filter. 
  * @return The filtered image.
  */
-Image gaussianFreq(Image &inimg, int flag, float std) {
+Image gaussianFreq(const Image &inimg, int flag, float std) {
   Image outimg, filter, mag, phase;
   int nr, nc;
   double dist;
@@ -149,6 +151,7 @@ Image gaussianFreq(Image &inimg, int flag, float std) {
 
   // inverse FFT
   outimg.createImage(nr, nc);
+  outimg.setMaxval(inimg.getMaxval());
   ifft(outimg, mag, phase);
   
   return outimg;
@@ -162,7 +165,7 @@ Image gaussianFreq(Image &inimg, int flag, float std) {
  * @param std The standard deviation of the Gaussian blur kernel.
  * @return The filtered image.
  */
-Image wiener(Image &inimg, float K, float std) {
+Image wiener(const Image &inimg, float K, float std) {
   Image outimg, filter, mag, phase;
   int nr, nc;
   double dist, blur, blur2;
@@ -191,6 +194,7 @@ Image wiener(Image &inimg, float K, float std) {
 
   // inverse FFT
   outimg.createImage(nr, nc);
+  outimg.setMaxval(inimg.getMaxval());
   ifft(outimg, mag, phase);
   
   return outimg;
@@ -202,7 +206,7 @@ Image wiener(Image &inimg, float K, float std) {
  * @param inimg The input image.
  * @return The filtered image.
  */
-Image inverseFilter(Image &inimg, float std) {
+Image inverseFilter(const Image &inimg, float std) {
   Image outimg, filter, mag, phase;
   int nr, nc;
   double dist, blur;
@@ -230,6 +234,7 @@ Image inverseFilter(Image &inimg, float std) {
 
   // inverse FFT
   outimg.createImage(nr, nc);
+  outimg.setMaxval(inimg.getMaxval());
   ifft(outimg, mag, phase);
   
   return outimg;
@@ -0,0 +1,268 @@
+/**********************************************************
+ * gemm.cpp - cache-blocked, multithreaded multiplication
+ *            of float matrices (see Gemm.h)
+ *
+ *   - gemm: c += a * b
+ *
+ * The loops follow the usual blocked scheme: for each block
+ * of NC columns and KC rows of b (packed, stays in L2/L3),
+ * for each block of MC rows of a (packed, stays in L2),
+ * an MR x NR tile of c is kept in registers by kernel()
+ * while it runs over the KC products.
+ *
+ * Created: 10/17/26
+ **********************************************************/
+
+#include "Gemm.h"
+#include "Parallel.h"
+#include <vector>
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+#if defined(__AVX__)
+#define MR 6                 // rows of the register tile
+#define NR 16                // columns of the register tile
+#elif defined(__SSE2__)
+#define MR 4
+#define NR 8
+#else
+#define MR 4
+#define NR 4
+#endif
+#define KC 256               // rows of a packed panel of b
+#define MC (MR*24)           // rows of a packed block of a
+#define NC 1024              // columns of a packed block of b
+
+#define MINWORK (1 << 22)    // multiply-adds worth starting a thread for
+
+
+/**
+ * c += a * b for one MR x NR tile of c. a holds kc groups of MR values
+ * (a column of the tile rows each) and b kc groups of NR values (a row
+ * of the tile columns each), as packed by packA() and packB().
+ * @param kc The number of products.
+ * @param a The packed panel of a.
+ * @param b The packed panel of b.
+ * @param c The top-left element of the tile.
+ * @param ldc The row pitch of c.
+ */
+static void kernel(int kc, const float *a, const float *b, float *c, int ldc) {
+  int p, r;
+
+#if defined(__AVX__)
+  __m256 acc[MR][2], b0, b1, av;
+
+#if defined(__FMA__)
+#define MADD(s, x, y) s = _mm256_fmadd_ps(x, y, s)
+#else
+#define MADD(s, x, y) s = _mm256_add_ps(s, _mm256_mul_ps(x, y))
+#endif
+  for (r=0; r<MR; r++)
+    acc[r][0] = acc[r][1] = _mm256_setzero_ps();
+  for (p=0; p<kc; p++) {
+    b0 = _mm256_loadu_ps(b);
+    b1 = _mm256_loadu_ps(b+8);
+    for (r=0; r<MR; r++) {
+      av = _mm256_broadcast_ss(a+r);
+      MADD(acc[r][0], av, b0);
+      MADD(acc[r][1], av, b1);
+    }
+    a += MR;
+    b += NR;
+  }
+#undef MADD
+  for (r=0; r<MR; r++) {
+    _mm256_storeu_ps(c+r*ldc, _mm256_add_ps(_mm256_loadu_ps(c+r*ldc),
+                                            acc[r][0]));
+    _mm256_storeu_ps(c+r*ldc+8, _mm256_add_ps(_mm256_loadu_ps(c+r*ldc+8),
+                                              acc[r][1]));
+  }
+
+#elif defined(__SSE2__)
+  __m128 acc[MR][2], b0, b1, av;
+
+  for (r=0; r<MR; r++)
+    acc[r][0] = acc[r][1] = _mm_setzero_ps();
+  for (p=0; p<kc; p++) {
+    b0 = _mm_loadu_ps(b);
+    b1 = _mm_loadu_ps(b+4);
+    for (r=0; r<MR; r++) {
+      av = _mm_set1_ps(a[r]);
+      acc[r][0] = _mm_add_ps(acc[r][0], _mm_mul_ps(av, b0));
+      acc[r][1] = _mm_add_ps(acc[r][1], _mm_mul_ps(av, b1));
+    }
+    a += MR;
+    b += NR;
+  }
+  for (r=0; r<MR; r++) {
+    _mm_storeu_ps(c+r*ldc, _mm_add_ps(_mm_loadu_ps(c+r*ldc), acc[r][0]));
+    _mm_storeu_ps(c+r*ldc+4, _mm_add_ps(_mm_loadu_ps(c+r*ldc+4), acc[r][1]));
+  }
+
+#else
+  float acc[MR][NR];
+  int q;
+
+  for (r=0; r<MR; r++)
+    for (q=0; q<NR; q++)
+      acc[r][q] = 0;
+  for (p=0; p<kc; p++) {
+    for (r=0; r<MR; r++)
+      for (q=0; q<NR; q++)
+        acc[r][q] += a[r] * b[q];
+    a += MR;
+    b += NR;
+  }
+  for (r=0; r<MR; r++)
+    for (q=0; q<NR; q++)
+      c[r*ldc+q] += acc[r][q];
+#endif
+}
+
+
+/**
+ * Copy an mc x kc block of a into panels of MR rows, each stored column
+ * by column; the rows past mc are filled with 0.
+ * @param mc The number of rows.
+ * @param kc The number of columns.
+ * @param a The top-left element of the block.
+ * @param lda The row pitch of a.
+ * @param ap The packed block.
+ */
+static void packA(int mc, int kc, const float *a, int lda, float *ap) {
+  int i, p, r, mr;
+
+  for (i=0; i<mc; i+=MR) {
+    mr = min(MR, mc-i);
+    for (p=0; p<kc; p++) {
+      for (r=0; r<mr; r++)
+        ap[r] = a[(i+r)*lda+p];
+      for (; r<MR; r++)
+        ap[r] = 0;
+      ap += MR;
+    }
+  }
+}
+
+
+/**
+ * Copy a kc x nc block of b into panels of NR columns, each stored row
+ * by row; the columns past nc are filled with 0.
+ * @param kc The number of rows.
+ * @param nc The number of columns.
+ * @param b The top-left element of the block.
+ * @param ldb The row pitch of b.
+ * @param bp The packed block.
+ */
+static void packB(int kc, int nc, const float *b, int ldb, float *bp) {
+  int j, p, q, nr;
+  const float *s;
+
+  for (j=0; j<nc; j+=NR) {
+    nr = min(NR, nc-j);
+    for (p=0; p<kc; p++) {
+      s = b + p*ldb + j;
+      for (q=0; q<nr; q++)
+        bp[q] = s[q];
+      for (; q<NR; q++)
+        bp[q] = 0;
+      bp += NR;
+    }
+  }
+}
+
+
+/**
+ * c += a * b in the calling thread.
+ * @see gemm
+ */
+static void gemmBand(int m, int n, int k,
+                     const float *a, int lda,
+                     const float *b, int ldb,
+                     float *c, int ldc) {
+  int ic, jc, pc, ir, jr, mc, nc, kc, r, q;
+  float t[MR*NR], *cp;
+
+  if (m <= 0 || n <= 0 || k <= 0)
+    return;
+
+  // the packed blocks, no larger than the matrices need
+  vector<float> ap(min(MC, (m+MR-1)/MR*MR) * min(KC, k));
+  vector<float> bp(min(KC, k) * min(NC, (n+NR-1)/NR*NR));
+
+  for (jc=0; jc<n; jc+=NC) {
+    nc = min(NC, n-jc);
+    for (pc=0; pc<k; pc+=KC) {
+      kc = min(KC, k-pc);
+      packB(kc, nc, b+pc*ldb+jc, ldb, &bp[0]);
+      for (ic=0; ic<m; ic+=MC) {
+        mc = min(MC, m-ic);
+        packA(mc, kc, a+ic*lda+pc, lda, &ap[0]);
+        for (jr=0; jr<nc; jr+=NR)
+          for (ir=0; ir<mc; ir+=MR) {
+            cp = c + (ic+ir)*ldc + jc+jr;
+            if (mc-ir >= MR && nc-jr >= NR)
+              kernel(kc, &ap[ir*kc], &bp[jr*kc], cp, ldc);
+            else {            // a partial tile at the bottom or right edge
+              fill(t, t+MR*NR, 0.0f);
+              kernel(kc, &ap[ir*kc], &bp[jr*kc], t, NR);
+              for (r=0; r<min(MR, mc-ir); r++)
+                for (q=0; q<min(NR, nc-jr); q++)
+                  cp[r*ldc+q] += t[r*NR+q];
+            }
+          }
+      }
+    }
+  }
+}
+
+
+/**
+ * Multiply two matrices, c += a * b. Large products are split into bands
+ * of rows (or of columns, when c is wider than tall), one per thread of
+ * parallelRows() (see setThreads()).
+ * @param m The number of rows of a and c.
+ * @param n The number of columns of b and c.
+ * @param k The number of columns of a and rows of b.
+ * @param a The first matrix.
+ * @param lda The row pitch of a.
+ * @param b The second matrix.
+ * @param ldb The row pitch of b.
+ * @param c The result, added to.
+ * @param ldc The row pitch of c.
+ */
+void gemm(int m, int n, int k,
+          const float *a, int lda,
+          const float *b, int ldb,
+          float *c, int ldc) {
+  double work;
+  int nt, band;
+
+  work = (double)m * n * k;
+  nt = getThreads();
+  if (work / MINWORK < nt)
+    nt = (int)(work / MINWORK);
+  if (nt <= 1) {
+    gemmBand(m, n, k, a, lda, b, ldb, c, ldc);
+    return;
+  }
+
+  if (m >= n) {
+    band = ((m + nt - 1) / nt + MR - 1) / MR * MR;
+    parallelRows(m, band, [&](int i0, int i1) {
+        gemmBand(i1-i0, n, k, a+(long)i0*lda, lda, b, ldb,
+                 c+(long)i0*ldc, ldc);
+      });
+  }
+  else {
+    band = ((n + nt - 1) / nt + NR - 1) / NR * NR;
+    parallelRows(n, band, [&](int j0, int j1) {
+        gemmBand(m, j1-j0, k, a, lda, b+j0, ldb, c+j0, ldc);
+      });
+  }
+}
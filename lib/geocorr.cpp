@@ -9,6 +9,7 @@
  *
  * Modified:
  *  - 10/07/07 by H. Qi on formatting
+ *  - 10/17/26: the result keeps the maxval of the input image
  *******************************************/
 
 #include "Image.h"
@@ -37,7 +38,7 @@ using namespace std;
  * @return outimg Corrected image
  */
 
-Image geocorr(Image &inimg){
+Image geocorr(const Image &inimg){
   Image outimg, X, Y, U, V, A, B;
   Image W, W_transpose, W_temp, W_pseudo, W_temp_inv;
   int i, x, y, k, u, v;
@@ -50,6 +51,7 @@ Image geocorr(Image &inimg){
   nchan = inimg.getChannel();
 
   outimg.createImage(nr, nc, ntype);  
+  outimg.setMaxval(inimg.getMaxval());
 
   //Create Ideal Image Coordinates Matrices
   //Using 15 tiepoints
@@ -98,7 +98,7 @@ Image houghLine(Image &inimg) {
  * @param inimg The input image is gray scale
  * @return The hough map
  */
-void houghPara(Image &inimg) {
+void houghPara(const Image &inimg) {
   Image *A, mag, gradient;
   int i, j, theta, nc, nr, nchan;
   int x0, y0;
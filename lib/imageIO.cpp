@@ -1,9 +1,14 @@
 /**********************************************************
  * imageIO.cpp - read/write image 
- *               (can only r/w PGM/PPM image so far)
+ *               (PGM/PPM, and PAM and PFM, and packed and tiled
+ *               files)
  *
  *   - readImage: read an image from a file
+ *   - readImage8: read an image from a file into 8-bit pixels
+ *   - readImage16: read an image from a file into 16-bit pixels
  *   - writeImage: write an image to a file   
+ *   - writePAM: write an image to a PAM file
+ *   - writePFM: write a float image to a PFM file, without conversion
  *   - rescale: rescale the pixel value of an image
  * 
  * Author: Hairong Qi (C) hqi@utk.edu
@@ -11,30 +16,304 @@
  * Created: 01/26/06
  *
  * Modified:
+ *   - 10/17/26: rescale() and the rescaling writers map every channel by
+ *               the minimum and maximum of the whole image, which keeps
+ *               the hue of the colors
+ *   - 10/17/26: move StripReader and StripWriter to stripIO.cpp
+ *   - 10/17/26: an ASCII file read as a stream is parsed by parseRow()
+ *               from whole lines (textRow()), and its errors reported;
+ *               the raw rows of a stream are converted by rawRow()
+ *   - 10/17/26: move writeTiled() and TiledReader to tileIO.cpp
+ *   - 10/17/26: the bands of packed and tiled files run on the threads
+ *               of parallelRows()
+ *   - 10/17/26: move FrameReader and FrameWriter to frameIO.cpp; the
+ *               conversions they share are declared in PNMCodec.h
+ *   - 10/17/26: add the tiled files (PGMTILE/PPMTILE), writeTiled() and
+ *               TiledReader
+ *   - 10/17/26: add the packed files (PGMPACK/PPMPACK), a lossless
+ *               predictive code of the samples in bands of rows, coded
+ *               and decoded by separate threads
+ *   - 10/17/26: add FrameReader and FrameWriter; the conversions of the
+ *               rows of raw files are shared (rawRow(), packSamples())
+ *   - 10/17/26: writeImage() converts the pixels, rescaled or clamped, to
+ *               the samples in one vectorized pass (rowPack()) into a
+ *               block buffer, without copying the image
+ *   - 10/17/26: read PAM (P7, depth 1 or 3) and PFM (Pf/PF) files; add
+ *               writePAM() and writePFM(); the header parsing is shared
+ *               by the mapped and the stream readers
+ *   - 10/17/26: support 16-bit (maxval > 255) PGM/PPM files; the maxval
+ *               is kept by the image and honored by writeImage() and
+ *               rescale(); add readImage16() and writeImage() of 16-bit
+ *               images
+ *   - 10/17/26: add StripReader and StripWriter
+ *   - 10/17/26: parse the ASCII formats with from_chars() over the mapped
+ *               file, and format them into a buffer written in blocks
+ *   - 10/17/26: raw PGM/PPM files are mapped in memory and converted from
+ *               the mapping; readImage8() uses the pixels of a PGM file
+ *               in place
+ *   - 10/17/26: rescale() finds the minimum and maximum in one pass and
+ *               handles color images
+ *   - 10/17/26: do not zero the images that are read or rescaled
+ *   - 10/17/26: add readImage8() and writeImage() of 8-bit images; the
+ *               PGM/PPM code is shared by all the pixel types
  *   - 07/31/09: move rescale() to this file
  **********************************************************/
 #include "Image.h"
 #include "Dip.h"
+#include "TileIO.h"
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
+#include <cstdio>
+#include <charconv>
+#include <cstring>
+#include <climits>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include "Reduce.h"
+#include "Parallel.h"
+#include "PNMCodec.h"
 
 using namespace std;
 
+#define ASCIIBLOCK (1 << 16)   // bytes formatted before each write
+#define PFMBLOCK (1 << 20)     // bytes of color PFM pixels interleaved
+                               // before each write
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define PFMSCALE 1.0           // the scale of a PFM file in native order
+#else
+#define PFMSCALE -1.0
+#endif
+
+#define PACKBAND 64            // rows of each band of a packed file
+#define PACKBLOCK 32           // residuals of a packed file coded with
+                               // the same number of bits
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
 
 /**
- * Read image from a file                     
+ * Parse the header of an image file, a line at a time.
+ * @param line Reads the next line of the header (at most 79 characters,
+ *             without the newline) into its argument, returns 0 at the
+ *             end of the file.
+ * @param h The header.
+ * @return 1 if the file is a PGM/PPM/PAM/PFM, packed or tiled file, 0
+ *         otherwise.
+ */
+int parseHeader(const function<int(char *)> &line, PNMHeader &h) {
+  char dummy[80], key[80];
+  int depth, v, pfm, pack, tiled;
+
+  h.maxval = 255;
+  h.scale = 0;
+  h.band = h.tile = h.levels = 0;
+  pfm = pack = tiled = 0;
+
+  // identify image format
+  if (!line(dummy) || dummy[0] != 'P')
+    return 0;
+  switch (dummy[1]) {
+  case '5':
+    h.nt = PGMRAW;
+    h.nchan = 1;
+    break;
+  case '6':
+    h.nt = PPMRAW;
+    h.nchan = 3;
+    break;
+  case '2':
+    h.nt = PGMASCII;
+    h.nchan = 1;
+    break;
+  case '3':
+    h.nt = PPMASCII;
+    h.nchan = 3;
+    break;
+  case 'f':                      // PFM, gray-scale
+    h.nt = PGMRAW;
+    h.nchan = 1;
+    pfm = 1;
+    break;
+  case 'F':                      // PFM, color
+    h.nt = PPMRAW;
+    h.nchan = 3;
+    pfm = 1;
+    break;
+  case 'z':                      // packed, gray-scale
+    h.nt = PGMPACK;
+    h.nchan = 1;
+    pack = 1;
+    break;
+  case 'Z':                      // packed, color
+    h.nt = PPMPACK;
+    h.nchan = 3;
+    pack = 1;
+    break;
+  case 't':                      // tiled, gray-scale
+    h.nt = PGMTILE;
+    h.nchan = 1;
+    tiled = 1;
+    break;
+  case 'T':                      // tiled, color
+    h.nt = PPMTILE;
+    h.nchan = 3;
+    tiled = 1;
+    break;
+  case '7':                      // PAM, KEY value lines up to ENDHDR
+    h.nr = h.nc = depth = -1;
+    while (line(dummy) && strncmp(dummy, "ENDHDR", 6))
+      if (sscanf(dummy, "%79s %d", key, &v) == 2) {
+        if (!strcmp(key, "WIDTH"))
+          h.nc = v;
+        else if (!strcmp(key, "HEIGHT"))
+          h.nr = v;
+        else if (!strcmp(key, "DEPTH"))
+          depth = v;
+        else if (!strcmp(key, "MAXVAL"))
+          h.maxval = v;
+      }
+    if (h.nr < 0 || h.nc < 0)
+      return 0;
+    if (depth != 1 && depth != 3) {
+      cout << "readImage: PAM files of depth " << depth
+           << " are not supported, only 1 or 3\n";
+      exit(3);
+    }
+    h.nt = (depth == 1) ? PGMRAW : PPMRAW;
+    h.nchan = depth;
+    if (h.maxval < 1 || h.maxval > 65535)
+      h.maxval = 255;
+    return 1;
+  default:
+    return 0;
+  }
+
+  // skip the comments
+  do
+    if (!line(dummy))
+      return 0;
+  while (dummy[0] == '#');
+
+  // read the row number and column number
+  if (sscanf(dummy, "%d %d", &h.nc, &h.nr) != 2 || h.nc < 0 || h.nr < 0)
+    return 0;
+
+  // read the maximum pixel value, or the scale of a PFM file
+  if (!line(dummy))
+    return 0;
+  if (pfm) {
+    if (sscanf(dummy, "%f", &h.scale) != 1 || h.scale == 0)
+      return 0;
+  }
+  else if (sscanf(dummy, "%d", &h.maxval) != 1 || h.maxval < 1 ||
+           h.maxval > 65535)
+    h.maxval = 255;
+
+  // read the rows of a band of a packed file
+  if (pack && (!line(dummy) || sscanf(dummy, "%d", &h.band) != 1 ||
+               h.band < 1))
+    return 0;
+
+  // read the size of the tiles and the number of levels of a tiled file
+  if (tiled && (!line(dummy) ||
+                sscanf(dummy, "%d %d", &h.tile, &h.levels) != 2 ||
+                h.tile < 1 || h.levels < 1 || h.levels > 31))
+    return 0;
+
+  return 1;
+}
+
+
+/**
+ * Read the header of an image file through a stream.
+ * @param ifp The stream, left at the first pixel.
+ * @param h The header.
+ * @return 1 if the file is a PGM/PPM/PAM/PFM file, 0 otherwise.
+ */
+static int readHeader(ifstream &ifp, PNMHeader &h) {
+  return parseHeader([&](char *line) {
+                       return ifp.getline(line, 80, '\n') ? 1 : 0;
+                     }, h);
+}
+
+
+/**
+ * The number of bytes of a sample of a raw file: 4 for PFM, 2 when
+ * maxval > 255.
+ */
+int sampleBytes(const PNMHeader &h) {
+  if (h.scale != 0)
+    return 4;
+  return (h.maxval > 255) ? 2 : 1;
+}
+
+
+/**
+ * Convert row i of an image from a row of a PFM file, floats in the
+ * native byte order or not, interleaved for color images.
+ * @param s The row of the file.
+ * @param swap 1 if the byte order of the file is not the native one.
+ * @param img The image.
+ * @param i The row of the image.
+ */
+template <class T>
+static void floatRow(const unsigned char *s, int swap, BasicImage<T> &img,
+                     int i) {
+  unsigned int u;
+  float f;
+  T *q;
+  int j, k, nc, nchan;
+
+  nc = img.getCol();
+  nchan = img.getChannel();
+  for (k=0; k<nchan; k++) {
+    q = img.rowPtr(i,k);
+    for (j=0; j<nc; j++) {
+      memcpy(&u, s + 4*(j*nchan+k), 4);
+      if (swap)
+        u = __builtin_bswap32(u);
+      memcpy(&f, &u, 4);
+      q[j] = pixelCast<T>(f);
+    }
+  }
+}
+
+static void floatRow(const unsigned char *s, int swap, Image &img, int i) {
+  if (!swap && img.getChannel() == 1)  // the row as is
+    memcpy(img.rowPtr(i), s, (size_t)img.getCol() * sizeof(float));
+  else
+    floatRow<float>(s, swap, img, i);
+}
+
+
+template <class T>                     // decode a packed file (see below)
+static void unpackImage(const unsigned char *p, size_t bytes,
+                        const PNMHeader &h, BasicImage<T> &img,
+                        const char *fname);
+
+/**
+ * Read image from a file into an image of pixel type T, through a stream.
+ * Used for the files that cannot be mapped.
  * @param fname The name of the file 
- * @return An Image object
+ * @return An image object
  */
-Image readImage(char *fname) {
+template <class T>
+static BasicImage<T> readPNMStream(char *fname) {
   ifstream ifp;
-  char dummy[80];
-  unsigned char *img;
-  int i, j, k;
-  int tmp;
-  Image outimg;
-  int nr, nc, nt, nchan, maxi;
+  size_t len;
+  int i, bps;
+  BasicImage<T> outimg;
+  int nr, nc, nt, nchan;
+  PNMHeader h;
 
   ifp.open(fname, ios::in | ios::binary);
 
@@ -43,88 +322,898 @@ Image readImage(char *fname) {
     exit(1);
   }
 
-  // identify image format
-  ifp.getline(dummy, 80, '\n');
+  if (!readHeader(ifp, h)) {
+    cout << "readImage: Can't identify image format." << endl;
+    exit(1);
+  }
+  nr = h.nr;
+  nc = h.nc;
+  nt = h.nt;
+  nchan = h.nchan;
+  bps = sampleBytes(h);                // bytes per sample
+
+  // create the image
+  outimg.createImageUninit(nr, nc, nt);
+  outimg.setMaxval(h.maxval);
 
-  if (dummy[0] == 'P' && dummy[1] == '5') {
-    nt = PGMRAW;
-    nchan = 1;
+  if (nt == PGMTILE || nt == PPMTILE) {
+    cout << "readImage: the tiles of " << fname
+         << " are read from a mapping, it cannot be read as a stream\n";
+    exit(1);
   }
-  else if (dummy[0] == 'P' && dummy[1] == '6') {
-    nt = PPMRAW;
-    nchan = 3;
+
+  // a packed file is read whole, then decoded
+  if (nt == PGMPACK || nt == PPMPACK) {
+    vector<unsigned char> data((istreambuf_iterator<char>(ifp)),
+                               istreambuf_iterator<char>());
+    ifp.close();
+    unpackImage(data.data(), data.size(), h, outimg, fname);
+    return outimg;
   }
-  else if (dummy[0] == 'P' && dummy[1] == '2') {
-    nt = PGMASCII;
-    nchan = 1;
+
+  // the raw rows are read and converted one at a time, by rawRow() as
+  // from a mapping (PFM: stored from the bottom row up)
+  if (h.scale != 0 || nt == PGMRAW || nt == PPMRAW) {
+    len = (size_t)nc * nchan * bps;
+    vector<unsigned char> raw(len);
+    vector<unsigned short> wide((h.maxval > 255) ? (size_t)nc * nchan : 0);
+    for (i=0; i<nr; i++) {
+      ifp.read((char *)raw.data(), len);
+      if ((size_t)ifp.gcount() < len) {
+        cout << "readImage: " << fname << " is truncated\n";
+        exit(1);
+      }
+      rawRow(raw.data(), h, outimg, (h.scale != 0) ? nr-1-i : i,
+             wide.data());
+    }
   }
-  else if (dummy[0] == 'P' && dummy[1] == '3') {
-    nt = PPMASCII;
-    nchan = 3;
+  else {   // ASCII formats, parsed from whole lines
+    PNMText t;
+    for (i=0; i<nr; i++)
+      textRow(ifp, t, outimg, i, fname);
   }
-  else 
-    cout << "readImage: Can't identify image format." << endl;
 
-  // skip the comments
-  ifp.getline(dummy, 80, '\n');
+  ifp.close();
+  
+  return outimg;
+}
+
+
+/**
+ * Copy a line of the header like getline() does, at most 79 characters.
+ * @param p The start of the line.
+ * @param end The end of the file.
+ * @param line The line, without the newline.
+ * @return The start of the next line.
+ */
+static const char *headerLine(const char *p, const char *end, char *line) {
+  int n = 0;
 
-  while (dummy[0] == '#') {
-    ifp.getline(dummy, 80, '\n');
+  while (p < end && *p != '\n') {
+    if (n < 79)
+      line[n++] = *p;
+    p++;
   }
+  line[n] = '\0';
 
-  // read the row number and column number
-  sscanf(dummy, "%d %d", &nc, &nr);
+  return (p < end) ? p+1 : p;
+}
 
-  // read the maximum pixel value
-  ifp.getline(dummy, 80, '\n');
-  sscanf(dummy, "%d", &maxi); 
 
-  // create the image
-  outimg.createImage(nr, nc, nt);
+/**
+ * Map a PGM/PPM/PAM/PFM image file in memory. The mapping is private, so the
+ * pixels of a raw file can be read, or even modified, without copying
+ * the file.
+ * @param fname The name of the file.
+ * @param m The mapping and the header of the file.
+ * @return 1 if mapped, 0 if the file is not an image file or cannot
+ *         be mapped (e.g., a pipe); it is then read as a stream.
+ */
+int mapPNM(char *fname, PNMMap &m) {
+  struct stat st;
+  const char *p, *end;
+  int fd;
+
+  fd = open(fname, O_RDONLY);
+  if (fd < 0)                    // readPNMStream() reports the error
+    return 0;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < 2) {
+    close(fd);
+    return 0;
+  }
+  m.bytes = st.st_size;
+  m.map = mmap(0, m.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (m.map == MAP_FAILED)
+    return 0;
+
+  // read the header
+  p = (const char *) m.map;
+  end = p + m.bytes;
+  if (!parseHeader([&](char *line) {
+                     if (p >= end)
+                       return 0;
+                     p = headerLine(p, end, line);
+                     return 1;
+                   }, m)) {
+    munmap(m.map, m.bytes);
+    return 0;
+  }
 
-  // read the image data
-  img = (unsigned char *) new unsigned char [nr * nc * nchan];
-  if (!img) {
-    cout << "READIMAGE: Out of memory.\n";
+  if ((m.nt == PGMRAW || m.nt == PPMRAW) &&
+      (size_t)(end - p) < (size_t)m.nr * m.nc * m.nchan * sampleBytes(m)) {
+    cout << "readImage: " << fname << " is truncated\n";
     exit(1);
   }
+  m.pixels = (unsigned char *) p;
 
-  // added capability to process ASCII format as well
-  if (nt == PGMRAW || nt == PPMRAW) {
-    ifp.read((char *)img, (nr * nc * nchan * sizeof(unsigned char)));
-    for (i=0; i<nr; i++)
-      for (j=0; j<nc; j++)
-        for (k=0; k<nchan; k++)
-          outimg(i,j,k) = (float)img[(i*nc+j)*nchan+k];
+  return 1;
+}
+
+
+/**
+ * Convert a row of 8-bit pixels to the pixel type T.
+ */
+template <class T>
+static void copyRow(const unsigned char *s, T *q, int n) {
+  int j;
+
+  for (j=0; j<n; j++)
+    q[j] = (T)s[j];
+}
+
+static void copyRow(const unsigned char *s, float *q, int n) {
+  rowWiden(s, q, n);
+}
+
+
+/**
+ * Convert a row of 16-bit pixels to the pixel type T.
+ */
+template <class T>
+static void copyRow(const unsigned short *s, T *q, int n) {
+  int j;
+
+  for (j=0; j<n; j++)
+    q[j] = pixelCast<T>(s[j]);
+}
+
+static void copyRow(const unsigned short *s, float *q, int n) {
+  rowWiden(s, q, n);
+}
+
+
+/**
+ * Parse one row of pixels of an ASCII file in memory.
+ * @param p The text of the row.
+ * @param end The end of the file.
+ * @param q The row of each channel.
+ * @param nc The number of columns.
+ * @param nchan The number of channels.
+ * @param fname The name of the file.
+ * @return The text after the row.
+ */
+template <class T>
+static const char *parseRow(const char *p, const char *end, T **q,
+                            int nc, int nchan, const char *fname) {
+  from_chars_result r;
+  int j, k, tmp;
+
+  for (j=0; j<nc; j++)
+    for (k=0; k<nchan; k++) {
+      while (p < end && (*p == ' ' || (*p >= '\t' && *p <= '\r') ||
+                         *p == '#'))
+        if (*p == '#')
+          while (p < end && *p != '\n')
+            p++;
+        else
+          p++;
+      r = from_chars(p, end, tmp);
+      if (r.ec != errc()) {
+        cout << "readImage: " << fname 
+             << " is truncated or has a bad pixel value\n";
+        exit(1);
+      }
+      p = r.ptr;
+      q[k][j] = pixelCast<T>(tmp);
+    }
+
+  return p;
+}
+
+
+/**
+ * Parse the pixels of a mapped ASCII file. The values are separated by
+ * white space, and comments (from # to the end of the line) are skipped.
+ * @param m The mapped file.
+ * @param outimg The image, of the size of the file.
+ * @param fname The name of the file.
+ */
+template <class T>
+static void parseASCII(PNMMap &m, BasicImage<T> &outimg, char *fname) {
+  const char *p, *end;
+  int i;
+
+  p = (const char *) m.pixels;
+  end = (const char *) m.map + m.bytes;
+  for (i=0; i<m.nr; i++)
+    p = textRow(p, end, outimg, i, fname);
+}
+
+
+/**
+ * Parse row i of an ASCII file in memory.
+ * @param p The text of the row.
+ * @param end The end of the file.
+ * @param img The image, of the size of the file.
+ * @param i The row of the image.
+ * @param fname The name of the file.
+ * @return The text after the row.
+ */
+template <class T>
+const char *textRow(const char *p, const char *end, BasicImage<T> &img,
+                    int i, const char *fname) {
+  T *q[3];
+  int k;
+
+  for (k=0; k<img.getChannel(); k++)
+    q[k] = img.rowPtr(i,k);
+  return parseRow(p, end, q, img.getCol(), img.getChannel(), fname);
+}
+
+#define TEXTROWOF(T)                                                      \
+  template const char *textRow(const char *, const char *,                \
+                               BasicImage<T> &, int, const char *);       \
+  template void textRow(istream &, PNMText &, BasicImage<T> &, int,      \
+                        const char *)
+
+
+/**
+ * Parse row i of an ASCII file read as a stream. Whole lines are read
+ * into the text of t until it holds the values of the row, so that no
+ * value or comment is cut, and parseRow() takes them from there.
+ * @param ifp The stream, after the header.
+ * @param t The text read and not parsed yet (empty at the first row).
+ * @param img The image, of the size of the file.
+ * @param i The row of the image.
+ * @param fname The name of the file.
+ */
+template <class T>
+void textRow(istream &ifp, PNMText &t, BasicImage<T> &img, int i,
+             const char *fname) {
+  string line;
+  const char *p;
+  size_t need, j;
+  int in;
+
+  need = (size_t)img.getCol() * img.getChannel();
+  if (t.pos > t.text.size() / 2) {     // drop the text parsed
+    t.text.erase(0, t.pos);
+    t.pos = 0;
   }
-  else {   // ASCII formats
-    for (i=0; i<nr; i++)
+  while (t.avail < need) {
+    if (!getline(ifp, line)) {
+      cout << "readImage: " << fname << " is truncated\n";
+      exit(1);
+    }
+    in = 0;                            // count the values, up to a comment
+    for (j=0; j<line.size() && line[j] != '#'; j++)
+      if (line[j] == ' ' || (line[j] >= '\t' && line[j] <= '\r'))
+        in = 0;
+      else if (!in) {
+        in = 1;
+        t.avail++;
+      }
+    t.text += line;
+    t.text += '\n';
+  }
+
+  p = textRow(t.text.data() + t.pos, t.text.data() + t.text.size(), img, i,
+              fname);
+  t.pos = p - t.text.data();
+  t.avail -= need;
+}
+
+TEXTROWOF(float);
+TEXTROWOF(unsigned char);
+TEXTROWOF(unsigned short);
+
+
+/**
+ * Convert a row of 8 or 16-bit samples, interleaved for color images, to
+ * row i of an image of pixel type T.
+ * @param s The samples.
+ * @param img The image.
+ * @param i The row of the image.
+ */
+template <class S, class T>
+static void splitRow(const S *s, BasicImage<T> &img, int i) {
+  T *q;
+  int j, k, nc, nchan;
+
+  nc = img.getCol();
+  nchan = img.getChannel();
+  if (nchan == 1)
+    copyRow(s, img.rowPtr(i), nc);
+  else
+    for (k=0; k<nchan; k++) {          // PPM: split the channels
+      q = img.rowPtr(i,k);
       for (j=0; j<nc; j++)
-        for (k=0; k<nchan; k++) {
-          ifp >> tmp;
-          outimg(i,j,k) = (float)tmp;
-        }
+        q[j] = pixelCast<T>((int)s[j*nchan+k]);
+    }
+}
+
+
+/**
+ * Convert a row of a raw file (PGM/PPM/PAM with 8 or 16-bit samples, or
+ * PFM) to row i of an image of pixel type T.
+ * @param s The row of the file, interleaved for color images.
+ * @param h The header of the file.
+ * @param img The image.
+ * @param i The row of the image.
+ * @param wide Room for a row of 16-bit samples, when maxval > 255.
+ */
+template <class T>
+void rawRow(const unsigned char *s, const PNMHeader &h, BasicImage<T> &img,
+            int i, unsigned short *wide) {
+  if (h.scale != 0)                    // PFM
+    floatRow(s, (h.scale > 0) != (PFMSCALE > 0), img, i);
+  else if (h.maxval > 255) {           // 16-bit samples
+    rowLoadBE16(s, wide, h.nc * h.nchan);
+    splitRow(wide, img, i);
   }
+  else
+    splitRow(s, img, i);
+}
 
-  ifp.close();
-  delete [] img;
-  
+template void rawRow(const unsigned char *, const PNMHeader &, Image &,
+                     int, unsigned short *);
+template void rawRow(const unsigned char *, const PNMHeader &, Image8 &,
+                     int, unsigned short *);
+template void rawRow(const unsigned char *, const PNMHeader &, Image16 &,
+                     int, unsigned short *);
+
+
+static inline void storeLE32(unsigned char *p, uint32_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap32(v);
+#endif
+  memcpy(p, &v, 4);
+}
+
+
+/**
+ * Decode rows i0 to i1-1 of a packed file, a band coded on its own, into
+ * an image of pixel type T. The residuals of a row, of the samples
+ * interleaved for color images, come in blocks of PACKBLOCK: the bit
+ * width of the block (a byte), then the residuals, zigzag coded (0, -1,
+ * 1, -2, ... to 0, 1, 2, 3, ...) in that many bits each, least
+ * significant first. A sample is its residual plus the gradient
+ * prediction a + b - c from the samples of its channel on the left (a),
+ * above (b) and above on the left (c), 0 outside the band, all modulo
+ * 2^8 or 2^16. The widths are fixed within a block, so that the
+ * residuals are found without decoding the ones before.
+ * @param s The band, followed by 8 zero bytes.
+ * @param len The number of bytes of the band.
+ * @param img The image.
+ * @param i0 The first row of the band.
+ * @param i1 The row after the band.
+ * @param fname The name of the file.
+ */
+template <class S, class T>
+void unpackBand(const unsigned char *s, size_t len, BasicImage<T> &img,
+                int i0, int i1, const char *fname) {
+  const unsigned char *end;
+  unsigned int e, ones;
+  int i, t, u, c, k, w, n, nchan, bits;
+  S a;
+
+  nchan = img.getChannel();
+  n = img.getCol() * nchan;
+  bits = 8 * sizeof(S);
+  vector<S> rows(2 * ((size_t)n + nchan));   // 0 before each row
+  S *cur = rows.data() + nchan, *up = cur + n + nchan;
+
+  end = s + len - 8;
+  for (i=i0; i<i1; i++) {
+    for (t=0; t<n; t+=PACKBLOCK) {
+      c = min(PACKBLOCK, n-t);
+      if (s >= end || (w = *s++) > bits || s + (c*w + 7) / 8 > end) {
+        cout << "readImage: " << fname << " is truncated or corrupt\n";
+        exit(1);
+      }
+      ones = (1u << w) - 1;
+      for (u=0; u<c; u++) {            // b - c plus the residual
+        e = (unsigned int)(loadLE64(s + (u*w >> 3)) >> (u*w & 7)) & ones;
+        cur[t+u] = (S)(up[t+u] - up[t+u-nchan] + ((e >> 1) ^ -(e & 1)));
+      }
+      s += (c*w + 7) / 8;
+    }
+    for (k=0; k<nchan; k++)            // plus a, the sum along the row
+      for (a=0, t=k; t<n; t+=nchan)
+        cur[t] = a = (S)(a + cur[t]);
+    splitRow(cur, img, i);
+    swap(cur, up);
+  }
+}
+
+
+#define UNPACKBANDOF(S, T)                                                  \
+  template void unpackBand<S>(const unsigned char *, size_t,              \
+                              BasicImage<T> &, int, int, const char *)
+UNPACKBANDOF(unsigned char, float);
+UNPACKBANDOF(unsigned char, unsigned char);
+UNPACKBANDOF(unsigned char, unsigned short);
+UNPACKBANDOF(unsigned short, float);
+UNPACKBANDOF(unsigned short, unsigned char);
+UNPACKBANDOF(unsigned short, unsigned short);
+
+
+/**
+ * Run f(b) for the bands b = 0 to n-1 of a packed or tiled file, on the
+ * threads of parallelRows() (see setThreads()), a band at a time.
+ */
+void eachBand(int n, const function<void(int)> &f) {
+  parallelRows(n, 1, [&](int b0, int b1) {
+      int b;
+
+      for (b=b0; b<b1; b++)
+        f(b);
+    });
+}
+
+/**
+ * Decode the raster of a packed file (PGMPACK/PPMPACK): the sizes of its
+ * bands, 8 bytes each, then the bands, decoded by separate threads.
+ * @param p The raster.
+ * @param bytes Its size.
+ * @param h The header of the file.
+ * @param img The image, of the size of the file.
+ * @param fname The name of the file.
+ */
+template <class T>
+static void unpackImage(const unsigned char *p, size_t bytes,
+                        const PNMHeader &h, BasicImage<T> &img,
+                        const char *fname) {
+  size_t len;
+  int b, nb;
+
+  nb = (h.nr + h.band - 1) / h.band;
+  vector<size_t> start(nb + 1);
+  start[0] = 8 * (size_t)nb;
+  for (b=0; b<nb && start[b] <= bytes; b++) {
+    len = loadLE64(p + 8*b);
+    start[b+1] = (len >= 8 && len <= bytes) ? start[b] + len : bytes + 1;
+  }
+  if (start[b] > bytes) {
+    cout << "readImage: " << fname << " is truncated or corrupt\n";
+    exit(1);
+  }
+
+  eachBand(nb, [&](int b) {
+      int i0 = b * h.band, i1 = min(h.nr, i0 + h.band);
+
+      if (h.maxval > 255)
+        unpackBand<unsigned short>(p + start[b], start[b+1] - start[b],
+                                   img, i0, i1, fname);
+      else
+        unpackBand<unsigned char>(p + start[b], start[b+1] - start[b],
+                                  img, i0, i1, fname);
+    });
+}
+
+
+
+/**
+ * Read the pixels of a mapped file into an image of pixel type T, then
+ * unmap the file. The pixels are converted straight from the mapping.
+ * @param m The mapped file.
+ * @param fname The name of the file.
+ * @return An image object
+ */
+template <class T>
+static BasicImage<T> readMapped(PNMMap &m, char *fname) {
+  BasicImage<T> outimg;
+  size_t len;
+  int i;
+
+  madvise(m.map, m.bytes, MADV_SEQUENTIAL);
+  outimg.createImageUninit(m.nr, m.nc, m.nt);
+  outimg.setMaxval(m.maxval);
+
+  if (m.nt == PGMASCII || m.nt == PPMASCII) {
+    parseASCII(m, outimg, fname);
+    munmap(m.map, m.bytes);
+    return outimg;
+  }
+  if (m.nt == PGMPACK || m.nt == PPMPACK) {
+    unpackImage(m.pixels, (unsigned char *) m.map + m.bytes - m.pixels, m,
+                outimg, fname);
+    munmap(m.map, m.bytes);
+    return outimg;
+  }
+  if (m.nt == PGMTILE || m.nt == PPMTILE) {   // level 0, all the tiles
+    munmap(m.map, m.bytes);
+    if (m.nr > 0 && m.nc > 0) {
+      TiledReader in(fname);
+      in.read(outimg, 0, 0, m.nr, m.nc);
+      outimg.setType(m.nt);
+    }
+    return outimg;
+  }
+
+  // the rows of a PFM file are stored from the bottom row up
+  vector<unsigned short> wide((m.maxval > 255) ?
+                             (size_t)m.nc * m.nchan : 0);
+  len = (size_t)m.nc * m.nchan * sampleBytes(m);
+  for (i=0; i<m.nr; i++)
+    rawRow(m.pixels + (m.scale != 0 ? m.nr-1-i : i) * len, m, outimg, i,
+           wide.data());
+
+  munmap(m.map, m.bytes);
   return outimg;
 }
 
 
 /**
- * Write image buffer to a file.
- * @param inimg The image to be output.
+ * Read image from a file into an image of pixel type T
+ * @param fname The name of the file 
+ * @return An image object
+ */
+template <class T>
+static BasicImage<T> readPNM(char *fname) {
+  PNMMap m;
+
+  if (!mapPNM(fname, m))
+    return readPNMStream<T>(fname);
+  return readMapped<T>(m, fname);
+}
+
+
+/**
+ * Read image from a file                     
+ * @param fname The name of the file 
+ * @return An Image object
+ */
+Image readImage(char *fname) {
+  return readPNM<float>(fname);
+}
+
+
+/**
+ * Read image from a file into an 8-bit image, the pixels are never
+ * widened to float. The pixels of a raw 8-bit PGM file are not copied:
+ * the image uses them in a private mapping of the file, which costs
+ * nothing but the page cache and is unmapped with the last image using
+ * it. Such an image has the layout of the file, not the one of
+ * allocate(): its rows follow each other (the row pitch is the width)
+ * and start wherever the header ends, like the rows of a view. The pages
+ * written to are copied by the system, the file is never changed; an
+ * image sharing the pixels gets its own copy, with aligned and padded
+ * rows, when it is modified. The pixels of other files are copied.
+ * Convert to float (Image(img8)) only where an algorithm needs it.
+ * @param fname The name of the file 
+ * @return An Image8 object
+ */
+Image8 readImage8(char *fname) {
+  Image8 outimg;
+  ImageBuffer *b;
+  PNMMap m;
+
+  if (!mapPNM(fname, m))
+    return readPNMStream<unsigned char>(fname);
+  if (m.nt != PGMRAW ||          // the channels need to be split, the
+      m.maxval > 255 ||          // text parsed or the samples narrowed
+      m.scale != 0)
+    return readMapped<unsigned char>(m, fname);
+
+  b = new ImageBuffer;
+  b->refs = 1;
+  b->bytes = (size_t)m.nr * m.nc;
+  b->pool = 0;
+  b->map = m.map;
+  b->mapBytes = m.bytes;
+  outimg.useBuffer(b, m.pixels, m.nr, m.nc, PGMRAW, m.nc);
+  outimg.setMaxval(m.maxval);
+
+  return outimg;
+}
+
+
+/**
+ * Read image from a file into a 16-bit image, e.g., a PGM/PPM file with
+ * a maximum value above 255; the maximum value is kept by the image.
+ * @param fname The name of the file 
+ * @return An Image16 object
+ */
+Image16 readImage16(char *fname) {
+  return readPNM<unsigned short>(fname);
+}
+
+
+/**
+ * The map of the pixels done by rescale(), the same for every channel so
+ * that the colors keep their hue. The minimum and maximum over all the
+ * channels are clamped to [0, maxval+1] as getMaximum() and getMinimum()
+ * do for 8 bits.
+ * @param inimg The input image.
+ * @param a The lower bound.
+ * @param b The upper bound.
+ * @return The map.
+ */
+RescaleMap rescaleMap(const Image &inimg, float a, float b) {
+  RescaleMap r;
+  float maxi, mini;
+  int maxval;
+
+  // get the maximum and minimum of the image in one pass
+  maxval = inimg.getMaxval();
+  inimg.getMinMax(mini, maxi);
+  if (!(maxi > 0))
+    maxi = 0;
+  if (!(mini < maxval + 1))
+    mini = maxval + 1;
+
+  if (maxi == mini) {                  // every pixel to a or b
+    r.m = r.c = r.d = 0;
+    r.a = (maxi <= 0.0) ? a : b;
+  }
+  else {
+    r.m = mini;
+    r.c = b - a;
+    r.d = maxi - mini;
+    r.a = a;
+  }
+  return r;
+}
+
+
+/**
+ * Convert a row of integer pixels to samples clamped to [0, maxv]. They
+ * are never rescaled, so there is no map.
+ * @param p The pixels.
+ * @param q The samples.
+ * @param n The number of pixels.
+ * @param maxv The largest sample.
+ */
+template <class T, class S>
+static void packRow(const T *p, S *q, int n, int maxv, const RescaleMap *) {
+  int j;
+
+  for (j=0; j<n; j++)
+    q[j] = (S)min(pixelCast<unsigned short>(p[j]), (unsigned short)maxv);
+}
+
+/**
+ * Convert a row of float pixels to samples, through the map done by
+ * rescale() if there is one, or else clamped to [0, maxv].
+ * @param r The map of the pixels, or 0.
+ */
+template <class S>
+static void packRow(const float *p, S *q, int n, int maxv,
+                    const RescaleMap *r) {
+  if (r)
+    rowPack(p, q, n, maxv, r->m, r->c, r->d, r->a);
+  else
+    rowPack(p, q, n, maxv);
+}
+
+
+/**
+ * Convert a row of the channels of a color image to interleaved samples.
+ * @param temp The image.
+ * @param i The row.
+ * @param plane The samples of each channel, one after the other.
+ * @param q The interleaved samples.
+ * @param r The map of each channel done by rescale(), or 0.
+ */
+template <class T, class S>
+static void packColor(const BasicImage<T> &temp, int i, S *plane, S *q,
+                      const RescaleMap *r) {
+  int j, k, nc, nchan;
+
+  nc = temp.getCol();
+  nchan = temp.getChannel();
+  for (k=0; k<nchan; k++)
+    packRow(temp.rowPtr(i,k), plane + k*nc, nc, temp.getMaxval(),
+            r ? r+k : 0);
+  for (j=0; j<nc; j++)
+    for (k=0; k<nchan; k++)
+      q[j*nchan+k] = plane[k*nc+j];
+}
+
+
+/**
+ * Convert row i of an image to samples clamped to [0, maxval], where
+ * maxval is the maximum value of the image, interleaved for color images.
+ * @param img The image.
+ * @param i The row.
+ * @param q The samples.
+ * @param plane Room for the samples of each channel of the row.
+ * @param r The map of each channel done by rescale(), or 0.
+ */
+template <class T, class S>
+void packSamples(const BasicImage<T> &img, int i, S *q, vector<S> &plane,
+                 const RescaleMap *r) {
+  if (img.getChannel() == 1)
+    packRow(img.rowPtr(i), q, img.getCol(), img.getMaxval(), r);
+  else {
+    plane.resize((size_t)img.getCol() * img.getChannel());
+    packColor(img, i, plane.data(), q, r);
+  }
+}
+
+#define PACKSAMPLESOF(T, S)                                                 \
+  template void packSamples(const BasicImage<T> &, int, S *, vector<S> &, \
+                            const RescaleMap *)
+PACKSAMPLESOF(float, unsigned char);
+PACKSAMPLESOF(float, unsigned short);
+PACKSAMPLESOF(unsigned char, unsigned char);
+PACKSAMPLESOF(unsigned char, unsigned short);
+PACKSAMPLESOF(unsigned short, unsigned char);
+PACKSAMPLESOF(unsigned short, unsigned short);
+
+
+/**
+ * Code rows i0 to i1-1 of an image as a band of a packed file (see
+ * unpackBand()), the samples clamped to [0, maxval] as writePNM() does.
+ * @param img The image.
+ * @param i0 The first row of the band.
+ * @param i1 The row after the band.
+ * @param r The map of each channel done by rescale(), or 0.
+ * @param out The band, followed by 8 zero bytes.
+ */
+template <class S, class T>
+void packBand(const BasicImage<T> &img, int i0, int i1, const RescaleMap *r,
+              vector<unsigned char> &out) {
+  unsigned int m[PACKBLOCK], any;
+  unsigned char *q;
+  uint64_t acc;
+  size_t o, most;
+  int i, t, u, c, w, nb, n, nchan, bits;
+  S e;
+
+  nchan = img.getChannel();
+  n = img.getCol() * nchan;
+  bits = 8 * sizeof(S);
+  vector<S> rows(2 * ((size_t)n + nchan)), plane;   // 0 before each row
+  S *cur = rows.data() + nchan, *up = cur + n + nchan;
+
+  most = (size_t)n * bits / 8 + n / PACKBLOCK + 16;  // bytes of a row
+  out.resize(most);
+  q = out.data();
+  for (i=i0; i<i1; i++) {
+    o = q - out.data();
+    if (o + most > out.size()) {
+      out.resize(2 * (o + most));
+      q = out.data() + o;
+    }
+    packSamples(img, i, cur, plane, r);
+    for (t=0; t<n; t+=PACKBLOCK) {
+      c = min(PACKBLOCK, n-t);
+      any = 0;
+      for (u=0; u<c; u++) {            // the residuals, zigzag coded
+        e = (S)(cur[t+u] - cur[t+u-nchan] - up[t+u] + up[t+u-nchan]);
+        m[u] = (e >> (bits-1)) ? 2*(S)~e + 1 : 2*e;
+        any |= m[u];
+      }
+      w = any ? 32 - __builtin_clz(any) : 0;
+      *q++ = w;
+      acc = 0;
+      nb = 0;
+      for (u=0; u<c; u++) {            // w bits each, 4 bytes at a time
+        acc |= (uint64_t)m[u] << nb;
+        nb += w;
+        if (nb >= 32) {
+          storeLE32(q, (uint32_t)acc);
+          q += 4;
+          acc >>= 32;
+          nb -= 32;
+        }
+      }
+      for (; nb > 0; nb -= 8) {
+        *q++ = (unsigned char)acc;
+        acc >>= 8;
+      }
+    }
+    swap(cur, up);
+  }
+  memset(q, 0, 8);
+  out.resize(q - out.data() + 8);
+}
+
+#define PACKBANDOF(S, T)                                                    \
+  template void packBand<S>(const BasicImage<T> &, int, int,              \
+                            const RescaleMap *, vector<unsigned char> &)
+PACKBANDOF(unsigned char, float);
+PACKBANDOF(unsigned char, unsigned char);
+PACKBANDOF(unsigned char, unsigned short);
+PACKBANDOF(unsigned short, float);
+PACKBANDOF(unsigned short, unsigned char);
+PACKBANDOF(unsigned short, unsigned short);
+
+
+/**
+ * Write an image to a packed file (PGMPACK/PPMPACK), a lossless
+ * compressed raster of the samples clamped to [0, maxval], as written by
+ * writePNM(). The rows are coded in bands of PACKBAND rows, by separate
+ * threads. The header is the one of a PGM/PPM file, with the magic
+ * number Pz (PZ for color) and a fourth line, the rows of a band; it is
+ * followed by the size of each band in bytes (8 bytes, least significant
+ * first), then the bands.
+ * @param img The image to be output.
  * @param fname The output file name.
- * @param flag The rescale flag. Rescale when true.
+ * @param r The map of each channel done by rescale(), or 0.
  */
-void writeImage(Image &inimg, char *fname, int flag) {
+template <class T>
+static void writePacked(const BasicImage<T> &img, char *fname,
+                        const RescaleMap *r) {
   ofstream ofp;
-  int i, j, k;
-  int nr, nc, nchan, nt;
-  unsigned char *img;
-  Image temp;
+  int b, nb, nr;
+
+  nr = img.getRow();
+  nb = (nr + PACKBAND - 1) / PACKBAND;
+  vector<vector<unsigned char> > bands(nb);
+  vector<unsigned char> sizes(8 * (size_t)nb);
+
+  eachBand(nb, [&](int b) {
+      int i0 = b * PACKBAND, i1 = min(nr, i0 + PACKBAND);
+
+      if (img.getMaxval() > 255)
+        packBand<unsigned short>(img, i0, i1, r, bands[b]);
+      else
+        packBand<unsigned char>(img, i0, i1, r, bands[b]);
+    });
+
+  ofp.open(fname, ios::out | ios::binary);
+  if (!ofp) {
+    cout << "writeImage: Can't write image: " << fname << endl;
+    exit(1);
+  }
+  ofp << ((img.getChannel() == 1) ? "Pz" : "PZ") << endl;
+  ofp << img.getCol() << " " << nr << endl;
+  ofp << img.getMaxval() << endl;
+  ofp << PACKBAND << endl;
+  for (b=0; b<nb; b++)
+    storeLE64(sizes.data() + 8*b, bands[b].size());
+  ofp.write((char *) sizes.data(), sizes.size());
+  for (b=0; b<nb; b++)
+    ofp.write((char *) bands[b].data(), bands[b].size());
+  ofp.close();
+}
+
+/**
+ * Write the pixels of an image to a file, clamped to [0, maxval] where
+ * maxval is the maximum value of the image. The samples take two bytes,
+ * most significant first, when maxval is above 255. The pixels are
+ * converted row by row into a buffer written every RAWBLOCK bytes, the
+ * image is not copied. The images of type PGMPACK and PPMPACK are written
+ * to packed files (see writePacked()), and those of type PGMTILE and
+ * PPMTILE to tiled files (see writeTiles()).
+ * @param temp The image to be output.
+ * @param fname The output file name.
+ * @param pam 1 to write a PAM file (always raw) instead of PGM/PPM.
+ * @param r The map of each channel done by rescale(), to write the
+ *          rescaled image without computing it, or 0.
+ */
+template <class T>
+static void writePNM(const BasicImage<T> &temp, char *fname, int pam=0,
+                     const RescaleMap *r=0) {
+  ofstream ofp;
+  int i, j;
+  int nr, nc, nchan, nt, maxval, bps, raw;
+  size_t len, o;
+  char text[ASCIIBLOCK + 16], *p;  // the formatted ASCII pixels
+  to_chars_result res;
+
+  if (!pam && (temp.getType() == PGMPACK || temp.getType() == PPMPACK)) {
+    writePacked(temp, fname, r);
+    return;
+  }
+  if (!pam && (temp.getType() == PGMTILE || temp.getType() == PPMTILE)) {
+    writeTiles(temp, fname, TILESIZE, r);
+    return;
+  }
 
   ofp.open(fname, ios::out | ios::binary);
 
@@ -133,13 +1222,22 @@ void writeImage(Image &inimg, char *fname, int flag) {
     exit(1);
   }
 
-  nr = inimg.getRow();
-  nc = inimg.getCol();
-  nt = inimg.getType();
-  nchan = inimg.getChannel();
+  nr = temp.getRow();
+  nc = temp.getCol();
+  nt = temp.getType();
+  nchan = temp.getChannel();
+  maxval = temp.getMaxval();
+  bps = (maxval > 255) ? 2 : 1;
 
   // Write the format ID
-  switch (nt) {
+  if (pam) {
+    nt = (nchan == 1) ? PGMRAW : PPMRAW;
+    ofp << "P7\nWIDTH " << nc << "\nHEIGHT " << nr
+        << "\nDEPTH " << nchan << "\nMAXVAL " << maxval
+        << "\nTUPLTYPE " << ((nchan == 1) ? "GRAYSCALE" : "RGB")
+        << "\nENDHDR\n";
+  }
+  else switch (nt) {
   case PGMRAW:
     ofp << "P5" << endl;
     break;
@@ -156,105 +1254,273 @@ void writeImage(Image &inimg, char *fname, int flag) {
     cout << "writeImage: Can't identify image type\n";
   }
 
-  ofp << nc << " " << nr << endl;
+  if (!pam) {
+    ofp << nc << " " << nr << endl;
+    ofp << maxval << endl;
+  }
+
+  // the raw samples of the rows, written a block at a time; the 16-bit
+  // samples of a row, interleaved; the samples of each channel of a row
+  raw = (nt == PGMRAW || nt == PPMRAW);
+  len = (size_t)nc * nchan * bps;
+  vector<unsigned char> out(raw ? max(len, min(len * nr, (size_t)RAWBLOCK))
+                                : 0);
+  vector<unsigned short> row((raw && bps == 1) ? 0 : (size_t)nc * nchan);
+  vector<unsigned char> plane8;
+  vector<unsigned short> plane16;
+
+  o = 0;
+  p = text;
+  for (i=0; i<nr; i++) {
+    if (raw && bps == 1)               // the samples straight to out
+      packSamples(temp, i, out.data() + o, plane8, r);
+    else {
+      packSamples(temp, i, row.data(), plane16, r);
+      if (raw)
+        rowStoreBE16(row.data(), out.data() + o, nc*nchan);
+      else   // ASCII format, one value per line formatted into a buffer
+        for (j=0; j<nc*nchan; j++) {
+          if (p - text >= ASCIIBLOCK) {  // 16 bytes left, more than a
+            ofp.write(text, p - text);   // sample and its newline take
+            p = text;
+          }
+          res = to_chars(p, text + sizeof(text) - 1, row[j]);
+          if (res.ec != errc()) {
+            cout << "writeImage: Can't format a pixel\n";
+            exit(3);
+          }
+          p = res.ptr;
+          *p++ = '\n';
+        }
+    }
+    if (raw) {
+      o += len;
+      if (o + len > out.size()) {
+        ofp.write((char *) out.data(), o);
+        o = 0;
+      }
+    }
+  }
+  if (raw)
+    ofp.write((char *) out.data(), o);
+  else
+    ofp.write(text, p - text);
+
+  ofp.close();
+}
 
-  // if user allow rescale
+
+/**
+ * Write image buffer to a file. The format is given by the type of the
+ * image: PGM/PPM, raw or ASCII, or a packed file (PGMPACK/PPMPACK), a
+ * lossless code of the samples a few times smaller than a raw file
+ * for smooth images, which readImage() reads back.
+ * @param inimg The image to be output.
+ * @param fname The output file name.
+ * @param flag The rescale flag. Rescale when true.
+ */
+void writeImage(const Image &inimg, char *fname, int flag) {
+  RescaleMap r[3];
+
+  // if user allow rescale, to [0, maxval], the pixels are rescaled as
+  // they are written; otherwise any intensity outside [0, maxval] is
+  // clamped by writePNM()
   if (flag) {
-    temp = rescale(inimg);
+    r[0] = r[1] = r[2] = rescaleMap(inimg, 0, inimg.getMaxval());
+    writePNM(inimg, fname, 0, r);
   }
-  else {  // if the maximum has been set, any intensity that is
-          // larger than the maximum would be set as maximum
-    temp = inimg;
-    for (i=0; i<nr; i++)
-      for (j=0; j<nc; j++)
-        for (k=0; k<nchan; k++) {
-          if (temp(i,j,k) > L)
-            temp(i,j,k) = L;
-          if (temp(i,j,k) < 0)
-            temp(i,j,k) = 0;
-        }
+  else
+    writePNM(inimg, fname);
+}
+
+
+/**
+ * Write an 8-bit image to a file.
+ * @param inimg The image to be output.
+ * @param fname The output file name.
+ */
+void writeImage(const Image8 &inimg, char *fname) {
+  writePNM(inimg, fname);
+}
+
+
+/**
+ * Write a 16-bit image to a file, with two bytes a sample when its
+ * maximum value is above 255.
+ * @param inimg The image to be output.
+ * @param fname The output file name.
+ */
+void writeImage(const Image16 &inimg, char *fname) {
+  writePNM(inimg, fname);
+}
+
+
+/**
+ * Write an image to a PAM file, of depth 1 (GRAYSCALE) or 3 (RGB) and
+ * with the maximum value of the image, up to 65535. The pixels are
+ * clamped to [0, maxval] as writeImage() does without rescaling.
+ * @param inimg The image to be output.
+ * @param fname The output file name.
+ */
+void writePAM(const Image &inimg, char *fname) {
+  writePNM(inimg, fname, 1);
+}
+
+void writePAM(const Image8 &inimg, char *fname) {
+  writePNM(inimg, fname, 1);
+}
+
+void writePAM(const Image16 &inimg, char *fname) {
+  writePNM(inimg, fname, 1);
+}
+
+
+/**
+ * Write the buffers of iov to a file, in as few system calls as writev()
+ * allows.
+ * @param fd The file.
+ * @param iov The buffers, modified.
+ * @param n The number of buffers.
+ * @param fname The name of the file.
+ */
+void writeAll(int fd, struct iovec *iov, int n, const char *fname) {
+  ssize_t w;
+
+  while (n > 0) {
+    w = writev(fd, iov, min(n, IOV_MAX));
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      cout << "writeImage: Can't write image: " << fname << endl;
+      exit(1);
+    }
+    // skip what has been written
+    while (n > 0 && (size_t)w >= iov->iov_len) {
+      w -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n > 0) {
+      iov->iov_base = (char *) iov->iov_base + w;
+      iov->iov_len -= w;
+    }
   }
-  
-  ofp << L << endl;
+}
+
+
+/**
+ * Write a float image to a PFM file, without clamping or rounding, so
+ * that it is read back by readImage() exactly as it is (e.g., the
+ * intermediate results of a batch job). The floats are written in the
+ * native byte order, the rows from the bottom up as PFM requires. The
+ * rows of a gray-scale image are written from the image as they are,
+ * with one writev() call; those of a color image are interleaved into a
+ * buffer first.
+ * @param inimg The image to be output.
+ * @param fname The output file name.
+ */
+void writePFM(const Image &inimg, char *fname) {
+  int fd, i, j, k, n, nr, nc, nchan, rows;
+  char head[80];
+  const float *q[3];
+  float *p;
+
+  nr = inimg.getRow();
+  nc = inimg.getCol();
+  nchan = inimg.getChannel();
 
-  // convert the image data type back to unsigned char
-  img = (unsigned char *) new unsigned char [nr * nc * nchan];
-  if (!img) {
-    cout << "WRITEIMAGE: Out of memory.\n";
+  fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    cout << "writePFM: Can't write image: " << fname << endl;
     exit(1);
   }
+  n = snprintf(head, sizeof(head), "%s\n%d %d\n%.1f\n",
+               (nchan == 1) ? "Pf" : "PF", nc, nr, PFMSCALE);
 
-  if (nt == PGMRAW || nt == PPMRAW) {
-    for (i=0; i<nr; i++)
-      for (j=0; j<nc; j++)
-        for (k=0; k<nchan; k++) 
-          img[(i*nc+j)*nchan+k] = (unsigned char)temp(i,j,k);
-    ofp.write((char *)img, (nr * nc * nchan * sizeof(unsigned char)));
+  if (nchan == 1) {                    // the header and the rows
+    vector<struct iovec> iov(nr + 1);
+    iov[0].iov_base = head;
+    iov[0].iov_len = n;
+    for (i=0; i<nr; i++) {
+      iov[i+1].iov_base = (void *) inimg.rowPtr(nr-1-i);
+      iov[i+1].iov_len = (size_t)nc * sizeof(float);
+    }
+    writeAll(fd, &iov[0], nr + 1, fname);
   }
-  else {   // ASCII format
-    for (i=0; i<nr; i++)
-      for (j=0; j<nc; j++)
-        for (k=0; k<nchan; k++) 
-          ofp << (unsigned int)temp(i,j,k) << endl; 
+  else {                               // blocks of interleaved rows
+    rows = max(1, PFMBLOCK / (int)(nc * nchan * sizeof(float)));
+    vector<float> buf((size_t)min(rows, nr) * nc * nchan);
+    struct iovec iov[2];
+
+    iov[0].iov_base = head;            // written with the first block
+    iov[0].iov_len = n;
+    i = 0;
+    do {
+      p = &buf[0];
+      for (n=0; n<rows && i<nr; n++, i++) {
+        for (k=0; k<nchan; k++)
+          q[k] = inimg.rowPtr(nr-1-i, k);
+        for (j=0; j<nc; j++)
+          for (k=0; k<nchan; k++)
+            *p++ = q[k][j];
+      }
+      iov[1].iov_base = &buf[0];
+      iov[1].iov_len = (p - &buf[0]) * sizeof(float);
+      writeAll(fd, iov, 2, fname);
+      iov[0].iov_len = 0;
+    } while (i < nr);
   }
 
-  ofp.close();
-  delete [] img;
+  close(fd);
 }
 
 
 /** 
- * Rescale the image to be between min and max.
+ * Rescale the image to be between min and max. All the channels are
+ * rescaled by the minimum and maximum over the whole image, so a color
+ * keeps its hue. The result keeps the maximum value of the input image.
  * @param inimg The input image.
  * @param a The lower bound.
- * @param b The upper bound
+ * @param b The upper bound, the maximum value of the image when < 0
  * @return Rescaled image.
  */
-Image rescale(Image &inimg, float a, float b) {
+Image rescale(const Image &inimg, float a, float b) {
   int i, j, k;
-  int nr, nc, nt, nchan;
+  int nr, nc, nt, nchan, maxval;
   Image temp;
-  float maxi, mini;
+  RescaleMap r;
   
   nr = inimg.getRow();
   nc = inimg.getCol();
   nt = inimg.getType();
   nchan = inimg.getChannel();  
-  if (a<0 || b>L || a>b) {
+  maxval = inimg.getMaxval();
+  if (b < 0)
+    b = maxval;
+  if (a<0 || b>65535 || a>b) {
     cout << "rescale: the specified min and max need to be " 
-         << "between [0, " << L << "]\n"
+         << "between [0, 65535]\n"
          << "\tand min should be less than or equal to max\n";
     exit(3);
   }
-  if (nchan>1) {
-    cout << "rescale: can only handle single-channel image\n";
-    exit(3);
-  }
-  temp.createImage(nr, nc, nt);
+  temp.createImageUninit(nr, nc, nt);
+  temp.setMaxval(maxval);
+  r = rescaleMap(inimg, a, b);
      
-  // get the maximum and minimum of each channel
-  maxi = inimg.getMaximum();
-  mini = inimg.getMinimum();
-    
-  // rescale
-  if (maxi == mini) {
-    if (maxi <= 0.0) {
+  for (k=0; k<nchan; k++) {
+    // rescale
+    if (r.d == 0) {
       for (i=0; i<nr; i++)
 	for (j=0; j<nc; j++)
-	  temp(i,j) = a;
+	  temp(i,j,k) = r.a;
     }
     else {
       for (i=0; i<nr; i++)
 	for (j=0; j<nc; j++)
-	  temp(i,j) = b;
+	  temp(i,j,k) = 
+	    (inimg(i,j,k)-r.m) * r.c / r.d + r.a; 
     }
   }
-  else {
-    for (i=0; i<nr; i++)
-      for (j=0; j<nc; j++)
-	temp(i,j) = 
-	  (inimg(i,j)-mini) * (b-a) / (maxi-mini) + a; 
-  }
   
   return temp;
 }
@@ -2,7 +2,7 @@
  * lowpassFilter.cpp - perform low-pass filtering 
  *
  *   - average: the average filter
- *   - median: the median filter
+ *   - median: the median filter (also on 8-bit images)
  *   - contrah: the contraharmonic filter
  *   - gmean: geometric mean
  *   - amedian: adaptive median
@@ -12,10 +12,17 @@
  * Created: 01/24/06
  *
  * Modified:
+ *   - 10/17/26: the results keep the maxval of the input image
+ *   - 10/17/26: run the rows of median() and contrah() on all the
+ *               cores (see Parallel.h)
+ *   - 10/17/26: add overloads that write into a given output image;
+ *               free the neighbor buffers of median() and amedian()
+ *   - 10/17/26: add median() for 8-bit images (sliding histogram)
  *   - 11/04/08: add gmean(), amedian()
  **********************************************************/
 #include "Image.h"
 #include "Dip.h"
+#include "Parallel.h"
 #include <iostream>
 #include <cstdlib>
 #include <cmath>
@@ -26,8 +33,23 @@
  * @param size The size of the neighborhood. Assume odd for the simplicity.
  * @return The smoothed image using geometric mean filter.
  */
-Image gmean(Image &inimg, int size) {
+Image gmean(const Image &inimg, int size) {
   Image outimg;
+
+  gmean(inimg, size, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Geometric mean filter into outimg, whose buffer is reused if possible.
+ * @param img The input image, can be outimg itself.
+ * @param size The size of the neighborhood.
+ * @param outimg The smoothed image.
+ */
+void gmean(const Image &img, int size, Image &outimg) {
+  const Image inimg = img;      // shares the pixels, so outimg can be img
   int nr, nc, nchan, i, j, m, n;
   double sum;
 
@@ -40,6 +62,7 @@ Image gmean(Image &inimg, int size) {
   }
 
   outimg.createImage(nr, nc);
+  outimg.setMaxval(inimg.getMaxval());
 
   for (i=size/2; i<nr-size/2; i++)
     for (j=size/2; j<nc-size/2; j++) {
@@ -49,8 +72,6 @@ Image gmean(Image &inimg, int size) {
 	  sum *= inimg(i+m,j+n);
       outimg(i,j) = pow(sum, 1.0/(size*size));
     }
-  
-  return outimg;
 }
 
 
@@ -60,8 +81,23 @@ Image gmean(Image &inimg, int size) {
  * @param size The size of the neighborhood.
  * @return The smoothed image using average filter.
  */
-Image average(Image &inimg, int size) {
-  Image outimg, mask;
+Image average(const Image &inimg, int size) {
+  Image outimg;
+
+  average(inimg, size, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Average lowpass filter into outimg, whose buffer is reused if possible.
+ * @param inimg The input image, can be outimg itself.
+ * @param size The size of the neighborhood.
+ * @param outimg The smoothed image.
+ */
+void average(const Image &inimg, int size, Image &outimg) {
+  Image mask;
 
   // create the average mask
   mask.createImage(size, size);
@@ -69,9 +105,7 @@ Image average(Image &inimg, int size) {
   mask = mask / (size * size);
 
   // apply kernel operation
-  outimg = conv(inimg, mask);
-      
-  return outimg;
+  conv(inimg, mask, outimg);
 }
  
 
@@ -80,8 +114,22 @@ Image average(Image &inimg, int size) {
  * @param inimg The input image
  * @return The smoothed image.
  */
-Image gaussianSmooth(Image &inimg) {
-  Image outimg, mask;
+Image gaussianSmooth(const Image &inimg) {
+  Image outimg;
+
+  gaussianSmooth(inimg, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Gaussian lowpass filter into outimg, whose buffer is reused if possible.
+ * @param inimg The input image, can be outimg itself.
+ * @param outimg The smoothed image.
+ */
+void gaussianSmooth(const Image &inimg, Image &outimg) {
+  Image mask;
 
   // create the two masks and initialize to zero  
   mask.createImage(3,3);
@@ -91,9 +139,7 @@ Image gaussianSmooth(Image &inimg) {
   mask = mask / 16.0;
   
   // apply kernel operation
-  outimg = conv(inimg, mask); 
-    
-  return outimg;
+  conv(inimg, mask, outimg);
 }
 
  
@@ -103,11 +149,24 @@ Image gaussianSmooth(Image &inimg) {
  * @param masksize The size (or radius) of the neighborhood 
  * @return Image smoothed by median filter
  */
-Image median(Image &inimg, int masksize) {
+Image median(const Image &inimg, int masksize) {
   Image outimg;
+
+  median(inimg, masksize, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Median filter into outimg, whose buffer is reused if possible.
+ * @param img The input image, can be outimg itself
+ * @param masksize The size of the neighborhood
+ * @param outimg Image smoothed by median filter
+ */
+void median(const Image &img, int masksize, Image &outimg) {
+  const Image inimg = img;      // shares the pixels, so outimg can be img
   int nr, nc, nchan, radius1, radius2;
-  int i, j, m, n, l;
-  float *p;
 
   nr = inimg.getRow();
   nc = inimg.getCol();
@@ -118,6 +177,7 @@ Image median(Image &inimg, int masksize) {
   }
 
   outimg.createImage(nr, nc);
+  outimg.setMaxval(inimg.getMaxval());
   
   // handle odd and even mask size
   if ((float)masksize/2.0 > masksize/2) {
@@ -128,21 +188,128 @@ Image median(Image &inimg, int masksize) {
     radius2 = radius1 - 1;
   }
 
-  p = (float *) new float [masksize*masksize];
+  // the bands of rows run on separate threads, each with its own array
+  parallelRows(nr-radius2-radius1, rowBand(2 * nc * sizeof(float)),
+               [&](int i0, int i1) {
+      int i, j, m, n, l;
+      float *p;
+
+      p = (float *) new float [masksize*masksize];
+
+      for (i=radius1+i0; i<radius1+i1; i++)
+        for (j=radius1; j<nc-radius2; j++) {
+          l = 0;
+          for (m=-radius1; m<=radius2; m++)
+	    for (n=-radius1; n<=radius2; n++)
+	      p[l++] = inimg(i+m,j+n);
+          bubblesort(p, masksize*masksize);
+          outimg(i,j) = p[(int)masksize*masksize/2];
+        }
+
+      delete [] p;
+    });
+}
 
-  for (i=radius1; i<nr-radius2; i++)
-    for (j=radius1; j<nc-radius2; j++) {
-      l = 0;
-      for (m=-radius1; m<=radius2; m++)
-	for (n=-radius1; n<=radius2; n++)
-	  p[l++] = inimg(i+m,j+n);
-      bubblesort(p, masksize*masksize);
-      outimg(i,j) = p[(int)masksize*masksize/2];
-    }
+
+/**
+ * Median filter of an 8-bit image. The window slides along each row 
+ * keeping a 256-bin histogram of its pixels: moving one column drops the 
+ * leftmost column and adds a new one, and the median is found by moving 
+ * from the previous median through the histogram, so no sorting is 
+ * needed. The result is the same as that of the float version.
+ * @param inimg The input image
+ * @param masksize The size of the mask, default 3
+ * @return Image smoothed by the median filter
+ */
+Image8 median(const Image8 &inimg, int masksize) {
+  Image8 outimg;
+
+  median(inimg, masksize, outimg);
 
   return outimg;
 }
 
+
+/**
+ * Median filter of an 8-bit image into outimg, whose buffer is reused
+ * if possible.
+ * @param img The input image, can be outimg itself
+ * @param masksize The size of the mask
+ * @param outimg Image smoothed by the median filter
+ */
+void median(const Image8 &img, int masksize, Image8 &outimg) {
+  const Image8 inimg = img;     // shares the pixels, so outimg can be img
+  int nr, nc, nchan, radius1, radius2, half;
+
+  nr = inimg.getRow();
+  nc = inimg.getCol();
+  nchan = inimg.getChannel();
+  if (nchan > 1) {
+    cout << "Median: Can only handle gray-scale images.\n";
+    exit(3);
+  }
+
+  outimg.createImage(nr, nc);
+  outimg.setMaxval(inimg.getMaxval());
+  
+  // handle odd and even mask size
+  if ((float)masksize/2.0 > masksize/2) {
+    radius1 = radius2 = masksize/2;
+  }
+  else {
+    radius1 = masksize/2;
+    radius2 = radius1 - 1;
+  }
+  half = masksize*masksize/2;     // index of the median in sorted order
+
+  // the bands of rows run on separate threads
+  parallelRows(nr-radius2-radius1, rowBand(2 * nc), [&](int i0, int i1) {
+      int i, j, m, med, below;
+      int hist[256];
+      const unsigned char **p;
+      unsigned char *q;
+
+      p = new const unsigned char * [masksize];
+
+      for (i=radius1+i0; i<radius1+i1; i++) {
+        for (m=0; m<masksize; m++)
+          p[m] = inimg.rowPtr(i-radius1+m);
+        q = outimg.rowPtr(i);
+
+        // the window at the start of the row
+        for (m=0; m<256; m++)
+          hist[m] = 0;
+        for (m=0; m<masksize; m++)
+          for (j=0; j<masksize; j++)
+            hist[p[m][j]]++;
+        med = 0;                  // median, and # of pixels below it
+        below = 0;
+
+        for (j=radius1; j<nc-radius2; j++) {
+          if (j > radius1)        // slide the window one column right
+            for (m=0; m<masksize; m++) {
+              if (p[m][j-radius1-1] < med)
+                below--;
+              hist[p[m][j-radius1-1]]--;
+              if (p[m][j+radius2] < med)
+                below++;
+              hist[p[m][j+radius2]]++;
+            }
+
+          // the median is the smallest med with more than half pixels
+          // <= med
+          while (below > half)
+            below -= hist[--med];
+          while (below + hist[med] <= half)
+            below += hist[med++];
+          q[j] = med;
+        }
+      }
+
+      delete [] p;
+    });
+}
+
  
 /**
  * Adaptive median filter. Handles SAP noise better with prob. larger than 0.2
@@ -150,8 +317,23 @@ Image median(Image &inimg, int masksize) {
  * @param maxmask The maximum mask size. Assume starts from 3. 
  * @return Image smoothed by the adaptive median filter
  */
-Image amedian(Image &inimg, int maxmask) {
+Image amedian(const Image &inimg, int maxmask) {
   Image outimg;
+
+  amedian(inimg, maxmask, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Adaptive median filter into outimg, whose buffer is reused if possible.
+ * @param img The input image, can be outimg itself
+ * @param maxmask The maximum mask size.
+ * @param outimg Image smoothed by the adaptive median filter
+ */
+void amedian(const Image &img, int maxmask, Image &outimg) {
+  const Image inimg = img;      // shares the pixels, so outimg can be img
   int nr, nc, nchan, radius1, radius2, masksize, nsize;
   int i, j, m, n, l, flag;
   float *p, zmin, zmax, zmed, zxy;
@@ -165,6 +347,7 @@ Image amedian(Image &inimg, int maxmask) {
   }
 
   outimg.createImage(nr, nc);
+  outimg.setMaxval(inimg.getMaxval());
   
   flag = 1;
   for (i=0; i<nr; i++)
@@ -203,6 +386,7 @@ Image amedian(Image &inimg, int maxmask) {
 	zmax = p[nsize-1];
 	zmed = p[(int)nsize/2];
 	zxy = inimg(i,j);
+	delete [] p;
 	
 	// stage A
 	if (zmed-zmin>0 && zmed-zmax<0) { // the medium is not impulse
@@ -216,16 +400,12 @@ Image amedian(Image &inimg, int maxmask) {
 	    flag = 0;
 	  }
 	}
-	else {
+	else
 	  masksize++;
-	  delete p;
-	}
       }
       if (flag) 
 	outimg(i,j) = zmed;
     }
-
-  return outimg;
 }
  
 
@@ -236,7 +416,7 @@ Image amedian(Image &inimg, int maxmask) {
  * @return Image smoothed by the adaptive median filter
  */
 /*
-Image alnr(Image &inimg, int masksize) {
+Image alnr(const Image &inimg, int masksize) {
   Image outimg;
   int nr, nc, nchan;
   int i, j, m, n, l;
@@ -251,6 +431,7 @@ Image alnr(Image &inimg, int masksize) {
   }
 
   outimg.createImage(nr, nc);
+  outimg.setMaxval(inimg.getMaxval());
   
   // calculate the variance of the image
 
@@ -320,11 +501,26 @@ Image alnr(Image &inimg, int masksize) {
  * @param masksize The size of the neighborhood.
  * @return Restored image.
  */
-Image contrah(Image &inimg, float Q, int masksize) {
+Image contrah(const Image &inimg, float Q, int masksize) {
   Image outimg;
-  int i, j, m, n;
+
+  contrah(inimg, Q, masksize, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Contraharmonic mean filter into outimg, whose buffer is reused if
+ * possible.
+ * @param img The input image, can be outimg itself.
+ * @param Q The order of the filter
+ * @param masksize The size of the neighborhood.
+ * @param outimg Restored image.
+ */
+void contrah(const Image &img, float Q, int masksize, Image &outimg) {
+  const Image inimg = img;      // shares the pixels, so outimg can be img
   int nc, nr, nchan;
-  float sumn, sumd;
 
   // get the dimension
   nc = inimg.getCol();
@@ -336,24 +532,28 @@ Image contrah(Image &inimg, float Q, int masksize) {
   }
 
   outimg.createImage(nr, nc);
-
-  // apply the contraharmonic filter
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++) {
-      sumn = 0;
-      sumd = 0;    
-      for (m=-masksize; m<=masksize; m++)
-	for (n=-masksize; n<=masksize; n++)
-	  if (i+m>=0 && i+m<nr && j+n>=0 && j+n<nc &&
-	      masksize+m>=0 && masksize+m<nr && 
-	      masksize+n>=0 && masksize+n<nc) {
-	    sumn += pow((float)inimg(i+m,j+n), Q+1);
-	    sumd += pow((float)inimg(i+m,j+n), Q);
-	  }
-      outimg(i,j) = sumn / sumd;
-    }
-    
-  return outimg;
+  outimg.setMaxval(inimg.getMaxval());
+
+  // apply the contraharmonic filter, the bands of rows on separate threads
+  parallelRows(nr, rowBand(2 * nc * sizeof(float)), [&](int i0, int i1) {
+      int i, j, m, n;
+      float sumn, sumd;
+
+      for (i=i0; i<i1; i++)
+        for (j=0; j<nc; j++) {
+          sumn = 0;
+          sumd = 0;    
+          for (m=-masksize; m<=masksize; m++)
+	    for (n=-masksize; n<=masksize; n++)
+	      if (i+m>=0 && i+m<nr && j+n>=0 && j+n<nc &&
+	          masksize+m>=0 && masksize+m<nr && 
+	          masksize+n>=0 && masksize+n<nc) {
+	        sumn += pow((float)inimg(i+m,j+n), Q+1);
+	        sumd += pow((float)inimg(i+m,j+n), Q);
+	      }
+          outimg(i,j) = sumn / sumd;
+        }
+    });
 }
 
 
@@ -12,14 +12,18 @@
  *
  * Modified:
  *  - 02/15/06: bug in the calculation of dHP, by Tom Karnowski
+ *  - 10/17/26: convolve into the intermediate images allocated once,
+ *              so the iterations of linear() allocate no memory
+ *  - 10/17/26: convolve f with the three quadratic kernels in one pass
  ****************************************************************/
 
 #include "Image.h"
 #include "Dip.h"
-#include "MAP.h"
+#include "Map.h"
 #include <iostream>
 #include <cstdlib>
 #include <cmath>
+#include <vector>
 
 using namespace std;
 
@@ -29,7 +33,7 @@ using namespace std;
  * @param par The parameters
  * @return The restored image.
  */
-Image mapmfa(Image &gimg, Map &par) {
+Image mapmfa(const Image &gimg, Map &par) {
   Image fimg; 
   int done;
 
@@ -73,13 +77,16 @@ Image mapmfa(Image &gimg, Map &par) {
  * @param par The parameters
  * @return Converge or not.
  */
-int linear (Image &fimg, Image &gimg, Map &par) {
+int linear (Image &fimg, const Image &gimg, Map &par) {
   static int first = 1;
   static int nr, nc, nt, npix;
   static float stepsize, prevsmod, prevH;
   static int diverges;
-  static Image qxx(1,3), qyy(3,1), qxy(3,3), h;
-  static Image rxx, ryy, rxy, sxx, syy, sxy, dxx, dyy, dxy, fs, fss, dHP, dHN;
+  static vector<Image> q(3), r(3);   // the quadratic kernels, and f
+                                     // convolved with them
+  static Image &qxx = q[0], &qyy = q[1], &qxy = q[2], h;
+  static Image &rxx = r[0], &ryy = r[1], &rxy = r[2];
+  static Image sxx, syy, sxy, dxx, dyy, dxy, fs, fss, dHP, dHN;
   int done = 0;
   float t2, t3, alpha, s2, tmp, new_stepsize;
   float HN, HP, H, smod, mod, sum;
@@ -95,6 +102,8 @@ int linear (Image &fimg, Image &gimg, Map &par) {
   	npix = nr * nc;
   	
   	// fill in the quadratic kernel for the prior term
+  	qxx.createImage(1,3);
+  	qxy.createImage(3,3);
   	qxx(0,0) = qxx(0,2) = 1.0/sqrt(6.0); 
     qxx(0,1) = -2.0/sqrt(6.0);
     qyy = transpose(qxx);
@@ -149,11 +158,10 @@ int linear (Image &fimg, Image &gimg, Map &par) {
     // following the notation on textbook (Snyder&Qi) pp.125-126
 
     // Step 1: calculate H = HN + HP
-    rxx = conv(fimg, qxx);          // f convolves with quadratic kernels 
-    ryy = conv(fimg, qyy);          // for the prior term
-    rxy = conv(fimg, qxy);
+    convMulti(fimg, q, r);          // f convolves with quadratic kernels 
+                                    // for the prior term, in one pass
     
-    fs = conv(fimg, h);             // f convolves with gaussian kernel (h)
+    conv(fimg, h, fs);              // f convolves with gaussian kernel (h)
                                     // for the noise term
     
     for (i=0; i<nr; i++) {                     
@@ -177,11 +185,11 @@ int linear (Image &fimg, Image &gimg, Map &par) {
     H = HN - par.getBeta() * HP;
             
     // Step 2: calculate dHN and dHP
-    dxx = conv(sxx, qxx);                   // for the prior term
-    dyy = conv(syy, qyy);
-    dxy = conv(sxy, qxy);
+    conv(sxx, qxx, dxx);                    // for the prior term
+    conv(syy, qyy, dyy);
+    conv(sxy, qxy, dxy);
     
-    fss = conv(fs, h);                      // noise term (g-fxh)xhrev
+    conv(fs, h, fss);                       // noise term (g-fxh)xhrev
     
     for (i=0; i<nr; i++)
       for (j=0; j<nc; j++) {
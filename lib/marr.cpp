@@ -10,9 +10,11 @@
  * Created: 01/24/06
  *
  * Modified:
+ *   10/17/26 - run the rows of zeroCrossing() on all the cores
  **********************************************************/
 #include "Image.h"
 #include "Dip.h"
+#include "Parallel.h"
 #include <iostream>
 #include <cstdlib>
 
@@ -24,7 +26,7 @@ using namespace std;
  * @param std The standard deviation of Gaussian
  * @return The edge image.
  */
-Image marr(Image &inimg, float std) {
+Image marr(const Image &inimg, float std) {
   Image edge, LoG1, LoG2, conv1, conv2, zc1, zc2;
   int i, j, k;
   int nr, nc, nchan, nt;
@@ -95,8 +97,8 @@ Image LoG(float std) {
  * @param inimg The input image.
  * @return A binary image with zero crossings as white (or foreground).
  */
-Image zeroCrossing(Image &inimg) {
-  int i, j, k;
+Image zeroCrossing(const Image &inimg) {
+  int k;
   int nr, nc, nchan, nt;
   Image zc;
 
@@ -106,18 +108,23 @@ Image zeroCrossing(Image &inimg) {
   nt = inimg.getType();
   zc.createImage(nr, nc, nt);
 
+  // the bands of rows run on separate threads
   for (k=0; k<nchan; k++)
-    for (i=1; i<nr-1; i++) {
-      for (j=1; j<nc-1; j++) {
-        if ((inimg(i,j-1,k)*inimg(i,j+1,k)) < 0 || 
-	        (inimg(i-1,j,k)*inimg(i+1,j,k)) < 0 ||
-	        (inimg(i-1,j-1,k)*inimg(i+1,j+1,k)) < 0 ||
-	        (inimg(i-1,j+1,k)*inimg(i+1,j-1,k)) < 0)
-	      zc(i,j,k) = L;
-        else
-	      zc(i,j,k) = 0.0;
-      }
-    }
+    parallelRows(nr-2, rowBand(2 * nc * sizeof(float)), [&](int i0, int i1) {
+        int i, j;
+
+        for (i=1+i0; i<1+i1; i++) {
+          for (j=1; j<nc-1; j++) {
+            if ((inimg(i,j-1,k)*inimg(i,j+1,k)) < 0 || 
+	            (inimg(i-1,j,k)*inimg(i+1,j,k)) < 0 ||
+	            (inimg(i-1,j-1,k)*inimg(i+1,j+1,k)) < 0 ||
+	            (inimg(i-1,j+1,k)*inimg(i+1,j-1,k)) < 0)
+	          zc(i,j,k) = L;
+            else
+	          zc(i,j,k) = 0.0;
+          }
+        }
+      });
 
   return zc;
 }
@@ -3,7 +3,7 @@
  *
  *   - transpose: matrix transpose
  *   - inverse: matrix inverse
- *   - subImage: crop an image
+ *   - subImage: crop an image (a view, no copy)
  *   - pinv: matrix pseudo inverse
  * 
  * Author: Hairong Qi (C) hqi@utk.edu
@@ -11,6 +11,8 @@
  * Created: 01/11/08
  *
  * Modified:
+ *   - 10/17/26: the transposed image is not zeroed before it is written
+ *   - 10/17/26: subImage() returns a view instead of a copy
  *   - 07/30/09: add pinv() implementation
  **********************************************************/
 #include "Image.h"
@@ -31,7 +33,7 @@ void eliminate(Image &, int);
  * @param inimg The input matrix.
  * @return The transpose of the input matrix.
  */
-Image transpose(Image &inimg) {
+Image transpose(const Image &inimg) {
   int i, j;
   int nr, nc, nchan;  
   Image temp;
@@ -43,7 +45,7 @@ Image transpose(Image &inimg) {
     cout << "TRANSPOSE: Can only handle single-channel image.\n";
     exit(3);
   }
-  temp.createImage(nc, nr);
+  temp.createImageUninit(nc, nr);
 
   for (i=0; i<nr; i++)
     for (j=0; j<nc; j++)
@@ -58,7 +60,7 @@ Image transpose(Image &inimg) {
  * @param inimg The input matrix.
  * @return The inverse of the input matrix.
  */
-Image inverse(Image &inimg) {
+Image inverse(const Image &inimg) {
   int i, j, m, k, pivot;
   int nr, nc, nchan;
   Image temp, img;
@@ -181,7 +183,8 @@ void eliminate(Image &img, int pivot) {
  
 
 /**
- * Crop an image.
+ * Crop an image. The cropped image is a view sharing the pixels of inimg,
+ * no pixel is copied until one of the two images is modified.
  * @param inimg The input matrix.
  * @param srow The row index of the top-left corner, starts from 0.
  * @param scol The column index of the top-left corner.
@@ -189,27 +192,8 @@ void eliminate(Image &img, int pivot) {
  * @param ecol The column index of the lower-right corner.
  * @return The cropped image.
  */
-Image subImage(Image &inimg, int srow, int scol, int erow, int ecol) {
-  int i, j, k;
-  int nr, nc, nchan, nt;
-  Image temp;
-
-  nr = inimg.getRow();
-  nc = inimg.getCol();
-  nchan = inimg.getChannel();
-  nt = inimg.getType();  
-  if (srow > erow || scol > ecol || erow > nr -1 || ecol > nc - 1) {
-    cout << "subImage: Check the cropping index.\n";
-    exit(3);
-  }
-  temp.createImage(erow-srow+1, ecol-scol+1, nt);
-
-  for (i=srow; i<=erow; i++)
-    for (j=scol; j<=ecol; j++)
-      for (k=0; k<nchan; k++)
-        temp(i-srow,j-scol,k) = inimg(i,j,k);
-
-  return temp;
+Image subImage(const Image &inimg, int srow, int scol, int erow, int ecol) {
+  return inimg.getSubImage(srow, scol, erow, ecol);
 }
 
 
@@ -218,7 +202,7 @@ Image subImage(Image &inimg, int srow, int scol, int erow, int ecol) {
  * @param inimg The input matrix.
  * @return The pseudo-inverse of the input matrix.
  */
-Image pinv(Image &inimg) {
+Image pinv(const Image &inimg) {
   Image tinimg, temp, invtemp, outimg;
 
   tinimg = transpose(inimg);
@@ -0,0 +1,303 @@
+/**********************************************************
+ * parallel.cpp - a pool of threads running the row tiles
+ *                of the neighborhood operators
+ *                (see Parallel.h)
+ *
+ *   - setThreads, getThreads: the size of the pool
+ *   - rowBand: the rows of a tile that fits in L2
+ *   - parallelRows: run the tiles of a range of rows
+ *
+ * Created: 10/17/26
+ **********************************************************/
+
+#include "Parallel.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unistd.h>
+
+using namespace std;
+
+#define L2SIZE (256 << 10)   // L2 bytes, when the system does not tell
+
+static atomic<int> nthread(0);       // setThreads(), 0 for one per core
+static thread_local int inTile = 0;  // the thread is running a tile
+
+/**
+ * The tiles left to a thread, lo to hi-1, in one word so that the thread
+ * and the ones stealing from it update them at once.
+ */
+struct TileRange {
+  atomic<unsigned long long> v;
+
+  static unsigned long long pack(unsigned lo, unsigned hi) {
+    return (unsigned long long)hi << 32 | lo;
+  }
+};
+
+/**
+ * The threads, waiting for the tiles of the next parallelRows().
+ */
+class ThreadPool {
+ public:
+  ThreadPool() : job(0), quit(0), pending(0), parts(0), fn(0) {}
+  ~ThreadPool() { stop(); }
+
+  void run(int n, int band, const function<void(int, int)> &f, int nt);
+
+  mutex busy;                          // one parallelRows() at a time
+
+ private:
+  void start(int nt);                  // have nt-1 threads besides the caller
+  void stop();
+  void worker(int p, long seen);
+  void work(int p);                    // run tiles until none is left
+
+  vector<thread> threads;
+  vector<TileRange> ranges;            // one per thread, the caller's first
+  mutex lock;
+  condition_variable wake, done;
+  long job;                            // changes for each parallelRows()
+  int quit;
+  int pending;                         // threads still running tiles
+  int parts;                           // threads taking part in the job
+  int rows, rowsPer;                   // the rows and the rows of a tile
+  const function<void(int, int)> *fn;  // the function run on the tiles
+};
+
+static ThreadPool pool;
+
+
+/**
+ * Set the number of threads of parallelRows().
+ * @param n The number of threads, 1 to run the tiles in the calling
+ *          thread, 0 (the default) for one per core.
+ */
+void setThreads(int n)
+{
+  nthread = (n > 0) ? n : 0;
+}
+
+
+/**
+ * Returns the number of threads parallelRows() runs on.
+ * @return The number set by setThreads(), or the number of cores.
+ */
+int getThreads()
+{
+  int n = nthread;
+
+  if (n == 0)
+    n = (int)thread::hardware_concurrency();
+  return (n > 0) ? n : 1;
+}
+
+
+/**
+ * Returns the bytes of the L2 cache.
+ */
+static long cacheSize()
+{
+  long size = 0;
+
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+  return (size > 0) ? size : L2SIZE;
+}
+
+
+/**
+ * Returns the rows of a tile, so that the bytes its rows read and write
+ * fill half of the L2 cache.
+ * @param rowBytes The bytes read and written for one row of the output.
+ * @return The rows, at least 1.
+ */
+int rowBand(size_t rowBytes)
+{
+  static const long l2 = cacheSize();  // set once, by the first caller
+  long size;
+
+  if (rowBytes == 0)
+    return 1 << 20;
+  size = l2 / 2 / (long)rowBytes;
+  return (size > 0) ? (int)size : 1;
+}
+
+
+/**
+ * Run f(i0, i1) for the bands of rows [i0, i1) covering [0, n), each of
+ * band rows but the last, on the threads of the pool. It returns when
+ * all the bands are done. The bands run in the calling thread when there
+ * is only one, when one thread is used, or when the pool is busy (a
+ * call from within a band, or from another thread).
+ * @param n The number of rows.
+ * @param band The rows of a band.
+ * @param f The function.
+ */
+void parallelRows(int n, int band, const function<void(int, int)> &f)
+{
+  int i, nt, ntile;
+
+  if (n <= 0)
+    return;
+  if (band < 1)
+    band = 1;
+  ntile = (n + band - 1) / band;
+  nt = getThreads();
+  if (nt > ntile)
+    nt = ntile;
+  if (nt <= 1 || inTile || !pool.busy.try_lock()) {
+    for (i=0; i<n; i+=band)
+      f(i, (i + band < n) ? i + band : n);
+    return;
+  }
+  pool.run(n, band, f, nt);
+  pool.busy.unlock();
+}
+
+
+/**
+ * Run the tiles on nt threads, the calling one and nt-1 of the pool. Each
+ * thread starts with a range of consecutive tiles.
+ */
+void ThreadPool::run(int n, int band, const function<void(int, int)> &f,
+                     int nt)
+{
+  int p, ntile;
+
+  ntile = (n + band - 1) / band;
+  if ((int)threads.size() < nt - 1 ||
+      (int)threads.size() > getThreads() - 1)
+    start(getThreads());
+
+  {
+    lock_guard<mutex> g(lock);
+    if ((int)ranges.size() < nt)
+      ranges = vector<TileRange>(nt);
+    for (p=0; p<nt; p++)
+      ranges[p].v = TileRange::pack((long)ntile * p / nt,
+                                    (long)ntile * (p+1) / nt);
+    rows = n;
+    rowsPer = band;
+    fn = &f;
+    parts = nt;
+    pending = nt - 1;
+    job++;
+  }
+  wake.notify_all();
+
+  work(0);
+
+  unique_lock<mutex> g(lock);
+  done.wait(g, [this] { return pending == 0; });
+}
+
+
+/**
+ * Run tiles from the front of the range of thread p, then steal the back
+ * half of the largest range left, until every range is empty.
+ */
+void ThreadPool::work(int p)
+{
+  unsigned long long v;
+  unsigned lo, hi, mid, size, most;
+  int q, victim, i0;
+
+  inTile = 1;
+  for (;;) {
+    v = ranges[p].v.load();
+    lo = (unsigned)v;
+    hi = (unsigned)(v >> 32);
+    if (lo < hi) {
+      if (ranges[p].v.compare_exchange_weak(v, TileRange::pack(lo+1, hi))) {
+        i0 = (int)lo * rowsPer;
+        (*fn)(i0, (i0 + rowsPer < rows) ? i0 + rowsPer : rows);
+      }
+      continue;
+    }
+
+    victim = -1;
+    most = 0;
+    for (q=0; q<parts; q++) {
+      v = ranges[q].v.load();
+      size = (unsigned)(v >> 32) - (unsigned)v;
+      if (q != p && size > most) {
+        most = size;
+        victim = q;
+      }
+    }
+    if (victim < 0)
+      break;
+    v = ranges[victim].v.load();
+    lo = (unsigned)v;
+    hi = (unsigned)(v >> 32);
+    if (lo >= hi)
+      continue;
+    mid = hi - (hi - lo + 1) / 2;
+    if (ranges[victim].v.compare_exchange_strong(v,
+                                                 TileRange::pack(lo, mid)))
+      ranges[p].v = TileRange::pack(mid, hi);
+  }
+  inTile = 0;
+}
+
+
+/**
+ * Thread p of the pool: wait for a job after the one seen, run its tiles
+ * if it takes part.
+ */
+void ThreadPool::worker(int p, long seen)
+{
+  for (;;) {
+    {
+      unique_lock<mutex> g(lock);
+      wake.wait(g, [&] { return quit || job != seen; });
+      if (quit)
+        return;
+      seen = job;
+      if (p >= parts)
+        continue;
+    }
+    work(p);
+    {
+      lock_guard<mutex> g(lock);
+      pending--;
+    }
+    done.notify_one();
+  }
+}
+
+
+/**
+ * Start the pool over with nt-1 threads, the caller being the first.
+ */
+void ThreadPool::start(int nt)
+{
+  int p;
+
+  stop();
+  quit = 0;
+  for (p=1; p<nt; p++)
+    threads.push_back(thread(&ThreadPool::worker, this, p, job));
+}
+
+
+/**
+ * Stop the threads of the pool.
+ */
+void ThreadPool::stop()
+{
+  size_t p;
+
+  {
+    lock_guard<mutex> g(lock);
+    quit = 1;
+  }
+  wake.notify_all();
+  for (p=0; p<threads.size(); p++)
+    threads[p].join();
+  threads.clear();
+}
@@ -8,6 +8,7 @@
  *   - powerlaw: power-law transformation
  *   - threshold: thresholding an image using either binary or 
  *                gray-level thresholding
+ *   - negative, threshold: also on 8-bit images (Image8)
  *   - bitplane: bitplane slicing
  *   - sampling: downsample the image
  *   - quantization: quantize the image
@@ -18,6 +19,18 @@
  * Created: 01/24/06
  *
  * Modified:
+ *   10/17/26 - the results keep the maxval of the input (255 for the
+ *              binary ones), negative() is taken from the maxval
+ *   10/17/26 - autoThreshold() and histeq() get the intensity range with
+ *              one getMinMax() pass
+ *   10/17/26 - do not zero the results that are written entirely
+ *   10/17/26 - autoThreshold() and histeq() rescale to [0, L] explicitly,
+ *              rescale() defaults to the maximum value of the image
+ *   10/17/26 - add overloads of negative(), cs(), logtran(), powerlaw()
+ *              and threshold() that write into a given output image
+ *   10/17/26 - add 8-bit versions of negative() and threshold()
+ *   10/17/26 - walk the images one row at a time through rowPtr() so
+ *              the inner loops run over contiguous pixels
  *   11/07/11 - modify histeq() for better performance efficiency
  *   07/31/09 - move rescale() to imageIO.cpp
  *   02/06/06 - Chris reported problem with gcc4 when using
@@ -33,33 +46,52 @@ using namespace std;
 
 /**
  * Image negative.  s = L - r where
- * L: the largest intensity in the image,
+ * L: the largest intensity in the image, its maxval (255 for 8-bit data),
  * s: the enhanced pixel intensity, and
  * r: the original pixel intensity.
  * @para inimg Input image
  * @return Negative of the input image
  */
-Image negative(Image &inimg) {
+Image negative(const Image &inimg) {
   Image outimg;
+
+  negative(inimg, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Image negative into outimg, whose buffer is reused if possible.
+ * @param img Input image, can be outimg itself
+ * @param outimg Negative of the input image
+ */
+void negative(const Image &img, Image &outimg) {
+  const Image inimg = img;      // shares the pixels, so outimg can be img
   int i, j, k;
   int nc, nr, ntype, nchan;
-  Image maxi;
+  float m;
+  const float *p;
+  float *q;
 
   nc = inimg.getCol();
   nr = inimg.getRow();
   ntype = inimg.getType();
   nchan = inimg.getChannel();
+  m = inimg.getMaxval();
 
   // allocate memory for the negative image
-  outimg.createImage(nr, nc, ntype);
+  outimg.createImageUninit(nr, nc, ntype);
+  outimg.setMaxval(inimg.getMaxval());
 
   // find the negative
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        outimg(i,j,k) = L - inimg(i,j,k);
-
-  return outimg;
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++) {
+      p = inimg.rowPtr(i,k);
+      q = outimg.rowPtr(i,k);
+      for (j=0; j<nc; j++)
+        q[j] = m - p[j];
+    }
 }
 
 
@@ -72,10 +104,28 @@ Image negative(Image &inimg) {
  * @param b Intercept
  * @return Contrast stretched image.
  */
-Image cs(Image &inimg, float m, float b) {
+Image cs(const Image &inimg, float m, float b) {
   Image outimg;
+
+  cs(inimg, m, b, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Contrast stretching into outimg, whose buffer is reused if possible.
+ * @param img Input image, can be outimg itself
+ * @param m Slope
+ * @param b Intercept
+ * @param outimg Contrast stretched image.
+ */
+void cs(const Image &img, float m, float b, Image &outimg) {
+  const Image inimg = img;      // shares the pixels, so outimg can be img
   int i, j, k;
   int nr, nc, ntype, nchan;
+  const float *p;
+  float *q;
 
   // allocate memory
   nr = inimg.getRow();
@@ -83,15 +133,17 @@ Image cs(Image &inimg, float m, float b) {
   ntype = inimg.getType();
   nchan = inimg.getChannel();
 
-  outimg.createImage(nr, nc, ntype);
+  outimg.createImageUninit(nr, nc, ntype);
+  outimg.setMaxval(inimg.getMaxval());
 
   // perform contrast stretching
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        outimg(i,j,k) = m * inimg(i,j,k) + b;
-
-  return outimg;
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++) {
+      p = inimg.rowPtr(i,k);
+      q = outimg.rowPtr(i,k);
+      for (j=0; j<nc; j++)
+        q[j] = m * p[j] + b;
+    }
 }
 
 
@@ -100,10 +152,26 @@ Image cs(Image &inimg, float m, float b) {
  * @param inimg Input image
  * @return Image with dynamic range compressed
  */
-Image logtran(Image &inimg) {
+Image logtran(const Image &inimg) {
   Image outimg;
+
+  logtran(inimg, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Log transformation into outimg, whose buffer is reused if possible.
+ * @param img Input image, can be outimg itself
+ * @param outimg Image with dynamic range compressed
+ */
+void logtran(const Image &img, Image &outimg) {
+  const Image inimg = img;      // shares the pixels, so outimg can be img
   int i, j, k;
   int nr, nc, ntype, nchan;
+  const float *p;
+  float *q;
 
   // allocate memory
   nr = inimg.getRow();
@@ -111,14 +179,16 @@ Image logtran(Image &inimg) {
   ntype = inimg.getType();
   nchan = inimg.getChannel();
 
-  outimg.createImage(nr, nc, ntype);
-
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        outimg(i,j,k) = log(1.0+fabs(inimg(i,j,k)));
+  outimg.createImageUninit(nr, nc, ntype);
+  outimg.setMaxval(inimg.getMaxval());
 
-  return outimg;
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++) {
+      p = inimg.rowPtr(i,k);
+      q = outimg.rowPtr(i,k);
+      for (j=0; j<nc; j++)
+        q[j] = log(1.0+fabs(p[j]));
+    }
 }
 
 
@@ -129,10 +199,28 @@ Image logtran(Image &inimg) {
  * compress the low intensity content.
  * @return Image corrected by power-law transformation
  */
-Image powerlaw(Image &inimg, float gamma) {
+Image powerlaw(const Image &inimg, float gamma) {
   Image outimg;
+
+  powerlaw(inimg, gamma, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Power-law transformation into outimg, whose buffer is reused if
+ * possible.
+ * @param img Input image, can be outimg itself
+ * @param gamma The gamma value
+ * @param outimg Image corrected by power-law transformation
+ */
+void powerlaw(const Image &img, float gamma, Image &outimg) {
+  const Image inimg = img;      // shares the pixels, so outimg can be img
   int i, j, k;
   int nr, nc, ntype, nchan;
+  const float *p;
+  float *q;
 
   // allocate memory
   nr = inimg.getRow();
@@ -140,14 +228,16 @@ Image powerlaw(Image &inimg, float gamma) {
   ntype = inimg.getType();
   nchan = inimg.getChannel();
 
-  outimg.createImage(nr, nc, ntype);
+  outimg.createImageUninit(nr, nc, ntype);
+  outimg.setMaxval(inimg.getMaxval());
 
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        outimg(i,j,k) = pow(inimg(i,j,k), gamma);
-
-  return outimg;
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++) {
+      p = inimg.rowPtr(i,k);
+      q = outimg.rowPtr(i,k);
+      for (j=0; j<nc; j++)
+        q[j] = pow(p[j], gamma);
+    }
 }
 
 
@@ -159,10 +249,28 @@ Image powerlaw(Image &inimg, float gamma) {
  * thresholding; when nt==GRAY, using gray-level thresholding.
  * @return The thresholded image.
  */
-Image threshold(Image &inimg, float thresh, int nt) {
+Image threshold(const Image &inimg, float thresh, int nt) {
   Image outimg;
+
+  threshold(inimg, thresh, nt, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Thresholding into outimg, whose buffer is reused if possible.
+ * @param img The input image, can be outimg itself
+ * @param thresh The threshold.
+ * @param nt BINARY or GRAY.
+ * @param outimg The thresholded image.
+ */
+void threshold(const Image &img, float thresh, int nt, Image &outimg) {
+  const Image inimg = img;      // shares the pixels, so outimg can be img
   int i, j, k;
   int nr, nc, ntype, nchan;
+  const float *p;
+  float *q;
 
   // allocate memory
   nr = inimg.getRow();
@@ -170,20 +278,22 @@ Image threshold(Image &inimg, float thresh, int nt) {
   ntype = inimg.getType();
   nchan = inimg.getChannel();
 
-  outimg.createImage(nr, nc, ntype);
+  outimg.createImageUninit(nr, nc, ntype);
 
   if (nt != GRAY && nt != BINARY) 
     nt = BINARY;
-
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        if (inimg(i,j,k) >= thresh)
-          outimg(i,j,k) = (nt == GRAY) ? inimg(i,j,k) : L;
+  outimg.setMaxval((nt == GRAY) ? inimg.getMaxval() : (int)L);
+
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++) {
+      p = inimg.rowPtr(i,k);
+      q = outimg.rowPtr(i,k);
+      for (j=0; j<nc; j++)
+        if (p[j] >= thresh)
+          q[j] = (nt == GRAY) ? p[j] : L;
         else
-          outimg(i,j,k) = 0;
-
-  return outimg;
+          q[j] = 0;
+    }
 }
 
 /**
@@ -195,10 +305,31 @@ Image threshold(Image &inimg, float thresh, int nt) {
  * thresholding; when nt==GRAY, using gray-level thresholding.
  * @return The thresholded image.
  */
-Image threshold(Image &inimg, float lthresh, float uthresh, int nt) {
+Image threshold(const Image &inimg, float lthresh, float uthresh, int nt) {
   Image outimg;
+
+  threshold(inimg, lthresh, uthresh, nt, outimg);
+
+  return outimg;
+}
+
+
+/**
+ * Thresholding between certain range into outimg, whose buffer is
+ * reused if possible.
+ * @param img The input image, can be outimg itself
+ * @param lthresh The lower threshold.
+ * @param uthresh The upper threshold.
+ * @param nt BINARY or GRAY.
+ * @param outimg The thresholded image.
+ */
+void threshold(const Image &img, float lthresh, float uthresh, int nt,
+               Image &outimg) {
+  const Image inimg = img;      // shares the pixels, so outimg can be img
   int i, j;
   int nr, nc, ntype, nchan;
+  const float *p;
+  float *q;
 
   // allocate memory
   nr = inimg.getRow();
@@ -209,22 +340,198 @@ Image threshold(Image &inimg, float lthresh, float uthresh, int nt) {
     cout << "threshold: can only handle single-channel image.\n";
     exit(3);
   }
-  outimg.createImage(nr, nc, ntype);
+  outimg.createImageUninit(nr, nc, ntype);
 
   if (nt != GRAY && nt != BINARY) 
     nt = BINARY;
+  outimg.setMaxval((nt == GRAY) ? inimg.getMaxval() : (int)L);
 
-  for (i=0; i<nr; i++)
+  for (i=0; i<nr; i++) {
+    p = inimg.rowPtr(i);
+    q = outimg.rowPtr(i);
     for (j=0; j<nc; j++)
-      if (inimg(i,j) >= lthresh && inimg(i,j) <= uthresh)
-          outimg(i,j) = (nt == GRAY) ? inimg(i,j) : L;
-        else
-          outimg(i,j) = 0;
+      if (p[j] >= lthresh && p[j] <= uthresh)
+        q[j] = (nt == GRAY) ? p[j] : L;
+      else
+        q[j] = 0;
+  }
+}
+
+
+/**
+ * Image negative of an 8-bit image, s = L - r, L being its maxval (255
+ * for 8-bit data, a pixel above it gives 0).
+ * @para inimg Input image
+ * @return Negative of the input image
+ */
+Image8 negative(const Image8 &inimg) {
+  Image8 outimg;
+
+  negative(inimg, outimg);
 
   return outimg;
 }
 
 
+/**
+ * Image negative of an 8-bit image into outimg, whose buffer is reused
+ * if possible.
+ * @param img Input image, can be outimg itself
+ * @param outimg Negative of the input image
+ */
+void negative(const Image8 &img, Image8 &outimg) {
+  const Image8 inimg = img;     // shares the pixels, so outimg can be img
+  int i, j, k;
+  int nc, nr, ntype, nchan;
+  int m;
+  const unsigned char *p;
+  unsigned char *q;
+
+  nc = inimg.getCol();
+  nr = inimg.getRow();
+  ntype = inimg.getType();
+  nchan = inimg.getChannel();
+  m = inimg.getMaxval();
+
+  outimg.createImageUninit(nr, nc, ntype);
+  outimg.setMaxval(m);
+
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++) {
+      p = inimg.rowPtr(i,k);
+      q = outimg.rowPtr(i,k);
+      for (j=0; j<nc; j++)
+        q[j] = (p[j] < m) ? m - p[j] : 0;
+    }
+}
+
+/**
+ * Thresholding an 8-bit image: pixels in [lo, hi] are kept (GRAY) or
+ * set to 255 (BINARY), the others are set to 0.
+ * @param img The input image, can be outimg itself.
+ * @param lo The smallest intensity kept.
+ * @param hi The largest intensity kept.
+ * @param nt BINARY or GRAY.
+ * @param outimg The thresholded image.
+ */
+static void threshold8(const Image8 &img, int lo, int hi, int nt,
+                       Image8 &outimg) {
+  const Image8 inimg = img;     // shares the pixels, so outimg can be img
+  int i, j, k, v, fg;
+  int nr, nc, ntype, nchan;
+  const unsigned char *p;
+  unsigned char *q;
+
+  nr = inimg.getRow();
+  nc = inimg.getCol();
+  ntype = inimg.getType();
+  nchan = inimg.getChannel();
+
+  outimg.createImageUninit(nr, nc, ntype);
+  outimg.setMaxval((nt == GRAY) ? inimg.getMaxval() : 255);
+
+  fg = (nt == GRAY) ? 0 : 255;   // OR-ed into the pixels kept
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++) {
+      p = inimg.rowPtr(i,k);
+      q = outimg.rowPtr(i,k);
+      for (j=0; j<nc; j++) {
+        v = p[j];
+        q[j] = (v >= lo && v <= hi) ? (v | fg) : 0;
+      }
+    }
+}
+
+/**
+ * Thresholding an 8-bit image to a gray-level or a binary image. The 
+ * result is the same as that of the float version.
+ * @param inimg The input image.
+ * @param thresh The threshold.
+ * @param nt The type of the resulting image. When nt==BINARY, using binary
+ * thresholding; when nt==GRAY, using gray-level thresholding.
+ * @return The thresholded image.
+ */
+Image8 threshold(const Image8 &inimg, float thresh, int nt) {
+  Image8 outimg;
+
+  threshold(inimg, thresh, nt, outimg);
+
+  return outimg;
+}
+
+/**
+ * Thresholding an 8-bit image into outimg, whose buffer is reused if
+ * possible.
+ * @param inimg The input image, can be outimg itself.
+ * @param thresh The threshold.
+ * @param nt BINARY or GRAY.
+ * @param outimg The thresholded image.
+ */
+void threshold(const Image8 &inimg, float thresh, int nt, Image8 &outimg) {
+  if (nt != GRAY && nt != BINARY) 
+    nt = BINARY;
+
+  // the smallest integer intensity that is >= thresh
+  thresh = ceil(thresh);
+  if (thresh < 0)
+    thresh = 0;
+  if (thresh > 256)
+    thresh = 256;
+
+  threshold8(inimg, (int)thresh, 255, nt, outimg);
+}
+
+/**
+ * Thresholding an 8-bit image to a gray-level or a binary image between 
+ * certain range. The result is the same as that of the float version.
+ * @param inimg The input image.
+ * @param lthresh The lower threshold.
+ * @param uthresh The upper threshold.
+ * @param nt The type of the resulting image. When nt==BINARY, using binary
+ * thresholding; when nt==GRAY, using gray-level thresholding.
+ * @return The thresholded image.
+ */
+Image8 threshold(const Image8 &inimg, float lthresh, float uthresh, int nt) {
+  Image8 outimg;
+
+  threshold(inimg, lthresh, uthresh, nt, outimg);
+
+  return outimg;
+}
+
+/**
+ * Thresholding an 8-bit image between certain range into outimg, whose
+ * buffer is reused if possible.
+ * @param inimg The input image, can be outimg itself.
+ * @param lthresh The lower threshold.
+ * @param uthresh The upper threshold.
+ * @param nt BINARY or GRAY.
+ * @param outimg The thresholded image.
+ */
+void threshold(const Image8 &inimg, float lthresh, float uthresh, int nt,
+               Image8 &outimg) {
+  if (inimg.getChannel() > 1) {
+    cout << "threshold: can only handle single-channel image.\n";
+    exit(3);
+  }
+  if (nt != GRAY && nt != BINARY) 
+    nt = BINARY;
+
+  // the range of integer intensities within [lthresh, uthresh]
+  lthresh = ceil(lthresh);
+  uthresh = floor(uthresh);
+  if (lthresh < 0)
+    lthresh = 0;
+  if (lthresh > 256)
+    lthresh = 256;
+  if (uthresh < -1)
+    uthresh = -1;
+  if (uthresh > 255)
+    uthresh = 255;
+
+  threshold8(inimg, (int)lthresh, (int)uthresh, nt, outimg);
+}
+
 /**
  * Automatic thresholding using Otsu's method
  * Qi (10/06/07) revision:
@@ -233,7 +540,7 @@ Image threshold(Image &inimg, float lthresh, float uthresh, int nt) {
  * @param inimg The input image.
  * @return The thresholded image and the threshold automatically determined.
  */
-Image autoThreshold(Image &inimg) {
+Image autoThreshold(const Image &inimg) {
   Image temp;
   float maxi, mini;
   float *hist, *chist, *ihist;  // histogram, cumulative histogram, and
@@ -253,12 +560,11 @@ Image autoThreshold(Image &inimg) {
   }
 
   // check the range of the pixel intensity. rescale if out-of-range
-  maxi = inimg.getMaximum();    // wonder if we should just make
-  mini = inimg.getMinimum();    // getMaximum() return a scalar
+  inimg.getMinMax(mini, maxi);  // both in one pass
   if (mini<0 || maxi>L) {
     cout << "autoThreshold: "
          << "The intensity value is outside [0, " << L << "], rescale.\n";
-    temp = rescale(inimg);
+    temp = rescale(inimg, 0, L);
   }
   else
     temp = inimg;
@@ -319,7 +625,7 @@ Image autoThreshold(Image &inimg) {
  * @param inimg Input 8-bit b/w image.
  * @param outimg An array of 8 binary images.
  */
-void bitplane(Image &inimg, Image outimg[NBIT]) {
+void bitplane(const Image &inimg, Image outimg[NBIT]) {
   int nr, nc, nchan, nt;
   int i, j, k;
 
@@ -347,10 +653,12 @@ void bitplane(Image &inimg, Image outimg[NBIT]) {
  * @param s The downsample ratio (s > 1 and s is integer)
  * @return The downsampled image.
  */
-Image sampling(Image &inimg, int s) {
+Image sampling(const Image &inimg, int s) {
   Image outimg;
   int i, j, k;
   int nr, nc, ntype, nchan;
+  const float *p;
+  float *q;
 
   // check the range of s
   if (s < 1) {
@@ -364,12 +672,16 @@ Image sampling(Image &inimg, int s) {
   ntype = inimg.getType();
   nchan = inimg.getChannel();
 
-  outimg.createImage(nr, nc, ntype);
+  outimg.createImageUninit(nr, nc, ntype);
+  outimg.setMaxval(inimg.getMaxval());
 
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        outimg(i,j,k) = inimg(s*(i/s),s*(j/s),k);
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++) {
+      p = inimg.rowPtr(s*(i/s),k);
+      q = outimg.rowPtr(i,k);
+      for (j=0; j<nc; j++)
+        q[j] = p[s*(j/s)];
+    }
 
   return outimg;
 }
@@ -381,10 +693,12 @@ Image sampling(Image &inimg, int s) {
  * @param q The number of quantization levels
  * @return The quantized image
  */
-Image quantization(Image &inimg, int q) {
+Image quantization(const Image &inimg, int q) {
   Image outimg;
   int i, j, k;
   int nr, nc, ntype, nchan;
+  const float *p;
+  float *r;
 
   // allocate memory
   nr = inimg.getRow();
@@ -392,12 +706,15 @@ Image quantization(Image &inimg, int q) {
   ntype = inimg.getType();
   nchan = inimg.getChannel();
 
-  outimg.createImage(nr, nc, ntype);
+  outimg.createImageUninit(nr, nc, ntype);
 
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++)
-      for (k=0; k<nchan; k++)
-        outimg(i,j,k) = (int) (inimg(i,j,k) / ((L+1)/q));
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++) {
+      p = inimg.rowPtr(i,k);
+      r = outimg.rowPtr(i,k);
+      for (j=0; j<nc; j++)
+        r[j] = (int) (p[j] / ((L+1)/q));
+    }
 
   return outimg;
 }
@@ -408,7 +725,7 @@ Image quantization(Image &inimg, int q) {
  * @param inimg The input image 
  * @return The histogram equalized image. 
  */
-Image histeq(Image &inimg) {
+Image histeq(const Image &inimg) {
   Image outimg, temp;
   int nr, nc, nt, nchan;
   int i, j;
@@ -427,15 +744,14 @@ Image histeq(Image &inimg) {
   }
 
   // create histogram equalized image
-  outimg.createImage(nr, nc, nt);
+  outimg.createImageUninit(nr, nc, nt);
 
   // check the range of the pixel intensity. rescale if out-of-range
-  maxi = inimg.getMaximum();
-  mini = inimg.getMinimum();
+  inimg.getMinMax(mini, maxi);  // both in one pass
   if (mini<0 || maxi>L) {
     cout << "histeq: "
          << "The intensity value is outside [0, " << L << "], rescale.\n";
-    temp = rescale(inimg);
+    temp = rescale(inimg, 0, L);
   }
   else
     temp = inimg;
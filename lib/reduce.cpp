@@ -0,0 +1,555 @@
+/**********************************************************
+ * reduce.cpp - reductions over one row of pixels
+ *              (see Reduce.h)
+ *
+ *   - rowMinMax: smallest and largest pixel
+ *   - rowSumAbs: sum of the absolute values
+ *   - rowSumSq: sum of the squares
+ *   - rowSumSqDiff: sum of the squared differences
+ *   - rowWiden: convert 8-bit or 16-bit pixels to float
+ *   - rowPack: convert float pixels to 8-bit or 16-bit samples
+ *   - rowLoadBE16, rowStoreBE16: big-endian 16-bit samples
+ *
+ * Created: 10/17/26
+ **********************************************************/
+
+#include "Reduce.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+/**
+ * Merge the smallest and largest pixel of a float row into mini and maxi.
+ * The vector min/max return their second operand when the first is NaN,
+ * so NaN pixels are skipped, the same as by the comparisons of the loop.
+ * @param p The row.
+ * @param n The number of pixels.
+ * @param mini The minimum so far, updated.
+ * @param maxi The maximum so far, updated.
+ */
+void rowMinMax(const float *p, int n, float &mini, float &maxi) {
+  int j = 0;
+
+#if defined(__AVX__)
+  if (n >= 8) {
+    __m256 lo = _mm256_set1_ps(mini), hi = _mm256_set1_ps(maxi), x;
+    float a[8], b[8];
+    for (; j+8<=n; j+=8) {
+      x = _mm256_loadu_ps(p+j);
+      lo = _mm256_min_ps(x, lo);
+      hi = _mm256_max_ps(x, hi);
+    }
+    _mm256_storeu_ps(a, lo);
+    _mm256_storeu_ps(b, hi);
+    for (int m=0; m<8; m++) {
+      if (a[m] < mini)
+        mini = a[m];
+      if (b[m] > maxi)
+        maxi = b[m];
+    }
+  }
+#elif defined(__SSE2__)
+  if (n >= 4) {
+    __m128 lo = _mm_set1_ps(mini), hi = _mm_set1_ps(maxi), x;
+    float a[4], b[4];
+    for (; j+4<=n; j+=4) {
+      x = _mm_loadu_ps(p+j);
+      lo = _mm_min_ps(x, lo);
+      hi = _mm_max_ps(x, hi);
+    }
+    _mm_storeu_ps(a, lo);
+    _mm_storeu_ps(b, hi);
+    for (int m=0; m<4; m++) {
+      if (a[m] < mini)
+        mini = a[m];
+      if (b[m] > maxi)
+        maxi = b[m];
+    }
+  }
+#endif
+
+  for (; j<n; j++) {
+    if (p[j] < mini)
+      mini = p[j];
+    if (p[j] > maxi)
+      maxi = p[j];
+  }
+}
+
+/**
+ * Merge the smallest and largest pixel of an 8-bit row into mini and maxi.
+ * @param p The row.
+ * @param n The number of pixels.
+ * @param mini The minimum so far, updated.
+ * @param maxi The maximum so far, updated.
+ */
+void rowMinMax(const unsigned char *p, int n,
+               unsigned char &mini, unsigned char &maxi) {
+  int j = 0;
+
+#if defined(__AVX2__)
+  if (n >= 32) {
+    __m256i lo = _mm256_set1_epi8((char)mini), hi = _mm256_set1_epi8((char)maxi);
+    __m256i x;
+    unsigned char a[32], b[32];
+    for (; j+32<=n; j+=32) {
+      x = _mm256_loadu_si256((const __m256i *)(p+j));
+      lo = _mm256_min_epu8(lo, x);
+      hi = _mm256_max_epu8(hi, x);
+    }
+    _mm256_storeu_si256((__m256i *)a, lo);
+    _mm256_storeu_si256((__m256i *)b, hi);
+    for (int m=0; m<32; m++) {
+      if (a[m] < mini)
+        mini = a[m];
+      if (b[m] > maxi)
+        maxi = b[m];
+    }
+  }
+#elif defined(__SSE2__)
+  if (n >= 16) {
+    __m128i lo = _mm_set1_epi8((char)mini), hi = _mm_set1_epi8((char)maxi), x;
+    unsigned char a[16], b[16];
+    for (; j+16<=n; j+=16) {
+      x = _mm_loadu_si128((const __m128i *)(p+j));
+      lo = _mm_min_epu8(lo, x);
+      hi = _mm_max_epu8(hi, x);
+    }
+    _mm_storeu_si128((__m128i *)a, lo);
+    _mm_storeu_si128((__m128i *)b, hi);
+    for (int m=0; m<16; m++) {
+      if (a[m] < mini)
+        mini = a[m];
+      if (b[m] > maxi)
+        maxi = b[m];
+    }
+  }
+#endif
+
+  for (; j<n; j++) {
+    if (p[j] < mini)
+      mini = p[j];
+    if (p[j] > maxi)
+      maxi = p[j];
+  }
+}
+
+/**
+ * Merge the smallest and largest pixel of a 16-bit row into mini and
+ * maxi. Unsigned 16-bit min/max need SSE4.1, so without AVX2 this is
+ * left to the compiler, which vectorizes the integer loop by itself.
+ * @param p The row.
+ * @param n The number of pixels.
+ * @param mini The minimum so far, updated.
+ * @param maxi The maximum so far, updated.
+ */
+void rowMinMax(const unsigned short *p, int n,
+               unsigned short &mini, unsigned short &maxi) {
+  int j = 0;
+  unsigned short lo = mini, hi = maxi;
+
+#if defined(__AVX2__)
+  if (n >= 16) {
+    __m256i vlo = _mm256_set1_epi16((short)lo), vhi = _mm256_set1_epi16((short)hi);
+    __m256i x;
+    unsigned short a[16], b[16];
+    for (; j+16<=n; j+=16) {
+      x = _mm256_loadu_si256((const __m256i *)(p+j));
+      vlo = _mm256_min_epu16(vlo, x);
+      vhi = _mm256_max_epu16(vhi, x);
+    }
+    _mm256_storeu_si256((__m256i *)a, vlo);
+    _mm256_storeu_si256((__m256i *)b, vhi);
+    for (int m=0; m<16; m++) {
+      lo = (a[m] < lo) ? a[m] : lo;
+      hi = (b[m] > hi) ? b[m] : hi;
+    }
+  }
+#endif
+
+  for (; j<n; j++) {
+    lo = (p[j] < lo) ? p[j] : lo;
+    hi = (p[j] > hi) ? p[j] : hi;
+  }
+  mini = lo;
+  maxi = hi;
+}
+
+
+// the sums below convert the floats to double and keep two vector
+// accumulators; OP(x) is applied to each vector of floats first
+#if defined(__AVX__)
+#define ROW_SUM(OP)                                                     \
+  if (n >= 8) {                                                         \
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();         \
+    __m256 x;                                                           \
+    double a[4];                                                        \
+    for (; j+8<=n; j+=8) {                                              \
+      x = OP(j);                                                        \
+      s0 = _mm256_add_pd(s0, _mm256_cvtps_pd(_mm256_castps256_ps128(x)));\
+      s1 = _mm256_add_pd(s1, _mm256_cvtps_pd(_mm256_extractf128_ps(x,1)));\
+    }                                                                   \
+    _mm256_storeu_pd(a, _mm256_add_pd(s0, s1));                         \
+    sum = (a[0] + a[1]) + (a[2] + a[3]);                                \
+  }
+#elif defined(__SSE2__)
+#define ROW_SUM(OP)                                                     \
+  if (n >= 4) {                                                         \
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();               \
+    __m128 x;                                                           \
+    double a[2];                                                        \
+    for (; j+4<=n; j+=4) {                                              \
+      x = OP(j);                                                        \
+      s0 = _mm_add_pd(s0, _mm_cvtps_pd(x));                             \
+      s1 = _mm_add_pd(s1, _mm_cvtps_pd(_mm_movehl_ps(x, x)));           \
+    }                                                                   \
+    _mm_storeu_pd(a, _mm_add_pd(s0, s1));                               \
+    sum = a[0] + a[1];                                                  \
+  }
+#else
+#define ROW_SUM(OP)
+#endif
+
+/**
+ * Sum of the absolute values of a row.
+ * @param p The row.
+ * @param n The number of pixels.
+ * @return The sum.
+ */
+double rowSumAbs(const float *p, int n) {
+  double sum = 0;
+  int j = 0;
+
+#if defined(__AVX__)
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+#define ABS(j) _mm256_andnot_ps(sign, _mm256_loadu_ps(p+(j)))
+#elif defined(__SSE2__)
+  const __m128 sign = _mm_set1_ps(-0.0f);
+#define ABS(j) _mm_andnot_ps(sign, _mm_loadu_ps(p+(j)))
+#endif
+  ROW_SUM(ABS)
+#undef ABS
+
+  for (; j<n; j++)
+    sum += fabs(p[j]);
+  return sum;
+}
+
+/**
+ * Sum of the squares of a row, each square is computed in float.
+ * @param p The row.
+ * @param n The number of pixels.
+ * @return The sum.
+ */
+double rowSumSq(const float *p, int n) {
+  double sum = 0;
+  float v;
+  int j = 0;
+
+#if defined(__AVX__)
+#define SQ(j) _mm256_mul_ps(_mm256_loadu_ps(p+(j)), _mm256_loadu_ps(p+(j)))
+#elif defined(__SSE2__)
+#define SQ(j) _mm_mul_ps(_mm_loadu_ps(p+(j)), _mm_loadu_ps(p+(j)))
+#endif
+  ROW_SUM(SQ)
+#undef SQ
+
+  for (; j<n; j++) {
+    v = p[j] * p[j];
+    sum += v;
+  }
+  return sum;
+}
+
+/**
+ * Sum of the squared differences of two rows, computed in float.
+ * @param p The first row.
+ * @param q The second row.
+ * @param n The number of pixels.
+ * @return The sum.
+ */
+double rowSumSqDiff(const float *p, const float *q, int n) {
+  double sum = 0;
+  float v;
+  int j = 0;
+
+#if defined(__AVX__)
+  __m256 d;
+#define SQDIFF(j) (d = _mm256_sub_ps(_mm256_loadu_ps(p+(j)),            \
+                                     _mm256_loadu_ps(q+(j))),           \
+                   _mm256_mul_ps(d, d))
+#elif defined(__SSE2__)
+  __m128 d;
+#define SQDIFF(j) (d = _mm_sub_ps(_mm_loadu_ps(p+(j)), _mm_loadu_ps(q+(j))), \
+                   _mm_mul_ps(d, d))
+#endif
+  ROW_SUM(SQDIFF)
+#undef SQDIFF
+
+  for (; j<n; j++) {
+    v = (p[j] - q[j]) * (p[j] - q[j]);
+    sum += v;
+  }
+  return sum;
+}
+
+#undef ROW_SUM
+
+
+/**
+ * Convert a row of 8-bit pixels to float.
+ * @param p The 8-bit row.
+ * @param q The float row.
+ * @param n The number of pixels.
+ */
+void rowWiden(const unsigned char *p, float *q, int n) {
+  int j = 0;
+
+#if defined(__AVX2__)
+  for (; j+8<=n; j+=8)
+    _mm256_storeu_ps(q+j, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+                          _mm_loadl_epi64((const __m128i *)(p+j)))));
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  __m128i x, lo, hi;
+
+  for (; j+16<=n; j+=16) {
+    x = _mm_loadu_si128((const __m128i *)(p+j));
+    lo = _mm_unpacklo_epi8(x, zero);
+    hi = _mm_unpackhi_epi8(x, zero);
+    _mm_storeu_ps(q+j, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+    _mm_storeu_ps(q+j+4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+    _mm_storeu_ps(q+j+8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+    _mm_storeu_ps(q+j+12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+  }
+#endif
+
+  for (; j<n; j++)
+    q[j] = p[j];
+}
+
+/**
+ * Convert a row of 16-bit pixels to float.
+ * @param p The 16-bit row.
+ * @param q The float row.
+ * @param n The number of pixels.
+ */
+void rowWiden(const unsigned short *p, float *q, int n) {
+  int j = 0;
+
+#if defined(__AVX2__)
+  for (; j+8<=n; j+=8)
+    _mm256_storeu_ps(q+j, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+                          _mm_loadu_si128((const __m128i *)(p+j)))));
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  __m128i x;
+
+  for (; j+8<=n; j+=8) {
+    x = _mm_loadu_si128((const __m128i *)(p+j));
+    _mm_storeu_ps(q+j, _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero)));
+    _mm_storeu_ps(q+j+4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero)));
+  }
+#endif
+
+  for (; j<n; j++)
+    q[j] = p[j];
+}
+
+
+// the float pixels p[j..j+w-1] rescaled if needed, clamped to [0, hi]
+// (NaN to 0: max returns its second operand when the first is NaN) and
+// truncated to 32-bit integers
+#if defined(__AVX2__)
+static inline __m256i packLanes(const float *p, int scaled, __m256 m,
+                                __m256 c, __m256 d, __m256 a, __m256 hi) {
+  __m256 x = _mm256_loadu_ps(p);
+
+  if (scaled)
+    x = _mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_sub_ps(x, m), c),
+                                    d), a);
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), hi);
+  return _mm256_cvttps_epi32(x);
+}
+#elif defined(__SSE2__)
+static inline __m128i packLanes(const float *p, int scaled, __m128 m,
+                                __m128 c, __m128 d, __m128 a, __m128 hi) {
+  __m128 x = _mm_loadu_ps(p);
+
+  if (scaled)
+    x = _mm_add_ps(_mm_div_ps(_mm_mul_ps(_mm_sub_ps(x, m), c), d), a);
+  x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), hi);
+  return _mm_cvttps_epi32(x);
+}
+#endif
+
+/**
+ * The sample of a float pixel, the same as the vector code computes.
+ */
+static inline float packOne(float x, int scaled, float m, float c, float d,
+                            float a, float hi) {
+  if (scaled)
+    x = (x - m) * c / d + a;
+  if (!(x > 0))
+    return 0;
+  return (x < hi) ? x : hi;
+}
+
+/**
+ * Convert a row of float pixels to 8-bit samples, clamped to [0, maxv]
+ * (at most 255) and truncated, rescaled first if d != 0, as
+ * (p[j]-m)*c/d + a. The saturating packs of AVX2/SSE2 turn 16 pixels
+ * into 16 bytes at a time.
+ * @param p The float row.
+ * @param q The samples.
+ * @param n The number of pixels.
+ * @param maxv The largest sample.
+ * @param m, c, d, a The rescaling; every sample is a when d == 0.
+ */
+void rowPack(const float *p, unsigned char *q, int n, int maxv,
+             float m, float c, float d, float a) {
+  int j = 0, scaled;
+  float hi;
+
+  hi = (float)((maxv < 255) ? maxv : 255);
+  if (d == 0) {                        // a constant channel
+    fill(q, q+n, (unsigned char)packOne(a, 0, 0, 0, 0, 0, hi));
+    return;
+  }
+  scaled = !(m == 0 && c == 1 && d == 1 && a == 0);
+
+#if defined(__AVX2__)
+  const __m256 vm = _mm256_set1_ps(m), vc = _mm256_set1_ps(c),
+               vd = _mm256_set1_ps(d), va = _mm256_set1_ps(a),
+               vh = _mm256_set1_ps(hi);
+  __m256i w;
+
+  for (; j+16<=n; j+=16) {
+    w = _mm256_packus_epi32(packLanes(p+j, scaled, vm, vc, vd, va, vh),
+                            packLanes(p+j+8, scaled, vm, vc, vd, va, vh));
+    w = _mm256_permute4x64_epi64(w, 0xd8);   // undo the per-lane packing
+    _mm_storeu_si128((__m128i *)(q+j),
+                     _mm_packus_epi16(_mm256_castsi256_si128(w),
+                                      _mm256_extracti128_si256(w, 1)));
+  }
+#elif defined(__SSE2__)
+  const __m128 vm = _mm_set1_ps(m), vc = _mm_set1_ps(c),
+               vd = _mm_set1_ps(d), va = _mm_set1_ps(a),
+               vh = _mm_set1_ps(hi);
+  __m128i lo, up;
+
+  for (; j+16<=n; j+=16) {             // the values fit in 16-bit ints
+    lo = _mm_packs_epi32(packLanes(p+j, scaled, vm, vc, vd, va, vh),
+                         packLanes(p+j+4, scaled, vm, vc, vd, va, vh));
+    up = _mm_packs_epi32(packLanes(p+j+8, scaled, vm, vc, vd, va, vh),
+                         packLanes(p+j+12, scaled, vm, vc, vd, va, vh));
+    _mm_storeu_si128((__m128i *)(q+j), _mm_packus_epi16(lo, up));
+  }
+#endif
+
+  for (; j<n; j++)
+    q[j] = (unsigned char)packOne(p[j], scaled, m, c, d, a, hi);
+}
+
+/**
+ * Convert a row of float pixels to 16-bit samples, clamped to [0, maxv]
+ * and truncated, rescaled first if d != 0, as (p[j]-m)*c/d + a.
+ * @see rowPack
+ */
+void rowPack(const float *p, unsigned short *q, int n, int maxv,
+             float m, float c, float d, float a) {
+  int j = 0, scaled;
+  float hi;
+
+  hi = (float)((maxv < 65535) ? maxv : 65535);
+  if (d == 0) {                        // a constant channel
+    fill(q, q+n, (unsigned short)packOne(a, 0, 0, 0, 0, 0, hi));
+    return;
+  }
+  scaled = !(m == 0 && c == 1 && d == 1 && a == 0);
+
+#if defined(__AVX2__)
+  const __m256 vm = _mm256_set1_ps(m), vc = _mm256_set1_ps(c),
+               vd = _mm256_set1_ps(d), va = _mm256_set1_ps(a),
+               vh = _mm256_set1_ps(hi);
+  __m256i w;
+
+  for (; j+16<=n; j+=16) {
+    w = _mm256_packus_epi32(packLanes(p+j, scaled, vm, vc, vd, va, vh),
+                            packLanes(p+j+8, scaled, vm, vc, vd, va, vh));
+    _mm256_storeu_si256((__m256i *)(q+j),
+                        _mm256_permute4x64_epi64(w, 0xd8));
+  }
+#elif defined(__SSE2__)
+  const __m128 vm = _mm_set1_ps(m), vc = _mm_set1_ps(c),
+               vd = _mm_set1_ps(d), va = _mm_set1_ps(a),
+               vh = _mm_set1_ps(hi);
+  const __m128i bias = _mm_set1_epi32(32768), flip = _mm_set1_epi16(-32768);
+
+  for (; j+8<=n; j+=8)                 // no unsigned pack: shift to signed
+    _mm_storeu_si128((__m128i *)(q+j), _mm_xor_si128(flip, _mm_packs_epi32(
+        _mm_sub_epi32(packLanes(p+j, scaled, vm, vc, vd, va, vh), bias),
+        _mm_sub_epi32(packLanes(p+j+4, scaled, vm, vc, vd, va, vh), bias))));
+#endif
+
+  for (; j<n; j++)
+    q[j] = (unsigned short)packOne(p[j], scaled, m, c, d, a, hi);
+}
+
+
+// swap the two bytes of each 16-bit lane; x86 is little-endian, so this
+// turns big-endian samples into native ones and back
+#if defined(__AVX2__)
+#define SWAP16(x) _mm256_or_si256(_mm256_slli_epi16(x, 8), _mm256_srli_epi16(x, 8))
+#define SWAP16_ROW(s, d)                                                \
+  for (; j+16<=n; j+=16)                                                \
+    _mm256_storeu_si256((__m256i *)(d), SWAP16(_mm256_loadu_si256(      \
+                        (const __m256i *)(s))));
+#elif defined(__SSE2__)
+#define SWAP16(x) _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8))
+#define SWAP16_ROW(s, d)                                                \
+  for (; j+8<=n; j+=8)                                                  \
+    _mm_storeu_si128((__m128i *)(d), SWAP16(_mm_loadu_si128(            \
+                     (const __m128i *)(s))));
+#else
+#define SWAP16_ROW(s, d)
+#endif
+
+/**
+ * Read n big-endian 16-bit samples into native 16-bit pixels.
+ * @param p The samples, 2n bytes.
+ * @param q The pixels.
+ * @param n The number of samples.
+ */
+void rowLoadBE16(const unsigned char *p, unsigned short *q, int n) {
+  int j = 0;
+
+  SWAP16_ROW(p+2*j, q+j)
+  for (; j<n; j++)
+    q[j] = (unsigned short)(p[2*j] << 8 | p[2*j+1]);
+}
+
+/**
+ * Write n native 16-bit pixels as big-endian samples.
+ * @param p The pixels.
+ * @param q The samples, 2n bytes.
+ * @param n The number of samples.
+ */
+void rowStoreBE16(const unsigned short *p, unsigned char *q, int n) {
+  int j = 0;
+
+  SWAP16_ROW(p+j, q+2*j)
+  for (; j<n; j++) {
+    q[2*j] = (unsigned char)(p[j] >> 8);
+    q[2*j+1] = (unsigned char)(p[j] & 0xff);
+  }
+}
+
+#undef SWAP16_ROW
+#undef SWAP16
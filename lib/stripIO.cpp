@@ -0,0 +1,372 @@
+/**********************************************************
+ * stripIO.cpp - read and write PGM/PPM images a strip of rows
+ *               at a time (see StripIO.h)
+ *
+ *   - StripReader: read the strips of an image file
+ *   - StripWriter: append the rows of strips to an image file
+ *
+ * Created: 10/17/26
+ **********************************************************/
+
+#include "StripIO.h"
+#include "PNMCodec.h"
+#include "Reduce.h"
+#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+
+/**
+ * Open an image file to be read a strip of rows at a time. The file is
+ * mapped in memory when possible, and read as a stream otherwise.
+ * @param fname The name of the file.
+ * @param n The number of rows of each strip, besides the halo.
+ * @param h The number of rows of context above and below each strip.
+ */
+StripReader::StripReader(char *fname, int n, int h) {
+  PNMMap m;
+
+  name = fname;
+  rows = (n > 0) ? n : 1;
+  halo = (h > 0) ? h : 0;
+  nextRow = first = start = nread = 0;
+  released = 0;
+  text = 0;
+
+  if (mapPNM(fname, m)) {
+    map = m.map;
+    bytes = m.bytes;
+    cur = (const char *) m.pixels;
+    madvise(map, bytes, MADV_SEQUENTIAL);
+  }
+  else {
+    map = 0;
+    bytes = 0;
+    cur = 0;
+    ifp.open(fname, ios::in | ios::binary);
+    if (!ifp) {
+      cout << "StripReader: Can't read image: " << fname << endl;
+      exit(1);
+    }
+    if (!parseHeader([&](char *line) {
+                       return ifp.getline(line, 80, '\n') ? 1 : 0;
+                     }, m)) {
+      cout << "StripReader: Can't identify image format." << endl;
+      exit(1);
+    }
+    if (m.nt == PGMASCII || m.nt == PPMASCII)
+      text = new PNMText;
+  }
+  if (m.scale != 0) {
+    cout << "StripReader: the rows of a PFM file are stored bottom up, "
+         << "read " << fname << " with readImage()\n";
+    exit(3);
+  }
+  if (m.band != 0 || m.tile != 0) {
+    cout << "StripReader: the rows of a packed or tiled file are coded "
+         << "in bands or tiles, read " << fname << " with readImage()\n";
+    exit(3);
+  }
+  nr = m.nr;
+  nc = m.nc;
+  nt = m.nt;
+  nchan = m.nchan;
+  maxval = m.maxval;
+  bps = sampleBytes(m);
+  raw.resize((map || text) ? 0 : (size_t)nc * nchan * bps);
+  if (bps == 2)
+    wide.resize((size_t)nc * nchan);
+
+  buf.createImageUninit(min(nr, rows + 2*halo), nc, nt);
+  buf.setMaxval(maxval);
+}
+
+/**
+ * Close the file.
+ */
+StripReader::~StripReader() {
+  if (map)
+    munmap(map, bytes);
+  delete text;
+}
+
+/**
+ * Returns the number of rows of the image.
+ * @return Number of rows.
+ */
+int StripReader::getRow() const {
+  return nr;
+}
+
+/**
+ * Returns the number of columns of the image.
+ * @return Number of columns.
+ */
+int StripReader::getCol() const {
+  return nc;
+}
+
+/**
+ * Returns the number of channels of the image.
+ * @return Number of channels.
+ */
+int StripReader::getChannel() const {
+  return nchan;
+}
+
+/**
+ * Returns the type of the image file.
+ * @return The type (PGMRAW, PPMRAW, PGMASCII, PPMASCII).
+ */
+int StripReader::getType() const {
+  return nt;
+}
+
+/**
+ * Returns the maximum value of the image file.
+ * @return The maximum value.
+ */
+int StripReader::getMaxval() const {
+  return maxval;
+}
+
+/**
+ * Returns the image row of the first own row of the last strip.
+ * @return The row index.
+ */
+int StripReader::getFirst() const {
+  return first;
+}
+
+/**
+ * Returns the number of halo rows above the first own row of the last
+ * strip, i.e., the strip row of that row. It is less than the halo at
+ * the top of the image.
+ * @return The number of rows.
+ */
+int StripReader::getTop() const {
+  return first - start;
+}
+
+/**
+ * Read the next strip: its own rows, at most the n rows given to the
+ * constructor, and the halo rows above and below them that are in the
+ * image. The rows shared with the previous strip are not read again. The
+ * strip is a view of a buffer kept by the reader, which is reused if the
+ * caller does not keep the previous strip.
+ * @param strip The strip.
+ * @return The number of own rows, 0 once the whole image is read.
+ */
+int StripReader::next(Image &strip) {
+  int n, a, b, i, k;
+  size_t done;
+  float *p, *q;
+
+  strip = Image();                     // let buf be modified in place
+  if (nextRow >= nr)
+    return 0;
+
+  n = min(rows, nr - nextRow);
+  a = max(0, nextRow - halo);          // the image rows of the strip
+  b = min(nr, nextRow + n + halo);
+
+  // move the rows read already to the top, then read the others
+  if (a > start)
+    for (k=0; k<nchan; k++)
+      for (i=a; i<nread; i++) {
+        p = buf.rowPtr(i-start, k);
+        q = buf.rowPtr(i-a, k);
+        copy(p, p+nc, q);
+      }
+  readRows(nread-a, b-nread);
+
+  start = a;
+  nread = b;
+  first = nextRow;
+  nextRow += n;
+
+  if (b-a < buf.getRow())
+    strip = buf.getSubImage(0, 0, b-a-1, nc-1);
+  else
+    strip = buf;
+
+  // drop the pages of the mapping that have been read
+  if (map) {
+    done = (cur - (const char *) map) / sysconf(_SC_PAGESIZE)
+           * sysconf(_SC_PAGESIZE);
+    if (done > released) {
+      madvise((char *) map + released, done - released, MADV_DONTNEED);
+      released = done;
+    }
+  }
+
+  return n;
+}
+
+/**
+ * Read the next n rows of the file into the rows from i0 of the buffer.
+ * @param i0 The first row of the buffer.
+ * @param n The number of rows.
+ */
+void StripReader::readRows(int i0, int n) {
+  PNMHeader h = {nr, nc, nt, nchan, maxval, 0, 0, 0, 0};
+  const unsigned char *s;
+  int i;
+  size_t len;
+
+  len = (size_t)nc * nchan * bps;
+  for (i=i0; i<i0+n; i++) {
+    if (text)                          // ASCII, read as a stream
+      textRow(ifp, *text, buf, i, name.c_str());
+    else if (nt == PGMASCII || nt == PPMASCII)
+      cur = textRow(cur, (const char *) map + bytes, buf, i, name.c_str());
+    else {
+      if (map) {
+        s = (const unsigned char *) cur;
+        cur += len;
+      }
+      else {
+        ifp.read((char *) raw.data(), len);
+        if ((size_t)ifp.gcount() < len) {
+          cout << "StripReader: " << name << " is truncated\n";
+          exit(1);
+        }
+        s = raw.data();
+      }
+      rawRow(s, h, buf, i, wide.data());
+    }
+  }
+}
+
+
+/**
+ * Create an image file to be written a strip of rows at a time.
+ * @param fname The name of the file.
+ * @param r The number of rows of the image.
+ * @param c The number of columns of the image.
+ * @param t The type of the image (PGMRAW, PPMRAW, PGMASCII, PPMASCII).
+ * @param m The maximum value, two bytes a raw sample when above 255.
+ */
+StripWriter::StripWriter(char *fname, int r, int c, int t, int m) {
+  if (t == PGMPACK || t == PPMPACK || t == PGMTILE || t == PPMTILE) {
+    cout << "StripWriter: packed and tiled files are written whole, "
+         << "with writeImage()\n";
+    exit(3);
+  }
+  name = fname;
+  nr = r;
+  nc = c;
+  nt = t;
+  nchan = (t == PPMRAW || t == PPMASCII) ? 3 : 1;
+  nwritten = 0;
+  if (m < 1 || m > 65535) {
+    cout << "StripWriter: the maximum value should be within [1, 65535]\n";
+    exit(3);
+  }
+  maxval = m;
+
+  ofp.open(fname, ios::out | ios::binary);
+  if (!ofp) {
+    cout << "StripWriter: Can't write image: " << fname << endl;
+    exit(1);
+  }
+
+  // Write the format ID
+  switch (nt) {
+  case PGMRAW:
+    ofp << "P5" << endl;
+    break;
+  case PPMRAW:
+    ofp << "P6" << endl;
+    break;
+  case PGMASCII:
+    ofp << "P2" << endl;
+    break;
+  case PPMASCII:
+    ofp << "P3" << endl;
+    break;
+  default:
+    cout << "StripWriter: Can't identify image type\n";
+  }
+  ofp << nc << " " << nr << endl;
+  ofp << maxval << endl;
+
+  // a row, at most 5 digits and a newline per ASCII sample
+  text.resize((size_t)nc * nchan * 6 + 1);
+  row.resize((size_t)nc * nchan);
+}
+
+/**
+ * Close the file, telling if rows are missing.
+ */
+StripWriter::~StripWriter() {
+  if (nwritten < nr)
+    cout << "StripWriter: only " << nwritten << " of " << nr
+         << " rows written to " << name << endl;
+  ofp.close();
+}
+
+/**
+ * Returns the number of rows written so far.
+ * @return Number of rows.
+ */
+int StripWriter::getWritten() const {
+  return nwritten;
+}
+
+/**
+ * Append rows of a strip to the file, converted by packSamples() to
+ * samples clamped to [0, maxval] (the maxval of the file).
+ * @param strip The strip, as wide as the image, with as many channels.
+ * @param first The first row of the strip to write.
+ * @param n The number of rows to write, -1 to write to the end.
+ */
+void StripWriter::write(const Image &strip, int first, int n) {
+  Image s;
+  char *p;
+  int i, j;
+
+  if (n < 0)
+    n = strip.getRow() - first;
+  if (strip.getCol() != nc || strip.getChannel() != nchan ||
+      first < 0 || first + n > strip.getRow()) {
+    cout << "StripWriter: the strip does not fit the image\n";
+    exit(3);
+  }
+  if (nwritten + n > nr) {
+    cout << "StripWriter: more rows than the image has\n";
+    exit(3);
+  }
+
+  s = strip;                           // the same pixels, with the maxval
+  s.setMaxval(maxval);                 // of the file
+  for (i=first; i<first+n; i++) {
+    p = text.data();
+    if ((nt == PGMRAW || nt == PPMRAW) && maxval <= 255) {
+      packSamples(s, i, (unsigned char *) p, plane8, 0);
+      p += (size_t)nc * nchan;
+    }
+    else {
+      packSamples(s, i, row.data(), plane16, 0);
+      if (nt == PGMRAW || nt == PPMRAW) {
+        rowStoreBE16(row.data(), (unsigned char *) p, nc * nchan);
+        p += (size_t)nc * nchan * 2;
+      }
+      else
+        for (j=0; j<nc*nchan; j++) {
+          p = to_chars(p, text.data() + text.size(), row[j]).ptr;
+          *p++ = '\n';
+        }
+    }
+    ofp.write(text.data(), p - text.data());
+  }
+  if (!ofp) {
+    cout << "StripWriter: Can't write image: " << name << endl;
+    exit(1);
+  }
+  nwritten += n;
+}
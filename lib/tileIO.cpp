@@ -0,0 +1,417 @@
+/**********************************************************
+ * tileIO.cpp - write and read tiled image files, with
+ *              reduced-resolution levels (see TileIO.h)
+ *
+ *   - writeTiled: write an image to a tiled file
+ *   - TiledReader: read a region of a level of a tiled file
+ *
+ * Created: 10/17/26
+ *
+ * Modified:
+ *   - 10/17/26: a failed write to a tiled file is reported
+ **********************************************************/
+
+#include "TileIO.h"
+#include "PNMCodec.h"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <algorithm>
+#include <sys/mman.h>
+
+using namespace std;
+
+
+/**
+ * Halve the size of an image, each pixel the mean of a 2x2 block of the
+ * samples written for the image (clamped to [0, maxval], or rescaled, as
+ * writeImage() does), the last row or column repeated when the size is
+ * odd; a level of a tiled file from the one above, so that no level
+ * holds a value the level above could not. The means are samples too,
+ * their fraction dropped as writeImage() does.
+ * @param img The image.
+ * @param r The map of each channel done by rescale(), or 0.
+ * @return The image of half the size, with the maxval of img.
+ */
+template <class T>
+static Image16 halve(const BasicImage<T> &img, const RescaleMap *r) {
+  Image16 out;
+  const unsigned short *a, *b;
+  unsigned short *q;
+  int i, j, k, nr, nc, nchan;
+  vector<unsigned short> top, bottom, plane;
+
+  nr = img.getRow();
+  nc = img.getCol();
+  nchan = img.getChannel();
+  out.createImageUninit((nr + 1) / 2, (nc + 1) / 2, img.getType());
+  out.setMaxval(img.getMaxval());
+  top.resize((size_t)nc * nchan);
+  bottom.resize((size_t)nc * nchan);
+  for (i=0; i<out.getRow(); i++) {
+    packSamples(img, 2*i, top.data(), plane, r);
+    packSamples(img, min(2*i+1, nr-1), bottom.data(), plane, r);
+    for (k=0; k<nchan; k++) {
+      a = top.data() + k;                // interleaved samples
+      b = bottom.data() + k;
+      q = out.rowPtr(i, k);
+      for (j=0; j<nc/2; j++)
+        q[j] = (a[2*j*nchan] + a[(2*j+1)*nchan] + b[2*j*nchan] +
+                b[(2*j+1)*nchan]) >> 2;
+      if (nc % 2)
+        q[j] = (a[2*j*nchan] + b[2*j*nchan]) >> 1;
+    }
+  }
+
+  return out;
+}
+
+/**
+ * Exit if a write to a file failed (e.g., the disk is full).
+ * @param ofp The file.
+ * @param fname The name of the file.
+ */
+static void checkWrite(const ofstream &ofp, const char *fname) {
+  if (!ofp) {
+    cout << "writeImage: Can't write image: " << fname << endl;
+    exit(1);
+  }
+}
+
+/**
+ * Code a tile of an image (see writeTiles()).
+ * @param img The image.
+ * @param i The top row of the tile.
+ * @param j The left column of the tile.
+ * @param tile The size of the tiles.
+ * @param r The map of each channel done by rescale(), or 0.
+ * @param out The tile.
+ */
+template <class T>
+static void packTile(const BasicImage<T> &img, int i, int j, int tile,
+                     const RescaleMap *r, vector<unsigned char> &out) {
+  BasicImage<T> t;
+
+  t = img.getSubImage(i, j, min(i + tile, img.getRow()) - 1,
+                      min(j + tile, img.getCol()) - 1);
+  if (img.getMaxval() > 255)
+    packBand<unsigned short>(t, 0, t.getRow(), r, out);
+  else
+    packBand<unsigned char>(t, 0, t.getRow(), r, out);
+}
+
+/**
+ * Code the tiles of a level and write them, a row of tiles at a time,
+ * the tiles of a row coded by separate threads.
+ * @param lev The level.
+ * @param tile The size of the tiles.
+ * @param r The map of each channel done by rescale(), or 0.
+ * @param ofp The file.
+ * @param off The offset in the file of the next tile, moved past the
+ *            tiles of the level.
+ * @param index Where to store the offset of the next tile, moved past
+ *              the tiles of the level.
+ */
+template <class T>
+static void writeLevel(const BasicImage<T> &lev, int tile,
+                       const RescaleMap *r, ofstream &ofp, size_t &off,
+                       unsigned char *&index) {
+  int i, t, across;
+
+  across = (lev.getCol() + tile - 1) / tile;
+  vector<vector<unsigned char> > tiles(across);
+  for (i=0; i<lev.getRow(); i+=tile) {
+    eachBand(across, [&](int t) {
+        packTile(lev, i, t * tile, tile, r, tiles[t]);
+      });
+    for (t=0; t<across; t++) {
+      storeLE64(index, off);
+      index += 8;
+      ofp.write((char *) tiles[t].data(), tiles[t].size());
+      off += tiles[t].size();
+    }
+  }
+}
+
+/**
+ * Write an image to a tiled file (see TileIO.h), its samples clamped to
+ * [0, maxval] as writePNM() does. The header of a PGM/PPM file has the
+ * magic number Pt (PT for color) and a fourth line, the size of the tiles
+ * and the number of levels. It is followed by the offsets in the file of
+ * the tiles (8 bytes each, least significant first), level after level
+ * and row after row of tiles, and of the end of the last tile, then the
+ * tiles, each a band of a packed file (see unpackBand()). The tiles are
+ * written as they are coded, a row of tiles at a time, and the offsets
+ * once all are written; only the level being written and the next one
+ * are kept in memory.
+ * @param img The image to be output.
+ * @param fname The output file name.
+ * @param tile The size of the tiles.
+ * @param r The map of each channel done by rescale(), or 0.
+ */
+template <class T>
+void writeTiles(const BasicImage<T> &img, char *fname, int tile,
+                const RescaleMap *r) {
+  ofstream ofp;
+  string head;
+  size_t off;
+  unsigned char *at;
+  int n, l, nr, nc, levels;
+  Image16 cur;                         // the level being written
+
+  if (tile < 1) {
+    cout << "writeTiled: the size of the tiles needs to be at least 1\n";
+    exit(3);
+  }
+
+  // the levels, until one fits in a tile, and the number of their tiles
+  n = 0;
+  for (l=0; ; l++) {
+    nr = (int)(((long)img.getRow() + (1L << l) - 1) >> l);
+    nc = (int)(((long)img.getCol() + (1L << l) - 1) >> l);
+    n += ((nr + tile - 1) / tile) * ((nc + tile - 1) / tile);
+    if (nr <= tile && nc <= tile)
+      break;
+  }
+  levels = l + 1;
+
+  ofp.open(fname, ios::out | ios::binary);
+  if (!ofp) {
+    cout << "writeImage: Can't write image: " << fname << endl;
+    exit(1);
+  }
+  head = string((img.getChannel() == 1) ? "Pt\n" : "PT\n") +
+         to_string(img.getCol()) + " " + to_string(img.getRow()) + "\n" +
+         to_string(img.getMaxval()) + "\n" + to_string(tile) + " " +
+         to_string(levels) + "\n";
+  vector<unsigned char> index(8 * ((size_t)n + 1));
+  ofp.write(head.data(), head.size());
+  ofp.write((char *) index.data(), index.size());   // written again below
+  checkWrite(ofp, fname);
+
+  // level 0 is coded from the image, the others from the samples of the
+  // level above, already mapped by rescale() when asked to
+  off = head.size() + index.size();
+  at = index.data();
+  writeLevel(img, tile, r, ofp, off, at);
+  checkWrite(ofp, fname);
+  for (l=1; l<levels; l++) {
+    cur = (l == 1) ? halve(img, r) : halve(cur, 0);
+    writeLevel(cur, tile, 0, ofp, off, at);
+    checkWrite(ofp, fname);
+  }
+  storeLE64(at, off);
+
+  ofp.seekp(head.size());
+  ofp.write((char *) index.data(), index.size());
+  ofp.close();
+  checkWrite(ofp, fname);
+}
+
+template void writeTiles(const Image &, char *, int, const RescaleMap *);
+template void writeTiles(const Image8 &, char *, int, const RescaleMap *);
+template void writeTiles(const Image16 &, char *, int, const RescaleMap *);
+
+
+/**
+ * Write an image to a tiled file (see TileIO.h), with levels reduced 2,
+ * 4, 8, ... times until one fits in a tile. The pixels are clamped to
+ * [0, maxval] as writeImage() does.
+ * @param inimg The image to be output.
+ * @param fname The output file name.
+ * @param tile The size of the tiles.
+ * @param flag The rescale flag. Rescale when true.
+ */
+void writeTiled(const Image &inimg, char *fname, int tile, int flag) {
+  RescaleMap r[3];
+
+  if (flag)
+    r[0] = r[1] = r[2] = rescaleMap(inimg, 0, inimg.getMaxval());
+  writeTiles(inimg, fname, tile, flag ? r : 0);
+}
+
+void writeTiled(const Image8 &inimg, char *fname, int tile) {
+  writeTiles(inimg, fname, tile, 0);
+}
+
+void writeTiled(const Image16 &inimg, char *fname, int tile) {
+  writeTiles(inimg, fname, tile, 0);
+}
+
+
+/**
+ * Open a tiled file (see TileIO.h), which is mapped in memory; only the
+ * tiles read are paged in.
+ * @param fname The name of the file.
+ */
+TiledReader::TiledReader(char *fname) {
+  PNMMap m;
+  int l, n;
+
+  name = fname;
+  if (!mapPNM(fname, m)) {
+    cout << "TiledReader: Can't read image: " << fname << endl;
+    exit(1);
+  }
+  map = m.map;
+  bytes = m.bytes;
+  if (m.tile == 0) {
+    cout << "TiledReader: " << fname << " is not a tiled image\n";
+    exit(1);
+  }
+  madvise(map, bytes, MADV_RANDOM);
+  nr = m.nr;
+  nc = m.nc;
+  nchan = m.nchan;
+  maxval = m.maxval;
+  tile = m.tile;
+  levels = m.levels;
+
+  first.resize(levels + 1);
+  for (l=0, n=0; l<levels; l++) {
+    first[l] = n;
+    n += ((getRow(l) + tile - 1) / tile) * ((getCol(l) + tile - 1) / tile);
+  }
+  first[levels] = n;
+  index = m.pixels;
+  if ((size_t)((unsigned char *) map + bytes - index) < 8 * ((size_t)n + 1)) {
+    cout << "TiledReader: " << fname << " is truncated\n";
+    exit(1);
+  }
+}
+
+/**
+ * Unmap the file.
+ */
+TiledReader::~TiledReader() {
+  munmap(map, bytes);
+}
+
+/**
+ * Returns the number of rows of a level, ceil(rows/2^level).
+ * @param level The level, 0 for the full size.
+ * @return The number of rows.
+ */
+int TiledReader::getRow(int level) const {
+  return (int)(((long)nr + (1L << level) - 1) >> level);
+}
+
+/**
+ * Returns the number of columns of a level, ceil(cols/2^level).
+ * @param level The level, 0 for the full size.
+ * @return The number of columns.
+ */
+int TiledReader::getCol(int level) const {
+  return (int)(((long)nc + (1L << level) - 1) >> level);
+}
+
+/**
+ * Returns the number of channels of the image.
+ * @return The number of channels.
+ */
+int TiledReader::getChannel() const {
+  return nchan;
+}
+
+/**
+ * Returns the maximum value of the samples.
+ * @return The maxval.
+ */
+int TiledReader::getMaxval() const {
+  return maxval;
+}
+
+/**
+ * Returns the number of levels, the last one fits in a tile.
+ * @return The number of levels.
+ */
+int TiledReader::getLevels() const {
+  return levels;
+}
+
+/**
+ * Returns the size of the tiles.
+ * @return The number of rows (and columns) of a tile.
+ */
+int TiledReader::getTile() const {
+  return tile;
+}
+
+/**
+ * Read a region of a level into an image of pixel type T. The tiles
+ * under the region are decoded by separate threads, the others are not
+ * touched.
+ * @param roi The region, of type PGMRAW or PPMRAW.
+ * @param top The top row of the region.
+ * @param left The left column of the region.
+ * @param r The number of rows of the region.
+ * @param c The number of columns of the region.
+ * @param level The level.
+ */
+template <class T>
+void TiledReader::region(BasicImage<T> &roi, int top, int left, int r,
+                         int c, int level) {
+  int ty, tx, nx, across;
+
+  if (level < 0 || level >= levels || top < 0 || left < 0 || r < 1 ||
+      c < 1 || top + r > getRow(level) || left + c > getCol(level)) {
+    cout << "TiledReader: the region is not within level " << level
+         << " of " << name << endl;
+    exit(3);
+  }
+  roi.createImageUninit(r, c, (nchan == 1) ? PGMRAW : PPMRAW);
+  roi.setMaxval(maxval);
+
+  across = (getCol(level) + tile - 1) / tile;
+  ty = top / tile;
+  tx = left / tile;
+  nx = (left + c - 1) / tile - tx + 1;
+  eachBand(((top + r - 1) / tile - ty + 1) * nx, [&](int b) {
+      BasicImage<T> t;
+      size_t off, end;
+      int i0, j0, i, j, k, n, m, u;
+
+      i0 = (ty + b / nx) * tile;       // the tile, at (i0, j0)
+      j0 = (tx + b % nx) * tile;
+      k = first[level] + (i0 / tile) * across + j0 / tile;
+      off = loadLE64(index + 8*k);
+      end = loadLE64(index + 8*k + 8);
+      if (off > end || end > bytes || end - off < 8) {
+        cout << "TiledReader: " << name << " is truncated or corrupt\n";
+        exit(1);
+      }
+      t.createImageUninit(min(tile, getRow(level) - i0),
+                          min(tile, getCol(level) - j0), roi.getType());
+      if (maxval > 255)
+        unpackBand<unsigned short>((unsigned char *) map + off, end - off,
+                                   t, 0, t.getRow(), name.c_str());
+      else
+        unpackBand<unsigned char>((unsigned char *) map + off, end - off,
+                                  t, 0, t.getRow(), name.c_str());
+
+      // the part of the tile within the region
+      i = max(top, i0);
+      j = max(left, j0);
+      n = min(top + r, i0 + t.getRow()) - i;
+      m = min(left + c, j0 + t.getCol()) - j;
+      for (k=0; k<nchan; k++)
+        for (u=0; u<n; u++)
+          memcpy(roi.rowPtr(i + u - top, k) + (j - left),
+                 t.rowPtr(i + u - i0, k) + (j - j0), m * sizeof(T));
+    });
+}
+
+void TiledReader::read(Image &roi, int top, int left, int r, int c,
+                       int level) {
+  region(roi, top, left, r, c, level);
+}
+
+void TiledReader::read(Image8 &roi, int top, int left, int r, int c,
+                       int level) {
+  region(roi, top, left, r, c, level);
+}
+
+void TiledReader::read(Image16 &roi, int top, int left, int r, int c,
+                       int level) {
+  region(roi, top, left, r, c, level);
+}
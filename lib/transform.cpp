@@ -13,6 +13,7 @@
  * Created: 01/24/06
  *
  * Modified:
+ *   - 10/17/26: the results keep the maxval of the input image
  *   - 07/30/09: correct perspective transformation
  **********************************************************/
 #include "Image.h"
@@ -30,7 +31,7 @@ using namespace std;
  * @param theta The rotation angle.
  * @return The rotated image.
  */
-Image rotate(Image &inimg, float theta) {
+Image rotate(const Image &inimg, float theta) {
   Image outimg;
   Image R(3,3), IR;   // the rotation matrix
   int i, j, k;
@@ -42,6 +43,7 @@ Image rotate(Image &inimg, float theta) {
   nt = inimg.getType();
   nchan = inimg.getChannel();
   outimg.createImage(nr, nc, nt);
+  outimg.setMaxval(inimg.getMaxval());
   
   // convert from degree to radian
   theta = theta * PI / 180.0;
@@ -81,7 +83,7 @@ Image rotate(Image &inimg, float theta) {
  * @param sy The scaling factor in the vertical direction
  * @return The scaled image.
  */
-Image scale(Image &inimg, float sx, float sy) {
+Image scale(const Image &inimg, float sx, float sy) {
   Image outimg;
   Image S(3,3), IS;   // the translation matrix
   int i, j, k;
@@ -93,6 +95,7 @@ Image scale(Image &inimg, float sx, float sy) {
   nt = inimg.getType();
   nchan = inimg.getChannel();
   outimg.createImage(nr, nc, nt);
+  outimg.setMaxval(inimg.getMaxval());
 
   S(0,0) = sx;
   S(0,1) = 0;
@@ -129,7 +132,7 @@ Image scale(Image &inimg, float sx, float sy) {
  * @param ty The translation in the vertical direction.
  * @return The translated image.
  */
-Image translate(Image &inimg, float tx, float ty) {
+Image translate(const Image &inimg, float tx, float ty) {
   Image outimg;
   Image T(3,3), IT;   // the translation matrix
   int i, j, k;
@@ -141,6 +144,7 @@ Image translate(Image &inimg, float tx, float ty) {
   nt = inimg.getType();
   nchan = inimg.getChannel();
   outimg.createImage(nr, nc, nt);
+  outimg.setMaxval(inimg.getMaxval());
 
   T(0,0) = 1;
   T(0,1) = 0;
@@ -177,7 +181,7 @@ Image translate(Image &inimg, float tx, float ty) {
  * @param hy The shear factor in the vertical direction.
  * @return The sheared image.
  */
-Image shear(Image &inimg, float hx, float hy) {
+Image shear(const Image &inimg, float hx, float hy) {
   Image outimg;
   Image H(3,3), IH;   // the translation matrix
   int i, j, k;
@@ -189,6 +193,7 @@ Image shear(Image &inimg, float hx, float hy) {
   nt = inimg.getType();
   nchan = inimg.getChannel();
   outimg.createImage(nr, nc, nt);
+  outimg.setMaxval(inimg.getMaxval());
 
   H(0,0) = 1;
   H(0,1) = hx;             // shear along the vertical direction
@@ -228,7 +233,7 @@ Image shear(Image &inimg, float hx, float hy) {
  * 
  * @return The image after perspective transformation.
  */
-Image perspective(Image &inimg, Image &tiepoints) {
+Image perspective(const Image &inimg, const Image &tiepoints) {
   Image outimg;
   Image P(3,3), IP;   // the translation matrix
   int i, j, k;
@@ -252,6 +257,7 @@ Image perspective(Image &inimg, Image &tiepoints) {
   nt = inimg.getType();
   nchan = inimg.getChannel();
   outimg.createImage(nr, nc, nt);
+  outimg.setMaxval(inimg.getMaxval());
    
   // find the 8 coefficients of projection matrix P, by solving AC=B
   // where C is a lexicographical representation of P
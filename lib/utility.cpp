@@ -7,8 +7,6 @@
  *   - psnr: peak signal-to-noise ratio
  *   - rmse: root mean square error
  *   - power: power of an image
- *   - sqrt: square root of an image (pixel wise)
- *   - abs: absolute value of an image (pixel wise)
  *   - norm: sqrt of summation
  *   - sum: summation of pixel intensity
  *   - var: variance of image
@@ -23,9 +21,15 @@
  *   - 02/12/06 - add abs()
  *   - 02/12/06 - add sum()
  *   - 11/04/08 - add var(), rmse()
+ *   - 10/17/26 - sqrt() and abs() of an image are lazy expressions now,
+ *                moved to ImageExpr.h
+ *   - 10/17/26 - sum(), power() and rmse() add up the rows with the
+ *                vectorized kernels of Reduce.h in double; rmse() and
+ *                psnr() handle color images
  **********************************************************/
 #include "Image.h"
 #include "Dip.h"
+#include "Reduce.h"
 #include <iostream>
 #include <cstdlib>
 #include <cmath>
@@ -143,20 +147,15 @@ double gaussrand() {
  * @param inimg2 The degraded image.
  * @return PSNR
  */
-float psnr(Image &inimg1, Image &inimg2) {
-  int i, j;
+float psnr(const Image &inimg1, const Image &inimg2) {
   int nc, nr, nchan;
 
   // get the dimension
   nc = inimg1.getCol();
   nr = inimg1.getRow();
   nchan = inimg1.getChannel();
-  if (nchan == 3) {
-    cout << "psnr: " 
-         << "This program does not handle color image.\n";
-    exit(3);
-  }
-  if (nr != inimg2.getRow() || nc != inimg2.getCol()) {
+  if (nr != inimg2.getRow() || nc != inimg2.getCol() ||
+      nchan != inimg2.getChannel()) {
     cout << "psnr: "
 	 << "The two input images do not have the same dimensions.\n";
     exit(3);
@@ -167,76 +166,51 @@ float psnr(Image &inimg1, Image &inimg2) {
 
 
 /**
- * Calculate root mean square error (RMSE).  
+ * Calculate root mean square error (RMSE) over all the pixels of all
+ * the channels. The squared errors are accumulated in double.
  * @param inimg1 The original image.
  * @param inimg2 The degraded image.
  * @return RMSE
  */
-float rmse(Image &inimg1, Image &inimg2) {
-  int i, j;
+float rmse(const Image &inimg1, const Image &inimg2) {
+  int i, k;
   int nc, nr, nchan;
-  float sum;
+  KahanSum sum;
 
   // get the dimension
   nc = inimg1.getCol();
   nr = inimg1.getRow();
   nchan = inimg1.getChannel();
-  if (nchan > 1) {
-    cout << "rmse: " 
-         << "This program does not handle color image.\n";
-    exit(3);
-  }
-  if (nr != inimg2.getRow() || nc != inimg2.getCol()) {
+  if (nr != inimg2.getRow() || nc != inimg2.getCol() ||
+      nchan != inimg2.getChannel()) {
     cout << "rmse: "
 	 << "The two input images do not have the same dimensions.\n";
     exit(3);
   }
     
-  // calculate root mean square error (RMSE)
-  sum = 0;
-  for (i=0; i<nr; i++)
-    for (j=0; j<nc; j++) 
-      sum += (inimg1(i,j) - inimg2(i,j)) * (inimg1(i,j) - inimg2(i,j));
-
-  return sqrt(sum/(nr*nc));
+  // calculate root mean square error (RMSE), one row at a time
+  for (k=0; k<nchan; k++)
+    for (i=0; i<nr; i++)
+      sum.add(rowSumSqDiff(inimg1.rowPtr(i,k), inimg2.rowPtr(i,k), nc));
+  
+  return sqrt(sum.get()/((double)nr*nc*nchan));
 }
 
 
 /**
- * Power of an image.
+ * Power of an image. The squares are accumulated in double.
  * @param inimg The input image.
  * @return The power of the image.
  */
-float power(Image &inimg) {
-  int i, j, k;
-  float p = 0.0;
-
-  for (i=0; i<inimg.getRow(); i++)
-    for (j=0; j<inimg.getCol(); j++)
-      for (k=0; k<inimg.getChannel(); k++)
-	    p += inimg(i,j,k) * inimg(i,j,k);
-
-  return p / inimg.getChannel();
-}
-
-
-/**
- * Square root of an image.
- * @param inimg The input image.
- * @return The square root of the image.
- */
-Image sqrt(Image &inimg) {
-  int i, j, k;
-  Image outimg;
-  
-  outimg.createImage(inimg.getRow(), inimg.getCol(), inimg.getType());
+float power(const Image &inimg) {
+  int i, k;
+  KahanSum p;
 
-  for (i=0; i<inimg.getRow(); i++)
-    for (j=0; j<inimg.getCol(); j++)
-      for (k=0; k<inimg.getChannel(); k++)
-	     outimg(i,j,k) = sqrt(inimg(i,j,k));
+  for (k=0; k<inimg.getChannel(); k++)
+    for (i=0; i<inimg.getRow(); i++)
+      p.add(rowSumSq(inimg.rowPtr(i,k), inimg.getCol()));
 
-  return outimg;
+  return p.get() / inimg.getChannel();
 }
 
 
@@ -261,40 +235,20 @@ void outofMemory() {
 
 
 /**
- * Absolute value of an image.
- * @param inimg The input image.
- * @return The absolute of the image.
- */
-Image abs(Image &inimg) {
-  int i, j, k;
-  Image outimg;
-  
-  outimg.createImage(inimg.getRow(), inimg.getCol(), inimg.getType());
-
-  for (i=0; i<inimg.getRow(); i++)
-    for (j=0; j<inimg.getCol(); j++)
-      for (k=0; k<inimg.getChannel(); k++)
-	     outimg(i,j,k) = fabs(inimg(i,j,k));
-
-  return outimg;
-}
-
-
-/**
- * Summation of all pixel intensities in an image.
+ * Summation of all pixel intensities in an image (their absolute
+ * values), accumulated in double.
  * @param inimg The input image.
  * @return The summation of all pixel intensities.
  */
-float sum(Image &inimg) {
-  int i, j, k;
-  float sum = 0.0;
+float sum(const Image &inimg) {
+  int i, k;
+  KahanSum sum;
   
-  for (i=0; i<inimg.getRow(); i++)
-    for (j=0; j<inimg.getCol(); j++)
-      for (k=0; k<inimg.getChannel(); k++)
-	     sum += fabs(inimg(i,j,k));
+  for (k=0; k<inimg.getChannel(); k++)
+    for (i=0; i<inimg.getRow(); i++)
+      sum.add(rowSumAbs(inimg.rowPtr(i,k), inimg.getCol()));
 
-  return sum;
+  return sum.get();
 }
 
 
@@ -10,6 +10,8 @@
  *   - wt2d: based on Tom Karnowski's project of Class 2005 
  * 
  * Last Modified:
+ *   - 10/17/26: wt2d transforms the rows and columns in place with one
+ *               workspace instead of copying each one out with subImage()
  *   - 12/01/07: instead of membership functions, written as standard
  *               function by hqi@utk.edu
  *               wt2d forward and inverse is handled in one function
@@ -22,59 +24,155 @@
 
 using namespace std;
 
+// coefficients for D4 wavelet transform
+static const double C0 = 0.4829629131445341;
+static const double C1 = 0.8365163037378079;
+static const double C2 = 0.2241438680420134;
+static const double C3 = -0.1294095225512604;
+
+// the filters producing the two halves (forward) or the even and odd 
+// samples (inverse) of the transform, applied to 4 input samples
+static const double LOWPASS[4] = {C0, C1, C2, C3};
+static const double HIGHPASS[4] = {C3, -C2, C1, -C0};
+static const double EVEN[4] = {C2, C1, C0, C3};
+static const double ODD[4] = {C3, -C0, C1, -C2};
+
+
 /**
- * Daubechies 4-coefficient wavelet filter. 
- * Reference: Numerical Recipe in C
- * @param inimg The input vector, whose length should be power of 2.
- * @param n The length of the low-passed signal, corresponding to the WT level
+ * Daubechies 4-coefficient wavelet filter on a vector of floats, the
+ * same as daub4() below.
+ * @param a The input vector, the coefficients are saved in a.
+ * @param n The length of the low-passed signal.
  * @param isign Apply wavelet filter when isign=1
  *              Apply the inverse when isign=-1
- * @return The wavelet coefficients at a certain level, saved in inimg
+ * @param wksp Workspace of at least n floats.
  **/
-
-void daub4(Image &inimg, int n, int isign)
+static void daub4(float *a, int n, int isign, float *wksp)
 {
-  // coefficients for D4 wavelet transform
-  const double C0 = 0.4829629131445341;
-  const double C1 = 0.8365163037378079;
-  const double C2 = 0.2241438680420134;
-  const double C3 = -0.1294095225512604;
-
-  Image wksp;
+  const double *h;
   int nh, nh1, i, j;
 
-  wksp.createImage(1,n);
+  if (n < 2)
+    return;
   nh1 = (nh=n>>1) + 1;
 
   if (isign>=0) {
     for (i=0,j=0; j<n-3; j+=2,i++) {
-      // the 1st half is the smoothed version of the input vector,
-      // obtained by applying the low-pass filter
-      wksp(0,i) = C0*inimg(0,j)+C1*inimg(0,j+1)+C2*inimg(0,j+2)+ 
-	C3*inimg(0,j+3);           
-      // the 2nd half is the detail obtained by applying the high-pass filter
-      wksp(0,i+nh) = C3*inimg(0,j)-C2*inimg(0,j+1)+C1*inimg(0,j+2)- 
-	C0*inimg(0,j+3);           
+      h = LOWPASS;
+      wksp[i] = h[0]*a[j]+h[1]*a[j+1]+h[2]*a[j+2]+h[3]*a[j+3];
+      h = HIGHPASS;
+      wksp[i+nh] = h[0]*a[j]+h[1]*a[j+1]+h[2]*a[j+2]+h[3]*a[j+3];
     }
     // taking care of the last coefficient from wrap-around values
-    wksp(0,i) = C0*inimg(0,n-2)+C1*inimg(0,n-1)+C2*inimg(0,0)+C3*inimg(0,1);
-    wksp(0,i+nh) = C3*inimg(0,n-2)-C2*inimg(0,n-1)+C1*inimg(0,0)-C0*inimg(0,1);
+    h = LOWPASS;
+    wksp[i] = h[0]*a[n-2]+h[1]*a[n-1]+h[2]*a[0]+h[3]*a[1];
+    h = HIGHPASS;
+    wksp[i+nh] = h[0]*a[n-2]+h[1]*a[n-1]+h[2]*a[0]+h[3]*a[1];
   }
   else {
-    wksp(0,0) = C2*inimg(0,nh-1)+C1*inimg(0,n-1)+C0*inimg(0,0)+
-      C3*inimg(0,nh1-1);
-    wksp(0,1) = C3*inimg(0,nh-1)-C0*inimg(0,n-1)+C1*inimg(0,0)- 
-      C2*inimg(0,nh1-1);
+    h = EVEN;
+    wksp[0] = h[0]*a[nh-1]+h[1]*a[n-1]+h[2]*a[0]+h[3]*a[nh1-1];
+    h = ODD;
+    wksp[1] = h[0]*a[nh-1]+h[1]*a[n-1]+h[2]*a[0]+h[3]*a[nh1-1];
     for (i=0,j=2; i<nh-1; i++) {
-      wksp(0,j++) = C2*inimg(0,i)+C1*inimg(0,i+nh)+C0*inimg(0,i+1)+ 
-	C3*inimg(0,i+nh1);
-      wksp(0,j++) = C3*inimg(0,i)-C0*inimg(0,i+nh)+C1*inimg(0,i+1)- 
-	C2*inimg(0,i+nh1);
+      h = EVEN;
+      wksp[j++] = h[0]*a[i]+h[1]*a[i+nh]+h[2]*a[i+1]+h[3]*a[i+nh1];
+      h = ODD;
+      wksp[j++] = h[0]*a[i]+h[1]*a[i+nh]+h[2]*a[i+1]+h[3]*a[i+nh1];
     }
   }
 
   for (i=0; i<n; i++)
-    inimg(0,i) = wksp(0,i);
+    a[i] = wksp[i];
+}
+
+
+/**
+ * Filter 4 rows of nc samples, out = h0*a + h1*b + h2*c + h3*d.
+ **/
+static void filterRows(float *out, const float *a, const float *b,
+                       const float *c, const float *d, 
+                       const double *h, int nc)
+{
+  int j;
+
+  for (j=0; j<nc; j++)
+    out[j] = h[0]*a[j]+h[1]*b[j]+h[2]*c[j]+h[3]*d[j];
+}
+
+
+/**
+ * Daubechies 4-coefficient wavelet filter applied to the columns of an 
+ * image. All the columns are filtered together one row at a time, so
+ * the pixels are visited in memory order instead of walking down each
+ * column. Gives the same coefficients as daub4() on each column.
+ * @param a The first row of the image, the coefficients are saved in a.
+ * @param stride The row pitch of the image.
+ * @param nc The number of columns.
+ * @param n The length of the low-passed signal (# of rows filtered).
+ * @param isign Apply wavelet filter when isign=1
+ *              Apply the inverse when isign=-1
+ * @param wksp Workspace of at least n*nc floats.
+ **/
+static void daub4Cols(float *a, int stride, int nc, int n, int isign, 
+                      float *wksp)
+{
+  int nh, nh1, i, j, m;
+
+#define ROW(r) (a + (r)*stride)
+  if (n < 2)
+    return;
+  nh1 = (nh=n>>1) + 1;
+
+  if (isign>=0) {
+    for (i=0,j=0; j<n-3; j+=2,i++) {
+      filterRows(wksp + i*nc, ROW(j), ROW(j+1), ROW(j+2), ROW(j+3),
+                 LOWPASS, nc);
+      filterRows(wksp + (i+nh)*nc, ROW(j), ROW(j+1), ROW(j+2), ROW(j+3),
+                 HIGHPASS, nc);
+    }
+    // taking care of the last coefficient from wrap-around values
+    filterRows(wksp + i*nc, ROW(n-2), ROW(n-1), ROW(0), ROW(1), 
+               LOWPASS, nc);
+    filterRows(wksp + (i+nh)*nc, ROW(n-2), ROW(n-1), ROW(0), ROW(1), 
+               HIGHPASS, nc);
+  }
+  else {
+    filterRows(wksp, ROW(nh-1), ROW(n-1), ROW(0), ROW(nh1-1), EVEN, nc);
+    filterRows(wksp + nc, ROW(nh-1), ROW(n-1), ROW(0), ROW(nh1-1), 
+               ODD, nc);
+    for (i=0,j=2; i<nh-1; i++,j+=2) {
+      filterRows(wksp + j*nc, ROW(i), ROW(i+nh), ROW(i+1), ROW(i+nh1), 
+                 EVEN, nc);
+      filterRows(wksp + (j+1)*nc, ROW(i), ROW(i+nh), ROW(i+1), ROW(i+nh1),
+                 ODD, nc);
+    }
+  }
+
+  for (i=0; i<n; i++)
+    for (m=0; m<nc; m++)
+      ROW(i)[m] = wksp[i*nc+m];
+#undef ROW
+}
+
+
+/**
+ * Daubechies 4-coefficient wavelet filter. 
+ * Reference: Numerical Recipe in C
+ * @param inimg The input vector, whose length should be power of 2.
+ * @param n The length of the low-passed signal, corresponding to the WT level
+ * @param isign Apply wavelet filter when isign=1
+ *              Apply the inverse when isign=-1
+ * @return The wavelet coefficients at a certain level, saved in inimg
+ **/
+
+void daub4(Image &inimg, int n, int isign)
+{
+  float *wksp;
+
+  wksp = new float [n];
+  daub4(inimg.rowPtr(0), n, isign, wksp);
+  delete [] wksp;
 }
 
 
@@ -84,7 +182,7 @@ void daub4(Image &inimg, int n, int isign)
  * @isign DWT when isign=1, IDWT isign=-1
  * @return 1-D DWT or IDWT.
  **/
-Image wt1d(Image &inimg, int isign)
+Image wt1d(const Image &inimg, int isign)
 {
   int nn, i, j, nr, nc, len, count;
   Image temp;
@@ -135,10 +233,11 @@ Image wt1d(Image &inimg, int isign)
  *         LL quadrant - horizontal edges (details in the vertical direction)
  *         LR quadrant - corners (details in both directions)
  **/
-Image wt2d(Image &inimg, int level, int isign)
+Image wt2d(const Image &inimg, int level, int isign)
 {
-  int i, j, nn1, nn2, nr, nc, nr2, nc2;
-  Image temp, inimg2;
+  int i, nn1, nn2, nr, nc, nr2, nc2, stride;
+  float *p, *wksp;
+  Image inimg2;
 
   nr = inimg.getRow();
   nc = inimg.getCol();
@@ -158,6 +257,11 @@ Image wt2d(Image &inimg, int level, int isign)
   else
     inimg2 = inimg;
 
+  // the transform is done in place, only one workspace is allocated
+  p = inimg2.rowPtr(0);         // unshares the pixels of inimg
+  stride = inimg2.getStride();
+  wksp = new float [nr2*nc2];
+
   // perform 2-D wt using Daubechies mother wavelet with 4 coefficients
   // somehow, when nn1 or nn2 is less than 4, still continue. need fix
   if (isign >= 0) {
@@ -165,20 +269,10 @@ Image wt2d(Image &inimg, int level, int isign)
 	   nn2>=(int)nr2/pow(2.0,(double)level); 
 	 nn1>>=1,nn2>>=1) {
       // WT in the horizontal direction
-      for (i=0; i<nr2; i++) {
-	temp = subImage(inimg2, i, 0, i, nc2-1);
-	daub4(temp, nn1, isign);
-	for (j=0; j<nc2; j++)
-	  inimg2(i,j) = temp(0,j);
-      }
+      for (i=0; i<nr2; i++)
+	daub4(p + i*stride, nn1, isign, wksp);
       // WT in the vertical direction
-      for (j=0; j<nc2; j++) {
-	temp = subImage(inimg2, 0, j, nr2-1, j);
-	temp = transpose(temp);
-	daub4(temp, nn2, isign);
-	for (i=0; i<nr2; i++)
-	  inimg2(i,j) = temp(0,i);
-      }
+      daub4Cols(p, stride, nc2, nn2, isign, wksp);
     }
   }
   else {
@@ -186,23 +280,15 @@ Image wt2d(Image &inimg, int level, int isign)
 	   nn2=(int)nr2/pow(2.0,(double)level); nn1<=nc2 && nn2<=nr2;
 	 nn1<<=1,nn2<<=1) {
       // WT in the horizontal direction
-      for (i=0; i<nr2; i++) {
-	temp = subImage(inimg2, i, 0, i, nc2-1);
-	daub4(temp, nn1, isign);
-	for (j=0; j<nc2; j++)
-	  inimg2(i,j) = temp(0,j);
-      }
+      for (i=0; i<nr2; i++)
+	daub4(p + i*stride, nn1, isign, wksp);
       // WT in the vertical direction
-      for (j=0; j<nc2; j++) {
-	temp = subImage(inimg2, 0, j, nr2-1, j);
-	temp = transpose(temp);
-	daub4(temp, nn2, isign);
-	for (i=0; i<nr2; i++)
-	  inimg2(i,j) = temp(0,i);
-      }
+      daub4Cols(p, stride, nc2, nn2, isign, wksp);
     }
   }
 
+  delete [] wksp;
+
   return inimg2;
 }
 